@@ -0,0 +1,56 @@
+(** Meter stream encoding benchmark: JSON frames vs compact delta packets
+
+    Simulates 100 tracks at 60 fps with slowly moving levels (a third of
+    the tracks hold still, as silent or static tracks do) and reports
+    CPU per tick and SSE bytes per second for each encoding.
+
+    Run with: dune exec bench/bench_meter_codec.exe *)
+
+let tracks = 100
+let fps = 60
+let ticks = 6000
+
+let channel db = Metering.{
+  rms_linear = db_to_linear db;
+  peak_linear = db_to_linear (db +. 4.0);
+  rms_db = db;
+  peak_db = db +. 4.0;
+}
+
+let frames_at tick =
+  let t = Float.of_int tick /. Float.of_int fps in
+  List.init tracks (fun i ->
+    let db =
+      if i mod 3 = 0 then -40.0
+      else -18.0 +. 6.0 *. Float.sin (t *. (0.5 +. Float.of_int i *. 0.03))
+    in
+    let c = channel db in
+    Metering.create_frame ~timestamp:t ~track_index:i ~output:Metering.{ left = c; right = c; mono_sum = c } ())
+
+let run name encode =
+  (* Frames are built up front so only encoding is timed *)
+  let inputs = Array.init ticks frames_at in
+  let bytes = ref 0 in
+  let minor0 = Gc.minor_words () in
+  let t0 = Unix.gettimeofday () in
+  Array.iteri (fun tick frames -> bytes := !bytes + String.length (encode tick frames)) inputs;
+  let elapsed = Unix.gettimeofday () -. t0 in
+  let words = Gc.minor_words () -. minor0 in
+  Printf.printf "  %-10s %8.1f us/tick %10.0f bytes/s %10.0f words/tick\n" name
+    (elapsed *. 1e6 /. Float.of_int ticks)
+    (Float.of_int !bytes /. (Float.of_int ticks /. Float.of_int fps))
+    (words /. Float.of_int ticks)
+
+let () =
+  Printf.printf "%d tracks at %d fps\n" tracks fps;
+  run "json" (fun _ frames ->
+    String.concat "" (List.map (fun frame ->
+      Sse.format_event (Sse.create_event ~event_type:Sse.Meter ~data:(Metering.frame_to_json frame) ())) frames));
+  run "json batch" (fun _ frames ->
+    Sse.format_event (Sse.create_event ~event_type:Sse.Meter
+      ~data:(`Assoc [("frames", `List (List.map Metering.frame_to_json frames))]) ()));
+  let enc = Sse.Meter_codec.create_encoder () in
+  run "compact" (fun tick frames ->
+    match Sse.Meter_codec.encode enc ~timestamp:(Float.of_int tick) frames with
+    | Some packet -> Sse.format_compact_event packet
+    | None -> "")
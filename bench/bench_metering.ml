@@ -0,0 +1,55 @@
+(** Stereo metering benchmark: split-array metering vs fused kernels,
+    true-peak oversampling against sample peak, and the STFT analyzer
+
+    Run with: dune exec bench/bench_metering.exe *)
+
+open Metering
+
+let sizes = [64; 256; 1024; 4096; 8192]
+
+let time name ~frames iterations f =
+  f ();
+  let minor0 = Gc.minor_words () in
+  let t0 = Unix.gettimeofday () in
+  for _ = 1 to iterations do f () done;
+  let elapsed = Unix.gettimeofday () -. t0 in
+  let words = Gc.minor_words () -. minor0 in
+  Printf.printf "  %-24s %8.2f ns/frame %10.1f words/call\n" name
+    (elapsed *. 1e9 /. float_of_int (iterations * frames))
+    (words /. float_of_int iterations)
+
+(** The previous implementation: split into L/R/mono arrays, two passes each *)
+let split_arrays samples =
+  let half = Array.length samples / 2 in
+  let left = Array.init half (fun i -> samples.(i * 2)) in
+  let right = Array.init half (fun i -> samples.(i * 2 + 1)) in
+  let mono = Array.init half (fun i -> (samples.(i * 2) +. samples.(i * 2 + 1)) /. 2.0) in
+  ignore (Sys.opaque_identity (meter_channel left, meter_channel right, meter_channel mono))
+
+let () =
+  List.iter (fun frames ->
+    let iterations = max 100 (4_000_000 / frames) in
+    let samples = Array.init (2 * frames) (fun i -> Float.sin (Float.of_int i *. 0.01)) in
+    let inter = Bigarray.Array1.of_array Bigarray.float32 Bigarray.c_layout samples in
+    let left = Bigarray.Array1.init Bigarray.float32 Bigarray.c_layout frames (fun i -> samples.(2 * i)) in
+    let right = Bigarray.Array1.init Bigarray.float32 Bigarray.c_layout frames (fun i -> samples.(2 * i + 1)) in
+    let acc = create_acc () in
+    let scope = create_goniometer () in
+    let tp = True_peak.create ~channels:2 () in
+    let stft = Spectrum.create ~sample_rate:48000.0 (Spectrum.create_plan 4096) in
+    Printf.printf "%d frames\n" frames;
+    time "split arrays" ~frames iterations (fun () -> split_arrays samples);
+    time "fused float array" ~frames iterations (fun () ->
+      reset_acc acc; accumulate_interleaved_array acc samples);
+    time "fused f32 interleaved" ~frames iterations (fun () ->
+      reset_acc acc; accumulate_interleaved acc inter);
+    time "fused f32 planar" ~frames iterations (fun () ->
+      reset_acc acc; accumulate_planar acc ~left ~right);
+    time "fused f32 + goniometer" ~frames iterations (fun () ->
+      reset_acc acc; accumulate_interleaved ~scope acc inter);
+    time "true peak f32 interleaved" ~frames iterations (fun () ->
+      True_peak.process_interleaved tp inter);
+    time "stft 4096 (one channel)" ~frames iterations (fun () ->
+      Spectrum.process_f32 ~stride:2 stft inter);
+    print_newline ()
+  ) sizes
@@ -0,0 +1,37 @@
+(** Metrics recording benchmark: cost of leaving instrumentation on
+
+    Measures histogram observations and counter increments on one domain
+    and on several domains at once (each recording into its own shard),
+    and the cost of a scrape.
+
+    Run with: dune exec bench/bench_metrics.exe *)
+
+let iterations = 10_000_000
+
+let h = Metrics.histogram ~label:"method" "bench_request_seconds"
+let c = Metrics.counter ~label:"operation" "bench_retries_total"
+
+let run name f =
+  f ();
+  let minor0 = Gc.minor_words () in
+  let t0 = Unix.gettimeofday () in
+  for _ = 1 to iterations do f () done;
+  let elapsed = Unix.gettimeofday () -. t0 in
+  Printf.printf "  %-24s %6.2f ns/op %8.3f words/op\n" name
+    (elapsed *. 1e9 /. Float.of_int iterations)
+    ((Gc.minor_words () -. minor0) /. Float.of_int iterations)
+
+let () =
+  Printf.printf "Recording (%d ops)\n" iterations;
+  run "observe" (fun () -> Metrics.observe h "tools/call" 0.0042);
+  run "incr" (fun () -> Metrics.incr c "transport_play");
+  List.iter (fun domains ->
+    let t0 = Unix.gettimeofday () in
+    List.init domains (fun _ ->
+      Domain.spawn (fun () -> for _ = 1 to iterations do Metrics.observe h "tools/call" 0.0042 done))
+    |> List.iter Domain.join;
+    Printf.printf "  observe x%d domains       %6.2f ns/op per domain\n" domains
+      ((Unix.gettimeofday () -. t0) *. 1e9 /. Float.of_int iterations)) [2; 4];
+  let t0 = Unix.gettimeofday () in
+  let text = Metrics.expose () in
+  Printf.printf "Scrape: %.1f us, %d bytes\n" ((Unix.gettimeofday () -. t0) *. 1e6) (String.length text)
@@ -0,0 +1,71 @@
+(** OSC codec benchmarks: Angstrom parser vs zero-copy Cstruct decoder,
+    and pooled encoder allocation for mixer bundles
+
+    Run with: dune exec bench/bench_osc.exe *)
+
+open Osc
+
+let iterations = 200_000
+
+let meter_message i =
+  Message {
+    address = Printf.sprintf "/track/%d/vu" (i + 1);
+    args = [Float32 0.5; Float32 0.25];
+  }
+
+let corpora = [
+  "message",
+  Serialize.serialize (Message {
+    address = "/track/1/volume";
+    args = [Int32 1l; Float32 0.75; String "Vocals"];
+  });
+  "bundle (16 msgs)",
+  Serialize.serialize (Bundle {
+    timetag = timetag_immediately;
+    elements = List.init 16 meter_message;
+  });
+  "nested bundle (4x8)",
+  Serialize.serialize (Bundle {
+    timetag = timetag_immediately;
+    elements = List.init 4 (fun _ ->
+      Bundle { timetag = timetag_immediately; elements = List.init 8 meter_message });
+  });
+]
+
+let time name f =
+  Gc.full_major ();
+  let minor0 = (Gc.quick_stat ()).minor_words in
+  let t0 = Unix.gettimeofday () in
+  for _ = 1 to iterations do
+    ignore (Sys.opaque_identity (f ()))
+  done;
+  let elapsed = Unix.gettimeofday () -. t0 in
+  let words = (Gc.quick_stat ()).minor_words -. minor0 in
+  Printf.printf "  %-22s %8.1f ns/op %10.1f words/op\n" name
+    (elapsed *. 1e9 /. float_of_int iterations)
+    (words /. float_of_int iterations);
+  elapsed
+
+let mixer_bundle =
+  Bundle {
+    timetag = timetag_immediately;
+    elements = List.init 32 (fun i ->
+      Message { address = Printf.sprintf "/track/%d/volume" (i + 1); args = [Float32 0.8] });
+  }
+
+let () =
+  Printf.printf "encode mixer bundle (32 tracks)\n";
+  let _ = time "string serialize" (fun () -> Serialize.serialize mixer_bundle) in
+  let b = Serialize.create_buffer () in
+  let _ = time "pooled encode" (fun () -> Serialize.encode b mixer_bundle) in
+  print_newline ();
+  List.iter (fun (label, data) ->
+    Printf.printf "%s (%d bytes)\n" label (String.length data);
+    let cs = Cstruct.of_string data in
+    let a = time "angstrom" (fun () -> Parse.parse data) in
+    let d = time "cstruct decode" (fun () -> Decode.decode cs) in
+    let _ = time "cstruct fold (address)" (fun () ->
+      Decode.fold_messages (fun n v ->
+        if Decode.address_equal v "/track/1/vu" then n + 1 else n) 0 cs) in
+    Printf.printf "  speedup: %.2fx\n\n" (a /. d)
+  ) corpora
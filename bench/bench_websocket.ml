@@ -0,0 +1,86 @@
+(** Transport benchmark: HTTP POST + SSE vs one WebSocket connection
+
+    Runs offline (no sockets) so it measures only what each transport
+    adds per message on the server: for a JSON-RPC round trip, parsing
+    the request line and headers and writing a response with headers vs
+    decoding and encoding a WebSocket frame; for a meter tick, a
+    base64 SSE event vs a binary frame. Reports CPU and bytes per
+    message.
+
+    Run with: dune exec bench/bench_websocket.exe *)
+
+let iterations = 100_000
+
+let request = {|{"jsonrpc":"2.0","id":42,"method":"tools/call","params":{"name":"daw_transport","arguments":{"action":"play"}}}|}
+let response = {|{"jsonrpc":"2.0","id":42,"result":{"content":[{"type":"text","text":"{\"success\":true}"}]}}|}
+
+let http_request body =
+  Printf.sprintf
+    "POST /mcp HTTP/1.1\r\nHost: localhost:8931\r\nContent-Type: application/json\r\nAccept: application/json, text/event-stream\r\nContent-Length: %d\r\n\r\n%s"
+    (String.length body) body
+
+(** Server side of one POST: parse as [run_http] does, write the reply *)
+let http_roundtrip input out =
+  let buf = Eio.Buf_read.of_string input in
+  ignore (Eio.Buf_read.line buf);
+  let content_length = ref 0 in
+  let rec headers () =
+    let line = Eio.Buf_read.line buf in
+    if line <> "" then begin
+      (match String.index_opt line ':' with
+       | Some i when String.lowercase_ascii (String.trim (String.sub line 0 i)) = "content-length" ->
+         content_length := int_of_string (String.trim (String.sub line (i + 1) (String.length line - i - 1)))
+       | _ -> ());
+      headers ()
+    end
+  in
+  headers ();
+  ignore (Eio.Buf_read.take !content_length buf);
+  Buffer.add_string out (Printf.sprintf
+    "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nAccess-Control-Allow-Origin: *\r\nContent-Length: %d\r\n\r\n"
+    (String.length response));
+  Buffer.add_string out response
+
+let measure name ~bytes f =
+  let minor0 = Gc.minor_words () in
+  let t0 = Unix.gettimeofday () in
+  for _ = 1 to iterations do f () done;
+  let elapsed = Unix.gettimeofday () -. t0 in
+  Printf.printf "  %-16s %8.2f us/msg %8d bytes/msg %8.0f words/msg\n" name
+    (elapsed *. 1e6 /. Float.of_int iterations) bytes
+    ((Gc.minor_words () -. minor0) /. Float.of_int iterations)
+
+let meter_frames =
+  List.init 16 (fun i ->
+    let c = Metering.{
+      rms_linear = db_to_linear (-18.0); peak_linear = db_to_linear (-14.0);
+      rms_db = -18.0; peak_db = -14.0 } in
+    Metering.create_frame ~timestamp:0.0 ~track_index:i ~output:Metering.{ left = c; right = c; mono_sum = c } ())
+
+let () =
+  Eio_main.run @@ fun _env ->
+  let mask = "\x37\xfa\x21\x3d" in
+  Printf.printf "JSON-RPC round trip (%d iterations)\n" iterations;
+  let input = http_request request in
+  let out = Buffer.create 512 in
+  http_roundtrip input out;
+  measure "http post" ~bytes:(String.length input + Buffer.length out) (fun () ->
+    Buffer.clear out;
+    http_roundtrip input out);
+  let frame = Websocket.encode_frame ~mask ~opcode:Websocket.op_text request in
+  let reply = Websocket.encode_frame ~opcode:Websocket.op_text response in
+  measure "websocket" ~bytes:(String.length frame + String.length reply) (fun () ->
+    Buffer.clear out;
+    let ws = Websocket.create (Eio.Buf_read.of_string frame) (Eio.Flow.buffer_sink out) in
+    (match Websocket.read_message ws with
+     | Websocket.Text _ -> Websocket.send_text ws response
+     | _ -> assert false));
+
+  Printf.printf "Meter tick, %d tracks keyframe\n" (List.length meter_frames);
+  let packet =
+    Option.get (Sse.Meter_codec.encode (Sse.Meter_codec.create_encoder ()) ~timestamp:0.0 meter_frames)
+  in
+  measure "sse base64" ~bytes:(String.length (Sse.format_compact_event packet)) (fun () ->
+    ignore (Sse.format_compact_event packet));
+  measure "websocket binary" ~bytes:(String.length (Websocket.encode_frame ~opcode:Websocket.op_binary packet))
+    (fun () -> ignore (Websocket.encode_frame ~opcode:Websocket.op_binary packet))
@@ -36,8 +36,38 @@ let classify_jsonrpc_message (body : string) : jsonrpc_kind =
        | _ -> `Unknown)
   | _ -> `Unknown
 
-(** Run stdio transport - reads JSON-RPC from stdin, writes to stdout *)
-let run_stdio () =
+(** Response line for a JSON-RPC message; notifications, responses and
+    cancelled requests get none. [session] scopes request ids (one per
+    connection). *)
+let handle_message_line ~ctx ~session line =
+  match classify_jsonrpc_message line with
+  | `Notification ->
+      ignore (Daw_mcp.Mcp_server.process_line_with_context ~ctx ~session line);
+      None
+  | `Response ->
+      (* Response: ignore for server-only stdio usage *)
+      None
+  | `Request | `Unknown ->
+      Daw_mcp.Mcp_server.process_line_with_context_opt ~ctx ~session line
+
+(** Run [handle] on a message as the root span of a (sampled) trace *)
+let traced handle line = Metrics.Trace.with_trace ~cat:"jsonrpc" "jsonrpc" (fun () -> handle line)
+
+(** Read lines from [buf] and hand each non-empty one to [dispatch] until
+    end of input, then wait for the responses still in flight *)
+let dispatch_lines dispatch handle buf =
+  let rec loop () =
+    match Eio.Buf_read.line buf with
+    | line ->
+      if String.length line > 0 then Daw_mcp.Dispatch.submit dispatch (traced handle) line;
+      loop ()
+    | exception End_of_file -> Daw_mcp.Dispatch.drain dispatch
+  in
+  loop ()
+
+(** Run stdio transport - reads JSON-RPC from stdin, writes to stdout.
+    Lines are handled concurrently, up to [max_in_flight] at a time. *)
+let run_stdio ~max_in_flight ~ordering () =
   setup_logging (Some Logs.Warning);
   Logs.info (fun m -> m "DAW MCP starting (stdio mode)");
 
@@ -45,31 +75,21 @@ let run_stdio () =
   let net = Eio.Stdenv.net env in
   let clock = Eio.Stdenv.clock env in
   Daw_drivers.Time_compat.set_clock clock;
+  Transport.Applescript.set_process_mgr (Eio.Stdenv.process_mgr env);
   let stdin_flow = Eio.Stdenv.stdin env in
   let stdout_flow = Eio.Stdenv.stdout env in
 
   Eio.Switch.run @@ fun sw ->
-  let ctx = Daw_mcp.Mcp_server.create_context ~sw ~net ~clock in
+  let ctx = Daw_mcp.Mcp_server.create_context ~sw ~net ~clock () in
   let buf = Eio.Buf_read.of_flow ~max_size:1_000_000 stdin_flow in
 
-  (* Simple line-by-line processing *)
+  let dispatch =
+    Daw_mcp.Dispatch.create ~sw ~max_in_flight ~ordering (fun text -> Eio.Flow.copy_string text stdout_flow)
+  in
   try
-    while true do
-      let line = Eio.Buf_read.line buf in
-      if String.length line > 0 then begin
-        match classify_jsonrpc_message line with
-        | `Notification ->
-            ignore (Daw_mcp.Mcp_server.process_line_with_context ~ctx line)
-        | `Response ->
-            (* Response: ignore for server-only stdio usage *)
-            ()
-        | `Request | `Unknown ->
-            let response = Daw_mcp.Mcp_server.process_line_with_context ~ctx line in
-            Eio.Flow.copy_string (response ^ "\n") stdout_flow
-      end
-    done
+    dispatch_lines dispatch (handle_message_line ~ctx ~session:(Daw_mcp.Mcp_server.new_session ())) buf;
+    Logs.info (fun m -> m "DAW MCP shutting down")
   with
-  | End_of_file -> Logs.info (fun m -> m "DAW MCP shutting down")
   | Eio.Buf_read.Buffer_limit_exceeded -> Logs.err (fun m -> m "Input too large")
 
 (** Parse HTTP request line into (method, path) *)
@@ -83,41 +103,136 @@ let send_sse_event flow ~event ~data =
   let msg = Printf.sprintf "event: %s\ndata: %s\n\n" event data in
   Eio.Flow.copy_string msg flow
 
-(** SSE client registry for shutdown notification *)
-type sse_client = {
-  flow: Eio.Flow.sink_ty Eio.Resource.t;
-  mutable connected: bool;
-}
-let sse_clients : (int, sse_client) Hashtbl.t = Hashtbl.create 16
-let sse_client_counter = ref 0
-
-let register_sse_client flow =
-  incr sse_client_counter;
-  let id = !sse_client_counter in
-  let client = { flow; connected = true } in
-  Hashtbl.add sse_clients id client;
-  id
-
-let unregister_sse_client id =
-  (match Hashtbl.find_opt sse_clients id with
-   | Some c -> c.connected <- false
-   | None -> ());
-  Hashtbl.remove sse_clients id
-
-let broadcast_sse_shutdown reason =
+(** Shutdown notification for SSE clients *)
+let sse_shutdown_event reason =
   let data = Printf.sprintf
     {|{"jsonrpc":"2.0","method":"notifications/shutdown","params":{"reason":"%s","message":"Server is shutting down, please reconnect"}}|}
     reason
   in
-  let msg = Printf.sprintf "event: notification\ndata: %s\n\n" data in
-  Hashtbl.iter (fun _ client ->
-    if client.connected then
-      try Eio.Flow.copy_string msg client.flow with Eio.Io _ | End_of_file -> ()
-  ) sse_clients
+  Printf.sprintf "event: notification\ndata: %s\n\n" data
 
 (** Graceful shutdown exception *)
 exception Shutdown
 
+(** Meter hub tracks: master plus 16 tracks *)
+let meter_tracks = 17
+
+(** Stand-in audio for the meter hub until a DAW audio bridge feeds it:
+    a phase-continuous sine per track, a little quieter and higher each
+    track, panned slightly so the stereo field is non-trivial *)
+let simulated_meter_source ~sample_rate =
+  let phases = Array.make meter_tracks 0.0 in
+  fun track (block : Metering.float32_buffer) ->
+    let freq = 220.0 *. Float.of_int (track + 1) in
+    let amp = 0.5 /. Float.of_int (track + 1) in
+    let step = 2.0 *. Float.pi *. freq /. sample_rate in
+    let pan = 0.1 *. Float.of_int (track mod 3 - 1) in
+    let phase = ref phases.(track) in
+    for i = 0 to Bigarray.Array1.dim block / 2 - 1 do
+      let x = amp *. sin !phase in
+      Bigarray.Array1.unsafe_set block (2 * i) (x *. (1.0 -. pan));
+      Bigarray.Array1.unsafe_set block (2 * i + 1) (x *. (1.0 +. pan));
+      phase := !phase +. step
+    done;
+    phases.(track) <- Float.rem !phase (2.0 *. Float.pi)
+
+(** Apply [?frame_rate=], [?track_indices=1,2] and [?encoding=] query
+    overrides to a meter stream configuration *)
+let meter_config_of_query (config : Sse.stream_config) query =
+  List.fold_left (fun (config : Sse.stream_config) pair ->
+    match String.split_on_char '=' pair with
+    | ["frame_rate"; v] ->
+      (match int_of_string_opt v with
+       | Some fps when fps > 0 -> { config with Sse.frame_rate = fps }
+       | _ -> config)
+    | ["track_indices"; v] ->
+      let tracks = List.filter_map int_of_string_opt (String.split_on_char ',' v) in
+      { config with Sse.track_indices = (if tracks = [] then None else Some tracks) }
+    | ["encoding"; v] ->
+      (match Sse.encoding_of_string v with
+       | Some encoding -> { config with Sse.encoding }
+       | None -> config)
+    | _ -> config) config (String.split_on_char '&' query)
+
+(** The [data:] lines of an SSE event; [None] for keepalives
+    ([event: ping]) and comment-only events *)
+let sse_payload text =
+  let lines = String.split_on_char '\n' text in
+  if List.mem "event: ping" lines then None
+  else
+    match
+      List.filter_map (fun line ->
+        if String.starts_with ~prefix:"data: " line then Some (String.sub line 6 (String.length line - 6))
+        else None) lines
+    with
+    | [] -> None
+    | lines -> Some (String.concat "\n" lines)
+
+(** Raised to end a WebSocket connection's switch *)
+exception Websocket_done
+
+(** One WebSocket connection: JSON-RPC requests are handled concurrently
+    (see [Daw_mcp.Dispatch]) and answered as text messages, broadcast
+    notifications are pushed as text messages (keepalives become
+    WebSocket pings), and with [meter_config] the meter hub's frames
+    arrive as binary [Meter_codec] packets (or JSON text for a JSON
+    stream). Returns when the client closes or disconnects, cancelling
+    its calls still in flight. A client
+    dropped by the broadcast (evicted, or a failed write) has missed
+    notifications, so it is closed with status 1013 to make it
+    reconnect. *)
+let serve_websocket ~ctx ~sse ~meters ?meter_config buf flow =
+  let ws = Websocket.create buf flow in
+  let session = Daw_mcp.Mcp_server.new_session () in
+  let send_payload text =
+    match sse_payload text with
+    | Some data -> Websocket.send_text ws data
+    | None -> Websocket.send_ping ws ""
+  in
+  try
+    Eio.Switch.run @@ fun sw ->
+    (* Pushes run as daemons so they stop when the request loop ends *)
+    Eio.Fiber.fork_daemon ~sw (fun () ->
+      Sse.Broadcast.serve sse send_payload;
+      Websocket.close ~code:1013 ws;
+      Eio.Switch.fail sw Websocket_done;
+      `Stop_daemon);
+    Option.iter (fun (config : Sse.stream_config) ->
+      Eio.Fiber.fork_daemon ~sw (fun () ->
+        let sub = Sse.subscribe ~raw:true meters config in
+        Fun.protect ~finally:(fun () -> Sse.unsubscribe meters sub) (fun () ->
+          while true do
+            let payload = Sse.next_event sub in
+            match config.Sse.encoding with
+            | Sse.Compact -> Websocket.send_binary ws payload
+            | Sse.Json -> Websocket.send_text ws payload
+          done;
+          `Stop_daemon))) meter_config;
+    (* Requests run concurrently so [notifications/cancelled] reaches them *)
+    let dispatch = Daw_mcp.Dispatch.create ~sw ~delimiter:"" (Websocket.send_text ws) in
+    let rec loop () =
+      match Websocket.read_message ws with
+      | Websocket.Text body ->
+        Daw_mcp.Dispatch.submit dispatch (traced (handle_message_line ~ctx ~session)) body;
+        loop ()
+      | Websocket.Binary _ -> loop ()
+      | Websocket.Close _ -> ()
+    in
+    loop ();
+    (* Answers can no longer be sent: cancel the calls still in flight
+       rather than waiting for them *)
+    Eio.Switch.fail sw Websocket_done
+  with Websocket_done | Eio.Io _ | End_of_file -> ()
+
+(** Expose integer fields of a JSON stats object as metrics sampled at
+    scrape time; counters get a [_total] suffix *)
+let sample_stats ~prefix stats fields =
+  List.iter (fun (field, counter, help) ->
+    Metrics.sampled ~counter ~help (prefix ^ field ^ if counter then "_total" else "") (fun () ->
+      match Yojson.Safe.Util.member field (stats ()) with
+      | `Int n -> [("", Float.of_int n)]
+      | _ -> [])) fields
+
 (** Run HTTP transport using Eio with SSE support for MCP streamable-http *)
 let run_http port =
   setup_logging (Some Logs.Info);
@@ -127,25 +242,16 @@ let run_http port =
   let net = Eio.Stdenv.net env in
   let clock = Eio.Stdenv.clock env in
   Daw_drivers.Time_compat.set_clock clock;
+  Transport.Applescript.set_process_mgr (Eio.Stdenv.process_mgr env);
 
-  (* Graceful shutdown setup *)
-  let switch_ref = ref None in
-  let shutdown_initiated = ref false in
+  (* Graceful shutdown setup: the signal handler only records the signal
+     and wakes the shutdown fiber, which does the Eio work *)
+  let shutdown_signal = ref None in
+  let shutdown_requested = Eio.Condition.create () in
   let initiate_shutdown signal_name =
-    if not !shutdown_initiated then begin
-      shutdown_initiated := true;
-      Logs.info (fun m -> m "DAW MCP: Received %s, shutting down gracefully..." signal_name);
-
-      (* Broadcast shutdown notification to all SSE clients *)
-      broadcast_sse_shutdown signal_name;
-      Logs.info (fun m -> m "DAW MCP: Sent shutdown notification to %d SSE clients" (Hashtbl.length sse_clients));
-
-      (* Give clients 500ms to receive the notification *)
-      Unix.sleepf 0.5;
-
-      match !switch_ref with
-      | Some sw -> Eio.Switch.fail sw Shutdown
-      | None -> ()
+    if !shutdown_signal = None then begin
+      shutdown_signal := Some signal_name;
+      Eio.Condition.broadcast shutdown_requested
     end
   in
   Sys.set_signal Sys.sigterm (Sys.Signal_handle (fun _ -> initiate_shutdown "SIGTERM"));
@@ -153,14 +259,62 @@ let run_http port =
 
   (try
   Eio.Switch.run @@ fun sw ->
-  switch_ref := Some sw;
-  let ctx = Daw_mcp.Mcp_server.create_context ~sw ~net ~clock in
+  let sse = Sse.Broadcast.create () in
+  Eio.Fiber.fork_daemon ~sw (fun () -> Sse.Broadcast.run_keepalive sse ~clock);
+  Eio.Fiber.fork_daemon ~sw (fun () ->
+    let signal_name =
+      Eio.Condition.loop_no_mutex shutdown_requested (fun () -> !shutdown_signal)
+    in
+    Logs.info (fun m -> m "DAW MCP: Received %s, shutting down gracefully..." signal_name);
+    (* Notify every SSE client through its own queue, then give the
+       writers up to 500ms to deliver *)
+    let clients = Sse.Broadcast.clients sse in
+    Sse.Broadcast.publish sse Sse.Broadcast.Notification (sse_shutdown_event signal_name);
+    Sse.Broadcast.flush sse ~clock ~timeout:0.5;
+    Logs.info (fun m -> m "DAW MCP: Sent shutdown notification to %d SSE clients (%d undelivered)"
+      clients (Sse.Broadcast.total_depth sse));
+    Eio.Switch.fail sw Shutdown;
+    `Stop_daemon);
+  let sample_rate = 48000.0 in
+  let meters =
+    (* Spare cores meter in parallel once the bank has enough tracks *)
+    let domains = max 0 (min 4 (Domain.recommended_domain_count () - 1)) in
+    Sse.create_hub ~domains ~sample_rate ~tracks:meter_tracks
+      ~source:(simulated_meter_source ~sample_rate) ()
+  in
+  Eio.Switch.on_release sw (fun () -> Sse.shutdown_hub meters);
+  (* One monotonic tick source times every meter stream *)
+  let ticker = Sse.Ticker.create (Eio.Stdenv.mono_clock env) in
+  Eio.Fiber.fork_daemon ~sw (fun () -> Sse.Ticker.run ticker);
+  Eio.Fiber.fork_daemon ~sw (fun () -> Sse.run_hub meters ~ticker);
+  let ctx = Daw_mcp.Mcp_server.create_context ~meters ~sw ~net ~clock () in
+  sample_stats ~prefix:"daw_sse_" (fun () -> Sse.Broadcast.stats sse) [
+    ("clients", false, "Connected SSE clients");
+    ("queued", false, "Events queued across SSE clients");
+    ("max_depth", false, "Deepest SSE client queue");
+    ("delivered", true, "SSE events written");
+    ("coalesced", true, "Meter events replaced before delivery");
+    ("evictions", true, "SSE clients evicted for a full queue");
+    ("write_errors", true, "SSE writes that failed");
+  ];
+  sample_stats ~prefix:"daw_meter_" (fun () -> Sse.hub_stats meters) [
+    ("subscribers", false, "Meter stream subscribers");
+    ("groups", false, "Meter stream groups");
+    ("events", true, "Meter events produced");
+    ("dropped", true, "Meter events dropped for slow subscribers");
+  ];
+  Metrics.sampled ~counter:true ~help:"osascript children killed on cancellation"
+    "daw_osascript_killed_total" (fun () -> [("", Float.of_int (Transport.Applescript.killed ()))]);
   let addr = `Tcp (Eio.Net.Ipaddr.V4.loopback, port) in
   let socket = Eio.Net.listen ~sw ~backlog:128 ~reuse_addr:true net addr in
 
   Logs.info (fun m -> m "Listening on http://127.0.0.1:%d" port);
   Logs.info (fun m -> m "  GET /mcp  -> SSE stream (streamable-http)");
   Logs.info (fun m -> m "  POST /mcp -> JSON-RPC requests");
+  Logs.info (fun m -> m "  GET /mcp/meters/<stream> -> meter SSE stream (daw_meter_stream)");
+  Logs.info (fun m -> m "  GET /metrics -> Prometheus metrics");
+  Logs.info (fun m -> m "  GET /debug/trace -> sampled request spans (Chrome trace JSON, ?traces=N)");
+  Logs.info (fun m -> m "  GET /mcp/ws -> WebSocket (JSON-RPC both ways, ?meters=<stream> for binary meters)");
   Logs.info (fun m -> m "  Graceful shutdown: SIGTERM/SIGINT supported");
 
   (* Accept connections *)
@@ -169,22 +323,30 @@ let run_http port =
       Logs.err (fun m -> m "Connection error: %s" (Printexc.to_string exn))
     ) (fun flow _addr ->
       let buf = Eio.Buf_read.of_flow ~max_size:1_000_000 flow in
+      let request_start = Metrics.Trace.now () in
 
       (* Parse request line *)
       let first_line = Eio.Buf_read.line buf in
       let (http_method, path) = parse_request_line first_line in
       Logs.info (fun m -> m "Request: %s %s" http_method path);
 
-      (* Parse headers and extract Content-Length *)
+      (* Parse headers (lowercase names); extract Content-Length and Last-Event-ID *)
       let content_length = ref 0 in
+      let last_event_id = ref None in
+      let request_headers = ref [] in
       let rec parse_headers () =
         let line = Eio.Buf_read.line buf in
         if String.length line > 0 then begin
-          let lower = String.lowercase_ascii line in
-          if String.length lower > 15 && String.sub lower 0 15 = "content-length:" then begin
-            let value_str = String.trim (String.sub line 15 (String.length line - 15)) in
-            content_length := int_of_string_opt value_str |> Option.value ~default:0
-          end;
+          (match String.index_opt line ':' with
+           | Some i ->
+             let name = String.lowercase_ascii (String.trim (String.sub line 0 i)) in
+             let value = String.trim (String.sub line (i + 1) (String.length line - i - 1)) in
+             request_headers := (name, value) :: !request_headers;
+             if name = "content-length" then
+               content_length := int_of_string_opt value |> Option.value ~default:0
+             else if name = "last-event-id" then
+               last_event_id := Sse.Replay.parse_id value
+           | None -> ());
           parse_headers ()
         end
       in
@@ -195,9 +357,6 @@ let run_http port =
         (* SSE stream for MCP streamable-http *)
         Logs.info (fun m -> m "SSE client connected");
 
-        (* Register client for shutdown broadcast *)
-        let client_id = register_sse_client (flow :> Eio.Flow.sink_ty Eio.Resource.t) in
-
         let headers = String.concat "\r\n" [
           "HTTP/1.1 200 OK";
           "Content-Type: text/event-stream";
@@ -211,15 +370,76 @@ let run_http port =
         (* Send initial endpoint event (MCP protocol) *)
         send_sse_event flow ~event:"endpoint" ~data:"/mcp";
 
-        (* Keep connection alive with periodic pings *)
-        (try
-          while true do
-            Eio.Time.sleep clock 15.0;
-            send_sse_event flow ~event:"ping" ~data:(string_of_float (Daw_drivers.Time_compat.now ()))
-          done
-        with Eio.Io _ | End_of_file ->
-          unregister_sse_client client_id;
-          Logs.info (fun m -> m "SSE client disconnected"))
+        (* Notifications and shared-wheel keepalives arrive through this
+           client's own queue and writer *)
+        Sse.Broadcast.serve ?last_event_id:!last_event_id sse
+          ~snapshot:(fun () -> Yojson.Safe.to_string (Daw_mcp.Mcp_server.context_status ctx))
+          (fun text -> Eio.Flow.copy_string text flow);
+        Logs.info (fun m -> m "SSE client disconnected")
+
+      | "GET", ws_path when ws_path = "/mcp/ws" || String.starts_with ~prefix:"/mcp/ws?" ws_path ->
+        (match Websocket.upgrade_key !request_headers with
+         | None ->
+           let body = "Expected a WebSocket upgrade" in
+           let headers = Printf.sprintf
+             "HTTP/1.1 400 Bad Request\r\nContent-Length: %d\r\n\r\n" (String.length body)
+           in
+           Eio.Flow.copy_string headers flow;
+           Eio.Flow.copy_string body flow
+         | Some key ->
+           let query =
+             match String.index_opt ws_path '?' with
+             | Some i -> String.sub ws_path (i + 1) (String.length ws_path - i - 1)
+             | None -> ""
+           in
+           let meter_config =
+             List.find_map (fun pair ->
+               match String.split_on_char '=' pair with
+               | ["meters"; id] ->
+                 Option.map (fun config -> meter_config_of_query config query)
+                   (Sse.meter_stream_config meters id)
+               | _ -> None) (String.split_on_char '&' query)
+           in
+           Eio.Flow.copy_string (Websocket.handshake_response ~key) flow;
+           Logs.info (fun m -> m "WebSocket client connected");
+           serve_websocket ~ctx ~sse ~meters ?meter_config buf flow;
+           Logs.info (fun m -> m "WebSocket client disconnected"))
+
+      | "GET", meter_path when String.starts_with ~prefix:"/mcp/meters/" meter_path ->
+        let rest = String.sub meter_path 12 (String.length meter_path - 12) in
+        let stream_id, query =
+          match String.index_opt rest '?' with
+          | Some i -> (String.sub rest 0 i, String.sub rest (i + 1) (String.length rest - i - 1))
+          | None -> (rest, "")
+        in
+        (match Sse.meter_stream_config meters stream_id with
+         | None ->
+           let body = "Unknown meter stream" in
+           let headers = Printf.sprintf
+             "HTTP/1.1 404 Not Found\r\nContent-Length: %d\r\n\r\n" (String.length body)
+           in
+           Eio.Flow.copy_string headers flow;
+           Eio.Flow.copy_string body flow
+         | Some config ->
+           let config = meter_config_of_query config query in
+           let headers = String.concat "\r\n" [
+             "HTTP/1.1 200 OK";
+             "Content-Type: text/event-stream";
+             "Cache-Control: no-cache";
+             "Connection: keep-alive";
+             "Access-Control-Allow-Origin: *";
+             "\r\n"
+           ] in
+           Eio.Flow.copy_string headers flow;
+           let sub = Sse.subscribe ?last_event_id:!last_event_id meters config in
+           Logs.info (fun m -> m "Meter client joined %s" stream_id);
+           (try
+              Fun.protect ~finally:(fun () -> Sse.unsubscribe meters sub) (fun () ->
+                while true do
+                  Eio.Flow.copy_string (Sse.next_event sub) flow
+                done)
+            with Eio.Io _ | End_of_file ->
+              Logs.info (fun m -> m "Meter client left %s" stream_id)))
 
       | "GET", "/health" ->
         let body = "OK" in
@@ -230,15 +450,53 @@ let run_http port =
         Eio.Flow.copy_string headers flow;
         Eio.Flow.copy_string body flow
 
+      | "GET", "/metrics" ->
+        let body = Metrics.expose () in
+        let headers = Printf.sprintf
+          "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %d\r\n\r\n"
+          Metrics.content_type (String.length body)
+        in
+        Eio.Flow.copy_string headers flow;
+        Eio.Flow.copy_string body flow
+
+      | "GET", trace_path when trace_path = "/debug/trace" || String.starts_with ~prefix:"/debug/trace?" trace_path ->
+        let traces =
+          match String.index_opt trace_path '?' with
+          | Some i ->
+            List.find_map (fun pair ->
+              match String.split_on_char '=' pair with
+              | ["traces"; n] -> int_of_string_opt n
+              | _ -> None)
+              (String.split_on_char '&' (String.sub trace_path (i + 1) (String.length trace_path - i - 1)))
+          | None -> None
+        in
+        let body = Metrics.Trace.export ?traces () in
+        let headers = Printf.sprintf
+          "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nAccess-Control-Allow-Origin: *\r\nContent-Length: %d\r\n\r\n"
+          (String.length body)
+        in
+        Eio.Flow.copy_string headers flow;
+        Eio.Flow.copy_string body flow
+
       | "POST", "/mcp" | "POST", "/" ->
-        (* JSON-RPC request *)
+        (* JSON-RPC request, traced from its first byte when sampled *)
+        Metrics.Trace.with_trace ~cat:"http" ~start:request_start "POST /mcp" @@ fun () ->
+        Metrics.Trace.finish ~cat:"http" "http.headers" ~start:request_start;
         let body =
-          if !content_length > 0 then Eio.Buf_read.take !content_length buf
-          else ""
+          Metrics.Trace.span ~cat:"http" "http.body" (fun () ->
+            if !content_length > 0 then Eio.Buf_read.take !content_length buf
+            else "")
+        in
+        (* Each POST is its own connection: cancellation works within an
+           MCP session (Mcp-Session-Id), never across clients *)
+        let session =
+          match List.assoc_opt "mcp-session-id" !request_headers with
+          | Some id -> "http:" ^ id
+          | None -> Daw_mcp.Mcp_server.new_session ()
         in
         (match classify_jsonrpc_message body with
          | `Notification ->
-             ignore (Daw_mcp.Mcp_server.process_json_with_context ~ctx body);
+             ignore (Daw_mcp.Mcp_server.process_json_with_context ~ctx ~session body);
              let headers = String.concat "\r\n" [
                "HTTP/1.1 202 Accepted";
                "Access-Control-Allow-Origin: *";
@@ -255,14 +513,17 @@ let run_http port =
              ] in
              Eio.Flow.copy_string headers flow
          | `Request | `Unknown ->
-             let response = Daw_mcp.Mcp_server.process_json_with_context ~ctx body in
-             let response_body = Yojson.Safe.to_string response in
+             let response = Daw_mcp.Mcp_server.process_json_with_context ~ctx ~session body in
+             let response_body =
+               Metrics.Trace.span ~cat:"json" "json.encode" (fun () -> Yojson.Safe.to_string response)
+             in
              let headers = Printf.sprintf
                "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nAccess-Control-Allow-Origin: *\r\nContent-Length: %d\r\n\r\n"
                (String.length response_body)
              in
-             Eio.Flow.copy_string headers flow;
-             Eio.Flow.copy_string response_body flow)
+             Metrics.Trace.span ~cat:"http" "http.write" (fun () ->
+               Eio.Flow.copy_string headers flow;
+               Eio.Flow.copy_string response_body flow))
 
       | "OPTIONS", _ ->
         (* CORS preflight *)
@@ -292,7 +553,7 @@ let run_http port =
       Logs.info (fun m -> m "DAW MCP: Shutdown complete."))
 
 (** Run Unix socket transport for AU/CLAP plugin IPC *)
-let run_socket socket_path =
+let run_socket ~max_in_flight ~ordering socket_path =
   setup_logging (Some Logs.Info);
   Logs.info (fun m -> m "DAW MCP starting (Unix socket mode: %s)" socket_path);
 
@@ -303,6 +564,7 @@ let run_socket socket_path =
   let net = Eio.Stdenv.net env in
   let clock = Eio.Stdenv.clock env in
   Daw_drivers.Time_compat.set_clock clock;
+  Transport.Applescript.set_process_mgr (Eio.Stdenv.process_mgr env);
 
   (* Graceful shutdown setup *)
   let switch_ref = ref None in
@@ -322,7 +584,7 @@ let run_socket socket_path =
   (try
   Eio.Switch.run @@ fun sw ->
   switch_ref := Some sw;
-  let ctx = Daw_mcp.Mcp_server.create_context ~sw ~net ~clock in
+  let ctx = Daw_mcp.Mcp_server.create_context ~sw ~net ~clock () in
   let addr = `Unix socket_path in
   let socket = Eio.Net.listen ~sw ~backlog:16 ~reuse_addr:true net addr in
 
@@ -337,17 +599,17 @@ let run_socket socket_path =
       Logs.info (fun m -> m "Plugin connected");
       let buf = Eio.Buf_read.of_flow ~max_size:1_000_000 flow in
 
-      (* Line-by-line JSON-RPC processing *)
+      (* Concurrent JSON-RPC processing; a failed write ends the connection's switch *)
       try
-        while true do
-          let line = Eio.Buf_read.line buf in
-          if String.length line > 0 then begin
-            let response = Daw_mcp.Mcp_server.process_line_with_context ~ctx line in
-            Eio.Flow.copy_string (response ^ "\n") flow
-          end
-        done
+        Eio.Switch.run (fun conn_sw ->
+          let dispatch =
+            Daw_mcp.Dispatch.create ~sw:conn_sw ~max_in_flight ~ordering (fun text -> Eio.Flow.copy_string text flow)
+          in
+          dispatch_lines dispatch
+            (Daw_mcp.Mcp_server.process_line_with_context_opt ~ctx
+               ~session:(Daw_mcp.Mcp_server.new_session ())) buf);
+        Logs.info (fun m -> m "Plugin disconnected")
       with
-      | End_of_file -> Logs.info (fun m -> m "Plugin disconnected")
       | exn -> Logs.err (fun m -> m "Error: %s" (Printexc.to_string exn))
     )
   done
@@ -370,16 +632,40 @@ let verbose_arg =
   let doc = "Enable verbose logging" in
   Arg.(value & flag & info ["v"; "verbose"] ~doc)
 
-let main_cmd port socket verbose =
+let max_in_flight_arg =
+  let doc = "Requests handled concurrently per stdio or socket connection" in
+  Arg.(value & opt int 16 & info ["max-in-flight"] ~docv:"N" ~doc)
+
+let ordered_arg =
+  let doc = "Write stdio/socket responses in request order instead of as soon as they are ready" in
+  Arg.(value & flag & info ["ordered"] ~doc)
+
+let trace_sample_arg =
+  let doc = "Fraction of requests traced into span rings (0 disables, 1 traces every request)" in
+  Arg.(value & opt float 0.01 & info ["trace-sample"] ~docv:"RATE" ~doc)
+
+let trace_file_arg =
+  let doc = "Write the recorded spans as Chrome trace JSON to $(docv) on exit" in
+  Arg.(value & opt (some string) None & info ["trace-file"] ~docv:"PATH" ~doc)
+
+let main_cmd port socket verbose max_in_flight ordered trace_sample trace_file =
   if verbose then setup_logging (Some Logs.Debug);
+  Metrics.Trace.configure ~sample:trace_sample ();
+  let max_in_flight = max 1 max_in_flight in
+  let ordering = if ordered then Daw_mcp.Dispatch.Ordered else Daw_mcp.Dispatch.Unordered in
+  Fun.protect ~finally:(fun () ->
+    Option.iter (fun path ->
+      Out_channel.with_open_bin path (fun oc -> output_string oc (Metrics.Trace.export ())))
+      trace_file) @@ fun () ->
   match socket, port with
-  | Some s, _ -> run_socket s
+  | Some s, _ -> run_socket ~max_in_flight ~ordering s
   | None, Some p -> run_http p
-  | None, None -> run_stdio ()
+  | None, None -> run_stdio ~max_in_flight ~ordering ()
 
 let cmd =
   let doc = "DAW MCP Server - Control DAWs via AI" in
   let info = Cmd.info "daw-mcp" ~version ~doc in
-  Cmd.v info Term.(const main_cmd $ port_arg $ socket_arg $ verbose_arg)
+  Cmd.v info Term.(const main_cmd $ port_arg $ socket_arg $ verbose_arg $ max_in_flight_arg $ ordered_arg
+                          $ trace_sample_arg $ trace_file_arg)
 
 let () = exit (Cmd.eval cmd)
@@ -20,8 +20,15 @@
 open Daw_driver.Driver
 open Osc
 
+(** Default OSC ports *)
+let default_host = "127.0.0.1"
+let default_port = 11000
+
 (** Ableton state *)
 type state = {
+  host : string;
+  port : int;
+  protocol : protocol;
   mutable connected : bool;
   mutable osc_client : Osc.Transport.t option;
   mutable transport_state : transport_state;
@@ -29,7 +36,11 @@ type state = {
   mutable selected_track : int;
 }
 
-let state = {
+(** Fresh per-instance state *)
+let create_state ?(host = default_host) ?(port = default_port) ?(protocol = Udp) () = {
+  host;
+  port;
+  protocol;
   connected = false;
   osc_client = None;
   transport_state = Stopped;
@@ -37,9 +48,8 @@ let state = {
   selected_track = 0;
 }
 
-(** Default OSC ports *)
-let default_host = "127.0.0.1"
-let default_port = 11000
+(** Default instance state *)
+let state = create_state ()
 
 (** Detect Ableton Live running *)
 let detect_ableton () =
@@ -57,7 +67,7 @@ let detect_ableton () =
   || command_succeeds "pgrep" [ "-x"; "Live" ]
 
 (** Send OSC message to Ableton *)
-let send_osc msg =
+let send_osc state msg =
   match state.osc_client with
   | Some client -> Osc.Transport.send client msg; true
   | None -> false
@@ -82,7 +92,11 @@ module Addr = struct
   let select_track n = Printf.sprintf "/live/track/%d/select" n
 end
 
-module Ableton_driver : DAW_DRIVER = struct
+(** Driver bound to one Ableton instance (see [Reaper.Make]) *)
+module Make (S : sig val state : state end) : DAW_DRIVER = struct
+  let state = S.state
+  let send_osc = send_osc state
+
   let name = "Ableton Live"
 
   let get_info () =
@@ -95,15 +109,21 @@ module Ableton_driver : DAW_DRIVER = struct
 
   let connect ~sw ~net () =
     if detect_ableton () then begin
-      let client = Osc.Transport.create ~sw ~net ~host:default_host ~port:default_port in
-      state.osc_client <- Some client;
-      state.connected <- true;
-      Logs.info (fun m -> m "Connected to Ableton Live via OSC on port %d" default_port);
-      Eio.Promise.create_resolved (Ok true)
+      match Osc_connect.connect ~sw ~net ~host:state.host ~port:state.port state.protocol with
+      | client ->
+        state.osc_client <- Some client;
+        state.connected <- true;
+        Logs.info (fun m -> m "Connected to Ableton Live via OSC on %s"
+          (Osc_connect.describe ~host:state.host ~port:state.port state.protocol));
+        Eio.Promise.create_resolved (Ok true)
+      | exception (Eio.Io _ as e) -> Eio.Promise.create_resolved (Error e)
     end else
       Eio.Promise.create_resolved (Ok false)
 
   let disconnect () =
+    (match state.osc_client with
+     | Some client -> Osc.Transport.close client
+     | None -> ());
     state.osc_client <- None;
     state.connected <- false;
     Logs.info (fun m -> m "Disconnected from Ableton Live")
@@ -257,28 +277,38 @@ module Ableton_driver : DAW_DRIVER = struct
     Eio.Promise.create_resolved (Error (Failure "Automation modes not yet implemented"))
 end
 
+module Ableton_driver = Make (struct let state = state end)
+
 (** Ableton-specific functions *)
 
 (** Fire a clip at track/clip position *)
 let fire_clip ~track ~clip =
   let msg = message (Addr.clip_fire track clip) [] in
-  send_osc msg
+  send_osc state msg
 
 (** Fire a scene by index *)
 let fire_scene scene =
   let msg = message (Addr.scene_fire scene) [] in
-  send_osc msg
+  send_osc state msg
 
 (** Continue playing from current position *)
 let continue_playing () =
   let msg = message Addr.continue_playing [] in
-  send_osc msg
+  send_osc state msg
 
 let create () : (module DAW_DRIVER) = (module Ableton_driver)
 
+(** Create an independent Ableton driver for [endpoint] *)
+let create_at (endpoint : endpoint) : (module DAW_DRIVER) =
+  let module D = Make (struct
+    let state = create_state ~host:endpoint.host ~port:endpoint.port ~protocol:endpoint.protocol ()
+  end) in
+  (module D)
+
 let register () =
   Daw_driver.Driver.register {
     daw_id = Ableton;
     create;
     detect = detect_ableton;
+    create_at = Some create_at;
   }
@@ -278,4 +278,5 @@ let register () =
     daw_id = LogicPro;
     create;
     detect = detect_logic;
+    create_at = None;
   }
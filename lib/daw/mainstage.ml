@@ -281,4 +281,5 @@ let register () =
     daw_id = MainStage;
     create;
     detect = detect_mainstage;
+    create_at = None;
   }
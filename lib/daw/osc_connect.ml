@@ -0,0 +1,22 @@
+(** OSC Connect - open an OSC transport for a driver endpoint *)
+
+open Daw_driver.Driver
+
+let osc_framing = function
+  | Slip -> Osc.Transport.Slip
+  | Length_prefix -> Osc.Transport.Length_prefix
+
+(** Connect to [host]/[port] over [protocol] *)
+let connect ~sw ~net ~host ~port protocol =
+  match protocol with
+  | Udp -> Osc.Transport.create ~sw ~net ~host ~port
+  | Tcp framing ->
+    Osc.Transport.connect ~sw ~net (Osc.Transport.Tcp { host; port; framing = osc_framing framing })
+  | Unix_socket (path, framing) ->
+    Osc.Transport.connect ~sw ~net (Osc.Transport.Unix_socket { path; framing = osc_framing framing })
+
+(** Human-readable description for logs *)
+let describe ~host ~port = function
+  | Udp -> Printf.sprintf "%s:%d" host port
+  | Tcp _ -> Printf.sprintf "tcp://%s:%d" host port
+  | Unix_socket (path, _) -> Printf.sprintf "unix:%s" path
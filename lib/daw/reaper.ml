@@ -15,23 +15,28 @@ type state = {
   mutable client : Osc.Transport.t option;
   mutable host : string;
   mutable port : int;
+  mutable protocol : protocol;
   mutable connected : bool;
   mutable transport_state : transport_state;
   mutable tempo : float;
   mutable position : float;
 }
 
-(** Global state *)
-let state = {
+(** Fresh per-instance state *)
+let create_state ?(host = "127.0.0.1") ?(port = 8000) ?(protocol = Udp) () = {
   client = None;
-  host = "127.0.0.1";
-  port = 8000;  (* Default Reaper OSC port *)
+  host;
+  port;  (* Default Reaper OSC port *)
+  protocol;
   connected = false;
   transport_state = Stopped;
   tempo = 120.0;
   position = 0.0;
 }
 
+(** Default instance state (used by [create] and [configure]) *)
+let state = create_state ()
+
 (** Check if Reaper is running (macOS) *)
 let detect_reaper () =
   try
@@ -84,7 +89,7 @@ module Addr = struct
 end
 
 (** Send OSC message to Reaper *)
-let send_osc address args =
+let send_osc state address args =
   match state.client with
   | Some client ->
     Osc.Transport.send_message client address args;
@@ -93,18 +98,24 @@ let send_osc address args =
     Error (Failure "Not connected to Reaper")
 
 (** Send OSC with float arg *)
-let send_float address value =
-  send_osc address [Osc.Float32 value]
+let send_float state address value =
+  send_osc state address [Osc.Float32 value]
 
 (** Send OSC with int arg *)
-let send_int address value =
-  send_osc address [Osc.Int32 (Int32.of_int value)]
+let send_int state address value =
+  send_osc state address [Osc.Int32 (Int32.of_int value)]
 
 (** Send OSC trigger (no args or 1.0) *)
-let send_trigger address =
-  send_osc address [Osc.Float32 1.0]
+let send_trigger state address =
+  send_osc state address [Osc.Float32 1.0]
+
+(** Driver bound to one Reaper instance. Each application of [Make] owns its
+    own OSC client, so several Reaper endpoints can be driven at once. *)
+module Make (S : sig val state : state end) : DAW_DRIVER = struct
+  let state = S.state
+  let send_float = send_float state
+  let send_trigger = send_trigger state
 
-module Reaper_driver : DAW_DRIVER = struct
   let name = "Reaper"
 
   let get_info () =
@@ -116,11 +127,16 @@ module Reaper_driver : DAW_DRIVER = struct
     })
 
   let connect ~sw ~net () =
-    let client = Osc.Transport.create ~sw ~net ~host:state.host ~port:state.port in
-    state.client <- Some client;
-    state.connected <- true;
-    Logs.info (fun m -> m "Connected to Reaper at %s:%d" state.host state.port);
-    Eio.Promise.create_resolved (Ok true)
+    match Osc_connect.connect ~sw ~net ~host:state.host ~port:state.port state.protocol with
+    | client ->
+      state.client <- Some client;
+      state.connected <- true;
+      Logs.info (fun m -> m "Connected to Reaper at %s"
+        (Osc_connect.describe ~host:state.host ~port:state.port state.protocol));
+      Eio.Promise.create_resolved (Ok true)
+    | exception (Eio.Io _ as e) ->
+      (* Stream transports fail here when nothing is listening *)
+      Eio.Promise.create_resolved (Error e)
 
   let disconnect () =
     (match state.client with
@@ -284,15 +300,26 @@ module Reaper_driver : DAW_DRIVER = struct
     Eio.Promise.create_resolved (Error (Failure "Automation not yet implemented"))
 end
 
+(** Driver bound to the default instance state *)
+module Reaper_driver = Make (struct let state = state end)
+
 (** Create Reaper driver *)
 let create () : (module DAW_DRIVER) = (module Reaper_driver)
 
+(** Create an independent Reaper driver for [endpoint] *)
+let create_at (endpoint : endpoint) : (module DAW_DRIVER) =
+  let module D = Make (struct
+    let state = create_state ~host:endpoint.host ~port:endpoint.port ~protocol:endpoint.protocol ()
+  end) in
+  (module D)
+
 (** Register driver *)
 let register () =
   Daw_driver.Driver.register {
     daw_id = Reaper;
     create;
     detect = detect_reaper;
+    create_at = Some create_at;
   }
 
 (** Configure connection parameters *)
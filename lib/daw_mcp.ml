@@ -2,3 +2,4 @@
 
 module Types = Types
 module Mcp_server = Mcp_server
+module Dispatch = Dispatch
@@ -0,0 +1,149 @@
+(** Dispatch - Concurrent JSON-RPC line dispatch for stream transports
+
+    The stdio and Unix socket transports read one JSON-RPC message per
+    line. Each line is handled in its own fiber, so a slow call (an
+    AppleScript round trip, a DAW that is not answering) no longer holds
+    up the messages behind it, [ping] included. At most [max_in_flight]
+    lines run at once per connection; when the limit is reached the
+    reader stops reading, which pushes back on the peer. [ping] and
+    [notifications/cancelled] still get through at the limit: they are
+    cheap and are exactly what a peer sends when its calls are stuck.
+
+    Responses carry their JSON-RPC id and are written as soon as they
+    are ready, through a mutex so lines never interleave. With [Ordered]
+    a response that finishes early is held until every earlier line has
+    been answered, for peers that match responses by position.
+*)
+
+type ordering =
+  | Unordered  (** write each response when it is ready *)
+  | Ordered    (** write responses in request order *)
+
+type t = {
+  sw : Eio.Switch.t;
+  ordering : ordering;
+  slots : Eio.Semaphore.t;
+  write : string -> unit;
+  delimiter : string;
+  write_lock : Eio.Mutex.t;
+  idle : Eio.Condition.t;             (** broadcast when a line finishes *)
+  held : (int, string option) Hashtbl.t;  (** finished early (ordered) *)
+  mutable next_seq : int;             (** sequence number of the next line *)
+  mutable next_write : int;           (** next sequence to write (ordered) *)
+  mutable in_flight : int;
+  mutable peak : int;
+  mutable completed : int;
+  mutable failed : int;
+}
+
+(** Dispatcher writing each response followed by [delimiter] (default a
+    newline) with [write]. Handler fibers run in [sw]. *)
+let create ~sw ?(max_in_flight = 16) ?(ordering = Unordered) ?(delimiter = "\n") write =
+  if max_in_flight < 1 then invalid_arg "Dispatch.create: max_in_flight must be positive";
+  {
+    sw;
+    ordering;
+    slots = Eio.Semaphore.make max_in_flight;
+    write;
+    delimiter;
+    write_lock = Eio.Mutex.create ();
+    idle = Eio.Condition.create ();
+    held = Hashtbl.create 16;
+    next_seq = 0;
+    next_write = 0;
+    in_flight = 0;
+    peak = 0;
+    completed = 0;
+    failed = 0;
+  }
+
+let emit t response =
+  Eio.Mutex.use_rw ~protect:true t.write_lock (fun () -> t.write (response ^ t.delimiter))
+
+(** Write a finished line's response, or in ordered mode every response
+    that is now at the head of the line *)
+let finish t seq response =
+  match t.ordering with
+  | Unordered -> Option.iter (emit t) response
+  | Ordered ->
+    Hashtbl.replace t.held seq response;
+    let rec drain () =
+      match Hashtbl.find_opt t.held t.next_write with
+      | Some response ->
+        Hashtbl.remove t.held t.next_write;
+        t.next_write <- t.next_write + 1;
+        Option.iter (emit t) response;
+        drain ()
+      | None -> ()
+    in
+    drain ()
+
+(** Answer for a line whose handler raised: a JSON-RPC internal error
+    (-32603) carrying the request's id, or [None] for notifications and
+    lines that are not requests *)
+let internal_error line exn =
+  match Yojson.Safe.from_string line with
+  | `Assoc fields ->
+    (match List.assoc_opt "id" fields, List.assoc_opt "method" fields with
+     | Some ((`Int _ | `String _) as id), Some _ ->
+       Some (Yojson.Safe.to_string
+         (Mcp_server.make_error (Some id) (-32603) ("Internal error: " ^ Printexc.to_string exn)))
+     | _ -> None)
+  | _ -> None
+  | exception Yojson.Json_error _ -> None
+
+(** Methods dispatched without a slot *)
+let control_methods = ["ping"; "notifications/cancelled"]
+
+let is_control line =
+  match Yojson.Safe.from_string line with
+  | `Assoc fields ->
+    (match List.assoc_opt "method" fields with
+     | Some (`String m) -> List.mem m control_methods
+     | _ -> false)
+  | _ -> false
+  | exception Yojson.Json_error _ -> false
+
+(** Handle [line] in a new fiber once a slot is free. [handle] returns
+    the response line, or [None] for messages that get no reply
+    (notifications, responses); if it raises, a request is answered
+    with an internal error. Blocks while [max_in_flight] lines are
+    running, except for [ping] and cancellation, which run at once. The
+    line is only parsed here when every slot is taken. *)
+let submit t handle line =
+  let bypass = Eio.Semaphore.get_value t.slots = 0 && is_control line in
+  if not bypass then Eio.Semaphore.acquire t.slots;
+  let seq = t.next_seq in
+  t.next_seq <- seq + 1;
+  t.in_flight <- t.in_flight + 1;
+  if t.in_flight > t.peak then t.peak <- t.in_flight;
+  Eio.Fiber.fork ~sw:t.sw (fun () ->
+    Fun.protect ~finally:(fun () ->
+      t.in_flight <- t.in_flight - 1;
+      if not bypass then Eio.Semaphore.release t.slots;
+      Eio.Condition.broadcast t.idle) @@ fun () ->
+    let response =
+      match handle line with
+      | response -> t.completed <- t.completed + 1; response
+      | exception (Eio.Cancel.Cancelled _ as exn) -> raise exn
+      | exception exn ->
+        t.failed <- t.failed + 1;
+        Logs.err (fun m -> m "Dispatch: handler failed: %s" (Printexc.to_string exn));
+        internal_error line exn
+    in
+    finish t seq response)
+
+(** Wait until every submitted line has been answered *)
+let drain t =
+  Eio.Condition.loop_no_mutex t.idle (fun () -> if t.in_flight = 0 then Some () else None)
+
+let in_flight t = t.in_flight
+
+let stats t =
+  `Assoc [
+    ("ordering", `String (match t.ordering with Unordered -> "unordered" | Ordered -> "ordered"));
+    ("in_flight", `Int t.in_flight);
+    ("peak_in_flight", `Int t.peak);
+    ("completed", `Int t.completed);
+    ("failed", `Int t.failed);
+  ]
@@ -31,6 +31,9 @@ type meter_data = {
 }
 type automation_mode = Off | Read | Write | Touch | Latch
 type automation_point = { time: float; value: float; curve: unit }
+type framing = Slip | Length_prefix
+type protocol = Udp | Tcp of framing | Unix_socket of string * framing
+type endpoint = { host: string; port: int; protocol: protocol }
 
 module type DAW_DRIVER = sig
   val name : string
@@ -75,6 +78,7 @@ type driver_entry = {
   daw_id : daw_id;
   create : unit -> (module DAW_DRIVER);
   detect : unit -> bool;
+  create_at : (endpoint -> (module DAW_DRIVER)) option;
 }
 
 (* Driver registry *)
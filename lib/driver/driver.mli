@@ -94,6 +94,24 @@ type automation_point = {
   curve : unit;
 }
 
+(** Packet framing for OSC over stream sockets *)
+type framing =
+  | Slip           (** OSC 1.1 SLIP framing *)
+  | Length_prefix  (** OSC 1.0 int32 size prefix *)
+
+(** Transport used to reach an OSC control surface *)
+type protocol =
+  | Udp
+  | Tcp of framing
+  | Unix_socket of string * framing  (** socket path; host/port unused *)
+
+(** Network endpoint of a DAW control surface (OSC host/port) *)
+type endpoint = {
+  host : string;
+  port : int;
+  protocol : protocol;
+}
+
 (** Module type that all DAW drivers must implement *)
 module type DAW_DRIVER = sig
   val name : string
@@ -155,6 +173,9 @@ type driver_entry = {
   daw_id : daw_id;
   create : unit -> (module DAW_DRIVER);
   detect : unit -> bool;
+  create_at : (endpoint -> (module DAW_DRIVER)) option;
+      (** Create an independent instance bound to [endpoint].
+          [None] for drivers that can only talk to a single local app. *)
 }
 
 val register : driver_entry -> unit
@@ -16,6 +16,7 @@ type connection_error = [
   | `Max_attempts
   | `Still_connecting
   | `Command_failed of string
+  | `Unknown_instance of string
 ]
 
 (** Connection state *)
@@ -25,24 +26,81 @@ type connection_state =
   | Connected of (module DAW_DRIVER)
   | Failed of string
 
-(** Integration manager state *)
-type t = {
+(** Which driver instance a command is routed to.
+    [instance] wins over [daw]; with neither, the default instance is used. *)
+type target = {
+  daw : daw_id option;
+  instance : string option;
+}
+
+let default_target = { daw = None; instance = None }
+
+(** One independent driver instance. Commands for an instance are queued on
+    [jobs] and executed in order by its own worker fiber, so a slow DAW only
+    ever delays its own commands. *)
+type instance = {
+  id : string;
+  daw_id : daw_id;
+  endpoint : endpoint option;
   mutable state : connection_state;
-  mutable last_daw_id : daw_id option;
   mutable reconnect_attempts : int;
-  max_reconnect_attempts : int;
   breaker : Mcp_resilience.circuit_breaker;
+  jobs : (unit -> unit) Eio.Stream.t;
+  mutable worker : Eio.Cancel.t option;  (** the worker fiber's context *)
+  mutable stopped : bool;                (** removed; jobs fail at once *)
 }
 
-(** Create new integration manager *)
-let create () = {
-  state = Disconnected;
-  last_daw_id = None;
-  reconnect_attempts = 0;
-  max_reconnect_attempts = 3;
-  breaker = Mcp_resilience.create_circuit_breaker ~name:"daw_driver" ~failure_threshold:5 ();
+(** Instance summary for status reporting *)
+type instance_info = {
+  instance_id : string;
+  instance_daw : daw_id;
+  instance_endpoint : endpoint option;
+  status : string;
+  error : string option;
+  is_default : bool;
+}
+
+(** Integration manager state *)
+type t = {
+  instances : (string, instance) Hashtbl.t;
+  mutable default_id : string option;
+  mutable last_error : string option;
+  max_reconnect_attempts : int;
+  queue_capacity : int;
 }
 
+let operation_seconds =
+  Metrics.histogram ~label:"operation" ~help:"Driver operation latency, retries included"
+    "daw_driver_operation_seconds"
+
+let breaker_state_value cb =
+  match cb.Mcp_resilience.state with
+  | Mcp_resilience.Closed -> 0.0
+  | Mcp_resilience.HalfOpen -> 1.0
+  | Mcp_resilience.Open -> 2.0
+
+(** Per-instance breaker state and queue depth, read at scrape time *)
+let register_metrics t =
+  let per_instance f () = Hashtbl.fold (fun id inst acc -> (id, f inst) :: acc) t.instances [] in
+  Metrics.sampled ~label:"instance" ~help:"Circuit breaker state (0 closed, 1 half-open, 2 open)"
+    "daw_circuit_breaker_state" (per_instance (fun inst -> breaker_state_value inst.breaker));
+  Metrics.sampled ~label:"instance" ~help:"Consecutive failures counted by the circuit breaker"
+    "daw_circuit_breaker_failures" (per_instance (fun inst -> Float.of_int inst.breaker.Mcp_resilience.failure_count));
+  Metrics.sampled ~label:"instance" ~help:"Commands queued for the instance worker"
+    "daw_instance_queue_depth" (per_instance (fun inst -> Float.of_int (Eio.Stream.length inst.jobs)))
+
+(** Create new integration manager *)
+let create () =
+  let t = {
+    instances = Hashtbl.create 8;
+    default_id = None;
+    last_error = None;
+    max_reconnect_attempts = 3;
+    queue_capacity = 64;
+  } in
+  register_metrics t;
+  t
+
 (** Reset circuit breaker state after successful connection *)
 let reset_circuit_breaker cb =
   Eio.Mutex.use_rw ~protect:true cb.Mcp_resilience.mutex (fun () ->
@@ -72,165 +130,391 @@ let daw_name = function
   | ProTools -> "Pro Tools"
   | FLStudio -> "FL Studio"
 
+(** Short lowercase DAW name used in instance ids *)
+let daw_slug = function
+  | Reaper -> "reaper"
+  | Ableton -> "ableton"
+  | LogicPro -> "logic"
+  | MainStage -> "mainstage"
+  | Cubase -> "cubase"
+  | ProTools -> "protools"
+  | FLStudio -> "fl"
+
+(** Instance id: ["reaper"] or ["reaper@127.0.0.1:8001"] *)
+let instance_id daw_id endpoint =
+  match endpoint with
+  | None -> daw_slug daw_id
+  | Some { protocol = Udp; host; port } -> Printf.sprintf "%s@%s:%d" (daw_slug daw_id) host port
+  | Some { protocol = Tcp _; host; port } -> Printf.sprintf "%s@tcp:%s:%d" (daw_slug daw_id) host port
+  | Some { protocol = Unix_socket (path, _); _ } -> Printf.sprintf "%s@unix:%s" (daw_slug daw_id) path
+
 (** Detect all running DAWs *)
 let detect_running_daws () =
   get_all ()
-  |> List.filter (fun entry -> entry.detect ())
-  |> List.map (fun entry -> entry.daw_id)
-
-(** Connect to a specific DAW *)
-let connect_to_daw t ~sw ~net daw_id =
-  match find_by_id daw_id with
+  |> List.filter (fun (entry : driver_entry) -> entry.detect ())
+  |> List.map (fun (entry : driver_entry) -> entry.daw_id)
+
+let error_message = function
+  | `Unknown_daw _ -> "Unknown DAW"
+  | `Not_running _ -> "DAW is not running"
+  | `Connection_failed msg -> "Connection failed: " ^ msg
+  | `No_daw_found -> "No DAW found"
+  | `Max_attempts -> "Max reconnection attempts reached"
+  | `Still_connecting -> "Still connecting..."
+  | `Command_failed msg -> "Command failed: " ^ msg
+  | `Unknown_instance id -> "Unknown instance: " ^ id
+
+(** {1 Instance workers} *)
+
+exception Worker_stopped
+
+(** Find or create the instance for [daw_id]/[endpoint] and start its worker *)
+let get_or_add_instance t ~sw ?endpoint daw_id =
+  let id = instance_id daw_id endpoint in
+  match Hashtbl.find_opt t.instances id with
+  | Some inst -> inst
   | None ->
-    t.state <- Failed (Printf.sprintf "Unknown DAW: %s" (daw_name daw_id));
-    Error (`Unknown_daw daw_id)
+    let inst = {
+      id;
+      daw_id;
+      endpoint;
+      state = Disconnected;
+      reconnect_attempts = 0;
+      breaker = Mcp_resilience.create_circuit_breaker
+          ~name:("daw_driver:" ^ id) ~failure_threshold:5 ();
+      jobs = Eio.Stream.create t.queue_capacity;
+      worker = None;
+      stopped = false;
+    } in
+    Hashtbl.replace t.instances id inst;
+    Eio.Fiber.fork_daemon ~sw (fun () ->
+      let rec loop () =
+        let job = Eio.Stream.take inst.jobs in
+        job ();
+        loop ()
+      in
+      (try
+         Eio.Cancel.sub (fun cc ->
+           inst.worker <- Some cc;
+           loop ())
+       with Eio.Cancel.Cancelled Worker_stopped -> ());
+      `Stop_daemon);
+    Logs.debug (fun m -> m "Created driver instance %s" id);
+    inst
+
+exception Abandoned
+
+(** Run [f] on the instance's worker fiber and wait for its result.
+    If the caller is cancelled while waiting, a queued job is skipped and
+    a running one is cancelled (killing any child process it started),
+    so the worker moves on instead of finishing abandoned work. The job
+    runs in the caller's trace, with its wait in the queue as a span. *)
+let submit inst f =
+  let promise, resolver = Eio.Promise.create () in
+  let abandoned = ref false in
+  let running = ref None in
+  let trace = Metrics.Trace.current () in
+  let queued = if Option.is_some trace then Metrics.Trace.now () else 0.0 in
+  Eio.Stream.add inst.jobs (fun () ->
+    if inst.stopped then Eio.Promise.resolve resolver (Error Worker_stopped)
+    else if not !abandoned then Metrics.Trace.with_context trace @@ fun () ->
+      Metrics.Trace.finish ~cat:"driver" "driver.queue" ~start:queued;
+      let result =
+        match
+          Eio.Cancel.sub (fun cc ->
+            running := Some cc;
+            Fun.protect ~finally:(fun () -> running := None) f)
+        with
+        | v -> Ok v
+        | exception (Eio.Cancel.Cancelled _ as exn) ->
+          (* Abandoned by the caller, unless the worker itself is cancelled;
+             a stopped worker still answers before it exits *)
+          if inst.stopped then Error Worker_stopped
+          else begin
+            Eio.Fiber.check ();
+            Error exn
+          end
+        | exception exn -> Error exn
+      in
+      Eio.Promise.resolve resolver result);
+  match Eio.Promise.await promise with
+  | Ok v -> v
+  | Error exn -> raise exn
+  | exception (Eio.Cancel.Cancelled _ as exn) ->
+    abandoned := true;
+    Option.iter (fun cc -> Eio.Cancel.cancel cc Abandoned) !running;
+    raise exn
+
+(** Connect an instance, closing the driver it replaces. Must run on the
+    instance's worker. *)
+let connect_instance inst ~sw ~net =
+  (match inst.state with
+   | Connected old ->
+     let module D = (val old : DAW_DRIVER) in
+     D.disconnect ()
+   | Disconnected | Connecting | Failed _ -> ());
+  match find_by_id inst.daw_id with
+  | None ->
+    inst.state <- Failed (Printf.sprintf "Unknown DAW: %s" (daw_name inst.daw_id));
+    Error (`Unknown_daw inst.daw_id)
   | Some entry ->
-    t.state <- Connecting;
-    let driver = entry.create () in
-    let module D = (val driver : DAW_DRIVER) in
-    let result = Eio.Promise.await (D.connect ~sw ~net ()) in
-    match result with
-    | Ok true ->
-      t.state <- Connected driver;
-      t.last_daw_id <- Some daw_id;
-      t.reconnect_attempts <- 0;
-      reset_circuit_breaker t.breaker;
-      Logs.info (fun m -> m "Connected to %s" (daw_name daw_id));
-      Ok driver
-    | Ok false ->
-      t.state <- Failed (Printf.sprintf "%s is not running" (daw_name daw_id));
-      Error (`Not_running daw_id)
-    | Error exn ->
-      t.state <- Failed (Printexc.to_string exn);
-      Error (`Connection_failed (Printexc.to_string exn))
+    let driver_opt = match inst.endpoint, entry.create_at with
+      | None, _ -> Ok (entry.create ())
+      | Some endpoint, Some create_at -> Ok (create_at endpoint)
+      | Some _, None ->
+        Error (`Connection_failed
+          (Printf.sprintf "%s does not support custom endpoints" (daw_name inst.daw_id)))
+    in
+    match driver_opt with
+    | Error err ->
+      inst.state <- Failed (error_message err);
+      Error err
+    | Ok driver ->
+      inst.state <- Connecting;
+      let module D = (val driver : DAW_DRIVER) in
+      match Eio.Promise.await (D.connect ~sw ~net ()) with
+      | Ok true ->
+        inst.state <- Connected driver;
+        inst.reconnect_attempts <- 0;
+        reset_circuit_breaker inst.breaker;
+        Logs.info (fun m -> m "Connected to %s (%s)" (daw_name inst.daw_id) inst.id);
+        Ok driver
+      | Ok false ->
+        D.disconnect ();
+        inst.state <- Failed (Printf.sprintf "%s is not running" (daw_name inst.daw_id));
+        Error (`Not_running inst.daw_id)
+      | Error exn ->
+        D.disconnect ();
+        inst.state <- Failed (Printexc.to_string exn);
+        Error (`Connection_failed (Printexc.to_string exn))
+
+(** Reconnect an instance, bounded by [max_reconnect_attempts] *)
+let reconnect_instance t inst ~sw ~net =
+  if inst.reconnect_attempts >= t.max_reconnect_attempts then begin
+    inst.state <- Failed "Max reconnection attempts reached";
+    Error `Max_attempts
+  end else begin
+    inst.reconnect_attempts <- inst.reconnect_attempts + 1;
+    Logs.info (fun m -> m "Reconnection attempt %d/%d for %s"
+      inst.reconnect_attempts t.max_reconnect_attempts inst.id);
+    connect_instance inst ~sw ~net
+  end
+
+let default_instance t =
+  match t.default_id with
+  | Some id -> Hashtbl.find_opt t.instances id
+  | None -> None
+
+(** {1 Connection management} *)
+
+(** Connect to a specific DAW, optionally at a non-default endpoint.
+    The instance becomes the default target for commands without [daw]/[instance]. *)
+let connect_to_daw ?endpoint t ~sw ~net daw_id =
+  let inst = get_or_add_instance t ~sw ?endpoint daw_id in
+  let result = submit inst (fun () -> connect_instance inst ~sw ~net) in
+  (match result with
+   | Ok _ ->
+     t.default_id <- Some inst.id;
+     t.last_error <- None
+   | Error err ->
+     if t.default_id = None then t.last_error <- Some (error_message err));
+  result
 
 (** Auto-detect and connect to first available DAW *)
 let auto_connect t ~sw ~net =
   let running = detect_running_daws () in
   match running with
   | [] ->
-    t.state <- Failed "No DAW detected";
+    t.last_error <- Some "No DAW detected";
     Error `No_daw_found
   | daw_id :: _ ->
     connect_to_daw t ~sw ~net daw_id
 
-(** Disconnect from current DAW *)
-let disconnect t =
-  match t.state with
+let disconnect_instance inst =
+  match inst.state with
   | Connected driver ->
     let module D = (val driver : DAW_DRIVER) in
     D.disconnect ();
-    t.state <- Disconnected;
-    Logs.info (fun m -> m "Disconnected from DAW")
+    inst.state <- Disconnected;
+    Logs.info (fun m -> m "Disconnected from %s" inst.id)
   | _ -> ()
 
+(** Disconnect from current DAW *)
+let disconnect t =
+  Option.iter disconnect_instance (default_instance t)
+
+(** Stop an instance's worker fiber: a running job is cancelled and
+    queued ones fail with [Worker_stopped] *)
+let stop_worker inst =
+  inst.stopped <- true;
+  Option.iter (fun cc -> Eio.Cancel.cancel cc Worker_stopped) inst.worker;
+  let rec drain () =
+    match Eio.Stream.take_nonblocking inst.jobs with
+    | Some job -> job (); drain ()
+    | None -> ()
+  in
+  drain ()
+
+(** Disconnect and forget every instance, stopping their workers *)
+let disconnect_all t =
+  Hashtbl.iter (fun _ inst -> disconnect_instance inst; stop_worker inst) t.instances;
+  Hashtbl.reset t.instances;
+  t.default_id <- None
+
 (** Attempt reconnection *)
 let try_reconnect t ~sw ~net =
-  if t.reconnect_attempts >= t.max_reconnect_attempts then begin
-    t.state <- Failed "Max reconnection attempts reached";
-    Error `Max_attempts
-  end else begin
-    t.reconnect_attempts <- t.reconnect_attempts + 1;
-    Logs.info (fun m -> m "Reconnection attempt %d/%d"
-      t.reconnect_attempts t.max_reconnect_attempts);
-    match t.last_daw_id with
-    | Some daw_id -> connect_to_daw t ~sw ~net daw_id
-    | None -> auto_connect t ~sw ~net
-  end
+  match default_instance t with
+  | Some inst -> submit inst (fun () -> reconnect_instance t inst ~sw ~net)
+  | None -> auto_connect t ~sw ~net
 
 (** Get current driver (if connected) *)
 let get_driver t =
-  match t.state with
-  | Connected driver -> Some driver
+  match default_instance t with
+  | Some { state = Connected driver; _ } -> Some driver
   | _ -> None
 
 (** Check if connected *)
 let is_connected t =
-  match t.state with
-  | Connected _ -> true
-  | _ -> false
+  Option.is_some (get_driver t)
+
+let state_to_string = function
+  | Disconnected -> "disconnected"
+  | Connecting -> "connecting"
+  | Connected _ -> "connected"
+  | Failed _ -> "error"
 
 (** Get connection status as JSON-friendly record *)
 let get_status t =
-  let state_str = match t.state with
-    | Disconnected -> "disconnected"
-    | Connecting -> "connecting"
-    | Connected _ -> "connected"
-    | Failed _ -> "error"
-  in
-  let error_msg = match t.state with
-    | Failed msg -> Some msg
-    | _ -> None
-  in
-  let daw_name = match t.state with
-    | Connected driver ->
-      let module D = (val driver : DAW_DRIVER) in
-      Some D.name
-    | _ -> None
-  in
-  (state_str, daw_name, error_msg)
-
-(** Execute command with auto-reconnect and resilience *)
-let with_driver t ~sw ~net ~clock ~op_name f =
-  let op () =
-    let res = 
-      match t.state with
-      | Connected driver -> f driver
-      | Disconnected | Failed _ ->
-          (* Try to reconnect *)
-          begin match try_reconnect t ~sw ~net with
-          | Ok driver -> f driver
-          | Error err -> Error err
-          end
-      | Connecting ->
-          Error `Still_connecting
+  match default_instance t with
+  | None ->
+    (match t.last_error with
+     | Some msg -> ("error", None, Some msg)
+     | None -> ("disconnected", None, None))
+  | Some inst ->
+    let error_msg = match inst.state with
+      | Failed msg -> Some msg
+      | _ -> None
     in
-    match res with
-    | Ok r -> Mcp_resilience.Ok r
-    | Error err -> Mcp_resilience.Error (match err with
-        | `Unknown_daw _ -> "Unknown DAW"
-        | `Not_running _ -> "DAW is not running"
-        | `Connection_failed msg -> "Connection failed: " ^ msg
-        | `No_daw_found -> "No DAW found"
-        | `Max_attempts -> "Max reconnection attempts reached"
-        | `Still_connecting -> "Still connecting..."
-        | `Command_failed msg -> "Command failed: " ^ msg)
-  in
-  let result = Mcp_resilience.with_retry_eio ~clock ~circuit_breaker:(Some t.breaker) ~op_name ~classify:(fun e -> Fail e) op in
-  match result with
-  | Ok r -> Ok r
-  | Error err -> Error (`Connection_failed err)
-  | CircuitOpen -> Error (`Connection_failed "Circuit breaker open")
-  | TimedOut -> Error (`Connection_failed "Operation timed out")
+    let daw_name = match inst.state with
+      | Connected driver ->
+        let module D = (val driver : DAW_DRIVER) in
+        Some D.name
+      | _ -> None
+    in
+    (state_to_string inst.state, daw_name, error_msg)
+
+(** List all known driver instances *)
+let list_instances t =
+  Hashtbl.fold (fun _ inst acc ->
+    {
+      instance_id = inst.id;
+      instance_daw = inst.daw_id;
+      instance_endpoint = inst.endpoint;
+      status = state_to_string inst.state;
+      error = (match inst.state with Failed msg -> Some msg | _ -> None);
+      is_default = (t.default_id = Some inst.id);
+    } :: acc
+  ) t.instances []
+  |> List.sort (fun a b -> String.compare a.instance_id b.instance_id)
+
+(** Resolve a target to an instance, creating one when a DAW is named
+    but not yet known. *)
+let resolve t ~sw target =
+  match target.instance, target.daw with
+  | Some id, _ ->
+    (match Hashtbl.find_opt t.instances id with
+     | Some inst -> Ok inst
+     | None -> Error (`Unknown_instance id))
+  | None, Some daw_id ->
+    (match default_instance t with
+     | Some inst when inst.daw_id = daw_id -> Ok inst
+     | _ ->
+       let existing = Hashtbl.fold (fun _ inst acc ->
+         match acc with
+         | None when inst.daw_id = daw_id -> Some inst
+         | _ -> acc
+       ) t.instances None in
+       match existing with
+       | Some inst -> Ok inst
+       | None -> Ok (get_or_add_instance t ~sw daw_id))
+  | None, None ->
+    (match default_instance t with
+     | Some inst -> Ok inst
+     | None ->
+       match detect_running_daws () with
+       | [] ->
+         t.last_error <- Some "No DAW detected";
+         Error `No_daw_found
+       | daw_id :: _ ->
+         let inst = get_or_add_instance t ~sw daw_id in
+         t.default_id <- Some inst.id;
+         Ok inst)
+
+(** Execute command with auto-reconnect and resilience.
+    Runs on the target instance's worker fiber with its own circuit breaker. *)
+let with_driver ?(target = default_target) t ~sw ~net ~clock ~op_name f =
+  match resolve t ~sw target with
+  | Error err -> Error err
+  | Ok inst ->
+    submit inst (fun () ->
+      let op () =
+        let res =
+          match inst.state with
+          | Connected driver -> Metrics.Trace.span ~cat:"driver" "driver.call" (fun () -> f driver)
+          | Disconnected | Failed _ ->
+              (* Try to reconnect *)
+              begin match Metrics.Trace.span ~cat:"driver" "driver.reconnect" (fun () ->
+                  reconnect_instance t inst ~sw ~net) with
+              | Ok driver -> Metrics.Trace.span ~cat:"driver" "driver.call" (fun () -> f driver)
+              | Error err -> Error err
+              end
+          | Connecting ->
+              Error `Still_connecting
+        in
+        match res with
+        | Ok r -> Mcp_resilience.Ok r
+        | Error err -> Mcp_resilience.Error (error_message err)
+      in
+      let result =
+        Metrics.time operation_seconds op_name @@ fun () ->
+        Metrics.Trace.span ~cat:"driver" op_name @@ fun () ->
+          Mcp_resilience.with_retry_eio ~clock ~circuit_breaker:(Some inst.breaker) ~op_name
+            ~classify:(fun e -> Fail e) op
+      in
+      match result with
+      | Ok r -> Ok r
+      | Error err -> Error (`Connection_failed err)
+      | CircuitOpen -> Error (`Connection_failed "Circuit breaker open")
+      | TimedOut -> Error (`Connection_failed "Operation timed out"))
 
 (** Transport commands with error handling *)
 module Transport = struct
-  let play t ~sw ~net ~clock =
-    with_driver t ~sw ~net ~clock ~op_name:"transport_play" (fun driver ->
+  let play ?target t ~sw ~net ~clock =
+    with_driver ?target t ~sw ~net ~clock ~op_name:"transport_play" (fun driver ->
       let module D = (val driver : DAW_DRIVER) in
       match Eio.Promise.await (D.play ()) with
       | Ok () -> Ok `Playing
       | Error exn -> Error (`Command_failed (Printexc.to_string exn))
     )
 
-  let stop t ~sw ~net ~clock =
-    with_driver t ~sw ~net ~clock ~op_name:"transport_stop" (fun driver ->
+  let stop ?target t ~sw ~net ~clock =
+    with_driver ?target t ~sw ~net ~clock ~op_name:"transport_stop" (fun driver ->
       let module D = (val driver : DAW_DRIVER) in
       match Eio.Promise.await (D.stop ()) with
       | Ok () -> Ok `Stopped
       | Error exn -> Error (`Command_failed (Printexc.to_string exn))
     )
 
-  let record t ~sw ~net ~clock =
-    with_driver t ~sw ~net ~clock ~op_name:"transport_record" (fun driver ->
+  let record ?target t ~sw ~net ~clock =
+    with_driver ?target t ~sw ~net ~clock ~op_name:"transport_record" (fun driver ->
       let module D = (val driver : DAW_DRIVER) in
       match Eio.Promise.await (D.record ()) with
       | Ok () -> Ok `Recording
       | Error exn -> Error (`Command_failed (Printexc.to_string exn))
     )
 
-  let get_state t ~sw ~net ~clock =
-    with_driver t ~sw ~net ~clock ~op_name:"transport_get_state" (fun driver ->
+  let get_state ?target t ~sw ~net ~clock =
+    with_driver ?target t ~sw ~net ~clock ~op_name:"transport_get_state" (fun driver ->
       let module D = (val driver : DAW_DRIVER) in
       match Eio.Promise.await (D.get_transport_state ()) with
       | Ok state -> Ok state
@@ -240,16 +524,16 @@ end
 
 (** Tempo commands *)
 module Tempo = struct
-  let get t ~sw ~net ~clock =
-    with_driver t ~sw ~net ~clock ~op_name:"tempo_get" (fun driver ->
+  let get ?target t ~sw ~net ~clock =
+    with_driver ?target t ~sw ~net ~clock ~op_name:"tempo_get" (fun driver ->
       let module D = (val driver : DAW_DRIVER) in
       match Eio.Promise.await (D.get_tempo ()) with
       | Ok bpm -> Ok bpm
       | Error exn -> Error (`Command_failed (Printexc.to_string exn))
     )
 
-  let set t ~sw ~net ~clock bpm =
-    with_driver t ~sw ~net ~clock ~op_name:"tempo_set" (fun driver ->
+  let set ?target t ~sw ~net ~clock bpm =
+    with_driver ?target t ~sw ~net ~clock ~op_name:"tempo_set" (fun driver ->
       let module D = (val driver : DAW_DRIVER) in
       match Eio.Promise.await (D.set_tempo bpm) with
       | Ok () -> Ok bpm
@@ -259,24 +543,24 @@ end
 
 (** Track commands *)
 module Tracks = struct
-  let get_all t ~sw ~net ~clock =
-    with_driver t ~sw ~net ~clock ~op_name:"tracks_get_all" (fun driver ->
+  let get_all ?target t ~sw ~net ~clock =
+    with_driver ?target t ~sw ~net ~clock ~op_name:"tracks_get_all" (fun driver ->
       let module D = (val driver : DAW_DRIVER) in
       match Eio.Promise.await (D.get_tracks ()) with
       | Ok tracks -> Ok tracks
       | Error exn -> Error (`Command_failed (Printexc.to_string exn))
     )
 
-  let select t ~sw ~net ~clock index =
-    with_driver t ~sw ~net ~clock ~op_name:"tracks_select" (fun driver ->
+  let select ?target t ~sw ~net ~clock index =
+    with_driver ?target t ~sw ~net ~clock ~op_name:"tracks_select" (fun driver ->
       let module D = (val driver : DAW_DRIVER) in
       match Eio.Promise.await (D.select_track index) with
       | Ok () -> Ok index
       | Error exn -> Error (`Command_failed (Printexc.to_string exn))
     )
 
-  let get_selected t ~sw ~net ~clock =
-    with_driver t ~sw ~net ~clock ~op_name:"tracks_get_selected" (fun driver ->
+  let get_selected ?target t ~sw ~net ~clock =
+    with_driver ?target t ~sw ~net ~clock ~op_name:"tracks_get_selected" (fun driver ->
       let module D = (val driver : DAW_DRIVER) in
       match Eio.Promise.await (D.get_selected_track ()) with
       | Ok index -> Ok index
@@ -286,40 +570,40 @@ end
 
 (** Mixer commands *)
 module Mixer = struct
-  let set_volume t ~sw ~net ~clock ~track_index value =
-    with_driver t ~sw ~net ~clock ~op_name:"mixer_set_volume" (fun driver ->
+  let set_volume ?target t ~sw ~net ~clock ~track_index value =
+    with_driver ?target t ~sw ~net ~clock ~op_name:"mixer_set_volume" (fun driver ->
       let module D = (val driver : DAW_DRIVER) in
       match Eio.Promise.await (D.set_volume ~track_index value) with
       | Ok () -> Ok ()
       | Error exn -> Error (`Command_failed (Printexc.to_string exn))
     )
 
-  let set_pan t ~sw ~net ~clock ~track_index value =
-    with_driver t ~sw ~net ~clock ~op_name:"mixer_set_pan" (fun driver ->
+  let set_pan ?target t ~sw ~net ~clock ~track_index value =
+    with_driver ?target t ~sw ~net ~clock ~op_name:"mixer_set_pan" (fun driver ->
       let module D = (val driver : DAW_DRIVER) in
       match Eio.Promise.await (D.set_pan ~track_index value) with
       | Ok () -> Ok ()
       | Error exn -> Error (`Command_failed (Printexc.to_string exn))
     )
 
-  let set_mute t ~sw ~net ~clock ~track_index enabled =
-    with_driver t ~sw ~net ~clock ~op_name:"mixer_set_mute" (fun driver ->
+  let set_mute ?target t ~sw ~net ~clock ~track_index enabled =
+    with_driver ?target t ~sw ~net ~clock ~op_name:"mixer_set_mute" (fun driver ->
       let module D = (val driver : DAW_DRIVER) in
       match Eio.Promise.await (D.set_mute ~track_index enabled) with
       | Ok () -> Ok ()
       | Error exn -> Error (`Command_failed (Printexc.to_string exn))
     )
 
-  let set_solo t ~sw ~net ~clock ~track_index enabled =
-    with_driver t ~sw ~net ~clock ~op_name:"mixer_set_solo" (fun driver ->
+  let set_solo ?target t ~sw ~net ~clock ~track_index enabled =
+    with_driver ?target t ~sw ~net ~clock ~op_name:"mixer_set_solo" (fun driver ->
       let module D = (val driver : DAW_DRIVER) in
       match Eio.Promise.await (D.set_solo ~track_index enabled) with
       | Ok () -> Ok ()
       | Error exn -> Error (`Command_failed (Printexc.to_string exn))
     )
 
-  let get_channel t ~sw ~net ~clock ~track_index =
-    with_driver t ~sw ~net ~clock ~op_name:"mixer_get_channel" (fun driver ->
+  let get_channel ?target t ~sw ~net ~clock ~track_index =
+    with_driver ?target t ~sw ~net ~clock ~op_name:"mixer_get_channel" (fun driver ->
       let module D = (val driver : DAW_DRIVER) in
       match Eio.Promise.await (D.get_mixer_channel ~track_index) with
       | Ok channel -> Ok channel
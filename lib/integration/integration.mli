@@ -14,6 +14,7 @@ type connection_error = [
   | `Max_attempts
   | `Still_connecting
   | `Command_failed of string
+  | `Unknown_instance of string
 ]
 
 (** Connection state *)
@@ -23,7 +24,28 @@ type connection_state =
   | Connected of (module Daw_driver.Driver.DAW_DRIVER)
   | Failed of string
 
-(** Integration manager state *)
+(** Which driver instance a command is routed to.
+    [instance] wins over [daw]; with neither, the default instance is used. *)
+type target = {
+  daw : Daw_driver.Driver.daw_id option;
+  instance : string option;
+}
+
+val default_target : target
+
+(** Instance summary for status reporting *)
+type instance_info = {
+  instance_id : string;
+  instance_daw : Daw_driver.Driver.daw_id;
+  instance_endpoint : Daw_driver.Driver.endpoint option;
+  status : string;
+  error : string option;
+  is_default : bool;
+}
+
+(** Integration manager state: a registry of independent driver instances
+    keyed by DAW and endpoint, each with its own worker fiber, command queue
+    and circuit breaker. *)
 type t
 
 (** Create new integration manager *)
@@ -35,11 +57,16 @@ val register_all_drivers : unit -> unit
 (** Get human-readable DAW name *)
 val daw_name : Daw_driver.Driver.daw_id -> string
 
+(** Instance id for a DAW and optional endpoint, e.g. ["reaper@127.0.0.1:8001"] *)
+val instance_id : Daw_driver.Driver.daw_id -> Daw_driver.Driver.endpoint option -> string
+
 (** Detect all running DAWs *)
 val detect_running_daws : unit -> Daw_driver.Driver.daw_id list
 
-(** Connect to a specific DAW *)
-val connect_to_daw : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> Daw_driver.Driver.daw_id ->
+(** Connect to a specific DAW, optionally at a non-default [endpoint].
+    The connected instance becomes the default target. *)
+val connect_to_daw : ?endpoint:Daw_driver.Driver.endpoint ->
+  t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> Daw_driver.Driver.daw_id ->
   ((module Daw_driver.Driver.DAW_DRIVER), connection_error) result
 
 (** Auto-detect and connect to first available DAW *)
@@ -49,6 +76,10 @@ val auto_connect : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t ->
 (** Disconnect from current DAW *)
 val disconnect : t -> unit
 
+(** Disconnect and forget every instance, stopping their worker fibers;
+    commands still queued for them fail *)
+val disconnect_all : t -> unit
+
 (** Attempt reconnection *)
 val try_reconnect : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t ->
   ((module Daw_driver.Driver.DAW_DRIVER), connection_error) result
@@ -62,51 +93,55 @@ val is_connected : t -> bool
 (** Get connection status as JSON-friendly record *)
 val get_status : t -> string * string option * string option
 
-(** Execute command with auto-reconnect and resilience *)
-val with_driver : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
+(** All known driver instances, sorted by id *)
+val list_instances : t -> instance_info list
+
+(** Execute command with auto-reconnect and resilience on the target
+    instance's worker fiber *)
+val with_driver : ?target:target -> t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
   op_name:string -> ((module Daw_driver.Driver.DAW_DRIVER) -> ('a, connection_error) result) ->
   ('a, connection_error) result
 
 (** Transport commands with error handling *)
 module Transport : sig
-  val play : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
+  val play : ?target:target -> t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
     ([ `Playing ], connection_error) result
-  val stop : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
+  val stop : ?target:target -> t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
     ([ `Stopped ], connection_error) result
-  val record : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
+  val record : ?target:target -> t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
     ([ `Recording ], connection_error) result
-  val get_state : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
+  val get_state : ?target:target -> t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
     (Daw_driver.Driver.transport_state, connection_error) result
 end
 
 (** Tempo commands *)
 module Tempo : sig
-  val get : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
+  val get : ?target:target -> t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
     (float, connection_error) result
-  val set : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock -> float ->
+  val set : ?target:target -> t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock -> float ->
     (float, connection_error) result
 end
 
 (** Track commands *)
 module Tracks : sig
-  val get_all : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
+  val get_all : ?target:target -> t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
     (Daw_driver.Driver.track list, connection_error) result
-  val select : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock -> int ->
+  val select : ?target:target -> t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock -> int ->
     (int, connection_error) result
-  val get_selected : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
+  val get_selected : ?target:target -> t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
     (int, connection_error) result
 end
 
 (** Mixer commands *)
 module Mixer : sig
-  val set_volume : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
+  val set_volume : ?target:target -> t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
     track_index:int -> float -> (unit, connection_error) result
-  val set_pan : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
+  val set_pan : ?target:target -> t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
     track_index:int -> float -> (unit, connection_error) result
-  val set_mute : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
+  val set_mute : ?target:target -> t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
     track_index:int -> bool -> (unit, connection_error) result
-  val set_solo : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
+  val set_solo : ?target:target -> t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
     track_index:int -> bool -> (unit, connection_error) result
-  val get_channel : t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
+  val get_channel : ?target:target -> t -> sw:Eio.Switch.t -> net:_ Eio.Net.t -> clock:_ Eio.Time.clock ->
     track_index:int -> (Daw_driver.Driver.mixer_channel, connection_error) result
 end
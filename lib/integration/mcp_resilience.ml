@@ -12,6 +12,13 @@ type logger = log_level -> string -> unit
 (** No-op logger *)
 let null_logger _ _ = ()
 
+let retries =
+  Metrics.counter ~label:"operation" ~help:"Attempts retried after a failure" "daw_driver_retries_total"
+
+let rejections =
+  Metrics.counter ~label:"breaker" ~help:"Calls rejected by an open circuit breaker"
+    "daw_circuit_breaker_rejections_total"
+
 (* ============================================ *)
 (* Retry Policy Configuration                   *)
 (* ============================================ *)
@@ -176,6 +183,7 @@ let with_retry_eio
     in
     if not cb_allows then begin
       logger Warn (Printf.sprintf "%s: circuit breaker OPEN, rejecting" op_name);
+      (match circuit_breaker with Some cb -> Metrics.incr rejections cb.name | None -> ());
       CircuitOpen
     end
     else if n > policy.max_attempts then begin
@@ -183,9 +191,11 @@ let with_retry_eio
     end
     else begin
       if n > 1 then begin
+        Metrics.incr retries op_name;
         let delay_ms = calculate_delay policy (n - 1) in
         logger Debug (Printf.sprintf "%s: retrying in %.0fms (attempt %d)" op_name delay_ms n);
-        Eio.Time.sleep clock (delay_ms /. 1000.0)
+        Metrics.Trace.span ~cat:"retry" "retry.backoff" (fun () ->
+          Eio.Time.sleep clock (delay_ms /. 1000.0))
       end;
 
       match f () with
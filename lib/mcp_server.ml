@@ -106,6 +106,21 @@ let resource_to_wire_json (resource : resource) =
   in
   `Assoc (List.rev fields)
 
+(** Optional routing arguments shared by integration-backed tools *)
+let routing_properties = [
+  ("daw", `Assoc [
+    ("type", `String "string");
+    ("description", `String "Route to this DAW (reaper, ableton, logic, mainstage) or instance id; defaults to the last connected DAW");
+  ]);
+  ("instance", `Assoc [
+    ("type", `String "string");
+    ("description", `String "Route to a specific driver instance, e.g. reaper@127.0.0.1:8001 (see daw_status)");
+  ]);
+]
+
+(** FFT sizes daw_spectrum accepts *)
+let spectrum_fft_sizes = [1024; 2048; 4096; 8192; 16384]
+
 (** Define all MCP tools *)
 let tools : tool list = [
   {
@@ -118,6 +133,28 @@ let tools : tool list = [
           ("type", `String "string");
           ("description", `String "Specific DAW to connect to (optional). Options: reaper, ableton, logic, cubase, protools, fl, mainstage");
         ]);
+        ("host", `Assoc [
+          ("type", `String "string");
+          ("description", `String "OSC host for an additional instance (OSC DAWs only, requires daw and port)");
+        ]);
+        ("port", `Assoc [
+          ("type", `String "integer");
+          ("description", `String "OSC port for an additional instance (OSC DAWs only)");
+        ]);
+        ("transport", `Assoc [
+          ("type", `String "string");
+          ("enum", `List [`String "udp"; `String "tcp"; `String "unix"]);
+          ("description", `String "OSC transport for the instance (default udp). tcp/unix use stream framing");
+        ]);
+        ("framing", `Assoc [
+          ("type", `String "string");
+          ("enum", `List [`String "slip"; `String "length"]);
+          ("description", `String "Stream framing for tcp/unix: slip (OSC 1.1, default) or length (OSC 1.0 size prefix)");
+        ]);
+        ("path", `Assoc [
+          ("type", `String "string");
+          ("description", `String "Unix socket path (transport=unix)");
+        ]);
       ]);
     ];
   };
@@ -136,7 +173,7 @@ let tools : tool list = [
           ("type", `String "number");
           ("description", `String "Position in seconds (for goto)");
         ]);
-      ]);
+      ] @ routing_properties);
       ("required", `List [`String "action"]);
     ];
   };
@@ -150,7 +187,7 @@ let tools : tool list = [
           ("type", `String "number");
           ("description", `String "Tempo in BPM (omit to get current tempo)");
         ]);
-      ]);
+      ] @ routing_properties);
     ];
   };
   {
@@ -167,7 +204,7 @@ let tools : tool list = [
           ("type", `String "string");
           ("description", `String "Track name to search for");
         ]);
-      ]);
+      ] @ routing_properties);
     ];
   };
   {
@@ -200,7 +237,7 @@ let tools : tool list = [
           ("type", `String "boolean");
           ("description", `String "Record arm state");
         ]);
-      ]);
+      ] @ routing_properties);
       ("required", `List [`String "track"]);
     ];
   };
@@ -209,7 +246,7 @@ let tools : tool list = [
     description = "List all tracks in the project";
     input_schema = `Assoc [
       ("type", `String "object");
-      ("properties", `Assoc []);
+      ("properties", `Assoc routing_properties);
     ];
   };
   {
@@ -223,7 +260,7 @@ let tools : tool list = [
   (* Phase 6: Real-time Metering Tools *)
   {
     name = "daw_meter";
-    description = "Get real-time audio meter levels (RMS/Peak in dB)";
+    description = "Get real-time audio meter levels (RMS/Peak in dB, EBU R128 loudness in LUFS, stereo correlation/balance)";
     input_schema = `Assoc [
       ("type", `String "object");
       ("properties", `Assoc [
@@ -236,6 +273,46 @@ let tools : tool list = [
           ("enum", `List [`String "left"; `String "right"; `String "stereo"]);
           ("description", `String "Channel to read (default: stereo)");
         ]);
+        ("loudness", `Assoc [
+          ("type", `String "boolean");
+          ("description", `String "Include momentary/short-term/integrated LUFS and loudness range (default: true)");
+        ]);
+        ("ballistics", `Assoc [
+          ("type", `String "string");
+          ("enum", `List [`String "rms"; `String "vu"; `String "ppm1"; `String "ppm2"; `String "digital"]);
+          ("description", `String "Meter ballistics preset (default: rms)");
+        ]);
+        ("goniometer", `Assoc [
+          ("type", `String "boolean");
+          ("description", `String "Include goniometer density and phase-angle histograms (default: false)");
+        ]);
+      ]);
+    ];
+  };
+  {
+    name = "daw_spectrum";
+    description = "Get spectrum analysis (third-octave bands, spectral centroid and tilt)";
+    input_schema = `Assoc [
+      ("type", `String "object");
+      ("properties", `Assoc [
+        ("track", `Assoc [
+          ("type", `String "integer");
+          ("description", `String "Track index (1-based), omit for master");
+        ]);
+        ("fft_size", `Assoc [
+          ("type", `String "integer");
+          ("enum", `List (List.map (fun n -> `Int n) spectrum_fft_sizes));
+          ("description", `String "FFT size in samples (default: 4096)");
+        ]);
+        ("window", `Assoc [
+          ("type", `String "string");
+          ("enum", `List [`String "hann"; `String "hamming"; `String "blackman-harris"; `String "rectangular"]);
+          ("description", `String "Analysis window (default: hann)");
+        ]);
+        ("points", `Assoc [
+          ("type", `String "integer");
+          ("description", `String "Log-spaced spectrum points to return, 1-1024 (default: 64)");
+        ]);
       ]);
     ];
   };
@@ -247,13 +324,22 @@ let tools : tool list = [
       ("properties", `Assoc [
         ("track", `Assoc [
           ("type", `String "integer");
-          ("description", `String "Track index (1-based), omit for master");
+          ("description", `String "Track index (1-based, 0 = master), omit for all tracks");
         ]);
         ("fps", `Assoc [
           ("type", `String "integer");
           ("enum", `List [`Int 30; `Int 60]);
           ("description", `String "Frames per second (default: 30)");
         ]);
+        ("encoding", `Assoc [
+          ("type", `String "string");
+          ("enum", `List [`String "json"; `String "compact"]);
+          ("description", `String "Frame encoding (default: json)");
+        ]);
+        ("stream_id", `Assoc [
+          ("type", `String "string");
+          ("description", `String "Stream to stop (returned by start)");
+        ]);
         ("action", `Assoc [
           ("type", `String "string");
           ("enum", `List [`String "start"; `String "stop"]);
@@ -263,6 +349,27 @@ let tools : tool list = [
       ("required", `List [`String "action"]);
     ];
   };
+  {
+    name = "daw_meter_history";
+    description = "Get a track's recent meter history as min/max/RMS points (peak envelope and RMS per channel)";
+    input_schema = `Assoc [
+      ("type", `String "object");
+      ("properties", `Assoc [
+        ("track", `Assoc [
+          ("type", `String "integer");
+          ("description", `String "Track index (default: 0)");
+        ]);
+        ("seconds", `Assoc [
+          ("type", `String "number");
+          ("description", `String "How far back to look (default: 60)");
+        ]);
+        ("points", `Assoc [
+          ("type", `String "integer");
+          ("description", `String "Points to return per channel, 1-1000 (default: 100)");
+        ]);
+      ]);
+    ];
+  };
   (* Phase 6: Automation Tools *)
   {
     name = "daw_automation_read";
@@ -545,7 +652,7 @@ Examples:
 Tools:
 - daw_detect, daw_transport, daw_tempo, daw_select_track, daw_mixer, daw_tracks,
   daw_automation_read, daw_automation_write, daw_automation_mode, daw_plugin_param,
-  daw_markers, daw_routing, daw_render, daw_meter, daw_meter_stream,
+  daw_markers, daw_routing, daw_render, daw_meter, daw_spectrum, daw_meter_stream,
   daw_settings, daw_status
 |};
   };
@@ -573,6 +680,7 @@ All tools are currently implemented as code but mostly untested.
 - daw_routing
 - daw_render
 - daw_meter
+- daw_spectrum
 - daw_meter_stream
 - daw_settings
 - daw_status
@@ -593,6 +701,49 @@ let error_to_string = function
   | `Max_attempts -> "Max reconnection attempts reached"
   | `Still_connecting -> "Still connecting..."
   | `Command_failed msg -> Printf.sprintf "Command failed: %s" msg
+  | `Unknown_instance id -> Printf.sprintf "Unknown instance: %s" id
+
+(** Routing target from optional [daw]/[instance] tool arguments.
+    A [daw] value that is not a DAW name is treated as an instance id. *)
+let target_of_args args =
+  let open Yojson.Safe.Util in
+  match args with
+  | `Assoc _ ->
+    let instance = args |> member "instance" |> to_string_option in
+    (match args |> member "daw" |> to_string_option with
+     | None -> Daw_integration.{ daw = None; instance }
+     | Some name ->
+       match daw_id_of_string name with
+       | Some daw_id -> Daw_integration.{ daw = Some daw_id; instance }
+       | None ->
+         Daw_integration.{ daw = None;
+                           instance = (match instance with Some _ -> instance | None -> Some name) })
+  | _ -> Daw_integration.default_target
+
+(** Instance summary as JSON *)
+let instance_info_to_json (info : Daw_integration.instance_info) =
+  `Assoc [
+    ("id", `String info.instance_id);
+    ("daw", `String (Daw_integration.daw_name info.instance_daw));
+    ("endpoint", match info.instance_endpoint with
+      | Some ep -> `String (Printf.sprintf "%s:%d" ep.Daw_driver.Driver.host ep.port)
+      | None -> `Null);
+    ("state", `String info.status);
+    ("error", match info.error with Some e -> `String e | None -> `Null);
+    ("default", `Bool info.is_default);
+  ]
+
+(** Connection status and instances, as reported by [daw_status] *)
+let status_json integration =
+  let (state, daw_name, error_msg) = Daw_integration.get_status integration in
+  `Assoc [
+    ("state", `String state);
+    ("daw", match daw_name with Some n -> `String n | None -> `Null);
+    ("error", match error_msg with Some e -> `String e | None -> `Null);
+    ("connected", `Bool (state = "connected"));
+    ("instances", `List (List.map instance_info_to_json
+      (Daw_integration.list_instances integration)));
+  ]
 
 (** Make tool result JSON *)
 let make_tool_result req_id result =
@@ -662,25 +813,62 @@ let handle_resources_templates_list req_id _params =
     ("resourceTemplates", `List []);
   ])
 
+(** Loudness of the simulated daw_meter signal, measured once: 3 s of the
+    signal so the short-term window is filled *)
+let simulated_loudness = lazy (
+  let lm = Metering.Loudness.create ~sample_rate:44100.0 ~channels:2 () in
+  let long = Array.init (3 * 44100) (fun i -> sin (Float.of_int i *. 0.1) *. 0.5) in
+  Metering.Loudness.process_planar_array lm [| long; long |];
+  Metering.Loudness.reading lm)
+
 (** Handle tools/call request with Integration layer *)
-let handle_tools_call ~req_id ~integration ~sw ~net ~clock params =
+let handle_tools_call ?meters ~req_id ~integration ~sw ~net ~clock params =
   let open Yojson.Safe.Util in
   let name = params |> member "name" |> to_string in
   let args = params |> member "arguments" in
+  let target = target_of_args args in
 
   match name with
   | "daw_detect" ->
     (* Auto-detect or connect to specific DAW *)
     let daw_name_opt = args |> member "daw" |> to_string_option in
-    let result = match daw_name_opt with
-      | Some name ->
+    let endpoint =
+      let open Daw_driver.Driver in
+      let framing =
+        match args |> member "framing" |> to_string_option with
+        | Some "length" -> Length_prefix
+        | _ -> Slip
+      in
+      let host_opt = args |> member "host" |> to_string_option in
+      let host = Option.value ~default:"127.0.0.1" host_opt in
+      (* Only a request naming no endpoint at all uses the default one *)
+      match args |> member "transport" |> to_string_option,
+            args |> member "port" |> to_int_option,
+            args |> member "path" |> to_string_option with
+      | Some "unix", _, Some path -> Ok (Some { host; port = 0; protocol = Unix_socket (path, framing) })
+      | Some "unix", _, None -> Error "transport \"unix\" requires path"
+      | Some "tcp", Some port, _ -> Ok (Some { host; port; protocol = Tcp framing })
+      | Some "tcp", None, _ -> Error "transport \"tcp\" requires port"
+      | (None | Some "udp"), Some port, _ -> Ok (Some { host; port; protocol = Udp })
+      | (None | Some "udp"), None, _ when Option.is_some host_opt -> Error "host requires port"
+      | (None | Some "udp"), None, _ -> Ok None
+      | Some transport, _, _ -> Error (Printf.sprintf "Unknown transport: %s" transport)
+    in
+    let result = match daw_name_opt, endpoint with
+      | _, Error msg ->
+        `Assoc [
+          ("connected", `Bool false);
+          ("error", `String msg);
+        ]
+      | Some name, Ok endpoint ->
         (match daw_id_of_string name with
          | Some daw_id ->
-           (match Daw_integration.connect_to_daw integration ~sw ~net daw_id with
+           (match Daw_integration.connect_to_daw ?endpoint integration ~sw ~net daw_id with
             | Ok _driver ->
               `Assoc [
                 ("connected", `Bool true);
                 ("daw", `String (Daw_integration.daw_name daw_id));
+                ("instance", `String (Daw_integration.instance_id daw_id endpoint));
                 ("message", `String "Successfully connected");
               ]
             | Error err ->
@@ -694,7 +882,7 @@ let handle_tools_call ~req_id ~integration ~sw ~net ~clock params =
              ("connected", `Bool false);
              ("error", `String (Printf.sprintf "Unknown DAW: %s" name));
            ])
-      | None ->
+      | None, Ok _ ->
         (* Auto-detect *)
         (match Daw_integration.auto_connect integration ~sw ~net with
          | Ok driver ->
@@ -720,15 +908,15 @@ let handle_tools_call ~req_id ~integration ~sw ~net ~clock params =
     let action = args |> member "action" |> to_string in
     let result = match action with
       | "play" ->
-        (match Daw_integration.Transport.play integration ~sw ~net ~clock with
+        (match Daw_integration.Transport.play ~target integration ~sw ~net ~clock with
          | Ok `Playing -> `Assoc [("action", `String "play"); ("success", `Bool true)]
          | Error err -> `Assoc [("action", `String "play"); ("success", `Bool false); ("error", `String (error_to_string err))])
       | "stop" ->
-        (match Daw_integration.Transport.stop integration ~sw ~net ~clock with
+        (match Daw_integration.Transport.stop ~target integration ~sw ~net ~clock with
          | Ok `Stopped -> `Assoc [("action", `String "stop"); ("success", `Bool true)]
          | Error err -> `Assoc [("action", `String "stop"); ("success", `Bool false); ("error", `String (error_to_string err))])
       | "record" ->
-        (match Daw_integration.Transport.record integration ~sw ~net ~clock with
+        (match Daw_integration.Transport.record ~target integration ~sw ~net ~clock with
          | Ok `Recording -> `Assoc [("action", `String "record"); ("success", `Bool true)]
          | Error err -> `Assoc [("action", `String "record"); ("success", `Bool false); ("error", `String (error_to_string err))])
       | _ ->
@@ -740,13 +928,13 @@ let handle_tools_call ~req_id ~integration ~sw ~net ~clock params =
     let bpm = args |> member "bpm" |> to_float_option in
     let result = match bpm with
       | Some v ->
-        (match Daw_integration.Tempo.set integration ~sw ~net ~clock v with
+        (match Daw_integration.Tempo.set ~target integration ~sw ~net ~clock v with
          | Ok new_bpm ->
            `Assoc [("action", `String "set"); ("bpm", `Float new_bpm); ("success", `Bool true)]
          | Error err ->
            `Assoc [("action", `String "set"); ("bpm", `Float v); ("success", `Bool false); ("error", `String (error_to_string err))])
       | None ->
-        (match Daw_integration.Tempo.get integration ~sw ~net ~clock with
+        (match Daw_integration.Tempo.get ~target integration ~sw ~net ~clock with
          | Ok current_bpm ->
            `Assoc [("action", `String "get"); ("bpm", `Float current_bpm); ("success", `Bool true)]
          | Error err ->
@@ -758,7 +946,7 @@ let handle_tools_call ~req_id ~integration ~sw ~net ~clock params =
     let index = args |> member "index" |> to_int_option in
     let result = match index with
       | Some idx ->
-        (match Daw_integration.Tracks.select integration ~sw ~net ~clock idx with
+        (match Daw_integration.Tracks.select ~target integration ~sw ~net ~clock idx with
          | Ok selected_idx ->
            `Assoc [("index", `Int selected_idx); ("success", `Bool true)]
          | Error err ->
@@ -779,28 +967,28 @@ let handle_tools_call ~req_id ~integration ~sw ~net ~clock params =
     let results = [] in
     let results = match volume with
       | Some v ->
-        (match Daw_integration.Mixer.set_volume integration ~sw ~net ~clock ~track_index v with
+        (match Daw_integration.Mixer.set_volume ~target integration ~sw ~net ~clock ~track_index v with
          | Ok () -> ("volume", `Assoc [("set", `Float v); ("success", `Bool true)]) :: results
          | Error err -> ("volume", `Assoc [("set", `Float v); ("success", `Bool false); ("error", `String (error_to_string err))]) :: results)
       | None -> results
     in
     let results = match pan with
       | Some v ->
-        (match Daw_integration.Mixer.set_pan integration ~sw ~net ~clock ~track_index v with
+        (match Daw_integration.Mixer.set_pan ~target integration ~sw ~net ~clock ~track_index v with
          | Ok () -> ("pan", `Assoc [("set", `Float v); ("success", `Bool true)]) :: results
          | Error err -> ("pan", `Assoc [("set", `Float v); ("success", `Bool false); ("error", `String (error_to_string err))]) :: results)
       | None -> results
     in
     let results = match mute with
       | Some v ->
-        (match Daw_integration.Mixer.set_mute integration ~sw ~net ~clock ~track_index v with
+        (match Daw_integration.Mixer.set_mute ~target integration ~sw ~net ~clock ~track_index v with
          | Ok () -> ("mute", `Assoc [("set", `Bool v); ("success", `Bool true)]) :: results
          | Error err -> ("mute", `Assoc [("set", `Bool v); ("success", `Bool false); ("error", `String (error_to_string err))]) :: results)
       | None -> results
     in
     let results = match solo with
       | Some v ->
-        (match Daw_integration.Mixer.set_solo integration ~sw ~net ~clock ~track_index v with
+        (match Daw_integration.Mixer.set_solo ~target integration ~sw ~net ~clock ~track_index v with
          | Ok () -> ("solo", `Assoc [("set", `Bool v); ("success", `Bool true)]) :: results
          | Error err -> ("solo", `Assoc [("set", `Bool v); ("success", `Bool false); ("error", `String (error_to_string err))]) :: results)
       | None -> results
@@ -809,7 +997,7 @@ let handle_tools_call ~req_id ~integration ~sw ~net ~clock params =
     make_tool_result req_id result
 
   | "daw_tracks" ->
-    let result = match Daw_integration.Tracks.get_all integration ~sw ~net ~clock with
+    let result = match Daw_integration.Tracks.get_all ~target integration ~sw ~net ~clock with
       | Ok tracks ->
         let tracks_json = List.map (fun (t : Daw_driver.Driver.track) ->
           `Assoc [
@@ -836,51 +1024,150 @@ let handle_tools_call ~req_id ~integration ~sw ~net ~clock params =
     make_tool_result req_id result
 
   | "daw_status" ->
-    let (state, daw_name, error_msg) = Daw_integration.get_status integration in
-    let result = `Assoc [
-      ("state", `String state);
-      ("daw", match daw_name with Some n -> `String n | None -> `Null);
-      ("error", match error_msg with Some e -> `String e | None -> `Null);
-      ("connected", `Bool (state = "connected"));
-    ] in
-    make_tool_result req_id result
+    make_tool_result req_id (status_json integration)
 
   (* Phase 6: Real-time Metering *)
   | "daw_meter" ->
     let track = args |> member "track" |> to_int_option in
     let channel = args |> member "channel" |> to_string_option |> Option.value ~default:"stereo" in
-    (* Create a sample meter frame for demo - real implementation would get from plugin bridge *)
-    let meter = Metering.create_stereo_processor ~sample_rate:44100.0 in
-    (* Simulate some audio data *)
-    let samples = Array.init 1024 (fun i -> sin (Float.of_int i *. 0.1) *. 0.5) in
-    let stereo = Metering.process_stereo_buffer meter ~left:samples ~right:samples in
     let track_idx = Option.value track ~default:0 in
-    let frame = Metering.create_frame ~timestamp:0.0 ~track_index:track_idx ~output:stereo () in
-    let result = `Assoc [
-      ("track", match track with Some t -> `Int t | None -> `String "master");
-      ("channel", `String channel);
-      ("frame", Metering.frame_to_json frame);
-      ("success", `Bool true);
-    ] in
+    let track_json = match track with Some t -> `Int t | None -> `String "master" in
+    let ballistics = args |> member "ballistics" |> to_string_option |> Option.value ~default:"rms" in
+    let result =
+      match Metering.ballistics_of_string ballistics, Option.bind meters (fun hub -> Sse.latest_frame hub track_idx) with
+      | None, _ ->
+        `Assoc [
+          ("success", `Bool false);
+          ("error", `String ("Unknown ballistics: " ^ ballistics));
+        ]
+      | Some _, Some frame ->
+        (* The shared meter producer's frame, with the hub's ballistics;
+           true peak and goniometer need audio the hub does not keep *)
+        `Assoc [
+          ("track", track_json);
+          ("channel", `String channel);
+          ("source", `String "hub");
+          ("frame", Metering.frame_to_json frame);
+          ("success", `Bool true);
+        ]
+      | Some preset, None ->
+        (* Create a sample meter frame for demo - real implementation would get from plugin bridge *)
+        let meter = Metering.create_stereo_processor ~sample_rate:44100.0 in
+        Metering.set_stereo_ballistics meter preset;
+        let goniometer =
+          if args |> member "goniometer" |> to_bool_option |> Option.value ~default:false then
+            Some (Metering.create_goniometer ())
+          else None
+        in
+        meter.Metering.goniometer <- goniometer;
+        (* Simulate some audio data *)
+        let samples = Array.init 1024 (fun i -> sin (Float.of_int i *. 0.1) *. 0.5) in
+        let stereo = Metering.process_stereo_buffer meter ~left:samples ~right:samples in
+        let loudness =
+          if args |> member "loudness" |> to_bool_option |> Option.value ~default:true then begin
+            Some (Lazy.force simulated_loudness)
+          end else None
+        in
+        let frame =
+          Metering.create_frame ~timestamp:0.0 ~track_index:track_idx ~output:stereo ?loudness
+            ~field:(Metering.get_stereo_field meter) ()
+        in
+        `Assoc ([
+          ("track", track_json);
+          ("channel", `String channel);
+          ("source", `String "simulated");
+          ("ballistics", `String ballistics);
+          ("frame", Metering.frame_to_json frame);
+          ("true_peak_db", `Assoc [
+            ("left", `Float (Metering.get_true_peak meter.Metering.left));
+            ("right", `Float (Metering.get_true_peak meter.Metering.right));
+          ]);
+        ] @ (match goniometer with
+            | Some g -> [("goniometer", Metering.goniometer_to_json g)]
+            | None -> [])
+          @ [("success", `Bool true)])
+    in
+    make_tool_result req_id result
+
+  | "daw_spectrum" ->
+    let track = args |> member "track" |> to_int_option in
+    let fft_size = args |> member "fft_size" |> to_int_option |> Option.value ~default:4096 in
+    let window_name = args |> member "window" |> to_string_option |> Option.value ~default:"hann" in
+    let points = args |> member "points" |> to_int_option |> Option.value ~default:64 in
+    let points = max 1 (min 1024 points) in
+    let result =
+      match Metering.Spectrum.window_of_string window_name with
+      | None ->
+        `Assoc [
+          ("success", `Bool false);
+          ("error", `String ("Unknown window: " ^ window_name));
+        ]
+      | Some _ when not (List.mem fft_size spectrum_fft_sizes) ->
+        `Assoc [
+          ("success", `Bool false);
+          ("error", `String (Printf.sprintf "Unsupported fft_size: %d (use %s)" fft_size
+                               (String.concat ", " (List.map string_of_int spectrum_fft_sizes))));
+        ]
+      | Some window ->
+        (match Metering.Spectrum.create_plan ~window fft_size with
+         | exception Invalid_argument msg ->
+           `Assoc [("success", `Bool false); ("error", `String msg)]
+         | plan ->
+           (* Simulated signal, as in daw_meter - real implementation would get audio from plugin bridge *)
+           let analyzer = Metering.Spectrum.create ~sample_rate:44100.0 plan in
+           let samples = Array.init 44100 (fun i -> sin (Float.of_int i *. 0.1) *. 0.5) in
+           Metering.Spectrum.process_array analyzer samples;
+           `Assoc [
+             ("track", match track with Some t -> `Int t | None -> `String "master");
+             ("fft_size", `Int fft_size);
+             ("window", `String window_name);
+             ("analysis", Metering.Spectrum.analysis_to_json
+                (Metering.Spectrum.analysis ~points analyzer));
+             ("success", `Bool true);
+           ])
+    in
     make_tool_result req_id result
 
   | "daw_meter_stream" ->
     let action = args |> member "action" |> to_string in
     let track = args |> member "track" |> to_int_option in
     let fps = args |> member "fps" |> to_int_option |> Option.value ~default:30 in
-    let result = match action with
-      | "start" ->
+    let encoding = args |> member "encoding" |> to_string_option |> Option.value ~default:"json" in
+    let result = match action, meters with
+      | "start", Some hub ->
+        let config = {
+          Sse.default_config with
+          Sse.frame_rate = fps;
+          track_indices = Option.map (fun t -> [t]) track;
+          encoding = Option.value (Sse.encoding_of_string encoding) ~default:Sse.Json;
+        } in
+        let stream_id = Sse.open_meter_stream hub config in
         `Assoc [
           ("action", `String "start");
-          ("track", match track with Some t -> `Int t | None -> `String "master");
+          ("track", match track with Some t -> `Int t | None -> `String "all");
           ("fps", `Int fps);
-          ("stream_id", `String (Printf.sprintf "meter_%d" (Random.int 10000)));
-          ("message", `String "SSE stream started (connect to /sse/meter for data)");
+          ("encoding", `String (Sse.encoding_to_string config.Sse.encoding));
+          ("stream_id", `String stream_id);
+          ("url", `String ("/mcp/meters/" ^ stream_id));
+          ("message", `String ("GET /mcp/meters/" ^ stream_id ^ " for the SSE stream"));
           ("success", `Bool true);
         ]
-      | "stop" ->
+      | "start", None ->
+        `Assoc [
+          ("success", `Bool false);
+          ("error", `String "Meter streaming requires the HTTP transport");
+        ]
+      | "stop", _ ->
+        let stream_id = args |> member "stream_id" |> to_string_option in
+        let closed =
+          match meters, stream_id with
+          | Some hub, Some id -> Sse.close_meter_stream hub id
+          | _ -> false
+        in
         `Assoc [
           ("action", `String "stop");
+          ("stream_id", match stream_id with Some id -> `String id | None -> `Null);
+          ("closed", `Bool closed);
           ("message", `String "SSE stream stopped");
           ("success", `Bool true);
         ]
@@ -892,6 +1179,29 @@ let handle_tools_call ~req_id ~integration ~sw ~net ~clock params =
     in
     make_tool_result req_id result
 
+  | "daw_meter_history" ->
+    let track = args |> member "track" |> to_int_option |> Option.value ~default:0 in
+    let seconds = args |> member "seconds" |> to_number_option |> Option.value ~default:60.0 in
+    let points = args |> member "points" |> to_int_option |> Option.value ~default:100 in
+    let result =
+      match meters with
+      | None ->
+        `Assoc [
+          ("success", `Bool false);
+          ("error", `String "Meter history requires the HTTP transport");
+        ]
+      | Some hub ->
+        let seconds = Float.max 0.0 seconds and points = max 1 (min 1000 points) in
+        (match Sse.history_json hub ~track ~seconds ~points with
+         | Some (`Assoc fields) -> `Assoc (fields @ [("success", `Bool true)])
+         | Some _ | None ->
+           `Assoc [
+             ("success", `Bool false);
+             ("error", `String (Printf.sprintf "No meter history for track %d" track));
+           ])
+    in
+    make_tool_result req_id result
+
   (* Phase 6: Automation *)
   | "daw_automation_read" ->
     let track = args |> member "track" |> to_int in
@@ -1166,16 +1476,131 @@ let handle_tools_call ~req_id ~integration ~sw ~net ~clock params =
   | _ ->
     make_error None (-32601) (Printf.sprintf "Unknown tool: %s" name)
 
+(** {1 Cancellation and Deadlines} *)
+
+(** Tool calls in flight, each in its own cancellation context keyed by
+    its session and JSON-RPC id, so [notifications/cancelled] can stop
+    it. The session scopes ids to one connection (or MCP session): a
+    client can only cancel its own requests. *)
+type request_table = {
+  running : (string, Eio.Cancel.t) Hashtbl.t;
+  mutable cancelled : int;   (** by [notifications/cancelled] *)
+  mutable timed_out : int;   (** by the tool's deadline *)
+}
+
+exception Cancelled_by_client
+
+(** Error code of a cancelled request's response; transports that can
+    stay silent drop it (see [process_json_with_context_opt]) *)
+let cancelled_code = -32800
+
+let timeout_code = -32001
+
+(** Seconds a tool call may run before it is cancelled *)
+let default_tool_deadline = 30.0
+
+let tool_deadlines = [
+  ("daw_detect", 15.0);
+  ("daw_status", 10.0);
+  ("daw_render", 600.0);
+]
+
+let tool_deadline name =
+  Option.value ~default:default_tool_deadline (List.assoc_opt name tool_deadlines)
+
+let sessions = Atomic.make 0
+
+(** A fresh session token, e.g. for a new connection *)
+let new_session () = Printf.sprintf "conn-%d" (Atomic.fetch_and_add sessions 1)
+
+let request_key ~session = function
+  | None | Some `Null -> None
+  | Some id -> Some (session ^ "\000" ^ Yojson.Safe.to_string id)
+
+(** Run a request in its own cancellation context, registered under its
+    session and id while it runs, with a [deadline] in seconds *)
+let run_cancellable requests ~session ~clock ~deadline id f =
+  let run () =
+    match Eio.Time.with_timeout clock deadline (fun () -> Ok (f ())) with
+    | Ok v -> v
+    | Error `Timeout ->
+      requests.timed_out <- requests.timed_out + 1;
+      make_error id timeout_code (Printf.sprintf "Request timed out after %gs" deadline)
+  in
+  match request_key ~session id with
+  | None -> run ()
+  | Some key ->
+    match
+      Eio.Cancel.sub (fun cc ->
+        Hashtbl.replace requests.running key cc;
+        Fun.protect run ~finally:(fun () ->
+          match Hashtbl.find_opt requests.running key with
+          | Some c when c == cc -> Hashtbl.remove requests.running key
+          | _ -> ()))
+    with
+    | response -> response
+    | exception (Eio.Cancel.Cancelled Cancelled_by_client) ->
+      (* Only our sub-context was cancelled unless this fiber is too *)
+      Eio.Fiber.check ();
+      make_error id cancelled_code "Request cancelled"
+
+(** Handle [notifications/cancelled]: cancel the request of [session]
+    named by [params.requestId] if it is still running *)
+let cancel_request requests ~session params =
+  let open Yojson.Safe.Util in
+  let id = Option.map (member "requestId") params in
+  match request_key ~session id with
+  | None -> ()
+  | Some key ->
+    match Hashtbl.find_opt requests.running key with
+    | Some cc ->
+      Hashtbl.remove requests.running key;
+      requests.cancelled <- requests.cancelled + 1;
+      Logs.info (fun m -> m "Cancelling request %s%s" (Option.fold ~none:"" ~some:Yojson.Safe.to_string id)
+        (match params |> Option.map (member "reason") with
+         | Some (`String reason) -> ": " ^ reason
+         | _ -> ""));
+      Eio.Cancel.cancel cc Cancelled_by_client
+    | None -> ()
+
+let requests_json requests =
+  `Assoc [
+    ("in_flight", `Int (Hashtbl.length requests.running));
+    ("cancelled", `Int requests.cancelled);
+    ("timed_out", `Int requests.timed_out);
+  ]
+
 (** Server context for stateful operations *)
 type ('a, 'b) server_context = {
   integration : Daw_integration.t;
+  meters : Sse.hub option;  (** shared meter producer (HTTP transport) *)
+  requests : request_table;
   sw : Eio.Switch.t;
   net : 'a Eio.Net.t;
   clock : 'b Eio.Time.clock;
 }
 
-(** Handle JSON-RPC request with context *)
-let handle_request_with_context ~ctx req =
+(** {1 Request Metrics} *)
+
+let request_seconds =
+  Metrics.histogram ~label:"method" ~help:"JSON-RPC request latency by method" "mcp_request_seconds"
+
+let tool_seconds =
+  Metrics.histogram ~label:"tool" ~help:"tools/call latency by tool" "mcp_tool_seconds"
+
+let requests_in_flight =
+  Metrics.gauge ~label:"method" ~help:"JSON-RPC requests being handled" "mcp_requests_in_flight"
+
+let known_methods = [
+  "initialize"; "initialized"; "notifications/initialized"; "notifications/cancelled";
+  "tools/list"; "tools/call"; "resources/list"; "resources/read"; "resources/templates/list"; "ping";
+]
+
+(** Metric labels; names the server does not know are counted as ["other"] *)
+let method_label m = if List.mem m known_methods then m else "other"
+let tool_label name = if List.exists (fun (t : tool) -> t.name = name) tools then name else "other"
+
+let dispatch_request_with_context ~ctx ~session req =
   match req.method_ with
   | "initialize" -> handle_initialize req.id req.params
   | "initialized"
@@ -1187,38 +1612,74 @@ let handle_request_with_context ~ctx req =
   | "tools/call" ->
     (match req.params with
      | Some params ->
-       handle_tools_call
-         ~req_id:req.id
-         ~integration:ctx.integration
-         ~sw:ctx.sw
-         ~net:ctx.net
-         ~clock:ctx.clock
-         params
+       let name =
+         match Yojson.Safe.Util.member "name" params with
+         | `String name -> name
+         | _ -> ""
+       in
+       run_cancellable ctx.requests ~session ~clock:ctx.clock ~deadline:(tool_deadline name) req.id (fun () ->
+         Metrics.time tool_seconds (tool_label name) (fun () ->
+           Metrics.Trace.span ~cat:"tool" name (fun () ->
+             handle_tools_call
+               ?meters:ctx.meters
+               ~req_id:req.id
+               ~integration:ctx.integration
+               ~sw:ctx.sw
+               ~net:ctx.net
+               ~clock:ctx.clock
+               params)))
      | None -> make_error req.id (-32602) "Missing params")
+  | "notifications/cancelled" ->
+    cancel_request ctx.requests ~session req.params;
+    make_response req.id (`Assoc [])
   | "ping" -> make_response req.id (`Assoc [])
   | method_ -> make_error req.id (-32601) (Printf.sprintf "Unknown method: %s" method_)
 
-(** Process incoming JSON with context *)
-let process_json_with_context ~ctx json_str =
+(** Handle JSON-RPC request with context, recording latency by method.
+    [session] scopes request ids for cancellation (default: a fresh
+    session, so the request cannot be cancelled). *)
+let handle_request_with_context ~ctx ?(session = new_session ()) req =
+  let label = method_label req.method_ in
+  Metrics.add requests_in_flight label 1;
+  Fun.protect ~finally:(fun () -> Metrics.add requests_in_flight label (-1)) (fun () ->
+    Metrics.time request_seconds label (fun () ->
+      Metrics.Trace.span ~cat:"mcp" req.method_ (fun () -> dispatch_request_with_context ~ctx ~session req)))
+
+(** Process incoming JSON with context; see [handle_request_with_context]
+    for [session] *)
+let process_json_with_context ~ctx ?session json_str =
   try
-    let json = Yojson.Safe.from_string json_str in
-    match parse_request json with
-    | Ok req -> handle_request_with_context ~ctx req
+    let parsed =
+      Metrics.Trace.span ~cat:"json" "json.decode" (fun () ->
+        parse_request (Yojson.Safe.from_string json_str))
+    in
+    match parsed with
+    | Ok req -> handle_request_with_context ~ctx ?session req
     | Error msg -> make_error None (-32600) msg
   with Yojson.Json_error _ | Failure _ | Not_found | Invalid_argument _ ->
     make_error None (-32700) "Parse error"
 
 (** Create server context *)
-let create_context ~sw ~net ~clock =
+let create_context ?meters ~sw ~net ~clock () =
   (* Register all drivers on startup *)
   Daw_integration.register_all_drivers ();
+  let requests = { running = Hashtbl.create 16; cancelled = 0; timed_out = 0 } in
+  Metrics.sampled ~counter:true ~help:"Requests cancelled by notifications/cancelled"
+    "mcp_requests_cancelled_total" (fun () -> [("", Float.of_int requests.cancelled)]);
+  Metrics.sampled ~counter:true ~help:"Tool calls stopped by their deadline"
+    "mcp_requests_timed_out_total" (fun () -> [("", Float.of_int requests.timed_out)]);
   {
     integration = Daw_integration.create ();
+    meters;
+    requests;
     sw;
     net;
     clock;
   }
 
+(** DAW state for SSE resumption snapshots *)
+let context_status ctx = status_json ctx.integration
+
 (* Legacy stateless functions for backward compatibility *)
 
 (** Handle JSON-RPC request (stateless - deprecated) *)
@@ -1254,6 +1715,20 @@ let process_line line =
   Yojson.Safe.to_string response
 
 (** Process line with context *)
-let process_line_with_context ~ctx line =
-  let response = process_json_with_context ~ctx line in
-  Yojson.Safe.to_string response
+let process_line_with_context ~ctx ?session line =
+  let response = process_json_with_context ~ctx ?session line in
+  Metrics.Trace.span ~cat:"json" "json.encode" (fun () -> Yojson.Safe.to_string response)
+
+(** Like [process_json_with_context], but [None] for a request cancelled
+    by [notifications/cancelled]: MCP asks servers not to answer those *)
+let process_json_with_context_opt ~ctx ?session json_str =
+  let response = process_json_with_context ~ctx ?session json_str in
+  match Yojson.Safe.Util.(response |> member "error" |> member "code") with
+  | `Int code when code = cancelled_code -> None
+  | _ -> Some response
+  | exception Yojson.Safe.Util.Type_error _ -> Some response
+
+let process_line_with_context_opt ~ctx ?session line =
+  Option.map (fun response ->
+    Metrics.Trace.span ~cat:"json" "json.encode" (fun () -> Yojson.Safe.to_string response))
+    (process_json_with_context_opt ~ctx ?session line)
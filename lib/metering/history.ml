@@ -0,0 +1,191 @@
+(** History - Min/max/RMS decimation pyramid for meter and waveform data
+
+    Values are appended one at a time (a waveform sample, or one meter
+    reading summarising a block) and kept in a binary pyramid like an audio
+    overview file: a level-[k] node holds the min, max, sum of squares and
+    count of [2^k] consecutive values, and is written as soon as its two
+    children are complete, so appending costs O(1) amortised and does not
+    allocate.
+
+    Every level is a ring of [capacity] nodes. Recent values are kept at
+    full resolution while older ones survive only in coarser levels, so
+    memory is fixed at [levels * capacity] nodes while level [levels - 1]
+    still spans [capacity * 2^(levels - 1)] values.
+
+    A range query splits each output point into O(log n) aligned nodes
+    (bottom-up, as in a segment tree) stopping at the level that matches
+    the zoom, so any range returns a fixed number of points. Nodes that
+    have left their level's ring are replaced by their nearest retained
+    ancestor, which widens old points rather than dropping them.
+
+    With [file], the node storage is an mmap'd file instead of the heap,
+    letting the kernel page out long session histories. The file is
+    scratch space: it is truncated on [create] and not reloaded.
+*)
+
+type storage = (float, Bigarray.float64_elt, Bigarray.c_layout) Bigarray.Array2.t
+
+(** Fields per node: min, max, sum of squares, count *)
+let stride = 4
+
+type t = {
+  rate : float;            (** values per second *)
+  levels : int;
+  capacity : int;          (** nodes kept per level *)
+  nodes : storage;         (** [levels] rows of [capacity * stride] *)
+  counts : int array;      (** completed nodes per level *)
+  mutable total : int;     (** values appended *)
+  fd : Unix.file_descr option;
+}
+
+(** One output point of a query *)
+type point = {
+  min : float;
+  max : float;
+  rms : float;
+}
+
+let default_levels = 16
+let default_capacity = 2048
+
+(** Create a history for values arriving at [rate] per second *)
+let create ?(levels = default_levels) ?(capacity = default_capacity) ?file ~rate () =
+  if levels < 1 || levels > 48 then invalid_arg "History.create: levels must be in [1, 48]";
+  if capacity < 2 then invalid_arg "History.create: capacity must be at least 2";
+  if rate <= 0.0 then invalid_arg "History.create: rate must be positive";
+  let width = capacity * stride in
+  let nodes, fd =
+    match file with
+    | None -> (Bigarray.Array2.create Bigarray.float64 Bigarray.c_layout levels width, None)
+    | Some path ->
+      let fd = Unix.openfile path [Unix.O_RDWR; Unix.O_CREAT; Unix.O_TRUNC] 0o644 in
+      let map = Unix.map_file fd Bigarray.float64 Bigarray.c_layout true [| levels; width |] in
+      (Bigarray.array2_of_genarray map, Some fd)
+  in
+  { rate; levels; capacity; nodes; counts = Array.make levels 0; total = 0; fd }
+
+(** Release the backing file, if any. The history must not be used after. *)
+let close t = Option.iter Unix.close t.fd
+
+(** Number of values appended *)
+let length t = t.total
+
+(** Values per second *)
+let rate t = t.rate
+
+(** Bytes of node storage *)
+let storage_bytes t = t.levels * t.capacity * stride * 8
+
+(** Oldest value index still covered by level [k] *)
+let oldest_at t k = (max 0 (t.counts.(k) - t.capacity)) lsl k
+
+(** Oldest value index still covered by any level *)
+let oldest t = oldest_at t (t.levels - 1)
+
+let[@inline] slot t n = (n mod t.capacity) * stride
+
+(** {1 Appending} *)
+
+let push t mn mx ss c =
+  let nodes = t.nodes in
+  let mn = ref mn and mx = ref mx and ss = ref ss and c = ref c in
+  let k = ref 0 and climbing = ref true in
+  while !climbing do
+    let lvl = !k in
+    let n = t.counts.(lvl) in
+    let s = slot t n in
+    Bigarray.Array2.unsafe_set nodes lvl s !mn;
+    Bigarray.Array2.unsafe_set nodes lvl (s + 1) !mx;
+    Bigarray.Array2.unsafe_set nodes lvl (s + 2) !ss;
+    Bigarray.Array2.unsafe_set nodes lvl (s + 3) !c;
+    t.counts.(lvl) <- n + 1;
+    (* A right child completes its parent: merge with the left sibling *)
+    if n land 1 = 0 || lvl + 1 >= t.levels then climbing := false
+    else begin
+      let p = slot t (n - 1) in
+      mn := Float.min !mn (Bigarray.Array2.unsafe_get nodes lvl p);
+      mx := Float.max !mx (Bigarray.Array2.unsafe_get nodes lvl (p + 1));
+      ss := !ss +. Bigarray.Array2.unsafe_get nodes lvl (p + 2);
+      c := !c +. Bigarray.Array2.unsafe_get nodes lvl (p + 3);
+      incr k
+    end
+  done;
+  t.total <- t.total + 1
+
+(** Append one waveform sample *)
+let append t x = push t x x (x *. x) 1.0
+
+(** Append one value summarising [count] samples (e.g. a meter reading
+    with its block's peak envelope and RMS) *)
+let append_summary t ~min ~max ~rms ~count =
+  if count <= 0 then invalid_arg "History.append_summary: count must be positive";
+  let c = Float.of_int count in
+  push t min max (rms *. rms *. c) c
+
+(** Append a float array of waveform samples *)
+let append_array t samples = Array.iter (append t) samples
+
+(** {1 Queries} *)
+
+let retained t k n = n < t.counts.(k) && n >= t.counts.(k) - t.capacity
+
+(** Points covering value indices [\[start, stop)] (clamped to what is
+    stored). Returns [min points (stop - start)] points. *)
+let query t ~start ~stop ~points =
+  if points <= 0 then invalid_arg "History.query: points must be positive";
+  let start = max start (oldest t) and stop = min stop t.total in
+  if start >= stop then [||]
+  else begin
+    let span = stop - start in
+    let points = min points span in
+    (* Zoom level: the coarsest whose nodes fit in one point *)
+    let rec zoom k = if k + 1 < t.levels && 1 lsl (k + 1) <= span / points then zoom (k + 1) else k in
+    let top = zoom 0 in
+    Array.init points (fun p ->
+      let a = start + p * span / points and b = start + (p + 1) * span / points in
+      let mn = ref Float.infinity and mx = ref Float.neg_infinity in
+      let ss = ref 0.0 and c = ref 0.0 in
+      let taken = ref [] in
+      let rec take k n =
+        if k < t.levels && n < t.counts.(k) then
+          if retained t k n then begin
+            if not (List.mem (k, n) !taken) then begin
+              taken := (k, n) :: !taken;
+              let s = slot t n in
+              mn := Float.min !mn (Bigarray.Array2.unsafe_get t.nodes k s);
+              mx := Float.max !mx (Bigarray.Array2.unsafe_get t.nodes k (s + 1));
+              ss := !ss +. Bigarray.Array2.unsafe_get t.nodes k (s + 2);
+              c := !c +. Bigarray.Array2.unsafe_get t.nodes k (s + 3)
+            end
+          end else take (k + 1) (n lsr 1)
+      in
+      let l = ref a and r = ref b and k = ref 0 in
+      while !l < !r && !k < top do
+        if !l land 1 = 1 then begin take !k !l; incr l end;
+        if !r land 1 = 1 then begin decr r; take !k !r end;
+        l := !l lsr 1;
+        r := !r lsr 1;
+        incr k
+      done;
+      for n = !l to !r - 1 do take !k n done;
+      if !c <= 0.0 then { min = 0.0; max = 0.0; rms = 0.0 }
+      else { min = !mn; max = !mx; rms = Float.sqrt (!ss /. !c) })
+
+(** Same as [query] with times in seconds since the first value *)
+let query_seconds t ~from_s ~to_s ~points =
+  query t
+    ~start:(int_of_float (Float.floor (from_s *. t.rate)))
+    ~stop:(int_of_float (Float.ceil (to_s *. t.rate)))
+    ~points
+
+let point_to_json p =
+  `Assoc [("min", `Float p.min); ("max", `Float p.max); ("rms", `Float p.rms)]
+
+(** Query result as JSON, with the time span each point covers *)
+let query_to_json t ~start ~stop (points : point array) =
+  let start = max start (oldest t) and stop = min stop t.total in
+  `Assoc [
+    ("from_s", `Float (Float.of_int start /. t.rate));
+    ("to_s", `Float (Float.of_int (max start stop) /. t.rate));
+    ("points", `List (Array.to_list (Array.map point_to_json points)));
+  ]
@@ -0,0 +1,406 @@
+(** Loudness - ITU-R BS.1770-4 / EBU R128 loudness measurement
+
+    Samples pass through the two-stage K-weighting filter (high shelf and
+    RLB high-pass), and their weighted mean squares are accumulated into
+    100 ms sub-blocks. A ring of the last 30 sub-block energies gives:
+
+    - momentary loudness: mean of the last 4 sub-blocks (400 ms),
+    - short-term loudness: mean of the last 30 sub-blocks (3 s),
+    - integrated loudness: 400 ms blocks with 75% overlap, gated at
+      -70 LUFS absolute and -10 LU relative,
+    - loudness range (EBU Tech 3342): distance between the 10th and 95th
+      percentiles of short-term loudness, gated at -70 LUFS and -20 LU.
+
+    Gating works on histograms of block energies in 0.1 LU bins, so memory
+    and per-block work stay constant however long the programme runs. The
+    per-sample filter loops do not allocate.
+*)
+
+type float32_buffer = (float, Bigarray.float32_elt, Bigarray.c_layout) Bigarray.Array1.t
+
+(** {1 Constants} *)
+
+let absolute_gate = -70.0
+let relative_gate = -10.0
+let range_relative_gate = -20.0
+
+(** Sub-blocks per momentary (400 ms) and short-term (3 s) window *)
+let momentary_subblocks = 4
+let short_term_subblocks = 30
+
+(** Loudness in LUFS of a weighted mean-square energy *)
+let lufs_of_energy z =
+  if z <= 0.0 then Float.neg_infinity
+  else -0.691 +. 10.0 *. Float.log10 z
+
+(** Mean-square energy of a loudness in LUFS *)
+let energy_of_lufs l = 10.0 ** ((l +. 0.691) /. 10.0)
+
+(** {1 K-weighting} *)
+
+(** Normalised biquad (a0 = 1) *)
+type biquad = {
+  b0 : float;
+  b1 : float;
+  b2 : float;
+  a1 : float;
+  a2 : float;
+}
+
+(** Stage 1: high shelf modelling the acoustic effect of the head *)
+let pre_filter ~sample_rate =
+  let f0 = 1681.974450955533 and gain_db = 3.999843853973347 and q = 0.7071752369554196 in
+  let k = Float.tan (Float.pi *. f0 /. sample_rate) in
+  let vh = 10.0 ** (gain_db /. 20.0) in
+  let vb = vh ** 0.4996667741545416 in
+  let a0 = 1.0 +. k /. q +. k *. k in
+  {
+    b0 = (vh +. vb *. k /. q +. k *. k) /. a0;
+    b1 = 2.0 *. (k *. k -. vh) /. a0;
+    b2 = (vh -. vb *. k /. q +. k *. k) /. a0;
+    a1 = 2.0 *. (k *. k -. 1.0) /. a0;
+    a2 = (1.0 -. k /. q +. k *. k) /. a0;
+  }
+
+(** Stage 2: RLB high-pass *)
+let rlb_filter ~sample_rate =
+  let f0 = 38.13547087602444 and q = 0.5003270373238773 in
+  let k = Float.tan (Float.pi *. f0 /. sample_rate) in
+  let a0 = 1.0 +. k /. q +. k *. k in
+  {
+    b0 = 1.0;
+    b1 = -2.0;
+    b2 = 1.0;
+    a1 = 2.0 *. (k *. k -. 1.0) /. a0;
+    a2 = (1.0 -. k /. q +. k *. k) /. a0;
+  }
+
+(** BS.1770 channel weights: 1.0 for front channels, 1.41 for surrounds.
+    Five channels are read as L R C Ls Rs, six as L R C LFE Ls Rs
+    (the LFE is not measured). *)
+let default_weights channels =
+  match channels with
+  | 5 -> [| 1.0; 1.0; 1.0; 1.41; 1.41 |]
+  | 6 -> [| 1.0; 1.0; 1.0; 0.0; 1.41; 1.41 |]
+  | n -> Array.make n 1.0
+
+(** {1 Gating histograms} *)
+
+let hist_step = 0.1
+let hist_bins = 1000  (** -70 .. +30 LUFS *)
+
+(** Block energies above the absolute gate, binned by loudness *)
+type histogram = {
+  counts : int array;
+  energies : float array;
+  mutable total : int;
+  mutable total_energy : float;
+}
+
+let create_histogram () = {
+  counts = Array.make hist_bins 0;
+  energies = Array.make hist_bins 0.0;
+  total = 0;
+  total_energy = 0.0;
+}
+
+let reset_histogram h =
+  Array.fill h.counts 0 hist_bins 0;
+  Array.fill h.energies 0 hist_bins 0.0;
+  h.total <- 0;
+  h.total_energy <- 0.0
+
+let bin_of_lufs l =
+  let i = int_of_float ((l -. absolute_gate) /. hist_step) in
+  if i < 0 then 0 else if i >= hist_bins then hist_bins - 1 else i
+
+(** First bin lying entirely at or above [l] *)
+let first_bin_above l =
+  let i = int_of_float (Float.ceil ((l -. absolute_gate) /. hist_step)) in
+  if i < 0 then 0 else min i hist_bins
+
+let bin_center i = absolute_gate +. (float_of_int i +. 0.5) *. hist_step
+
+let histogram_add h z =
+  let l = lufs_of_energy z in
+  if l > absolute_gate then begin
+    let i = bin_of_lufs l in
+    h.counts.(i) <- h.counts.(i) + 1;
+    h.energies.(i) <- h.energies.(i) +. z;
+    h.total <- h.total + 1;
+    h.total_energy <- h.total_energy +. z
+  end
+
+(** Threshold [gate] LU below the mean of every block above the absolute gate *)
+let relative_threshold h gate =
+  lufs_of_energy (h.total_energy /. float_of_int h.total) +. gate
+
+(** {1 Meter} *)
+
+type t = {
+  channels : int;
+  weights : float array;
+  pre : biquad;
+  rlb : biquad;
+  state : float array;        (** 4 filter states per channel *)
+  sums : float array;         (** K-weighted sum of squares per channel *)
+  subblock_len : int;         (** samples per 100 ms *)
+  mutable filled : int;       (** samples in the current sub-block *)
+  ring : float array;         (** last [short_term_subblocks] sub-block energies *)
+  mutable head : int;         (** next ring slot *)
+  mutable subblocks : int;    (** sub-blocks completed *)
+  mutable momentary_energy : float;
+  mutable short_term_energy : float;
+  mutable max_momentary_energy : float;
+  mutable max_short_term_energy : float;
+  blocks : histogram;         (** 400 ms gating blocks *)
+  short_terms : histogram;    (** 3 s blocks for loudness range *)
+}
+
+(** Create a loudness meter for [channels] channels at [sample_rate] *)
+let create ?weights ~sample_rate ~channels () =
+  if channels <= 0 then invalid_arg "Loudness.create: channels must be positive";
+  if sample_rate <= 0.0 then invalid_arg "Loudness.create: sample_rate must be positive";
+  let weights =
+    match weights with
+    | Some w when Array.length w = channels -> Array.copy w
+    | Some _ -> invalid_arg "Loudness.create: one weight per channel required"
+    | None -> default_weights channels
+  in
+  {
+    channels;
+    weights;
+    pre = pre_filter ~sample_rate;
+    rlb = rlb_filter ~sample_rate;
+    state = Array.make (4 * channels) 0.0;
+    sums = Array.make channels 0.0;
+    subblock_len = max 1 (int_of_float (Float.round (sample_rate /. 10.0)));
+    filled = 0;
+    ring = Array.make short_term_subblocks 0.0;
+    head = 0;
+    subblocks = 0;
+    momentary_energy = 0.0;
+    short_term_energy = 0.0;
+    max_momentary_energy = 0.0;
+    max_short_term_energy = 0.0;
+    blocks = create_histogram ();
+    short_terms = create_histogram ();
+  }
+
+(** Forget all history (e.g. on transport restart) *)
+let reset t =
+  Array.fill t.state 0 (Array.length t.state) 0.0;
+  Array.fill t.sums 0 t.channels 0.0;
+  Array.fill t.ring 0 short_term_subblocks 0.0;
+  t.filled <- 0;
+  t.head <- 0;
+  t.subblocks <- 0;
+  t.momentary_energy <- 0.0;
+  t.short_term_energy <- 0.0;
+  t.max_momentary_energy <- 0.0;
+  t.max_short_term_energy <- 0.0;
+  reset_histogram t.blocks;
+  reset_histogram t.short_terms
+
+(** Mean of the [n] most recent sub-block energies *)
+let ring_mean t n =
+  let len = Array.length t.ring in
+  let sum = ref 0.0 in
+  for i = 1 to n do
+    sum := !sum +. t.ring.((t.head - i + len) mod len)
+  done;
+  !sum /. float_of_int n
+
+(** Close the current 100 ms sub-block and update the windows *)
+let finish_subblock t =
+  let e = ref 0.0 in
+  for c = 0 to t.channels - 1 do
+    e := !e +. t.weights.(c) *. t.sums.(c);
+    t.sums.(c) <- 0.0
+  done;
+  t.ring.(t.head) <- !e /. float_of_int t.subblock_len;
+  t.head <- (t.head + 1) mod short_term_subblocks;
+  t.subblocks <- t.subblocks + 1;
+  t.filled <- 0;
+  if t.subblocks >= momentary_subblocks then begin
+    let m = ring_mean t momentary_subblocks in
+    t.momentary_energy <- m;
+    if m > t.max_momentary_energy then t.max_momentary_energy <- m;
+    histogram_add t.blocks m
+  end;
+  if t.subblocks >= short_term_subblocks then begin
+    let s = ring_mean t short_term_subblocks in
+    t.short_term_energy <- s;
+    if s > t.max_short_term_energy then t.max_short_term_energy <- s;
+    histogram_add t.short_terms s
+  end
+
+(** Flush filter state that has decayed into the denormal range *)
+let flush_denormal x = if Float.abs x < 1e-30 then 0.0 else x
+
+(** Sample storage the K-weighting filter reads from *)
+module type SAMPLES = sig
+  type t
+  val get : t -> int -> float
+end
+
+(** K-weight [n] samples of channel [c] read at [off], [off + stride], ...
+    and add their squares to the channel's sub-block sum *)
+module Filter (S : SAMPLES) = struct
+  let run t c (buf : S.t) ~off ~stride ~n =
+    let p = t.pre and h = t.rlb and s = t.state and k = 4 * c in
+    let z1 = ref s.(k) and z2 = ref s.(k + 1) and z3 = ref s.(k + 2) and z4 = ref s.(k + 3) in
+    let sq = ref t.sums.(c) in
+    for i = 0 to n - 1 do
+      let x = S.get buf (off + i * stride) in
+      let y = p.b0 *. x +. !z1 in
+      z1 := p.b1 *. x -. p.a1 *. y +. !z2;
+      z2 := p.b2 *. x -. p.a2 *. y;
+      let w = h.b0 *. y +. !z3 in
+      z3 := h.b1 *. y -. h.a1 *. w +. !z4;
+      z4 := h.b2 *. y -. h.a2 *. w;
+      sq := !sq +. w *. w
+    done;
+    s.(k) <- flush_denormal !z1;
+    s.(k + 1) <- flush_denormal !z2;
+    s.(k + 2) <- flush_denormal !z3;
+    s.(k + 3) <- flush_denormal !z4;
+    t.sums.(c) <- !sq
+end
+
+module Filter_f32 = Filter (struct
+  type t = float32_buffer
+  let[@inline] get (b : t) i = Bigarray.Array1.unsafe_get b i
+end)
+
+module Filter_array = Filter (struct
+  type t = float array
+  let[@inline] get (b : t) i = Array.unsafe_get b i
+end)
+
+let filter_f32 = Filter_f32.run
+let filter_array = Filter_array.run
+
+(** Split [frames] frames at sub-block boundaries; [run ~frame ~n] filters
+    [n] frames starting at frame offset [frame] for every channel *)
+let process_frames t ~frames run =
+  let done_ = ref 0 in
+  while !done_ < frames do
+    let n = min (frames - !done_) (t.subblock_len - t.filled) in
+    run ~frame:!done_ ~n;
+    t.filled <- t.filled + n;
+    done_ := !done_ + n;
+    if t.filled = t.subblock_len then finish_subblock t
+  done
+
+(** Feed interleaved frames starting at sample [off] (default: all
+    remaining frames). Raises [Invalid_argument] if out of range. *)
+let process_interleaved ?(off = 0) ?frames t (buf : float32_buffer) =
+  let dim = Bigarray.Array1.dim buf in
+  let ch = t.channels in
+  let frames = match frames with Some n -> n | None -> (dim - off) / ch in
+  if off < 0 || frames < 0 || off + frames * ch > dim then
+    invalid_arg "Loudness.process_interleaved";
+  process_frames t ~frames (fun ~frame ~n ->
+    for c = 0 to ch - 1 do
+      filter_f32 t c buf ~off:(off + frame * ch + c) ~stride:ch ~n
+    done)
+
+(** Feed interleaved samples from an OCaml float array *)
+let process_interleaved_array t samples =
+  let ch = t.channels in
+  process_frames t ~frames:(Array.length samples / ch) (fun ~frame ~n ->
+    for c = 0 to ch - 1 do
+      filter_array t c samples ~off:(frame * ch + c) ~stride:ch ~n
+    done)
+
+(** Feed one array per channel (common length) *)
+let process_planar_array t (channels : float array array) =
+  if Array.length channels <> t.channels then
+    invalid_arg "Loudness.process_planar_array: channel count mismatch";
+  let frames = Array.fold_left (fun m a -> min m (Array.length a)) max_int channels in
+  process_frames t ~frames (fun ~frame ~n ->
+    Array.iteri (fun c buf -> filter_array t c buf ~off:frame ~stride:1 ~n) channels)
+
+(** {1 Readings} *)
+
+let lufs_opt z = if z > 0.0 then Some (lufs_of_energy z) else None
+
+(** Momentary loudness; [None] before 400 ms or on digital silence *)
+let momentary t =
+  if t.subblocks < momentary_subblocks then None else lufs_opt t.momentary_energy
+
+(** Short-term loudness; [None] before 3 s or on digital silence *)
+let short_term t =
+  if t.subblocks < short_term_subblocks then None else lufs_opt t.short_term_energy
+
+(** Gated integrated loudness; [None] until a block passes the absolute gate *)
+let integrated t =
+  let h = t.blocks in
+  if h.total = 0 then None
+  else begin
+    let first = first_bin_above (relative_threshold h relative_gate) in
+    let n = ref 0 and e = ref 0.0 in
+    for i = first to hist_bins - 1 do
+      n := !n + h.counts.(i);
+      e := !e +. h.energies.(i)
+    done;
+    if !n = 0 then None else Some (lufs_of_energy (!e /. float_of_int !n))
+  end
+
+(** Loudness range in LU; [None] until a short-term block passes the gate *)
+let range t =
+  let h = t.short_terms in
+  if h.total = 0 then None
+  else begin
+    let first = first_bin_above (relative_threshold h range_relative_gate) in
+    let n = ref 0 in
+    for i = first to hist_bins - 1 do
+      n := !n + h.counts.(i)
+    done;
+    if !n = 0 then None
+    else begin
+      (* Loudness of the k-th smallest gated value *)
+      let nth k =
+        let rec go i seen =
+          let seen = seen + h.counts.(i) in
+          if seen > k || i = hist_bins - 1 then bin_center i else go (i + 1) seen
+        in
+        go first 0
+      in
+      let percentile p = nth (int_of_float (Float.round (p *. float_of_int (!n - 1)))) in
+      Some (percentile 0.95 -. percentile 0.10)
+    end
+  end
+
+(** Loudness summary *)
+type reading = {
+  momentary : float option;       (** LUFS, 400 ms window *)
+  short_term : float option;      (** LUFS, 3 s window *)
+  integrated : float option;      (** gated LUFS since the last reset *)
+  range : float option;           (** LU *)
+  max_momentary : float option;   (** LUFS *)
+  max_short_term : float option;  (** LUFS *)
+}
+
+(** Current readings *)
+let reading t = {
+  momentary = momentary t;
+  short_term = short_term t;
+  integrated = integrated t;
+  range = range t;
+  max_momentary = lufs_opt t.max_momentary_energy;
+  max_short_term = lufs_opt t.max_short_term_energy;
+}
+
+(** Convert a reading to JSON; unavailable values are [null] *)
+let reading_to_json (r : reading) =
+  let opt = function Some v -> `Float v | None -> `Null in
+  `Assoc [
+    ("momentary_lufs", opt r.momentary);
+    ("short_term_lufs", opt r.short_term);
+    ("integrated_lufs", opt r.integrated);
+    ("range_lu", opt r.range);
+    ("max_momentary_lufs", opt r.max_momentary);
+    ("max_short_term_lufs", opt r.max_short_term);
+  ]
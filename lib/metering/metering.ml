@@ -60,29 +60,419 @@ type stereo_meter = {
   mono_sum : channel_meter;  (** L+R summed to mono *)
 }
 
-(** Calculate stereo meter data from interleaved samples *)
-let meter_stereo_interleaved samples =
-  let n = Array.length samples in
-  let half = n / 2 in
-  let left = Array.init half (fun i -> samples.(i * 2)) in
-  let right = Array.init half (fun i -> samples.(i * 2 + 1)) in
-  let mono = Array.init half (fun i -> (samples.(i * 2) +. samples.(i * 2 + 1)) /. 2.0) in
+(** {1 Fused stereo kernels}
+
+    One pass over the samples computes left, right and mono (L+R)/2 peak and
+    sum of squares together, plus the L*R cross term that the stereo-field
+    readings (correlation, balance, mid/side) are derived from.
+    Accumulators live in an all-float record, so the loops run on unboxed
+    floats and do not allocate. *)
+
+(** 32-bit float sample buffer, as delivered by audio callbacks *)
+type float32_buffer = (float, Bigarray.float32_elt, Bigarray.c_layout) Bigarray.Array1.t
+
+(** Running stereo accumulators *)
+type stereo_acc = {
+  mutable frames : float;
+  mutable left_sq : float;
+  mutable right_sq : float;
+  mutable mono_sq : float;
+  mutable cross : float;  (** sum of L*R *)
+  mutable left_peak : float;
+  mutable right_peak : float;
+  mutable mono_peak : float;
+}
+
+(** Create empty accumulators *)
+let create_acc () = {
+  frames = 0.0;
+  left_sq = 0.0; right_sq = 0.0; mono_sq = 0.0; cross = 0.0;
+  left_peak = 0.0; right_peak = 0.0; mono_peak = 0.0;
+}
+
+(** Reset accumulators for the next block *)
+let reset_acc a =
+  a.frames <- 0.0;
+  a.left_sq <- 0.0; a.right_sq <- 0.0; a.mono_sq <- 0.0; a.cross <- 0.0;
+  a.left_peak <- 0.0; a.right_peak <- 0.0; a.mono_peak <- 0.0
+
+(** Goniometer density: counts of (side, mid) positions on a [size] x
+    [size] grid. Column is side (R-L)/2 and row is mid (L+R)/2, both
+    mapped from [-1, 1]; row 0 is mid -1. Odd sizes centre a cell on each
+    axis, so mono and pure-side signals land on a single column or row. *)
+type goniometer = {
+  size : int;
+  cells : int array;
+  mutable samples : int;
+}
+
+(** Create an empty goniometer of [size] x [size] cells (default 33) *)
+let create_goniometer ?(size = 33) () =
+  if size < 2 then invalid_arg "Metering.create_goniometer: size must be at least 2";
+  { size; cells = Array.make (size * size) 0; samples = 0 }
+
+(** Clear the density counts *)
+let reset_goniometer g =
+  Array.fill g.cells 0 (Array.length g.cells) 0;
+  g.samples <- 0
+
+let[@inline] cell_of size v =
+  let i = int_of_float ((v +. 1.0) *. 0.5 *. Float.of_int size) in
+  if i < 0 then 0 else if i >= size then size - 1 else i
+
+let[@inline] plot g l r =
+  let ix = cell_of g.size ((r -. l) *. 0.5) and iy = cell_of g.size ((l +. r) *. 0.5) in
+  let k = iy * g.size + ix in
+  Array.unsafe_set g.cells k (Array.unsafe_get g.cells k + 1);
+  g.samples <- g.samples + 1
+
+let check_range name ~off ~len ~dim =
+  if off < 0 || len < 0 || off + len > dim then invalid_arg name
+
+(** {1 Envelope followers}
+
+    Sample-accurate meter ballistics: every sample moves a one-pole
+    follower, so a meter's response depends on elapsed time only, not on
+    how the audio is split into blocks. Followers run inside the fused
+    kernels when an [envelope] is passed. *)
+
+type detector =
+  | Peak_detector     (** follows |x| *)
+  | Average_detector  (** follows |x|, read scaled so a sine shows its RMS *)
+  | Rms_detector      (** follows x^2 *)
+
+type release =
+  | Exponential of float    (** one-pole time constant in ms *)
+  | Db_per_second of float  (** constant fall rate *)
+
+(** Meter ballistics: detector, attack time constant in ms (0 = instant)
+    and release *)
+type ballistics_preset = {
+  detector : detector;
+  attack_ms : float;
+  release : release;
+}
+
+(** VU (IEC 60268-17): average responding, 99% of a step in 300 ms *)
+let vu = { detector = Average_detector; attack_ms = 65.0; release = Exponential 65.0 }
+
+(** PPM type I (DIN 45406): a 10 ms burst reads -1 dB, falls 20 dB in 1.5 s *)
+let ppm_type_1 = { detector = Peak_detector; attack_ms = 4.5; release = Db_per_second (20.0 /. 1.5) }
+
+(** PPM type II (BBC / EBU): a 10 ms burst reads -2.5 dB, falls 24 dB in 2.8 s *)
+let ppm_type_2 = { detector = Peak_detector; attack_ms = 7.2; release = Db_per_second (24.0 /. 2.8) }
+
+(** Digital peak (IEC 60268-18): instant attack, falls 20 dB in 1.7 s *)
+let digital_peak = { detector = Peak_detector; attack_ms = 0.0; release = Db_per_second (20.0 /. 1.7) }
+
+(** RMS with 10 ms / 300 ms rise and fall times (the processor default) *)
+let rms_meter = { detector = Rms_detector; attack_ms = 10.0 /. 2.2; release = Exponential (300.0 /. 2.2) }
+
+(** Preset by name: ["vu"], ["ppm1"], ["ppm2"], ["digital"] or ["rms"] *)
+let ballistics_of_string = function
+  | "vu" -> Some vu
+  | "ppm1" -> Some ppm_type_1
+  | "ppm2" -> Some ppm_type_2
+  | "digital" -> Some digital_peak
+  | "rms" -> Some rms_meter
+  | _ -> None
+
+(** A preset compiled for one sample rate *)
+type follower = {
+  squared : bool;       (** follows x^2 rather than |x| *)
+  scale : float;        (** display scale *)
+  rise : float;         (** one-pole attack coefficient *)
+  linear_fall : bool;   (** [fall] is a per-sample multiplier *)
+  fall : float;         (** one-pole release coefficient or multiplier *)
+}
+
+let compile_follower ~sample_rate (p : ballistics_preset) =
+  let one_pole ms = if ms <= 0.0 then 1.0 else 1.0 -. Float.exp (-1000.0 /. (ms *. sample_rate)) in
+  let squared = p.detector = Rms_detector in
+  let linear_fall, fall =
+    match p.release with
+    | Exponential ms -> (false, one_pole ms)
+    | Db_per_second rate ->
+      (* Power falls twice as many dB per step as amplitude *)
+      (true, 10.0 ** (-. rate /. sample_rate /. (if squared then 10.0 else 20.0)))
+  in
   {
-    left = meter_channel left;
-    right = meter_channel right;
-    mono_sum = meter_channel mono;
+    squared;
+    scale = (if p.detector = Average_detector then Float.pi /. (2.0 *. Float.sqrt 2.0) else 1.0);
+    rise = one_pole p.attack_ms;
+    linear_fall;
+    fall;
   }
 
-(** Calculate stereo meter data from separate L/R arrays *)
-let meter_stereo ~left ~right =
-  let n = min (Array.length left) (Array.length right) in
-  let mono = Array.init n (fun i -> (left.(i) +. right.(i)) /. 2.0) in
+(** Level (the preset's ballistics) and peak followers for two channels *)
+type envelope = {
+  level : follower;
+  peak : follower;
+  state : float array;  (** level L, level R, peak L, peak R *)
+}
+
+(** Create an envelope; [level] defaults to [rms_meter], [peak] to [digital_peak] *)
+let create_envelope ?(level = rms_meter) ?(peak = digital_peak) ~sample_rate () = {
+  level = compile_follower ~sample_rate level;
+  peak = compile_follower ~sample_rate peak;
+  state = Array.make 4 0.0;
+}
+
+(** Return followers to silence *)
+let reset_envelope e = Array.fill e.state 0 4 0.0
+
+let[@inline] follow (f : follower) state i x =
+  let v = if f.squared then x *. x else Float.abs x in
+  let cur = Array.unsafe_get state i in
+  let next =
+    if v > cur then cur +. f.rise *. (v -. cur)
+    else if f.linear_fall then Float.max v (cur *. f.fall)
+    else cur +. f.fall *. (v -. cur)
+  in
+  Array.unsafe_set state i next
+
+let[@inline] follow_stereo e l r =
+  follow e.level e.state 0 l;
+  follow e.level e.state 1 r;
+  follow e.peak e.state 2 l;
+  follow e.peak e.state 3 r
+
+(** Flush followers that have decayed into the denormal range *)
+let flush_envelope e =
+  for i = 0 to 3 do
+    if e.state.(i) < 1e-30 then e.state.(i) <- 0.0
+  done
+
+(** Follow a mono buffer on [channel] *)
+let follow_mono e channel samples =
+  for i = 0 to Array.length samples - 1 do
+    let x = Array.unsafe_get samples i in
+    follow e.level e.state channel x;
+    follow e.peak e.state (2 + channel) x
+  done;
+  flush_envelope e
+
+let reading_db (f : follower) v =
+  linear_to_db (f.scale *. (if f.squared then Float.sqrt v else v))
+
+(** Level follower reading of [channel] (0 = left, 1 = right) in dB *)
+let envelope_level_db e channel = reading_db e.level e.state.(channel)
+
+(** Peak follower reading of [channel] in dB *)
+let envelope_peak_db e channel = reading_db e.peak e.state.(2 + channel)
+
+(** Sample storage the fused kernel reads from *)
+module type SAMPLES = sig
+  type t
+  val get : t -> int -> float
+end
+
+(** The fused kernel over one sample store: [frames] frames with left at
+    [loff], [loff + stride], ... of [lbuf] and right likewise in [rbuf] *)
+module Kernel (S : SAMPLES) = struct
+  let run ?env ?scope acc (lbuf : S.t) ~loff (rbuf : S.t) ~roff ~stride ~frames =
+    let ls = ref acc.left_sq and rs = ref acc.right_sq and ms = ref acc.mono_sq in
+    let cr = ref acc.cross in
+    let lp = ref acc.left_peak and rp = ref acc.right_peak and mp = ref acc.mono_peak in
+    for i = 0 to frames - 1 do
+      let l = S.get lbuf (loff + stride * i) in
+      let r = S.get rbuf (roff + stride * i) in
+      let m = (l +. r) *. 0.5 in
+      ls := !ls +. l *. l;
+      rs := !rs +. r *. r;
+      ms := !ms +. m *. m;
+      cr := !cr +. l *. r;
+      let al = Float.abs l and ar = Float.abs r and am = Float.abs m in
+      if al > !lp then lp := al;
+      if ar > !rp then rp := ar;
+      if am > !mp then mp := am;
+      (match scope with
+       | Some g -> plot g l r
+       | None -> ());
+      match env with
+      | Some e -> follow_stereo e l r
+      | None -> ()
+    done;
+    Option.iter flush_envelope env;
+    acc.frames <- acc.frames +. Float.of_int frames;
+    acc.left_sq <- !ls; acc.right_sq <- !rs; acc.mono_sq <- !ms; acc.cross <- !cr;
+    acc.left_peak <- !lp; acc.right_peak <- !rp; acc.mono_peak <- !mp
+end
+
+module Kernel_f32 = Kernel (struct
+  type t = float32_buffer
+  let[@inline] get (b : t) i = Bigarray.Array1.unsafe_get b i
+end)
+
+module Kernel_array = Kernel (struct
+  type t = float array
+  let[@inline] get (b : t) i = Array.unsafe_get b i
+end)
+
+(** Accumulate [frames] interleaved L/R frames starting at sample [off] *)
+let accumulate_interleaved ?(off = 0) ?frames ?env ?scope acc (buf : float32_buffer) =
+  let dim = Bigarray.Array1.dim buf in
+  let frames = match frames with Some n -> n | None -> (dim - off) / 2 in
+  check_range "Metering.accumulate_interleaved" ~off ~len:(2 * frames) ~dim;
+  Kernel_f32.run ?env ?scope acc buf ~loff:off buf ~roff:(off + 1) ~stride:2 ~frames
+
+(** Accumulate [frames] frames from separate L/R buffers starting at [off] *)
+let accumulate_planar ?(off = 0) ?frames ?env ?scope acc ~(left : float32_buffer) ~(right : float32_buffer) =
+  let dim = min (Bigarray.Array1.dim left) (Bigarray.Array1.dim right) in
+  let frames = match frames with Some n -> n | None -> dim - off in
+  check_range "Metering.accumulate_planar" ~off ~len:frames ~dim;
+  Kernel_f32.run ?env ?scope acc left ~loff:off right ~roff:off ~stride:1 ~frames
+
+(** Same kernel over OCaml float arrays (interleaved) *)
+let accumulate_interleaved_array ?env ?scope acc samples =
+  let frames = Array.length samples / 2 in
+  Kernel_array.run ?env ?scope acc samples ~loff:0 samples ~roff:1 ~stride:2 ~frames
+
+(** Same kernel over OCaml float arrays of equal length (planar) *)
+let accumulate_planar_array ?env ?scope acc ~left ~right =
+  let frames = min (Array.length left) (Array.length right) in
+  Kernel_array.run ?env ?scope acc left ~loff:0 right ~roff:0 ~stride:1 ~frames
+
+let channel_of ~sum_sq ~peak ~frames =
+  let rms_linear = if frames > 0.0 then Float.sqrt (sum_sq /. frames) else 0.0 in
   {
-    left = meter_channel left;
-    right = meter_channel right;
-    mono_sum = meter_channel mono;
+    rms_linear;
+    peak_linear = peak;
+    rms_db = linear_to_db rms_linear;
+    peak_db = linear_to_db peak;
   }
 
+(** Stereo meter from accumulated values *)
+let stereo_of_acc a = {
+  left = channel_of ~sum_sq:a.left_sq ~peak:a.left_peak ~frames:a.frames;
+  right = channel_of ~sum_sq:a.right_sq ~peak:a.right_peak ~frames:a.frames;
+  mono_sum = channel_of ~sum_sq:a.mono_sq ~peak:a.mono_peak ~frames:a.frames;
+}
+
+(** {1 Stereo field}
+
+    Correlation, balance and mid/side readings come from the same sums as
+    the stereo meter (L^2, R^2, mid^2 and L*R), so they cost one extra
+    multiply-add per frame in the fused kernels. *)
+
+(** Stereo-field readings of a block *)
+type stereo_field = {
+  correlation : float;   (** -1 (out of phase) .. +1 (mono); 0 for silence *)
+  balance : float;       (** -1 (left only) .. +1 (right only), by energy *)
+  mid_side_db : float;   (** mid over side energy in dB *)
+  width : float;         (** side share of total energy, 0 (mono) .. 1 (side only) *)
+  mono_loss_db : float;  (** mono-sum level relative to the mean L/R level *)
+}
+
+let silent_field = { correlation = 0.0; balance = 0.0; mid_side_db = 0.0; width = 0.0; mono_loss_db = 0.0 }
+
+let ratio_db num den =
+  if den <= 1e-30 then (if num <= 1e-30 then 0.0 else -. min_db)
+  else if num <= 1e-30 then min_db
+  else Float.max min_db (Float.min (-. min_db) (10.0 *. Float.log10 (num /. den)))
+
+(** Stereo field from sums (or means) of L^2, R^2, mid^2 and L*R *)
+let stereo_field_of_sums ~left_sq ~right_sq ~mono_sq ~cross =
+  let total = left_sq +. right_sq in
+  if total <= 1e-30 then silent_field
+  else begin
+    let side_sq = Float.max 0.0 ((total -. 2.0 *. cross) *. 0.25) in
+    let lr = left_sq *. right_sq in
+    {
+      correlation =
+        (if lr <= 1e-60 then 0.0
+         else Float.max (-1.0) (Float.min 1.0 (cross /. Float.sqrt lr)));
+      balance = (right_sq -. left_sq) /. total;
+      mid_side_db = ratio_db mono_sq side_sq;
+      width = (if mono_sq +. side_sq <= 1e-30 then 0.0 else side_sq /. (mono_sq +. side_sq));
+      mono_loss_db = ratio_db mono_sq (total *. 0.5);
+    }
+  end
+
+(** Stereo field from accumulated values *)
+let stereo_field_of_acc a =
+  stereo_field_of_sums ~left_sq:a.left_sq ~right_sq:a.right_sq ~mono_sq:a.mono_sq ~cross:a.cross
+
+let stereo_field_to_json f =
+  `Assoc [
+    ("correlation", `Float f.correlation);
+    ("balance", `Float f.balance);
+    ("mid_side_db", `Float f.mid_side_db);
+    ("width", `Float f.width);
+    ("mono_loss_db", `Float f.mono_loss_db);
+  ]
+
+(** Density of each goniometer cell relative to the busiest one, rows
+    from mid -1 to mid +1 *)
+let goniometer_density g =
+  let peak = Array.fold_left max 0 g.cells in
+  Array.init g.size (fun row ->
+    Array.init g.size (fun col ->
+      if peak = 0 then 0.0 else Float.of_int g.cells.(row * g.size + col) /. Float.of_int peak))
+
+(** Share of samples per direction, [bins] (default 36) over 0 (right
+    anti-phase axis) to pi (left anti-phase axis); the centre bin is mono.
+    Opposite points fold together, as on a polar phase display. *)
+let goniometer_angles ?(bins = 36) g =
+  if bins <= 0 then invalid_arg "Metering.goniometer_angles: bins must be positive";
+  let hist = Array.make bins 0.0 in
+  let counted = ref 0 in
+  let n = Float.of_int g.size in
+  for row = 0 to g.size - 1 do
+    for col = 0 to g.size - 1 do
+      let c = g.cells.(row * g.size + col) in
+      let x = (Float.of_int col +. 0.5) /. n *. 2.0 -. 1.0 in
+      let y = (Float.of_int row +. 0.5) /. n *. 2.0 -. 1.0 in
+      (* The centre cells have no direction *)
+      if c > 0 && x *. x +. y *. y > 4.0 /. (n *. n) then begin
+        let x, y = if y < 0.0 then (-. x, -. y) else (x, y) in
+        let a = Float.atan2 y x in
+        let b = min (bins - 1) (int_of_float (a /. Float.pi *. Float.of_int bins)) in
+        hist.(b) <- hist.(b) +. Float.of_int c;
+        counted := !counted + c
+      end
+    done
+  done;
+  if !counted > 0 then Array.iteri (fun i v -> hist.(i) <- v /. Float.of_int !counted) hist;
+  hist
+
+let goniometer_to_json ?bins g =
+  let floats a = `List (Array.to_list (Array.map (fun v -> `Float v) a)) in
+  `Assoc [
+    ("size", `Int g.size);
+    ("samples", `Int g.samples);
+    ("density", `List (Array.to_list (Array.map floats (goniometer_density g))));
+    ("angles", floats (goniometer_angles ?bins g));
+  ]
+
+(** Calculate stereo meter data from interleaved samples *)
+let meter_stereo_interleaved samples =
+  let acc = create_acc () in
+  accumulate_interleaved_array acc samples;
+  stereo_of_acc acc
+
+(** Calculate stereo meter data from separate L/R arrays *)
+let meter_stereo ~left ~right =
+  let acc = create_acc () in
+  accumulate_planar_array acc ~left ~right;
+  let stereo = stereo_of_acc acc in
+  if Array.length left = Array.length right then stereo
+  else
+    (* Mono covers the common length; each side is metered in full *)
+    { stereo with left = meter_channel left; right = meter_channel right }
+
+(** Stereo meter from an interleaved float32 buffer *)
+let meter_stereo_f32 buf =
+  let acc = create_acc () in
+  accumulate_interleaved acc buf;
+  stereo_of_acc acc
+
+(** Stereo meter from planar float32 buffers *)
+let meter_stereo_planar_f32 ~left ~right =
+  let acc = create_acc () in
+  accumulate_planar acc ~left ~right;
+  stereo_of_acc acc
+
 (** Peak hold state for smooth metering display *)
 type peak_hold = {
   mutable current_peak : float;
@@ -99,6 +489,11 @@ let create_peak_hold ?(hold_time = 30) ?(release_rate = 0.5) () = {
   release_rate;
 }
 
+(** Hold time (blocks) and release (dB per block) of the processor and
+    bank peak holds *)
+let meter_hold_blocks = 60
+let meter_hold_release_db = 0.3
+
 (** Update peak hold with new value *)
 let update_peak_hold ph new_peak_db =
   if new_peak_db > ph.current_peak then begin
@@ -110,7 +505,8 @@ let update_peak_hold ph new_peak_db =
     ph.current_peak <- Float.max min_db (ph.current_peak -. ph.release_rate);
   ph.current_peak
 
-(** Ballistics for smooth meter movement *)
+(** Per-block dB smoothing, superseded by the sample-accurate envelope
+    presets; kept for existing callers *)
 type ballistics = {
   mutable current_value : float;
   attack_coeff : float;  (** 0.0-1.0, higher = faster attack *)
@@ -133,82 +529,192 @@ let update_ballistics b new_value_db =
   b.current_value <- b.current_value +. coeff *. (new_value_db -. b.current_value);
   b.current_value
 
+(** BS.1770 Annex 2 true-peak meter *)
+module True_peak = True_peak
+
+(** Calculate true peak (4x oversampled, linear) of audio samples *)
+let calculate_true_peak samples = True_peak.measure samples
+
 (** Full meter processor with ballistics and peak hold *)
 type meter_processor = {
-  rms_ballistics : ballistics;
-  peak_ballistics : ballistics;
+  sample_rate : float;
+  mutable envelope : envelope;  (** sample-accurate ballistics; shared by a stereo pair *)
+  channel : int;                (** envelope channel this processor reads *)
   peak_hold : peak_hold;
+  true_peak : True_peak.t;
+  true_peak_hold : peak_hold;
   mutable last_rms_db : float;
   mutable last_peak_db : float;
   mutable last_peak_hold_db : float;
+  mutable last_true_peak_db : float;
+  mutable last_true_peak_hold_db : float;
 }
 
-(** Create a full meter processor *)
-let create_processor ~sample_rate =
+let make_processor ~envelope ~channel ~sample_rate =
   {
-    rms_ballistics = create_ballistics ~attack_ms:10.0 ~release_ms:300.0 ~sample_rate ();
-    peak_ballistics = create_ballistics ~attack_ms:0.1 ~release_ms:500.0 ~sample_rate ();
-    peak_hold = create_peak_hold ~hold_time:60 ~release_rate:0.3 ();
+    sample_rate;
+    envelope;
+    channel;
+    peak_hold = create_peak_hold ~hold_time:meter_hold_blocks ~release_rate:meter_hold_release_db ();
+    true_peak = True_peak.create ~channels:1 ();
+    true_peak_hold = create_peak_hold ~hold_time:meter_hold_blocks ~release_rate:meter_hold_release_db ();
     last_rms_db = min_db;
     last_peak_db = min_db;
     last_peak_hold_db = min_db;
+    last_true_peak_db = min_db;
+    last_true_peak_hold_db = min_db;
   }
 
-(** Process a buffer and update meter values *)
-let process_buffer mp samples =
-  let meter = meter_channel samples in
-  mp.last_rms_db <- update_ballistics mp.rms_ballistics meter.rms_db;
-  mp.last_peak_db <- update_ballistics mp.peak_ballistics meter.peak_db;
-  mp.last_peak_hold_db <- update_peak_hold mp.peak_hold meter.peak_db;
+(** Create a full meter processor *)
+let create_processor ~sample_rate =
+  make_processor ~envelope:(create_envelope ~sample_rate ()) ~channel:0 ~sample_rate
+
+(** Close the true-peak block fed since the last call and update its hold *)
+let update_true_peak mp =
+  mp.last_true_peak_db <- linear_to_db (True_peak.take_peak mp.true_peak 0);
+  mp.last_true_peak_hold_db <- update_peak_hold mp.true_peak_hold mp.last_true_peak_db
+
+let feed_true_peak mp samples =
+  True_peak.process_array mp.true_peak ~channel:0 samples ~off:0 ~stride:1
+    ~frames:(Array.length samples);
+  update_true_peak mp
+
+(** Publish the processor's envelope readings; the peak hold follows the
+    block's sample peak *)
+let finish_channel mp (raw : channel_meter) =
+  let level_db = envelope_level_db mp.envelope mp.channel
+  and peak_db = envelope_peak_db mp.envelope mp.channel in
+  mp.last_rms_db <- level_db;
+  mp.last_peak_db <- peak_db;
+  mp.last_peak_hold_db <- update_peak_hold mp.peak_hold raw.peak_db;
   {
-    rms_linear = db_to_linear mp.last_rms_db;
-    peak_linear = db_to_linear mp.last_peak_db;
-    rms_db = mp.last_rms_db;
-    peak_db = mp.last_peak_db;
+    rms_linear = db_to_linear level_db;
+    peak_linear = db_to_linear peak_db;
+    rms_db = level_db;
+    peak_db;
   }
 
+(** Process a buffer and update meter values, with per-sample ballistics *)
+let process_buffer mp samples =
+  feed_true_peak mp samples;
+  follow_mono mp.envelope mp.channel samples;
+  finish_channel mp (meter_channel samples)
+
+(** Feed an already measured block through the envelope and peak hold,
+    as [frames] samples at the block's RMS and peak level (default 1) *)
+let process_meter ?(frames = 1) mp (meter : channel_meter) =
+  let e = mp.envelope in
+  for _ = 1 to frames do
+    follow e.level e.state mp.channel meter.rms_linear;
+    follow e.peak e.state (2 + mp.channel) meter.peak_linear
+  done;
+  flush_envelope e;
+  finish_channel mp meter
+
+(** Switch the processor's level ballistics (state restarts from silence) *)
+let set_ballistics ?peak mp preset =
+  mp.envelope <- create_envelope ~level:preset ?peak ~sample_rate:mp.sample_rate ()
+
+(** True peak of the last processed block in dBTP *)
+let get_true_peak mp = mp.last_true_peak_db
+
+(** Current true-peak hold value in dBTP *)
+let get_true_peak_hold mp = mp.last_true_peak_hold_db
+
 (** Stereo meter processor *)
 type stereo_processor = {
   left : meter_processor;
   right : meter_processor;
+  mutable last_field : stereo_field;  (** stereo field of the last block *)
+  mutable goniometer : goniometer option;  (** plotted in the same pass when set *)
 }
 
-(** Create stereo processor *)
-let create_stereo_processor ~sample_rate = {
-  left = create_processor ~sample_rate;
-  right = create_processor ~sample_rate;
-}
+(** Create stereo processor; both channels read one two-channel envelope *)
+let create_stereo_processor ~sample_rate =
+  let envelope = create_envelope ~sample_rate () in
+  {
+    left = make_processor ~envelope ~channel:0 ~sample_rate;
+    right = make_processor ~envelope ~channel:1 ~sample_rate;
+    last_field = silent_field;
+    goniometer = None;
+  }
+
+(** Switch the stereo level ballistics (state restarts from silence) *)
+let set_stereo_ballistics ?peak sp preset =
+  let e = create_envelope ~level:preset ?peak ~sample_rate:sp.left.sample_rate () in
+  sp.left.envelope <- e;
+  sp.right.envelope <- e
 
 (** Process stereo buffer *)
 let process_stereo_buffer sp ~left ~right =
-  let left_meter = process_buffer sp.left left in
-  let right_meter = process_buffer sp.right right in
-  let mono = Array.init (min (Array.length left) (Array.length right))
-    (fun i -> (left.(i) +. right.(i)) /. 2.0) in
+  feed_true_peak sp.left left;
+  feed_true_peak sp.right right;
+  let acc = create_acc () in
+  accumulate_planar_array ~env:sp.left.envelope ?scope:sp.goniometer acc ~left ~right;
+  sp.last_field <- stereo_field_of_acc acc;
+  let (raw : stereo_meter) = stereo_of_acc acc in
+  let (raw : stereo_meter) =
+    if Array.length left = Array.length right then raw
+    else { raw with left = meter_channel left; right = meter_channel right }
+  in
+  {
+    left = finish_channel sp.left raw.left;
+    right = finish_channel sp.right raw.right;
+    mono_sum = raw.mono_sum;
+  }
+
+(** Process an interleaved float32 buffer *)
+let process_stereo_f32 sp buf =
+  let frames = Bigarray.Array1.dim buf / 2 in
+  True_peak.process_f32 sp.left.true_peak ~channel:0 buf ~off:0 ~stride:2 ~frames;
+  True_peak.process_f32 sp.right.true_peak ~channel:0 buf ~off:1 ~stride:2 ~frames;
+  update_true_peak sp.left;
+  update_true_peak sp.right;
+  let acc = create_acc () in
+  accumulate_interleaved ~env:sp.left.envelope ?scope:sp.goniometer acc buf;
+  sp.last_field <- stereo_field_of_acc acc;
+  let (raw : stereo_meter) = stereo_of_acc acc in
   {
-    left = left_meter;
-    right = right_meter;
-    mono_sum = meter_channel mono;
+    left = finish_channel sp.left raw.left;
+    right = finish_channel sp.right raw.right;
+    mono_sum = raw.mono_sum;
   }
 
 (** Get current peak hold values *)
 let get_peak_holds sp =
   (sp.left.last_peak_hold_db, sp.right.last_peak_hold_db)
 
+(** Get current true-peak hold values *)
+let get_true_peak_holds sp =
+  (sp.left.last_true_peak_hold_db, sp.right.last_true_peak_hold_db)
+
+(** Stereo field of the last processed block *)
+let get_stereo_field sp = sp.last_field
+
+(** BS.1770 / EBU R128 loudness *)
+module Loudness = Loudness
+
+(** STFT spectrum analyzer *)
+module Spectrum = Spectrum
+
 (** Meter frame for streaming *)
 type meter_frame = {
   timestamp : float;
   track_index : int;
   input : stereo_meter option;
   output : stereo_meter;
+  loudness : Loudness.reading option;
+  field : stereo_field option;
 }
 
 (** Create meter frame *)
-let create_frame ~timestamp ~track_index ?input ~output () = {
+let create_frame ~timestamp ~track_index ?input ~output ?loudness ?field () = {
   timestamp;
   track_index;
   input;
   output;
+  loudness;
+  field;
 }
 
 (** Convert meter frame to JSON *)
@@ -225,9 +731,204 @@ let frame_to_json frame =
       ("right", channel_to_json s.right);
     ]
   in
-  `Assoc [
+  let loudness =
+    match frame.loudness with
+    | Some r -> [("loudness", Loudness.reading_to_json r)]
+    | None -> []
+  in
+  let field =
+    match frame.field with
+    | Some f -> [("stereo_field", stereo_field_to_json f)]
+    | None -> []
+  in
+  `Assoc ([
     ("timestamp", `Float frame.timestamp);
     ("track_index", `Int frame.track_index);
     ("input", match frame.input with Some i -> stereo_to_json i | None -> `Null);
     ("output", stereo_to_json frame.output);
-  ]
+  ] @ loudness @ field)
+
+(** Min/max/RMS history pyramid *)
+module History = History
+
+(** Append a frame's output meter to per-channel histories *)
+let record_frame ?(frames = 1) ~left ~right (frame : meter_frame) =
+  let add h (c : channel_meter) =
+    History.append_summary h ~min:(-. c.peak_linear) ~max:c.peak_linear ~rms:c.rms_linear ~count:frames
+  in
+  add left frame.output.left;
+  add right frame.output.right
+
+(** {1 Meter bank}
+
+    Meter state for many stereo tracks in structure-of-arrays layout:
+    follower states, block levels and peak holds live in flat float arrays
+    indexed by track and channel, so one pass meters every track without
+    per-track records. Above [parallel_threshold] tracks the pass is split
+    into contiguous track ranges across a pool of domains; tracks never
+    share state, so the ranges run without locking. *)
+
+type bank = {
+  tracks : int;
+  bank_level : follower;
+  bank_peak : follower;
+  level_env : float array;       (** 2 per track: L, R *)
+  peak_env : float array;
+  block_rms : float array;       (** 3 per track: L, R, mono (linear) *)
+  block_peak : float array;
+  block_cross : float array;     (** 1 per track: mean L*R *)
+  hold_db : float array;         (** 2 per track *)
+  hold_left : int array;         (** blocks of hold remaining, 2 per track *)
+  hold_blocks : int;
+  hold_release_db : float;
+  loudness_meters : Loudness.t array option;
+  pool : Worker_pool.t option;
+  parallel_threshold : int;
+}
+
+(** Create a bank for [tracks] stereo tracks. [domains] extra domains
+    (default 0) share the pass once there are at least
+    [parallel_threshold] tracks (default 64). With [loudness], every track
+    also runs a BS.1770 loudness meter. *)
+let create_bank ?(ballistics = rms_meter) ?(peak = digital_peak) ?(loudness = false)
+    ?(domains = 0) ?(parallel_threshold = 64) ~sample_rate ~tracks () =
+  if tracks < 0 then invalid_arg "Metering.create_bank: negative track count";
+  {
+    tracks;
+    bank_level = compile_follower ~sample_rate ballistics;
+    bank_peak = compile_follower ~sample_rate peak;
+    level_env = Array.make (2 * tracks) 0.0;
+    peak_env = Array.make (2 * tracks) 0.0;
+    block_rms = Array.make (3 * tracks) 0.0;
+    block_peak = Array.make (3 * tracks) 0.0;
+    block_cross = Array.make tracks 0.0;
+    hold_db = Array.make (2 * tracks) min_db;
+    hold_left = Array.make (2 * tracks) 0;
+    hold_blocks = meter_hold_blocks;
+    hold_release_db = meter_hold_release_db;
+    loudness_meters =
+      (if loudness then
+         Some (Array.init tracks (fun _ -> Loudness.create ~sample_rate ~channels:2 ()))
+       else None);
+    pool = (if domains > 0 then Some (Worker_pool.create domains) else None);
+    parallel_threshold;
+  }
+
+(** Number of tracks *)
+let bank_tracks b = b.tracks
+
+let update_hold b c peak_db =
+  if peak_db > b.hold_db.(c) then begin
+    b.hold_db.(c) <- peak_db;
+    b.hold_left.(c) <- b.hold_blocks
+  end else if b.hold_left.(c) > 0 then
+    b.hold_left.(c) <- b.hold_left.(c) - 1
+  else
+    b.hold_db.(c) <- Float.max min_db (b.hold_db.(c) -. b.hold_release_db)
+
+(** Meter one interleaved stereo block of track [i] *)
+let process_track b i (buf : float32_buffer) =
+  let frames = Bigarray.Array1.dim buf / 2 in
+  let lf = b.bank_level and pf = b.bank_peak in
+  let le = b.level_env and pe = b.peak_env in
+  let li = 2 * i and ri = 2 * i + 1 in
+  let ls = ref 0.0 and rs = ref 0.0 and ms = ref 0.0 and cr = ref 0.0 in
+  let lp = ref 0.0 and rp = ref 0.0 and mp = ref 0.0 in
+  for k = 0 to frames - 1 do
+    let l = Bigarray.Array1.unsafe_get buf (2 * k) in
+    let r = Bigarray.Array1.unsafe_get buf (2 * k + 1) in
+    let m = (l +. r) *. 0.5 in
+    ls := !ls +. l *. l;
+    rs := !rs +. r *. r;
+    ms := !ms +. m *. m;
+    cr := !cr +. l *. r;
+    let al = Float.abs l and ar = Float.abs r and am = Float.abs m in
+    if al > !lp then lp := al;
+    if ar > !rp then rp := ar;
+    if am > !mp then mp := am;
+    follow lf le li l;
+    follow lf le ri r;
+    follow pf pe li l;
+    follow pf pe ri r
+  done;
+  if le.(li) < 1e-30 then le.(li) <- 0.0;
+  if le.(ri) < 1e-30 then le.(ri) <- 0.0;
+  if pe.(li) < 1e-30 then pe.(li) <- 0.0;
+  if pe.(ri) < 1e-30 then pe.(ri) <- 0.0;
+  let n = Float.of_int (max 1 frames) in
+  let j = 3 * i in
+  b.block_rms.(j) <- Float.sqrt (!ls /. n);
+  b.block_rms.(j + 1) <- Float.sqrt (!rs /. n);
+  b.block_rms.(j + 2) <- Float.sqrt (!ms /. n);
+  b.block_peak.(j) <- !lp;
+  b.block_peak.(j + 1) <- !rp;
+  b.block_peak.(j + 2) <- !mp;
+  b.block_cross.(i) <- !cr /. n;
+  update_hold b li (linear_to_db !lp);
+  update_hold b ri (linear_to_db !rp);
+  match b.loudness_meters with
+  | Some meters -> Loudness.process_interleaved meters.(i) buf
+  | None -> ()
+
+(** Meter one interleaved stereo block per track ([blocks.(i)] is track
+    [i]). Blocks may differ in length. *)
+let process_bank b (blocks : float32_buffer array) =
+  if Array.length blocks <> b.tracks then
+    invalid_arg "Metering.process_bank: one block per track required";
+  match b.pool with
+  | Some pool when b.tracks >= b.parallel_threshold ->
+    let parts = Worker_pool.size pool in
+    Worker_pool.run pool (fun part ->
+      let first = part * b.tracks / parts and last = (part + 1) * b.tracks / parts in
+      for i = first to last - 1 do
+        process_track b i blocks.(i)
+      done)
+  | _ ->
+    for i = 0 to b.tracks - 1 do
+      process_track b i blocks.(i)
+    done
+
+(** Current stereo meter of track [i] (ballistics applied to L/R, raw
+    block values for the mono sum) *)
+let bank_meter b i =
+  let channel c =
+    let level_db = reading_db b.bank_level b.level_env.(2 * i + c) in
+    let peak_db = reading_db b.bank_peak b.peak_env.(2 * i + c) in
+    {
+      rms_linear = db_to_linear level_db;
+      peak_linear = db_to_linear peak_db;
+      rms_db = level_db;
+      peak_db;
+    }
+  in
+  let j = 3 * i + 2 in
+  ({
+    left = channel 0;
+    right = channel 1;
+    mono_sum = channel_of ~sum_sq:(b.block_rms.(j) *. b.block_rms.(j)) ~peak:b.block_peak.(j) ~frames:1.0;
+  } : stereo_meter)
+
+(** Stereo field of track [i]'s last block *)
+let bank_field b i =
+  let j = 3 * i in
+  let sq k = b.block_rms.(j + k) *. b.block_rms.(j + k) in
+  stereo_field_of_sums ~left_sq:(sq 0) ~right_sq:(sq 1) ~mono_sq:(sq 2) ~cross:b.block_cross.(i)
+
+(** Peak hold of track [i], (left, right) in dB *)
+let bank_peak_holds b i = (b.hold_db.(2 * i), b.hold_db.(2 * i + 1))
+
+(** Frames for [tracks] (default: all, out-of-range indices skipped), as
+    one batch in track order *)
+let bank_frames ?tracks b ~timestamp =
+  let indices =
+    match tracks with
+    | Some l -> List.filter (fun i -> i >= 0 && i < b.tracks) l
+    | None -> List.init b.tracks Fun.id
+  in
+  List.map (fun i ->
+    let loudness = Option.map (fun meters -> Loudness.reading meters.(i)) b.loudness_meters in
+    create_frame ~timestamp ~track_index:i ~output:(bank_meter b i) ?loudness
+      ~field:(bank_field b i) ()) indices
+
+(** Stop the bank's worker domains *)
+let shutdown_bank b = Option.iter Worker_pool.shutdown b.pool
@@ -50,6 +50,196 @@ val meter_stereo_interleaved : float array -> stereo_meter
 val meter_stereo : left:float array -> right:float array -> stereo_meter
 (** Calculate stereo meter data from separate L/R arrays *)
 
+(** {1 Envelope Followers} *)
+
+type detector =
+  | Peak_detector     (** follows |x| *)
+  | Average_detector  (** follows |x|, read scaled so a sine shows its RMS *)
+  | Rms_detector      (** follows x^2 *)
+
+type release =
+  | Exponential of float    (** one-pole time constant in ms *)
+  | Db_per_second of float  (** constant fall rate *)
+
+type ballistics_preset = {
+  detector : detector;
+  attack_ms : float;
+  release : release;
+}
+(** Meter ballistics: detector, attack time constant in ms (0 = instant)
+    and release *)
+
+val vu : ballistics_preset
+(** VU (IEC 60268-17): average responding, 99% of a step in 300 ms *)
+
+val ppm_type_1 : ballistics_preset
+(** PPM type I (DIN 45406): a 10 ms burst reads -1 dB, falls 20 dB in 1.5 s *)
+
+val ppm_type_2 : ballistics_preset
+(** PPM type II (BBC / EBU): a 10 ms burst reads -2.5 dB, falls 24 dB in 2.8 s *)
+
+val digital_peak : ballistics_preset
+(** Digital peak (IEC 60268-18): instant attack, falls 20 dB in 1.7 s *)
+
+val rms_meter : ballistics_preset
+(** RMS with 10 ms / 300 ms rise and fall times (the processor default) *)
+
+val ballistics_of_string : string -> ballistics_preset option
+(** Preset by name: ["vu"], ["ppm1"], ["ppm2"], ["digital"] or ["rms"] *)
+
+type envelope
+(** Per-sample level and peak followers for two channels. Followers are
+    updated sample by sample, so readings do not depend on block size. *)
+
+val create_envelope : ?level:ballistics_preset -> ?peak:ballistics_preset -> sample_rate:float -> unit -> envelope
+(** Create an envelope; [level] defaults to [rms_meter], [peak] to [digital_peak] *)
+
+val reset_envelope : envelope -> unit
+(** Return followers to silence *)
+
+val envelope_level_db : envelope -> int -> float
+(** Level follower reading of a channel (0 = left, 1 = right) in dB *)
+
+val envelope_peak_db : envelope -> int -> float
+(** Peak follower reading of a channel in dB *)
+
+(** {1 Fused Stereo Kernels} *)
+
+type float32_buffer = (float, Bigarray.float32_elt, Bigarray.c_layout) Bigarray.Array1.t
+(** 32-bit float sample buffer *)
+
+type stereo_acc = {
+  mutable frames : float;
+  mutable left_sq : float;
+  mutable right_sq : float;
+  mutable mono_sq : float;
+  mutable cross : float;  (** sum of L*R *)
+  mutable left_peak : float;
+  mutable right_peak : float;
+  mutable mono_peak : float;
+}
+(** Running L/R/mono sums of squares, L*R cross term and peaks.
+    Accumulating does not allocate, so one [stereo_acc] can be reused per
+    block. *)
+
+val create_acc : unit -> stereo_acc
+(** Create empty accumulators *)
+
+val reset_acc : stereo_acc -> unit
+(** Reset accumulators *)
+
+type goniometer = {
+  size : int;
+  cells : int array;
+  mutable samples : int;
+}
+(** Goniometer density: sample counts on a [size] x [size] grid of
+    side (R-L)/2 (column) against mid (L+R)/2 (row), both over [-1, 1];
+    row 0 is mid -1. Filled by the kernels when passed as [scope]. Odd
+    sizes centre a cell on each axis. *)
+
+val create_goniometer : ?size:int -> unit -> goniometer
+(** Create an empty goniometer (default 33 x 33) *)
+
+val reset_goniometer : goniometer -> unit
+(** Clear the density counts *)
+
+val accumulate_interleaved : ?off:int -> ?frames:int -> ?env:envelope -> ?scope:goniometer ->
+  stereo_acc -> float32_buffer -> unit
+(** Single pass over interleaved L/R frames starting at sample [off]
+    (default: all remaining frames), also advancing [env] sample by sample
+    and plotting into [scope]. Raises [Invalid_argument] if out of range. *)
+
+val accumulate_planar : ?off:int -> ?frames:int -> ?env:envelope -> ?scope:goniometer -> stereo_acc ->
+  left:float32_buffer -> right:float32_buffer -> unit
+(** Single pass over planar L/R buffers *)
+
+val accumulate_interleaved_array : ?env:envelope -> ?scope:goniometer -> stereo_acc -> float array -> unit
+(** Single pass over interleaved OCaml float arrays *)
+
+val accumulate_planar_array : ?env:envelope -> ?scope:goniometer -> stereo_acc ->
+  left:float array -> right:float array -> unit
+(** Single pass over planar OCaml float arrays (common length) *)
+
+val stereo_of_acc : stereo_acc -> stereo_meter
+(** Stereo meter from accumulated values *)
+
+val meter_stereo_f32 : float32_buffer -> stereo_meter
+(** Stereo meter from an interleaved float32 buffer *)
+
+val meter_stereo_planar_f32 : left:float32_buffer -> right:float32_buffer -> stereo_meter
+(** Stereo meter from planar float32 buffers *)
+
+(** {1 Stereo Field} *)
+
+type stereo_field = {
+  correlation : float;   (** -1 (out of phase) .. +1 (mono); 0 for silence *)
+  balance : float;       (** -1 (left only) .. +1 (right only), by energy *)
+  mid_side_db : float;   (** mid over side energy in dB *)
+  width : float;         (** side share of total energy, 0 (mono) .. 1 (side only) *)
+  mono_loss_db : float;  (** mono-sum level relative to the mean L/R level *)
+}
+(** Stereo-field readings of a block, derived from the fused kernel sums *)
+
+val stereo_field_of_sums : left_sq:float -> right_sq:float -> mono_sq:float -> cross:float -> stereo_field
+(** Stereo field from sums (or means) of L^2, R^2, mid^2 and L*R *)
+
+val stereo_field_of_acc : stereo_acc -> stereo_field
+(** Stereo field from accumulated values *)
+
+val stereo_field_to_json : stereo_field -> Yojson.Safe.t
+
+val goniometer_density : goniometer -> float array array
+(** Density per cell relative to the busiest cell, rows from mid -1 to +1 *)
+
+val goniometer_angles : ?bins:int -> goniometer -> float array
+(** Share of samples per direction over [0, pi] (default 36 bins), with
+    opposite points folded together; the centre bin is mono *)
+
+val goniometer_to_json : ?bins:int -> goniometer -> Yojson.Safe.t
+
+(** {1 True Peak} *)
+
+(** ITU-R BS.1770-4 Annex 2 true peak: 4x polyphase FIR oversampling
+    (48 taps, four 12-tap phases) with per-channel streaming state.
+    Processing does not allocate. Output lags input by about 6 samples. *)
+module True_peak : sig
+  type float32_buffer = (float, Bigarray.float32_elt, Bigarray.c_layout) Bigarray.Array1.t
+
+  type t
+  (** Streaming true-peak state for a fixed number of channels *)
+
+  val create : channels:int -> unit -> t
+  (** Create a meter *)
+
+  val reset : t -> unit
+  (** Clear filter history and peaks *)
+
+  val process_f32 : t -> channel:int -> float32_buffer -> off:int -> stride:int -> frames:int -> unit
+  (** Feed [frames] samples of [channel] read at [off], [off + stride], ... *)
+
+  val process_array : t -> channel:int -> float array -> off:int -> stride:int -> frames:int -> unit
+  (** Same over an OCaml float array *)
+
+  val process_interleaved : ?off:int -> ?frames:int -> t -> float32_buffer -> unit
+  (** Feed interleaved frames of every channel *)
+
+  val process_planar_array : t -> float array array -> unit
+  (** Feed one array per channel *)
+
+  val take_peak : t -> int -> float
+  (** Linear true peak of a channel since the last call, then restart it *)
+
+  val max_peak : t -> int -> float
+  (** Linear true peak of a channel since [reset] *)
+
+  val measure : float array -> float
+  (** One-shot linear true peak of a mono buffer *)
+end
+
+val calculate_true_peak : float array -> float
+(** Calculate true peak (4x oversampled, linear) of audio samples *)
+
 (** {1 Peak Hold} *)
 
 type peak_hold
@@ -64,7 +254,8 @@ val update_peak_hold : peak_hold -> float -> float
 (** {1 Ballistics} *)
 
 type ballistics
-(** Ballistics for smooth meter movement *)
+(** Per-block dB smoothing, superseded by the sample-accurate envelope
+    presets; kept for existing callers *)
 
 val create_ballistics : ?attack_ms:float -> ?release_ms:float -> sample_rate:float -> unit -> ballistics
 (** Create ballistics processor *)
@@ -81,25 +272,203 @@ val create_processor : sample_rate:float -> meter_processor
 (** Create a full meter processor *)
 
 val process_buffer : meter_processor -> float array -> channel_meter
-(** Process a buffer and update meter values *)
+(** Process a buffer and update meter values, with per-sample ballistics *)
+
+val process_meter : ?frames:int -> meter_processor -> channel_meter -> channel_meter
+(** Feed an already measured block through the envelope and peak hold,
+    as [frames] samples at the block's RMS and peak level (default 1).
+    True peak needs the samples and is not updated. *)
+
+val set_ballistics : ?peak:ballistics_preset -> meter_processor -> ballistics_preset -> unit
+(** Switch the level ballistics of [process_buffer] (state restarts from silence) *)
+
+val get_true_peak : meter_processor -> float
+(** True peak of the last processed block in dBTP *)
+
+val get_true_peak_hold : meter_processor -> float
+(** Current true-peak hold value in dBTP *)
 
 (** {1 Stereo Processor} *)
 
 type stereo_processor = {
   left : meter_processor;
   right : meter_processor;
+  mutable last_field : stereo_field;
+  mutable goniometer : goniometer option;
 }
-(** Stereo meter processor *)
+(** Stereo meter processor. The stereo field of each block is computed in
+    the metering pass; set [goniometer] to plot into it as well. *)
 
 val create_stereo_processor : sample_rate:float -> stereo_processor
 (** Create stereo processor *)
 
+val set_stereo_ballistics : ?peak:ballistics_preset -> stereo_processor -> ballistics_preset -> unit
+(** Switch the stereo level ballistics (state restarts from silence) *)
+
 val process_stereo_buffer : stereo_processor -> left:float array -> right:float array -> stereo_meter
 (** Process stereo buffer *)
 
+val process_stereo_f32 : stereo_processor -> float32_buffer -> stereo_meter
+(** Process an interleaved float32 buffer *)
+
 val get_peak_holds : stereo_processor -> float * float
 (** Get current peak hold values (left, right) in dB *)
 
+val get_true_peak_holds : stereo_processor -> float * float
+(** Get current true-peak hold values (left, right) in dBTP *)
+
+val get_stereo_field : stereo_processor -> stereo_field
+(** Stereo field of the last processed block *)
+
+(** {1 Loudness} *)
+
+(** ITU-R BS.1770-4 / EBU R128 loudness: K-weighted momentary (400 ms),
+    short-term (3 s), gated integrated loudness and loudness range (EBU
+    Tech 3342). Energies are kept per 100 ms sub-block in a ring, and
+    gating uses 0.1 LU histograms, so work per block and memory are
+    constant however long the meter runs. *)
+module Loudness : sig
+  type float32_buffer = (float, Bigarray.float32_elt, Bigarray.c_layout) Bigarray.Array1.t
+
+  type t
+  (** Streaming loudness meter for a fixed channel layout *)
+
+  val lufs_of_energy : float -> float
+  (** Loudness in LUFS of a K-weighted mean-square energy *)
+
+  val energy_of_lufs : float -> float
+  (** Inverse of [lufs_of_energy] *)
+
+  val create : ?weights:float array -> sample_rate:float -> channels:int -> unit -> t
+  (** Create a meter. Default weights are 1.0 per channel, except that 5
+      channels are read as L R C Ls Rs and 6 as L R C LFE Ls Rs. *)
+
+  val reset : t -> unit
+  (** Forget all history *)
+
+  val process_interleaved : ?off:int -> ?frames:int -> t -> float32_buffer -> unit
+  (** Feed interleaved frames starting at sample [off] (default: all
+      remaining frames). Raises [Invalid_argument] if out of range. *)
+
+  val process_interleaved_array : t -> float array -> unit
+  (** Feed interleaved samples from an OCaml float array *)
+
+  val process_planar_array : t -> float array array -> unit
+  (** Feed one array per channel (common length) *)
+
+  val momentary : t -> float option
+  (** Momentary loudness (LUFS); [None] before 400 ms or on silence *)
+
+  val short_term : t -> float option
+  (** Short-term loudness (LUFS); [None] before 3 s or on silence *)
+
+  val integrated : t -> float option
+  (** Gated integrated loudness (LUFS) since the last reset *)
+
+  val range : t -> float option
+  (** Loudness range (LU) since the last reset *)
+
+  type reading = {
+    momentary : float option;
+    short_term : float option;
+    integrated : float option;
+    range : float option;
+    max_momentary : float option;
+    max_short_term : float option;
+  }
+  (** Loudness summary; unavailable values are [None] *)
+
+  val reading : t -> reading
+  (** Current readings *)
+
+  val reading_to_json : reading -> Yojson.Safe.t
+  (** Convert a reading to JSON; unavailable values are [null] *)
+end
+
+(** {1 Spectrum} *)
+
+(** Streaming STFT analyzer: real FFT (radix-2 complex FFT of half the
+    size plus a split step) over a sliding window, with time-smoothed
+    power spectrum, third-octave bands, spectral centroid and tilt.
+    Plans are immutable and shareable; feeding samples does not allocate.
+    Levels are dBFS relative to a full-scale sine. *)
+module Spectrum : sig
+  type float32_buffer = (float, Bigarray.float32_elt, Bigarray.c_layout) Bigarray.Array1.t
+
+  type window =
+    | Rectangular
+    | Hann
+    | Hamming
+    | Blackman_harris
+
+  val window_to_string : window -> string
+  val window_of_string : string -> window option
+
+  type plan
+  (** FFT size, window, bit-reversal table and twiddles *)
+
+  val create_plan : ?window:window -> int -> plan
+  (** Plan for a power-of-two size >= 16 (default window: Hann) *)
+
+  type t
+  (** Analyzer state for one channel *)
+
+  val create : ?hop:int -> ?smoothing:float -> sample_rate:float -> plan -> t
+  (** [hop] defaults to half the plan size (50% overlap); [smoothing] in
+      [[0, 1)] is the weight kept from previous frames (default 0.8) *)
+
+  val reset : t -> unit
+  (** Clear the window ring and the smoothed spectrum *)
+
+  val process_f32 : ?off:int -> ?stride:int -> ?frames:int -> t -> float32_buffer -> unit
+  (** Feed samples read at [off], [off + stride], ... *)
+
+  val process_array : ?off:int -> ?stride:int -> ?frames:int -> t -> float array -> unit
+  (** Same over an OCaml float array *)
+
+  val frames : t -> int
+  (** Frames analysed since creation or [reset] *)
+
+  val bin_frequency : t -> int -> float
+  (** Centre frequency of an FFT bin *)
+
+  val spectrum_db : t -> float array
+  (** Smoothed spectrum in dBFS, bins [0 .. size / 2] *)
+
+  type band = {
+    center_hz : float;
+    level_db : float;
+  }
+  (** Third-octave band level *)
+
+  val bands : t -> band array
+  (** Smoothed third-octave band levels (25 Hz up to Nyquist) *)
+
+  val centroid : t -> float
+  (** Spectral centroid in Hz *)
+
+  val tilt_of_bands : band array -> float
+  (** Regression slope of band levels in dB per octave *)
+
+  val log_spectrum : ?min_hz:float -> t -> points:int -> (float * float) array
+  (** Smoothed spectrum at log-spaced (Hz, dBFS) points up to Nyquist *)
+
+  type analysis = {
+    frames : int;
+    bands : band array;
+    centroid_hz : float;
+    tilt_db_per_octave : float;
+    spectrum : (float * float) array;
+  }
+  (** Spectrum summary *)
+
+  val analysis : ?points:int -> t -> analysis
+  (** Summarise the smoothed spectrum ([points] log-spaced points, default 64) *)
+
+  val analysis_to_json : analysis -> Yojson.Safe.t
+  (** Convert an analysis to JSON *)
+end
+
 (** {1 Streaming} *)
 
 type meter_frame = {
@@ -107,11 +476,116 @@ type meter_frame = {
   track_index : int;
   input : stereo_meter option;
   output : stereo_meter;
+  loudness : Loudness.reading option;
+  field : stereo_field option;
 }
 (** Meter frame for streaming *)
 
-val create_frame : timestamp:float -> track_index:int -> ?input:stereo_meter -> output:stereo_meter -> unit -> meter_frame
+val create_frame : timestamp:float -> track_index:int -> ?input:stereo_meter -> output:stereo_meter ->
+  ?loudness:Loudness.reading -> ?field:stereo_field -> unit -> meter_frame
 (** Create meter frame *)
 
 val frame_to_json : meter_frame -> Yojson.Safe.t
 (** Convert meter frame to JSON *)
+
+(** {1 History} *)
+
+(** Min/max/RMS decimation pyramid of meter or waveform values with
+    tiered retention: each level is a fixed ring, so recent values stay at
+    full resolution and older ones only at coarser levels. Range queries
+    return a fixed number of points, each built from O(log n) nodes. *)
+module History : sig
+  type t
+
+  type point = {
+    min : float;
+    max : float;
+    rms : float;
+  }
+  (** One output point of a query *)
+
+  val default_levels : int
+  val default_capacity : int
+
+  val create : ?levels:int -> ?capacity:int -> ?file:string -> rate:float -> unit -> t
+  (** Create a history for values arriving at [rate] per second, keeping
+      [capacity] nodes (default 2048) on each of [levels] levels (default
+      16). With [file], nodes live in an mmap'd scratch file that is
+      truncated on creation. *)
+
+  val close : t -> unit
+  (** Release the backing file, if any *)
+
+  val length : t -> int
+  (** Number of values appended *)
+
+  val rate : t -> float
+  (** Values per second *)
+
+  val storage_bytes : t -> int
+  (** Bytes of node storage *)
+
+  val oldest : t -> int
+  (** Oldest value index still covered by some level *)
+
+  val append : t -> float -> unit
+  (** Append one waveform sample (does not allocate) *)
+
+  val append_summary : t -> min:float -> max:float -> rms:float -> count:int -> unit
+  (** Append one value summarising [count] samples *)
+
+  val append_array : t -> float array -> unit
+  (** Append waveform samples *)
+
+  val query : t -> start:int -> stop:int -> points:int -> point array
+  (** Points covering value indices [\[start, stop)], clamped to what is
+      stored; [min points (stop - start)] of them. Values that have left
+      the finer levels are represented by their coarser ancestors. *)
+
+  val query_seconds : t -> from_s:float -> to_s:float -> points:int -> point array
+  (** [query] with times in seconds since the first value *)
+
+  val point_to_json : point -> Yojson.Safe.t
+
+  val query_to_json : t -> start:int -> stop:int -> point array -> Yojson.Safe.t
+  (** Query result with the covered time span *)
+end
+
+val record_frame : ?frames:int -> left:History.t -> right:History.t -> meter_frame -> unit
+(** Append a frame's output meter to per-channel histories as the peak
+    envelope ([-peak, +peak]) and RMS of a block of [frames] samples
+    (default 1) *)
+
+(** {1 Meter Bank} *)
+
+type bank
+(** Meter state for many stereo tracks in structure-of-arrays layout
+    (flat float arrays indexed by track and channel) *)
+
+val create_bank : ?ballistics:ballistics_preset -> ?peak:ballistics_preset -> ?loudness:bool ->
+  ?domains:int -> ?parallel_threshold:int -> sample_rate:float -> tracks:int -> unit -> bank
+(** Create a bank. [domains] extra domains (default 0) share each pass
+    once there are at least [parallel_threshold] tracks (default 64);
+    [loudness] adds a BS.1770 meter per track. *)
+
+val bank_tracks : bank -> int
+(** Number of tracks *)
+
+val process_bank : bank -> float32_buffer array -> unit
+(** Meter one interleaved stereo block per track in a single pass.
+    Raises [Invalid_argument] unless there is one block per track. *)
+
+val bank_meter : bank -> int -> stereo_meter
+(** Current meter of a track *)
+
+val bank_field : bank -> int -> stereo_field
+(** Stereo field of a track's last block *)
+
+val bank_peak_holds : bank -> int -> float * float
+(** Peak hold of a track (left, right) in dB *)
+
+val bank_frames : ?tracks:int list -> bank -> timestamp:float -> meter_frame list
+(** Frames for the given tracks (default: all) as one batch in track order *)
+
+val shutdown_bank : bank -> unit
+(** Stop the bank's worker domains *)
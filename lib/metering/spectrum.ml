@@ -0,0 +1,390 @@
+(** Spectrum - Streaming STFT spectrum analyzer
+
+    Samples are collected in a ring of [size] samples; every [hop] samples
+    the latest window is multiplied by the analysis window and transformed
+    with a real FFT (a radix-2 complex FFT of [size / 2] points plus a
+    split step), and the resulting power spectrum is smoothed over time.
+
+    A [plan] holds everything that depends only on size and window
+    (bit-reversal table, twiddles, window coefficients); it is immutable
+    and can be shared by any number of analyzers, across domains. An
+    analyzer owns its ring and work buffers, and feeding samples does not
+    allocate.
+
+    Levels are in dBFS relative to a full-scale sine: a sine of amplitude
+    [a] reads [20 log10 a] in the band that contains it.
+*)
+
+type float32_buffer = (float, Bigarray.float32_elt, Bigarray.c_layout) Bigarray.Array1.t
+
+(** Level floor in dB (same as [Metering.min_db]) *)
+let floor_db = -96.0
+
+let db_of_power p =
+  if p <= 0.0 then floor_db
+  else Float.max floor_db (10.0 *. Float.log10 (2.0 *. p))
+
+(** {1 Plans} *)
+
+type window =
+  | Rectangular
+  | Hann
+  | Hamming
+  | Blackman_harris
+
+let window_to_string = function
+  | Rectangular -> "rectangular"
+  | Hann -> "hann"
+  | Hamming -> "hamming"
+  | Blackman_harris -> "blackman-harris"
+
+let window_of_string = function
+  | "rectangular" -> Some Rectangular
+  | "hann" -> Some Hann
+  | "hamming" -> Some Hamming
+  | "blackman-harris" -> Some Blackman_harris
+  | _ -> None
+
+(** Periodic window coefficient [i] of [n] *)
+let window_value window n i =
+  let x = 2.0 *. Float.pi *. float_of_int i /. float_of_int n in
+  match window with
+  | Rectangular -> 1.0
+  | Hann -> 0.5 -. 0.5 *. Float.cos x
+  | Hamming -> 0.54 -. 0.46 *. Float.cos x
+  | Blackman_harris ->
+    0.35875 -. 0.48829 *. Float.cos x +. 0.14128 *. Float.cos (2.0 *. x)
+    -. 0.01168 *. Float.cos (3.0 *. x)
+
+type plan = {
+  size : int;              (** real input length, power of two *)
+  half : int;              (** complex FFT length *)
+  bitrev : int array;      (** [half] entries *)
+  cos_t : float array;     (** complex FFT twiddles, [half / 2] entries *)
+  sin_t : float array;
+  split_cos : float array; (** real split twiddles, [half] entries *)
+  split_sin : float array;
+  window : window;
+  coeffs : float array;    (** window, [size] entries *)
+  norm : float;            (** power scale: 2 / (size * sum w^2) *)
+}
+
+let is_power_of_two n = n > 0 && n land (n - 1) = 0
+
+(** Precompute an FFT plan for [size] samples (a power of two >= 16) *)
+let create_plan ?(window = Hann) size =
+  if size < 16 || not (is_power_of_two size) then
+    invalid_arg "Spectrum.create_plan: size must be a power of two >= 16";
+  let half = size / 2 in
+  let bits =
+    let rec go b = if 1 lsl b = half then b else go (b + 1) in
+    go 0
+  in
+  let reverse i =
+    let r = ref 0 in
+    for b = 0 to bits - 1 do
+      if i land (1 lsl b) <> 0 then r := !r lor (1 lsl (bits - 1 - b))
+    done;
+    !r
+  in
+  let coeffs = Array.init size (window_value window size) in
+  let sum_sq = Array.fold_left (fun acc w -> acc +. w *. w) 0.0 coeffs in
+  let angle k n = 2.0 *. Float.pi *. float_of_int k /. float_of_int n in
+  {
+    size;
+    half;
+    bitrev = Array.init half reverse;
+    cos_t = Array.init (half / 2) (fun k -> Float.cos (angle k half));
+    sin_t = Array.init (half / 2) (fun k -> -. Float.sin (angle k half));
+    split_cos = Array.init half (fun k -> Float.cos (angle k size));
+    split_sin = Array.init half (fun k -> -. Float.sin (angle k size));
+    window;
+    coeffs;
+    norm = 2.0 /. (float_of_int size *. sum_sq);
+  }
+
+(** In-place radix-2 FFT of bit-reversed input in [re]/[im] *)
+let fft p re im =
+  let m = p.half in
+  let len = ref 2 in
+  while !len <= m do
+    let h = !len / 2 and step = m / !len in
+    let start = ref 0 in
+    while !start < m do
+      for k = 0 to h - 1 do
+        let wr = Array.unsafe_get p.cos_t (k * step) in
+        let wi = Array.unsafe_get p.sin_t (k * step) in
+        let a = !start + k in
+        let b = a + h in
+        let br = Array.unsafe_get re b and bi = Array.unsafe_get im b in
+        let tr = wr *. br -. wi *. bi in
+        let ti = wr *. bi +. wi *. br in
+        let ar = Array.unsafe_get re a and ai = Array.unsafe_get im a in
+        Array.unsafe_set re b (ar -. tr);
+        Array.unsafe_set im b (ai -. ti);
+        Array.unsafe_set re a (ar +. tr);
+        Array.unsafe_set im a (ai +. ti)
+      done;
+      start := !start + !len
+    done;
+    len := !len * 2
+  done
+
+(** Split the packed complex FFT of [size / 2] points into the power of
+    real-input bins [0 .. size / 2], scaled by [p.norm] *)
+let split_power p re im power =
+  let m = p.half in
+  (* DC and Nyquist are not mirrored: half weight *)
+  power.(0) <- 0.5 *. p.norm *. (re.(0) +. im.(0)) *. (re.(0) +. im.(0));
+  power.(m) <- 0.5 *. p.norm *. (re.(0) -. im.(0)) *. (re.(0) -. im.(0));
+  for k = 1 to m - 1 do
+    let zr = Array.unsafe_get re k and zi = Array.unsafe_get im k in
+    let cr = Array.unsafe_get re (m - k) and ci = Array.unsafe_get im (m - k) in
+    let er = 0.5 *. (zr +. cr) and ei = 0.5 *. (zi -. ci) in
+    let or_ = 0.5 *. (zi +. ci) and oi = -0.5 *. (zr -. cr) in
+    let wr = Array.unsafe_get p.split_cos k and wi = Array.unsafe_get p.split_sin k in
+    let xr = er +. wr *. or_ -. wi *. oi in
+    let xi = ei +. wr *. oi +. wi *. or_ in
+    Array.unsafe_set power k (p.norm *. (xr *. xr +. xi *. xi))
+  done
+
+(** {1 Third-octave bands} *)
+
+(** Nominal IEC 61260 centre frequencies, 25 Hz .. 20 kHz *)
+let band_centers = [|
+  25.; 31.5; 40.; 50.; 63.; 80.; 100.; 125.; 160.; 200.; 250.; 315.; 400.;
+  500.; 630.; 800.; 1000.; 1250.; 1600.; 2000.; 2500.; 3150.; 4000.; 5000.;
+  6300.; 8000.; 10000.; 12500.; 16000.; 20000.;
+|]
+
+(** Exact base-2 centre of band [i] (1 kHz is band 16) *)
+let exact_center i = 1000.0 *. (2.0 ** (float_of_int (i - 16) /. 3.0))
+
+(** {1 Analyzer} *)
+
+type t = {
+  plan : plan;
+  sample_rate : float;
+  hop : int;
+  alpha : float;              (** smoothing: weight of the newest frame *)
+  input : float array;        (** ring of the last [size] samples *)
+  mutable write : int;
+  mutable filled : int;
+  mutable since_hop : int;
+  re : float array;
+  im : float array;
+  power : float array;        (** latest frame, [half + 1] bins *)
+  smoothed : float array;
+  mutable frames : int;
+  band_lo : int array;        (** first bin of each band *)
+  band_hi : int array;        (** last bin (inclusive) *)
+  band_scale : float array;   (** share of [band_lo] for bands narrower than a bin *)
+}
+
+(** Create an analyzer. [hop] defaults to half the plan size (50%
+    overlap); [smoothing] in [[0, 1)] is the weight kept from previous
+    frames. Only bands below Nyquist are reported. *)
+let create ?hop ?(smoothing = 0.8) ~sample_rate plan =
+  let hop = Option.value hop ~default:(plan.size / 2) in
+  if hop <= 0 || hop > plan.size then invalid_arg "Spectrum.create: hop must be in 1 .. size";
+  if smoothing < 0.0 || smoothing >= 1.0 then invalid_arg "Spectrum.create: smoothing must be in [0, 1)";
+  let df = sample_rate /. float_of_int plan.size in
+  let nyquist = sample_rate /. 2.0 in
+  let bands =
+    List.filter (fun i -> exact_center i *. (2.0 ** (1.0 /. 6.0)) <= nyquist)
+      (List.init (Array.length band_centers) Fun.id)
+  in
+  let edges i =
+    let fc = exact_center i in
+    let lo = fc *. (2.0 ** (-1.0 /. 6.0)) and hi = fc *. (2.0 ** (1.0 /. 6.0)) in
+    let first = int_of_float (Float.ceil (lo /. df)) in
+    let last = min plan.half (int_of_float (Float.ceil (hi /. df)) - 1) in
+    if first <= last then (first, last, 1.0)
+    else
+      (* Band narrower than a bin: take its share of the bin at the centre *)
+      let bin = min plan.half (int_of_float (Float.round (fc /. df))) in
+      (bin, bin, (hi -. lo) /. df)
+  in
+  let edges = Array.of_list (List.map edges bands) in
+  {
+    plan;
+    sample_rate;
+    hop;
+    alpha = 1.0 -. smoothing;
+    input = Array.make plan.size 0.0;
+    write = 0;
+    filled = 0;
+    since_hop = 0;
+    re = Array.make plan.half 0.0;
+    im = Array.make plan.half 0.0;
+    power = Array.make (plan.half + 1) 0.0;
+    smoothed = Array.make (plan.half + 1) 0.0;
+    frames = 0;
+    band_lo = Array.map (fun (lo, _, _) -> lo) edges;
+    band_hi = Array.map (fun (_, hi, _) -> hi) edges;
+    band_scale = Array.map (fun (_, _, s) -> s) edges;
+  }
+
+(** Clear the ring and the smoothed spectrum *)
+let reset t =
+  Array.fill t.input 0 t.plan.size 0.0;
+  Array.fill t.smoothed 0 (t.plan.half + 1) 0.0;
+  t.write <- 0;
+  t.filled <- 0;
+  t.since_hop <- 0;
+  t.frames <- 0
+
+(** Transform the current window and fold it into the smoothed spectrum *)
+let analyze t =
+  let p = t.plan in
+  let mask = p.size - 1 in
+  (* [t.write] is the oldest sample once the ring is full *)
+  for i = 0 to p.half - 1 do
+    let a = 2 * i in
+    let j = Array.unsafe_get p.bitrev i in
+    Array.unsafe_set t.re j
+      (Array.unsafe_get t.input ((t.write + a) land mask) *. Array.unsafe_get p.coeffs a);
+    Array.unsafe_set t.im j
+      (Array.unsafe_get t.input ((t.write + a + 1) land mask) *. Array.unsafe_get p.coeffs (a + 1))
+  done;
+  fft p t.re t.im;
+  split_power p t.re t.im t.power;
+  if t.frames = 0 then Array.blit t.power 0 t.smoothed 0 (p.half + 1)
+  else
+    for k = 0 to p.half do
+      let s = Array.unsafe_get t.smoothed k in
+      Array.unsafe_set t.smoothed k (s +. t.alpha *. (Array.unsafe_get t.power k -. s))
+    done;
+  t.frames <- t.frames + 1
+
+let[@inline] push t x =
+  Array.unsafe_set t.input t.write x;
+  t.write <- (t.write + 1) land (t.plan.size - 1);
+  if t.filled < t.plan.size then t.filled <- t.filled + 1;
+  t.since_hop <- t.since_hop + 1;
+  if t.since_hop >= t.hop && t.filled = t.plan.size then begin
+    t.since_hop <- 0;
+    analyze t
+  end
+
+(** Feed [frames] samples read at [off], [off + stride], ... (default:
+    every remaining sample at that stride) *)
+let process_f32 ?(off = 0) ?(stride = 1) ?frames t (buf : float32_buffer) =
+  let dim = Bigarray.Array1.dim buf in
+  let frames = match frames with Some n -> n | None -> (dim - off + stride - 1) / stride in
+  if off < 0 || stride <= 0 || frames < 0 || (frames > 0 && off + (frames - 1) * stride >= dim) then
+    invalid_arg "Spectrum.process_f32";
+  for i = 0 to frames - 1 do
+    push t (Bigarray.Array1.unsafe_get buf (off + i * stride))
+  done
+
+(** Same over an OCaml float array *)
+let process_array ?(off = 0) ?(stride = 1) ?frames t (buf : float array) =
+  let dim = Array.length buf in
+  let frames = match frames with Some n -> n | None -> (dim - off + stride - 1) / stride in
+  if off < 0 || stride <= 0 || frames < 0 || (frames > 0 && off + (frames - 1) * stride >= dim) then
+    invalid_arg "Spectrum.process_array";
+  for i = 0 to frames - 1 do
+    push t (Array.unsafe_get buf (off + i * stride))
+  done
+
+(** {1 Results} *)
+
+(** Centre frequency of bin [k] *)
+let bin_frequency t k = float_of_int k *. t.sample_rate /. float_of_int t.plan.size
+
+(** Frames analysed since creation or [reset] *)
+let frames t = t.frames
+
+(** Smoothed spectrum in dBFS, one value per bin [0 .. size / 2] *)
+let spectrum_db t = Array.map db_of_power t.smoothed
+
+type band = {
+  center_hz : float;  (** nominal centre frequency *)
+  level_db : float;
+}
+
+(** Smoothed third-octave band levels *)
+let bands t =
+  Array.mapi (fun b lo ->
+    let sum = ref 0.0 in
+    for k = lo to t.band_hi.(b) do
+      sum := !sum +. t.smoothed.(k)
+    done;
+    { center_hz = band_centers.(b); level_db = db_of_power (!sum *. t.band_scale.(b)) })
+    t.band_lo
+
+(** Power-weighted mean frequency in Hz (0 when silent) *)
+let centroid t =
+  let num = ref 0.0 and den = ref 0.0 in
+  for k = 1 to t.plan.half do
+    num := !num +. bin_frequency t k *. t.smoothed.(k);
+    den := !den +. t.smoothed.(k)
+  done;
+  if !den > 0.0 then !num /. !den else 0.0
+
+(** Least-squares slope of the band levels against log2 frequency, in dB
+    per octave. Bands at the floor are ignored; 0 with fewer than two. *)
+let tilt_of_bands (bands : band array) =
+  let n = ref 0 and sx = ref 0.0 and sy = ref 0.0 and sxx = ref 0.0 and sxy = ref 0.0 in
+  Array.iter (fun b ->
+    if b.level_db > floor_db then begin
+      let x = Float.log2 (b.center_hz /. 1000.0) in
+      incr n;
+      sx := !sx +. x;
+      sy := !sy +. b.level_db;
+      sxx := !sxx +. x *. x;
+      sxy := !sxy +. x *. b.level_db
+    end) bands;
+  let n = float_of_int !n in
+  let d = n *. !sxx -. !sx *. !sx in
+  if n < 2.0 || d = 0.0 then 0.0 else (n *. !sxy -. !sx *. !sy) /. d
+
+(** Smoothed spectrum resampled to [points] log-spaced frequencies from
+    [min_hz] to Nyquist; each point is the mean power of the bins it covers *)
+let log_spectrum ?(min_hz = 20.0) t ~points =
+  let nyquist = t.sample_rate /. 2.0 in
+  let df = t.sample_rate /. float_of_int t.plan.size in
+  let ratio = nyquist /. min_hz in
+  Array.init points (fun i ->
+    let f_lo = min_hz *. (ratio ** (float_of_int i /. float_of_int points)) in
+    let f_hi = min_hz *. (ratio ** (float_of_int (i + 1) /. float_of_int points)) in
+    let lo = min t.plan.half (int_of_float (Float.round (f_lo /. df))) in
+    let hi = max lo (min t.plan.half (int_of_float (Float.round (f_hi /. df)) - 1)) in
+    let sum = ref 0.0 in
+    for k = lo to hi do
+      sum := !sum +. t.smoothed.(k)
+    done;
+    (Float.sqrt (f_lo *. f_hi), db_of_power (!sum /. float_of_int (hi - lo + 1))))
+
+(** Spectrum summary *)
+type analysis = {
+  frames : int;
+  bands : band array;
+  centroid_hz : float;
+  tilt_db_per_octave : float;
+  spectrum : (float * float) array;  (** (Hz, dBFS) *)
+}
+
+(** Summarise the smoothed spectrum *)
+let analysis ?(points = 64) t =
+  let bands = bands t in
+  {
+    frames = t.frames;
+    bands;
+    centroid_hz = centroid t;
+    tilt_db_per_octave = tilt_of_bands bands;
+    spectrum = log_spectrum t ~points;
+  }
+
+(** Convert an analysis to JSON *)
+let analysis_to_json (a : analysis) =
+  `Assoc [
+    ("frames", `Int a.frames);
+    ("centroid_hz", `Float a.centroid_hz);
+    ("tilt_db_per_octave", `Float a.tilt_db_per_octave);
+    ("bands", `List (Array.to_list (Array.map (fun b ->
+      `Assoc [("hz", `Float b.center_hz); ("db", `Float b.level_db)]) a.bands)));
+    ("spectrum", `List (Array.to_list (Array.map (fun (hz, db) ->
+      `List [`Float hz; `Float db]) a.spectrum)));
+  ]
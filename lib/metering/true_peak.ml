@@ -0,0 +1,153 @@
+(** True Peak - ITU-R BS.1770-4 Annex 2 true-peak measurement
+
+    Each channel is upsampled 4x with the 48-tap polyphase FIR from the
+    recommendation (four 12-tap phases), and the largest absolute value of
+    the oversampled signal is the true peak. This catches inter-sample
+    overs that a sample-peak meter misses by up to about 3 dB.
+
+    Per-channel history is kept twice in a row ([k] and [k + 12]) so the
+    12-sample window is always contiguous and the four phases are computed
+    in one pass over it. Processing does not allocate.
+
+    The filter delays its output by about 6 samples, so a peak in the
+    last samples of a block is reported with the next block.
+*)
+
+type float32_buffer = (float, Bigarray.float32_elt, Bigarray.c_layout) Bigarray.Array1.t
+
+let taps = 12
+let phases = 4
+
+(** Phase [p] occupies [coeffs.(p * taps) .. coeffs.(p * taps + taps - 1)] *)
+let coeffs = [|
+  (* phase 0 *)
+  0.0017089843750; 0.0109863281250; -0.0196533203125; 0.0332031250000;
+  -0.0594482421875; 0.1373291015625; 0.9721679687500; -0.1022949218750;
+  0.0476074218750; -0.0266113281250; 0.0148925781250; -0.0083007812500;
+  (* phase 1 *)
+  -0.0291748046875; 0.0292968750000; -0.0517578125000; 0.0891113281250;
+  -0.1665039062500; 0.4650878906250; 0.7797851562500; -0.2003173828125;
+  0.1015625000000; -0.0582275390625; 0.0330810546875; -0.0189208984375;
+  (* phase 2 *)
+  -0.0189208984375; 0.0330810546875; -0.0582275390625; 0.1015625000000;
+  -0.2003173828125; 0.7797851562500; 0.4650878906250; -0.1665039062500;
+  0.0891113281250; -0.0517578125000; 0.0292968750000; -0.0291748046875;
+  (* phase 3 *)
+  -0.0083007812500; 0.0148925781250; -0.0266113281250; 0.0476074218750;
+  -0.1022949218750; 0.9721679687500; 0.1373291015625; -0.0594482421875;
+  0.0332031250000; -0.0196533203125; 0.0109863281250; 0.0017089843750;
+|]
+
+(** Streaming true-peak state *)
+type t = {
+  channels : int;
+  history : float array;     (** [2 * taps] per channel, newest first from [pos] *)
+  pos : int array;           (** window start per channel *)
+  block_peak : float array;  (** linear true peak since the last [take_peak] *)
+  max_peak : float array;    (** linear true peak since [reset] *)
+}
+
+(** Create a true-peak meter for [channels] channels *)
+let create ~channels () =
+  if channels <= 0 then invalid_arg "True_peak.create: channels must be positive";
+  {
+    channels;
+    history = Array.make (2 * taps * channels) 0.0;
+    pos = Array.make channels 0;
+    block_peak = Array.make channels 0.0;
+    max_peak = Array.make channels 0.0;
+  }
+
+(** Clear filter history and peaks *)
+let reset t =
+  Array.fill t.history 0 (Array.length t.history) 0.0;
+  Array.fill t.pos 0 t.channels 0;
+  Array.fill t.block_peak 0 t.channels 0.0;
+  Array.fill t.max_peak 0 t.channels 0.0
+
+(** Push one sample into channel [c]'s window; returns the window start *)
+let[@inline] push t c x =
+  let base = 2 * taps * c in
+  let p = if t.pos.(c) = 0 then taps - 1 else t.pos.(c) - 1 in
+  t.pos.(c) <- p;
+  Array.unsafe_set t.history (base + p) x;
+  Array.unsafe_set t.history (base + p + taps) x;
+  base + p
+
+(** Largest absolute value of the four interpolated outputs for the
+    window starting at [w] *)
+let[@inline] window_peak h w =
+  let y0 = ref 0.0 and y1 = ref 0.0 and y2 = ref 0.0 and y3 = ref 0.0 in
+  for k = 0 to taps - 1 do
+    let x = Array.unsafe_get h (w + k) in
+    y0 := !y0 +. Array.unsafe_get coeffs k *. x;
+    y1 := !y1 +. Array.unsafe_get coeffs (taps + k) *. x;
+    y2 := !y2 +. Array.unsafe_get coeffs (2 * taps + k) *. x;
+    y3 := !y3 +. Array.unsafe_get coeffs (3 * taps + k) *. x
+  done;
+  Float.max (Float.max (Float.abs !y0) (Float.abs !y1))
+    (Float.max (Float.abs !y2) (Float.abs !y3))
+
+let finish t c peak =
+  if peak > t.block_peak.(c) then t.block_peak.(c) <- peak;
+  if peak > t.max_peak.(c) then t.max_peak.(c) <- peak
+
+(** Feed [frames] samples of channel [c] read at [off], [off + stride], ... *)
+let process_f32 t ~channel:c (buf : float32_buffer) ~off ~stride ~frames =
+  if c < 0 || c >= t.channels then invalid_arg "True_peak.process_f32: channel";
+  if off < 0 || frames < 0 || (frames > 0 && off + (frames - 1) * stride >= Bigarray.Array1.dim buf) then
+    invalid_arg "True_peak.process_f32";
+  let peak = ref 0.0 in
+  for i = 0 to frames - 1 do
+    let w = push t c (Bigarray.Array1.unsafe_get buf (off + i * stride)) in
+    let v = window_peak t.history w in
+    if v > !peak then peak := v
+  done;
+  finish t c !peak
+
+(** Same over an OCaml float array *)
+let process_array t ~channel:c (buf : float array) ~off ~stride ~frames =
+  if c < 0 || c >= t.channels then invalid_arg "True_peak.process_array: channel";
+  if off < 0 || frames < 0 || (frames > 0 && off + (frames - 1) * stride >= Array.length buf) then
+    invalid_arg "True_peak.process_array";
+  let peak = ref 0.0 in
+  for i = 0 to frames - 1 do
+    let w = push t c (Array.unsafe_get buf (off + i * stride)) in
+    let v = window_peak t.history w in
+    if v > !peak then peak := v
+  done;
+  finish t c !peak
+
+(** Feed interleaved frames of every channel starting at sample [off]
+    (default: all remaining frames) *)
+let process_interleaved ?(off = 0) ?frames t (buf : float32_buffer) =
+  let ch = t.channels in
+  let frames = match frames with Some n -> n | None -> (Bigarray.Array1.dim buf - off) / ch in
+  for c = 0 to ch - 1 do
+    process_f32 t ~channel:c buf ~off:(off + c) ~stride:ch ~frames
+  done
+
+(** Feed one array per channel *)
+let process_planar_array t (channels : float array array) =
+  if Array.length channels <> t.channels then
+    invalid_arg "True_peak.process_planar_array: channel count mismatch";
+  Array.iteri (fun c buf ->
+    process_array t ~channel:c buf ~off:0 ~stride:1 ~frames:(Array.length buf)) channels
+
+(** Linear true peak of [channel] since the last call, then restart it *)
+let take_peak t channel =
+  let p = t.block_peak.(channel) in
+  t.block_peak.(channel) <- 0.0;
+  p
+
+(** Linear true peak of [channel] since [reset] *)
+let max_peak t channel = t.max_peak.(channel)
+
+(** One-shot linear true peak of a mono buffer *)
+let measure samples =
+  let t = create ~channels:1 () in
+  process_array t ~channel:0 samples ~off:0 ~stride:1 ~frames:(Array.length samples);
+  (* Flush the filter delay so trailing peaks are counted *)
+  let tail = Array.make taps 0.0 in
+  process_array t ~channel:0 tail ~off:0 ~stride:1 ~frames:taps;
+  max_peak t 0
@@ -0,0 +1,100 @@
+(** Worker Pool - Persistent domains for data-parallel metering
+
+    Spawning a domain costs far more than metering one block, so workers
+    are started once and parked on a condition variable between jobs.
+    [run] hands the same job to every worker and to the calling domain,
+    each with its own part index, and returns when all parts are done.
+
+    Not reentrant: one [run] at a time per pool.
+*)
+
+type t = {
+  mutex : Mutex.t;
+  work : Condition.t;
+  finished : Condition.t;
+  mutable job : int -> unit;
+  mutable generation : int;   (** bumped for each job *)
+  mutable pending : int;      (** workers still running the job *)
+  mutable failure : exn option;
+  mutable stopping : bool;
+  mutable domains : unit Domain.t array;
+}
+
+let worker t index =
+  let rec loop seen =
+    Mutex.lock t.mutex;
+    while t.generation = seen && not t.stopping do
+      Condition.wait t.work t.mutex
+    done;
+    if t.stopping then Mutex.unlock t.mutex
+    else begin
+      let generation = t.generation and job = t.job in
+      Mutex.unlock t.mutex;
+      let failure = match job index with () -> None | exception e -> Some e in
+      Mutex.lock t.mutex;
+      if t.failure = None then t.failure <- failure;
+      t.pending <- t.pending - 1;
+      if t.pending = 0 then Condition.signal t.finished;
+      Mutex.unlock t.mutex;
+      loop generation
+    end
+  in
+  loop 0
+
+(** Start [workers] domains (0 runs every job on the caller) *)
+let create workers =
+  let t = {
+    mutex = Mutex.create ();
+    work = Condition.create ();
+    finished = Condition.create ();
+    job = ignore;
+    generation = 0;
+    pending = 0;
+    failure = None;
+    stopping = false;
+    domains = [||];
+  } in
+  t.domains <- Array.init (max 0 workers) (fun i -> Domain.spawn (fun () -> worker t i));
+  t
+
+(** Number of parts a job is split into (workers plus the caller) *)
+let size t = Array.length t.domains + 1
+
+(** Run [job part] for every part in [0, size t) and wait for all of
+    them; the caller runs the last part. Re-raises the first failure. *)
+let run t job =
+  let workers = Array.length t.domains in
+  if workers = 0 then job 0
+  else begin
+    Mutex.lock t.mutex;
+    if t.stopping then begin
+      Mutex.unlock t.mutex;
+      invalid_arg "Worker_pool.run: pool is shut down"
+    end;
+    t.job <- job;
+    t.failure <- None;
+    t.pending <- workers;
+    t.generation <- t.generation + 1;
+    Condition.broadcast t.work;
+    Mutex.unlock t.mutex;
+    let own = match job workers with () -> None | exception e -> Some e in
+    Mutex.lock t.mutex;
+    while t.pending > 0 do
+      Condition.wait t.finished t.mutex
+    done;
+    let failure = t.failure in
+    t.job <- ignore;
+    Mutex.unlock t.mutex;
+    match own, failure with
+    | Some e, _ | None, Some e -> raise e
+    | None, None -> ()
+  end
+
+(** Stop and join the workers *)
+let shutdown t =
+  Mutex.lock t.mutex;
+  let already = t.stopping in
+  t.stopping <- true;
+  Condition.broadcast t.work;
+  Mutex.unlock t.mutex;
+  if not already then Array.iter Domain.join t.domains
@@ -0,0 +1,324 @@
+(** Metrics - Lock-free Prometheus metrics with per-domain shards
+
+    Every domain records into its own shard (found through domain-local
+    storage): histogram buckets, counters and gauges are plain slots in
+    an int array and histogram sums slots in a float array. Recording
+    touches only the calling domain's shard, takes no lock and does not
+    allocate once the series exists. A scrape adds the slots up across
+    all shards, so it may see a domain's update slightly late but never
+    loses one.
+
+    A family has at most one label (method, tool, operation, ...).
+    Series are created on first use; past [max_series] label values per
+    family, new values are counted under ["other"] so a client cannot
+    grow the registry without bound.
+
+    Histograms have fixed log buckets, two per octave from 1 us to about
+    100 s, so every observation lies within 50% of its bucket's bound.
+
+    Values known only at scrape time (queue depths, breaker states, GC
+    statistics) are registered as sampled families read by a callback.
+*)
+
+module Trace = Trace
+
+(** {1 Buckets} *)
+
+(** Bucket upper bounds in seconds: 1, 1.5, 2, 3, 4, 6 ... us *)
+let bounds =
+  Array.init 54 (fun i ->
+    let octave = Float.ldexp 1e-6 (i / 2) in
+    if i mod 2 = 0 then octave else octave *. 1.5)
+
+(** Slots per histogram series: one per bound plus +Inf *)
+let buckets = Array.length bounds + 1
+
+(** Index of the first bound >= [v] ([Array.length bounds] for +Inf) *)
+let bucket_index v =
+  let rec search lo hi =
+    if lo >= hi then lo
+    else
+      let mid = (lo + hi) / 2 in
+      if v <= Array.unsafe_get bounds mid then search lo mid else search (mid + 1) hi
+  in
+  search 0 (Array.length bounds)
+
+(** {1 Shards} *)
+
+type shard = {
+  mutable counts : int array;
+  mutable sums : float array;
+}
+
+let shards : shard list Atomic.t = Atomic.make []
+let next_slot = Atomic.make 0
+let next_sum = Atomic.make 0
+
+let rec register_shard s =
+  let old = Atomic.get shards in
+  if not (Atomic.compare_and_set shards old (s :: old)) then register_shard s
+
+let shard_key =
+  Domain.DLS.new_key (fun () ->
+    let s = { counts = Array.make 1024 0; sums = Array.make 64 0.0 } in
+    register_shard s;
+    s)
+
+(** Grow the calling domain's shard to cover every slot allocated so far *)
+let grow s =
+  let slots = Atomic.get next_slot and sums = Atomic.get next_sum in
+  if slots > Array.length s.counts then begin
+    let a = Array.make (max slots (2 * Array.length s.counts)) 0 in
+    Array.blit s.counts 0 a 0 (Array.length s.counts);
+    s.counts <- a
+  end;
+  if sums > Array.length s.sums then begin
+    let a = Array.make (max sums (2 * Array.length s.sums)) 0.0 in
+    Array.blit s.sums 0 a 0 (Array.length s.sums);
+    s.sums <- a
+  end
+
+(** {1 Families} *)
+
+type kind = Counter | Gauge | Histogram
+
+type series = {
+  value : string;     (** label value, [""] without a label *)
+  slot : int;
+  sum : int;          (** histogram sum slot, -1 otherwise *)
+}
+
+type family = {
+  name : string;
+  help : string;
+  label : string;     (** label name, [""] for none *)
+  kind : kind;
+  series : series list Atomic.t;
+}
+
+type histogram = family
+type counter = family
+type gauge = family
+
+(** Label values per family before new ones are folded into ["other"] *)
+let max_series = 64
+
+let families : family list Atomic.t = Atomic.make []
+
+let rec register name ~help ~label kind =
+  let old = Atomic.get families in
+  match List.find_opt (fun f -> f.name = name) old with
+  | Some f when f.kind = kind && f.label = label -> f
+  | Some _ -> invalid_arg ("Metrics: " ^ name ^ " registered with another kind or label")
+  | None ->
+    let f = { name; help; label; kind; series = Atomic.make [] } in
+    if Atomic.compare_and_set families old (f :: old) then f else register name ~help ~label kind
+
+(** Histogram family (seconds); the same name returns the same family *)
+let histogram ?(help = "") ?(label = "") name = register name ~help ~label Histogram
+
+(** Monotonic counter family; by convention the name ends in [_total] *)
+let counter ?(help = "") ?(label = "") name = register name ~help ~label Counter
+
+(** Gauge family that is moved up and down with [add] *)
+let gauge ?(help = "") ?(label = "") name = register name ~help ~label Gauge
+
+let rec find_series value = function
+  | [] -> raise_notrace Not_found
+  | s :: rest -> if String.equal s.value value then s else find_series value rest
+
+let rec add_series f value =
+  let old = Atomic.get f.series in
+  match find_series value old with
+  | s -> s
+  | exception Not_found ->
+    if List.length old >= max_series && value <> "other" then add_series f "other"
+    else begin
+      let width = match f.kind with Histogram -> buckets | Counter | Gauge -> 1 in
+      let s = {
+        value;
+        slot = Atomic.fetch_and_add next_slot width;
+        sum = (match f.kind with Histogram -> Atomic.fetch_and_add next_sum 1 | Counter | Gauge -> -1);
+      } in
+      if Atomic.compare_and_set f.series old (old @ [s]) then s else add_series f value
+    end
+
+let series f value =
+  match find_series value (Atomic.get f.series) with
+  | s -> s
+  | exception Not_found -> add_series f value
+
+(** {1 Recording} *)
+
+(** Record [seconds] in the series for label [value] *)
+let observe f value seconds =
+  if f.kind <> Histogram then invalid_arg "Metrics.observe: not a histogram";
+  let s = series f value in
+  let shard = Domain.DLS.get shard_key in
+  if s.slot + buckets > Array.length shard.counts || s.sum >= Array.length shard.sums then grow shard;
+  let i = s.slot + bucket_index seconds in
+  Array.unsafe_set shard.counts i (Array.unsafe_get shard.counts i + 1);
+  Array.unsafe_set shard.sums s.sum (Array.unsafe_get shard.sums s.sum +. seconds)
+
+(** Add [n] to a counter or gauge series *)
+let add f value n =
+  if f.kind = Histogram then invalid_arg "Metrics.add: histogram";
+  let s = series f value in
+  let shard = Domain.DLS.get shard_key in
+  if s.slot >= Array.length shard.counts then grow shard;
+  Array.unsafe_set shard.counts s.slot (Array.unsafe_get shard.counts s.slot + n)
+
+let incr f value = add f value 1
+
+(** Seconds since [t0] (from [Mtime_clock.now_ns]), on the monotonic clock *)
+let elapsed t0 = Int64.to_float (Int64.sub (Mtime_clock.now_ns ()) t0) *. 1e-9
+
+(** Run [fn], recording its elapsed time on the monotonic clock, so
+    wall-clock steps cannot skew it (also when it raises). The two clock
+    readings are boxed [int64]s, so each call allocates: time requests
+    and driver operations with it, not per-sample or per-message paths. *)
+let time f value fn =
+  let t0 = Mtime_clock.now_ns () in
+  match fn () with
+  | v ->
+    observe f value (elapsed t0);
+    v
+  | exception exn ->
+    observe f value (elapsed t0);
+    raise exn
+
+(** {1 Reading} *)
+
+let slot_total slot =
+  List.fold_left (fun acc s ->
+    let counts = s.counts in
+    if slot < Array.length counts then acc + counts.(slot) else acc) 0 (Atomic.get shards)
+
+let sum_total i =
+  List.fold_left (fun acc s ->
+    let sums = s.sums in
+    if i < Array.length sums then acc +. sums.(i) else acc) 0.0 (Atomic.get shards)
+
+(** Current value of a counter or gauge series *)
+let value f label =
+  match find_series label (Atomic.get f.series) with
+  | s -> slot_total s.slot
+  | exception Not_found -> 0
+
+let counter_value = value
+let gauge_value = value
+
+(** Observations, sum and per-bucket (non-cumulative) counts of a
+    histogram series *)
+let histogram_stats f label =
+  match find_series label (Atomic.get f.series) with
+  | s ->
+    let counts = Array.init buckets (fun b -> slot_total (s.slot + b)) in
+    (Array.fold_left ( + ) 0 counts, sum_total s.sum, counts)
+  | exception Not_found -> (0, 0.0, Array.make buckets 0)
+
+(** Domains that have recorded something *)
+let shard_count () = List.length (Atomic.get shards)
+
+(** {1 Sampled Families} *)
+
+type sampled = {
+  s_name : string;
+  s_help : string;
+  s_label : string;
+  s_kind : kind;
+  read : unit -> (string * float) list;
+}
+
+let sampled_families : sampled list Atomic.t = Atomic.make []
+
+(** Register a family whose values [read] returns at scrape time, as
+    [(label_value, value)] pairs ([""] without a label). Registering the
+    same name again replaces the callback. *)
+let rec sampled ?(help = "") ?(label = "") ?(counter = false) name read =
+  let old = Atomic.get sampled_families in
+  let entry = { s_name = name; s_help = help; s_label = label; s_kind = (if counter then Counter else Gauge); read } in
+  let rest = List.filter (fun s -> s.s_name <> name) old in
+  if not (Atomic.compare_and_set sampled_families old (entry :: rest)) then
+    sampled ~help ~label ~counter name read
+
+let () =
+  let gc field ?(counter = true) name help =
+    sampled ~help ~counter name (fun () -> [("", field (Gc.quick_stat ()))])
+  in
+  gc (fun s -> s.Gc.minor_words) "ocaml_gc_minor_words_total" "Words allocated in the minor heap";
+  gc (fun s -> s.Gc.promoted_words) "ocaml_gc_promoted_words_total" "Words promoted to the major heap";
+  gc (fun s -> s.Gc.major_words) "ocaml_gc_major_words_total" "Words allocated in the major heap";
+  gc (fun s -> Float.of_int s.Gc.minor_collections) "ocaml_gc_minor_collections_total" "Minor collections";
+  gc (fun s -> Float.of_int s.Gc.major_collections) "ocaml_gc_major_collections_total" "Major collection cycles";
+  gc (fun s -> Float.of_int s.Gc.compactions) "ocaml_gc_compactions_total" "Heap compactions";
+  gc ~counter:false (fun s -> Float.of_int s.Gc.heap_words) "ocaml_gc_heap_words" "Major heap size in words";
+  gc ~counter:false (fun s -> Float.of_int s.Gc.top_heap_words) "ocaml_gc_top_heap_words" "Largest major heap size in words";
+  sampled ~help:"Domains with a metrics shard" "daw_mcp_metrics_shards"
+    (fun () -> [("", Float.of_int (shard_count ()))])
+
+(** {1 Exposition} *)
+
+let content_type = "text/plain; version=0.0.4; charset=utf-8"
+
+let escape v =
+  let b = Buffer.create (String.length v) in
+  String.iter (function
+    | '\\' -> Buffer.add_string b "\\\\"
+    | '"' -> Buffer.add_string b "\\\""
+    | '\n' -> Buffer.add_string b "\\n"
+    | c -> Buffer.add_char b c) v;
+  Buffer.contents b
+
+let labels ~label ~value ?le () =
+  let pairs =
+    (if label = "" then [] else [Printf.sprintf "%s=\"%s\"" label (escape value)])
+    @ (match le with Some le -> [Printf.sprintf "le=\"%s\"" le] | None -> [])
+  in
+  if pairs = [] then "" else "{" ^ String.concat "," pairs ^ "}"
+
+let kind_name = function Counter -> "counter" | Gauge -> "gauge" | Histogram -> "histogram"
+
+let header b ~name ~help kind =
+  if help <> "" then Printf.bprintf b "# HELP %s %s\n" name help;
+  Printf.bprintf b "# TYPE %s %s\n" name (kind_name kind)
+
+let float_string v =
+  if Float.is_integer v && Float.abs v < 1e15 then Printf.sprintf "%.0f" v else Printf.sprintf "%.17g" v
+
+let expose_family b f =
+  header b ~name:f.name ~help:f.help f.kind;
+  List.iter (fun s ->
+    let label = f.label and value = s.value in
+    match f.kind with
+    | Counter | Gauge -> Printf.bprintf b "%s%s %d\n" f.name (labels ~label ~value ()) (slot_total s.slot)
+    | Histogram ->
+      let counts = Array.init buckets (fun i -> slot_total (s.slot + i)) in
+      (* Every series carries the full fixed layout, so [le] sets match
+         across series and over time *)
+      let cumulative = ref 0 in
+      for i = 0 to Array.length bounds - 1 do
+        cumulative := !cumulative + counts.(i);
+        Printf.bprintf b "%s_bucket%s %d\n" f.name
+          (labels ~label ~value ~le:(Printf.sprintf "%g" bounds.(i)) ()) !cumulative
+      done;
+      let total = Array.fold_left ( + ) 0 counts in
+      Printf.bprintf b "%s_bucket%s %d\n" f.name (labels ~label ~value ~le:"+Inf" ()) total;
+      Printf.bprintf b "%s_sum%s %s\n" f.name (labels ~label ~value ()) (float_string (sum_total s.sum));
+      Printf.bprintf b "%s_count%s %d\n" f.name (labels ~label ~value ()) total) (Atomic.get f.series)
+
+let expose_sampled b s =
+  match s.read () with
+  | exception exn ->
+    Printf.bprintf b "# %s unavailable: %s\n" s.s_name (Printexc.to_string exn)
+  | values ->
+    header b ~name:s.s_name ~help:s.s_help s.s_kind;
+    List.iter (fun (value, v) ->
+      Printf.bprintf b "%s%s %s\n" s.s_name (labels ~label:s.s_label ~value ()) (float_string v)) values
+
+(** Every family in the Prometheus text format *)
+let expose () =
+  let b = Buffer.create 4096 in
+  List.iter (expose_family b) (List.rev (Atomic.get families));
+  List.iter (expose_sampled b) (List.rev (Atomic.get sampled_families));
+  Buffer.contents b
@@ -0,0 +1,111 @@
+(** Metrics - Lock-free Prometheus metrics with per-domain shards
+
+    Recording goes to the calling domain's shard without locks or
+    allocation once a series exists; [expose] merges the shards. Each
+    family has at most one label; past [max_series] values per family
+    new ones are counted as ["other"]. *)
+
+(** {1 Tracing} *)
+
+(** Sampled per-request spans in preallocated per-domain rings,
+    exported as Chrome [trace_event] JSON *)
+module Trace : sig
+  val configure : ?capacity:int -> ?sample:float -> unit -> unit
+  (** Spans kept per domain (default 4096; applies to domains that start
+      recording afterwards) and the fraction of requests traced (default
+      0.01; 0 disables, 1 traces every request) *)
+
+  val sample_rate : unit -> float
+
+  val now : unit -> float
+  (** Microseconds on the monotonic clock, the span clock *)
+
+  val with_trace : ?cat:string -> ?start:float -> string -> (unit -> 'a) -> 'a
+  (** Start a trace for a request if it is sampled and run the function
+      as its root span, from [start] if given; inside a trace this is
+      [span] *)
+
+  val span : ?cat:string -> string -> (unit -> 'a) -> 'a
+  (** Run the function as a span of the current trace; outside a sampled
+      trace it only runs the function *)
+
+  val finish : ?cat:string -> string -> start:float -> unit
+  (** Record a span from [start] (from [now]) until now *)
+
+  val current : unit -> int option
+  (** Trace id of the calling fiber *)
+
+  val with_context : int option -> (unit -> 'a) -> 'a
+  (** Continue a trace captured with [current] on another fiber *)
+
+  val length : unit -> int
+  (** Spans held across all domains *)
+
+  val export : ?traces:int -> unit -> string
+  (** Recent spans as Chrome [trace_event] JSON, one row per trace;
+      [traces] keeps only the newest ones *)
+
+  val clear : unit -> unit
+end
+
+(** {1 Families} *)
+
+type histogram
+type counter
+type gauge
+
+val histogram : ?help:string -> ?label:string -> string -> histogram
+(** Latency histogram in seconds, log-bucketed two per octave from 1 us
+    to about 100 s. Registering a name again returns the same family. *)
+
+val counter : ?help:string -> ?label:string -> string -> counter
+val gauge : ?help:string -> ?label:string -> string -> gauge
+
+val max_series : int
+
+(** {1 Recording} *)
+
+val observe : histogram -> string -> float -> unit
+(** [observe h label_value seconds] *)
+
+val time : histogram -> string -> (unit -> 'a) -> 'a
+(** Run a function and observe its elapsed time on the monotonic clock,
+    also when it raises. Allocates (boxed clock readings), so keep it off
+    per-sample and per-message hot paths. *)
+
+val incr : counter -> string -> unit
+
+val add : gauge -> string -> int -> unit
+(** Move a gauge series by [n] (e.g. +1/-1 around a request) *)
+
+(** {1 Reading} *)
+
+val bounds : float array
+(** Bucket upper bounds in seconds; the last bucket is +Inf *)
+
+val bucket_index : float -> int
+
+val counter_value : counter -> string -> int
+val gauge_value : gauge -> string -> int
+(** Current total of a series across domains *)
+
+val histogram_stats : histogram -> string -> int * float * int array
+(** Count, sum and per-bucket (non-cumulative) counts of a series *)
+
+val shard_count : unit -> int
+(** Domains that have recorded something *)
+
+(** {1 Sampled Families} *)
+
+val sampled : ?help:string -> ?label:string -> ?counter:bool -> string -> (unit -> (string * float) list) -> unit
+(** Family read at scrape time as [(label_value, value)] pairs ([""]
+    without a label); a gauge unless [counter]. Registering a name
+    again replaces the callback. GC statistics are registered this way
+    as [ocaml_gc_*]. *)
+
+(** {1 Exposition} *)
+
+val content_type : string
+
+val expose : unit -> string
+(** All families in the Prometheus text format *)
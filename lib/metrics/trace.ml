@@ -0,0 +1,176 @@
+(** Trace - Sampled per-request spans in preallocated rings
+
+    A sampled request gets a trace id, bound in fiber-local storage for
+    the fibers handling it (and rebound by code that hands work to other
+    fibers, see [current] / [with_context]). [span] records a complete
+    span only inside a sampled trace; elsewhere it just runs its
+    function after one fiber-local lookup.
+
+    Spans go into a fixed-size ring per domain, stored as parallel
+    arrays (name, category, trace id, start, duration) allocated once,
+    so recording overwrites the oldest span and never takes a lock.
+    Names are stored by reference: pass static strings or strings the
+    caller already has.
+
+    [export] merges the rings into Chrome [trace_event] JSON, one row
+    ([tid]) per trace, for chrome://tracing or Perfetto.
+*)
+
+type ring = {
+  names : string array;
+  cats : string array;
+  traces : int array;
+  starts : float array;   (** microseconds on the monotonic clock *)
+  durs : float array;     (** microseconds *)
+  domain : int;
+  mutable next : int;     (** spans ever written *)
+}
+
+let capacity = Atomic.make 4096
+let period = Atomic.make 100   (* trace one request in [period]; 0 disables *)
+let requests = Atomic.make 0
+let next_trace = Atomic.make 0
+let rings : ring list Atomic.t = Atomic.make []
+
+let rec register r =
+  let old = Atomic.get rings in
+  if not (Atomic.compare_and_set rings old (r :: old)) then register r
+
+let ring_key =
+  Domain.DLS.new_key (fun () ->
+    let n = Atomic.get capacity in
+    let r = {
+      names = Array.make n "";
+      cats = Array.make n "";
+      traces = Array.make n 0;
+      starts = Array.make n 0.0;
+      durs = Array.make n 0.0;
+      domain = (Domain.self () :> int);
+      next = 0;
+    } in
+    register r;
+    r)
+
+(** Spans kept per domain (for domains that record after this call) and
+    the fraction of requests traced (0 disables tracing, 1 traces all) *)
+let configure ?capacity:cap ?sample () =
+  Option.iter (fun n -> if n > 0 then Atomic.set capacity n) cap;
+  Option.iter (fun rate ->
+    Atomic.set period (if rate <= 0.0 then 0 else max 1 (int_of_float (Float.round (1.0 /. rate))))) sample
+
+let sample_rate () =
+  match Atomic.get period with 0 -> 0.0 | p -> 1.0 /. Float.of_int p
+
+let now () = Int64.to_float (Mtime_clock.now_ns ()) *. 1e-3
+
+(** {1 Context} *)
+
+let trace_key : int Eio.Fiber.key = Eio.Fiber.create_key ()
+
+(** Trace id of the calling fiber, if its request is sampled *)
+let current () = Eio.Fiber.get trace_key
+
+(** Run [f] in the trace [ctx] (from [current] on another fiber) *)
+let with_context ctx f =
+  match ctx with
+  | None -> f ()
+  | Some id -> Eio.Fiber.with_binding trace_key id f
+
+(** {1 Recording} *)
+
+(** Store a finished span in the calling domain's ring *)
+let record ~cat name trace ~start ~stop =
+  let r = Domain.DLS.get ring_key in
+  let i = r.next mod Array.length r.names in
+  Array.unsafe_set r.names i name;
+  Array.unsafe_set r.cats i cat;
+  Array.unsafe_set r.traces i trace;
+  Array.unsafe_set r.starts i start;
+  Array.unsafe_set r.durs i (stop -. start);
+  r.next <- r.next + 1
+
+let timed ?start ~cat name trace f =
+  let start = match start with Some s -> s | None -> now () in
+  match f () with
+  | v ->
+    record ~cat name trace ~start ~stop:(now ());
+    v
+  | exception exn ->
+    record ~cat name trace ~start ~stop:(now ());
+    raise exn
+
+(** Run [f] as a span of the current trace, if any *)
+let span ?(cat = "app") name f =
+  match current () with
+  | None -> f ()
+  | Some trace -> timed ~cat name trace f
+
+(** Start a trace for a request, subject to sampling, and run [f] in it
+    as the root span, optionally from an earlier [start] (from [now]).
+    Inside an existing trace this is a plain [span]. *)
+let with_trace ?(cat = "request") ?start name f =
+  match current () with
+  | Some trace -> timed ?start ~cat name trace f
+  | None ->
+    let p = Atomic.get period in
+    if p = 0 || Atomic.fetch_and_add requests 1 mod p <> 0 then f ()
+    else begin
+      let trace = Atomic.fetch_and_add next_trace 1 + 1 in
+      Eio.Fiber.with_binding trace_key trace (fun () -> timed ?start ~cat name trace f)
+    end
+
+(** Record a span that started at [start] (from [now]) and ends now,
+    e.g. time spent queued before another fiber picked the work up *)
+let finish ?(cat = "app") name ~start =
+  match current () with
+  | None -> ()
+  | Some trace -> record ~cat name trace ~start ~stop:(now ())
+
+(** {1 Export} *)
+
+type event = { e_name : string; e_cat : string; e_trace : int; e_ts : float; e_dur : float; e_domain : int }
+
+let events () =
+  List.concat_map (fun r ->
+    let n = Array.length r.names in
+    let count = min r.next n in
+    List.init count (fun k ->
+      let i = (r.next - count + k) mod n in
+      { e_name = r.names.(i); e_cat = r.cats.(i); e_trace = r.traces.(i);
+        e_ts = r.starts.(i); e_dur = r.durs.(i); e_domain = r.domain })) (Atomic.get rings)
+
+(** Spans currently held across all domains *)
+let length () = List.fold_left (fun acc r -> acc + min r.next (Array.length r.names)) 0 (Atomic.get rings)
+
+(** Recent spans as Chrome [trace_event] JSON. With [traces], only the
+    newest [traces] traces are included. *)
+let export ?traces () =
+  let all = List.sort (fun a b -> Float.compare a.e_ts b.e_ts) (events ()) in
+  let all =
+    match traces with
+    | None -> all
+    | Some k ->
+      let ids = List.sort_uniq (fun a b -> compare b a) (List.map (fun e -> e.e_trace) all) in
+      let keep = List.filteri (fun i _ -> i < k) ids in
+      List.filter (fun e -> List.mem e.e_trace keep) all
+  in
+  let event e =
+    `Assoc [
+      ("name", `String e.e_name);
+      ("cat", `String e.e_cat);
+      ("ph", `String "X");
+      ("ts", `Float e.e_ts);
+      ("dur", `Float e.e_dur);
+      ("pid", `Int 1);
+      ("tid", `Int e.e_trace);
+      ("args", `Assoc [("trace", `Int e.e_trace); ("domain", `Int e.e_domain)]);
+    ]
+  in
+  Yojson.Safe.to_string (`Assoc [
+    ("traceEvents", `List (List.map event all));
+    ("displayTimeUnit", `String "ms");
+    ("otherData", `Assoc [("sample_rate", `Float (sample_rate ()))]);
+  ])
+
+(** Drop every recorded span *)
+let clear () = List.iter (fun r -> r.next <- 0) (Atomic.get rings)
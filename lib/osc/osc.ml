@@ -12,12 +12,24 @@ let show_osc_packet = Osc_types.show_osc_packet
 (** Parse OSC binary data to OCaml types *)
 module Parse = Osc_parse
 
+(** Zero-copy decoding from Cstruct buffers *)
+module Decode = Osc_decode
+
 (** Serialize OCaml types to OSC binary data *)
 module Serialize = Osc_serialize
 
 (** UDP transport using Eio *)
 module Transport = Osc_transport
 
+(** Address-pattern dispatch for inbound messages *)
+module Dispatch = Osc_dispatch
+
+(** Timetag-scheduled bundles *)
+module Schedule = Osc_schedule
+
+(** Batched, coalescing receive stage *)
+module Batch = Osc_batch
+
 (** Convenience: create and send message in one call *)
 let send_message ~sw ~net ~host ~port address args =
   let t = Transport.create ~sw ~net ~host ~port in
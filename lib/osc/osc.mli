@@ -1,7 +1,7 @@
 (** OSC - Pure OCaml Open Sound Control implementation
 
     This module provides a complete OSC 1.0 implementation in pure OCaml,
-    using Angstrom for parsing and Faraday for serialization.
+    using Angstrom for parsing and a Cstruct encoder for serialization.
 *)
 
 (** {1 Types} *)
@@ -48,6 +48,15 @@ val show_osc_packet : osc_packet -> string
 (** Timetag for immediate execution *)
 val timetag_immediately : int64
 
+(** Seconds between the NTP and Unix epochs *)
+val ntp_unix_offset : float
+
+(** NTP timetag for a Unix timestamp *)
+val timetag_of_unix : float -> int64
+
+(** Unix timestamp of an NTP timetag *)
+val unix_of_timetag : int64 -> float
+
 (** {1 Constructors} *)
 
 (** Create a message packet *)
@@ -56,6 +65,9 @@ val message : string -> osc_arg list -> osc_packet
 (** Create a bundle for immediate execution *)
 val bundle_now : osc_packet list -> osc_packet
 
+(** Create a bundle executed at a Unix timestamp *)
+val bundle_at : float -> osc_packet list -> osc_packet
+
 (** Generate type tag string from arguments *)
 val make_type_tag : osc_arg list -> string
 
@@ -69,9 +81,65 @@ module Parse : sig
   val parse_cstruct : Cstruct.t -> (osc_packet, string) result
 end
 
+(** Zero-copy decoder working directly on the receive buffer *)
+module Decode : sig
+  (** Undecoded message: offsets into a buffer. Only valid while the
+      underlying buffer is not reused. *)
+  type view
+
+  (** Decode a complete packet *)
+  val decode : Cstruct.t -> (osc_packet, string) result
+
+  (** Decode from a string *)
+  val decode_string : string -> (osc_packet, string) result
+
+  (** View a single message without decoding its arguments *)
+  val view : Cstruct.t -> (view, string) result
+
+  (** Address as a fresh string *)
+  val address : view -> string
+
+  (** Compare the address without allocating *)
+  val address_equal : view -> string -> bool
+
+  (** Number of arguments *)
+  val arg_count : view -> int
+
+  (** Type tag of argument [i] *)
+  val type_tag : view -> int -> char
+
+  (** Decode all arguments *)
+  val args : view -> (osc_arg list, string) result
+
+  (** Decode argument [i] only *)
+  val arg : view -> int -> (osc_arg, string) result
+
+  (** Fold over every message of a packet (descending into bundles) as views *)
+  val fold_messages : ('a -> view -> 'a) -> 'a -> Cstruct.t -> ('a, string) result
+end
+
 (** {1 Serialization} *)
 
 module Serialize : sig
+  (** Reusable output buffer *)
+  type buffer
+
+  (** Create an empty buffer *)
+  val create_buffer : ?size:int -> unit -> buffer
+
+  (** Encode into [buffer], replacing its contents; the result is a view
+      that is only valid until the buffer is reused or released *)
+  val encode : buffer -> osc_packet -> Cstruct.t
+
+  (** Take a buffer from the shared pool *)
+  val acquire : unit -> buffer
+
+  (** Return a buffer to the shared pool *)
+  val release : buffer -> unit
+
+  (** Run a function with a pooled buffer *)
+  val with_buffer : (buffer -> 'a) -> 'a
+
   (** Serialize packet to string *)
   val serialize : osc_packet -> string
 
@@ -88,12 +156,26 @@ end
 (** {1 Transport} *)
 
 module Transport : sig
-  (** OSC UDP client *)
+  (** OSC client over UDP, TCP or a Unix socket *)
   type t
 
-  (** Create client connected to remote host:port *)
+  (** Packet framing for stream transports *)
+  type framing =
+    | Slip           (** OSC 1.1: SLIP with END on both sides *)
+    | Length_prefix  (** OSC 1.0: big-endian int32 size prefix *)
+
+  (** Where and how to reach an OSC peer *)
+  type endpoint =
+    | Udp of { host : string; port : int }
+    | Tcp of { host : string; port : int; framing : framing }
+    | Unix_socket of { path : string; framing : framing }
+
+  (** Create UDP client connected to remote host:port *)
   val create : sw:Eio.Switch.t -> net:_ Eio.Net.t -> host:string -> port:int -> t
 
+  (** Connect over the endpoint's transport *)
+  val connect : sw:Eio.Switch.t -> net:_ Eio.Net.t -> endpoint -> t
+
   (** Send OSC packet *)
   val send : t -> osc_packet -> unit
 
@@ -101,14 +183,33 @@ module Transport : sig
   val send_message : t -> string -> osc_arg list -> unit
 
   (** Send bundle *)
-  val send_bundle : t -> osc_packet list -> unit
+  val send_bundle : ?timetag:int64 -> t -> osc_packet list -> unit
 
   (** Set receive callback *)
   val on_receive : t -> (osc_packet -> unit) -> unit
 
+  (** Set raw receive callback; the datagram is only valid during the call *)
+  val on_receive_raw : t -> (Cstruct.t -> unit) -> unit
+
   (** Start receive loop in background fiber *)
   val start_receiving : sw:Eio.Switch.t -> t -> unit
 
+  (** Stream framing codec (used by the TCP/Unix transports) *)
+  module Frame : sig
+    (** Incremental frame decoder *)
+    type decoder
+
+    (** Create a decoder for a framing *)
+    val create : ?size:int -> framing -> decoder
+
+    (** Feed bytes; calls the function on each complete frame (the view is
+        only valid during the call) *)
+    val feed : decoder -> Cstruct.t -> (Cstruct.t -> unit) -> unit
+
+    (** Frame one encoded packet *)
+    val frame : framing -> Cstruct.t -> Cstruct.t
+  end
+
   (** Close connection *)
   val close : t -> unit
 
@@ -129,6 +230,154 @@ module Transport : sig
   end
 end
 
+(** {1 Dispatch} *)
+
+(** Address-pattern trie routing inbound messages to handlers.
+    Registered segments are literals, [%d] (integer capture) or OSC 1.0
+    patterns ([*], [?], [[]], [{}]); incoming addresses may be patterns too. *)
+module Dispatch : sig
+  (** Value captured by a non-literal segment *)
+  type capture =
+    | Int of int        (** [%d] segment *)
+    | Segment of string (** pattern segment *)
+
+  (** Dispatcher over payloads of type ['a] *)
+  type 'a t
+
+  (** Create an empty dispatcher *)
+  val create : unit -> 'a t
+
+  (** Register a handler for an address pattern, e.g. [/track/%d/volume] *)
+  val add : 'a t -> string -> (capture list -> 'a -> unit) -> unit
+
+  (** Remove every handler *)
+  val clear : 'a t -> unit
+
+  (** Deliver a payload to all matching handlers; returns how many ran.
+      A malformed address or pattern matches nothing. *)
+  val dispatch : 'a t -> string -> 'a -> int
+
+  (** Dispatch every message of a decoded packet *)
+  val dispatch_packet : osc_message t -> osc_packet -> unit
+
+  (** Route a transport's inbound datagrams as lazy message views *)
+  val attach : Decode.view t -> Transport.t -> unit
+
+  (** Whether an OSC address pattern matches an address *)
+  val pattern_matches : pattern:string -> string -> bool
+end
+
+(** {1 Scheduling} *)
+
+(** Bundles scheduled for future execution, either stamped with NTP
+    timetags and sent ahead by a lookahead, or held and fired locally for
+    DAWs that ignore timetags *)
+module Schedule : sig
+  (** Transport reading used to convert musical positions to wall time *)
+  type tempo_map = {
+    anchor_time : float;  (** Unix time of the reading *)
+    anchor_beat : float;  (** playhead in beats from the start of bar 1 *)
+    bpm : float;
+    beats_per_bar : int;
+  }
+
+  (** Anchor on a 1-based bar/beat(/tick) position read at [now] *)
+  val anchor : now:float -> bpm:float -> ?beats_per_bar:int -> ?ticks_per_beat:int ->
+    ?tick:int -> bar:int -> beat:int -> unit -> tempo_map
+
+  (** Anchor on a transport time in seconds read at [now] *)
+  val anchor_seconds : now:float -> bpm:float -> ?beats_per_bar:int -> float -> tempo_map
+
+  (** Wall-clock time of a beat *)
+  val time_of_beat : tempo_map -> float -> float
+
+  (** Wall-clock time of a 1-based bar/beat *)
+  val time_of_position : tempo_map -> bar:int -> ?beat:int -> unit -> float
+
+  type mode =
+    | Timetag  (** send early with the due time as timetag *)
+    | Local    (** hold until due, send as immediate *)
+
+  (** Scheduler *)
+  type t
+
+  (** Default lookahead in seconds *)
+  val default_lookahead : float
+
+  (** Create a scheduler sending through [send] *)
+  val create : ?lookahead:float -> ?mode:mode -> send:(osc_packet -> unit) -> unit -> t
+
+  (** Change the lookahead *)
+  val set_lookahead : t -> float -> unit
+
+  (** Schedule packets as a bundle due at a Unix time; returns an id *)
+  val at : t -> float -> osc_packet list -> int
+
+  (** Schedule packets at a bar/beat position *)
+  val at_position : t -> tempo_map -> bar:int -> ?beat:int -> osc_packet list -> int
+
+  (** Cancel a pending bundle *)
+  val cancel : t -> int -> bool
+
+  (** Number of pending bundles *)
+  val pending : t -> int
+
+  (** Send due bundles; returns the next release time *)
+  val poll : t -> now:float -> float option
+
+  (** Start the scheduler loop in a daemon fiber *)
+  val start : sw:Eio.Switch.t -> clock:_ Eio.Time.clock -> t -> unit
+end
+
+(** {1 Batched receive} *)
+
+(** Receive stage that decodes datagrams into a pending batch and hands
+    whole batches to a handler fiber, keeping only the latest message for
+    high-rate (coalesced) addresses *)
+module Batch : sig
+  (** Receive counters *)
+  type stats = {
+    received : int;        (** messages decoded *)
+    delivered : int;       (** messages handed to the handler *)
+    coalesced : int;       (** messages replaced by a newer value *)
+    dropped : int;         (** messages dropped on a full backlog *)
+    decode_errors : int;   (** malformed datagrams *)
+    batches : int;         (** handler invocations *)
+    backlog : int;         (** messages currently pending *)
+    max_backlog : int;     (** highest backlog seen *)
+  }
+
+  type t
+
+  (** Predicate matching any of the given address patterns *)
+  val coalesce_patterns : string list -> string -> bool
+
+  (** Default coalesced addresses: playhead and meter feedback *)
+  val default_coalesce : string -> bool
+
+  (** Default maximum backlog *)
+  val default_capacity : int
+
+  (** Create a stage delivering batches to the handler *)
+  val create : ?capacity:int -> ?coalesce:(string -> bool) ->
+    (osc_message list -> unit) -> t
+
+  (** Queue one message *)
+  val push : t -> osc_message -> unit
+
+  (** Decode a datagram and queue its messages *)
+  val push_datagram : t -> Cstruct.t -> unit
+
+  (** Remove and return pending messages in arrival order *)
+  val take_batch : t -> osc_message list
+
+  (** Feed a transport into the stage and start the delivery fiber *)
+  val attach : sw:Eio.Switch.t -> t -> Transport.t -> unit
+
+  (** Counter snapshot *)
+  val stats : t -> stats
+end
+
 (** {1 Convenience} *)
 
 (** Send a one-shot message *)
@@ -0,0 +1,161 @@
+(** OSC Batch - Coalescing receive stage for high-rate feedback
+
+    The transport's receive fiber only decodes datagrams and appends their
+    messages to a pending batch; a separate fiber hands the whole batch to
+    the handler each time it wakes. While the handler is busy, new
+    datagrams keep accumulating, and messages on coalesced addresses
+    (meters, playhead position) overwrite their pending predecessor in
+    place, so the handler sees only the latest value. Other messages are
+    queued in arrival order up to [capacity]; beyond that they are dropped
+    and counted.
+*)
+
+open Osc_types
+
+(** Receive counters *)
+type stats = {
+  received : int;        (** messages decoded *)
+  delivered : int;       (** messages handed to the handler *)
+  coalesced : int;       (** messages replaced by a newer value *)
+  dropped : int;         (** messages dropped on a full backlog *)
+  decode_errors : int;   (** malformed datagrams *)
+  batches : int;         (** handler invocations *)
+  backlog : int;         (** messages currently pending *)
+  max_backlog : int;     (** highest backlog seen *)
+}
+
+type t = {
+  coalesce : string -> bool;
+  capacity : int;
+  handler : osc_message list -> unit;
+  mutable pending : osc_message array;
+  mutable count : int;
+  slots : (string, int) Hashtbl.t;  (** coalesced address -> pending slot *)
+  ready : Eio.Condition.t;
+  mutable received : int;
+  mutable delivered : int;
+  mutable coalesced : int;
+  mutable dropped : int;
+  mutable decode_errors : int;
+  mutable batches : int;
+  mutable max_backlog : int;
+}
+
+(** Predicate matching any of the OSC address [patterns] (compiled once) *)
+let coalesce_patterns patterns =
+  let d = Osc_dispatch.create () in
+  List.iter (fun p -> Osc_dispatch.add d p (fun _ () -> ())) patterns;
+  fun address -> Osc_dispatch.dispatch d address () > 0
+
+(** High-rate Reaper/Ableton feedback addresses *)
+let default_coalesce = coalesce_patterns [
+  "/time"; "/time/str"; "/beat/str"; "/samples"; "/frames/str";
+  "/track/*/vu"; "/track/*/vu/*"; "/master/vu"; "/master/vu/*";
+  "/live/song/get/current_song_time";
+]
+
+let default_capacity = 4096
+
+let empty = { address = ""; args = [] }
+
+(** Create a batching stage delivering to [handler] *)
+let create ?(capacity = default_capacity) ?(coalesce = default_coalesce) handler =
+  {
+    coalesce;
+    capacity;
+    handler;
+    pending = Array.make (min capacity 256) empty;
+    count = 0;
+    slots = Hashtbl.create 64;
+    ready = Eio.Condition.create ();
+    received = 0;
+    delivered = 0;
+    coalesced = 0;
+    dropped = 0;
+    decode_errors = 0;
+    batches = 0;
+    max_backlog = 0;
+  }
+
+let append t msg =
+  if t.count = Array.length t.pending then begin
+    let bigger = Array.make (min t.capacity (2 * t.count)) empty in
+    Array.blit t.pending 0 bigger 0 t.count;
+    t.pending <- bigger
+  end;
+  t.pending.(t.count) <- msg;
+  t.count <- t.count + 1;
+  if t.count > t.max_backlog then t.max_backlog <- t.count
+
+(** Queue one message *)
+let push t (msg : osc_message) =
+  t.received <- t.received + 1;
+  if t.coalesce msg.address then begin
+    match Hashtbl.find_opt t.slots msg.address with
+    | Some slot ->
+      t.pending.(slot) <- msg;
+      t.coalesced <- t.coalesced + 1
+    | None when t.count < t.capacity ->
+      Hashtbl.replace t.slots msg.address t.count;
+      append t msg
+    | None -> t.dropped <- t.dropped + 1
+  end else if t.count < t.capacity then append t msg
+  else t.dropped <- t.dropped + 1;
+  Eio.Condition.broadcast t.ready
+
+(** Decode a datagram and queue its messages (bundles are flattened) *)
+let push_datagram t data =
+  match
+    Osc_decode.fold_messages (fun () v ->
+      match Osc_decode.args v with
+      | Ok args -> push t { address = Osc_decode.address v; args }
+      | Error _ -> t.decode_errors <- t.decode_errors + 1) () data
+  with
+  | Ok () -> ()
+  | Error msg ->
+    t.decode_errors <- t.decode_errors + 1;
+    Logs.warn (fun m -> m "OSC parse error: %s" msg)
+
+(** Remove and return everything pending, in arrival order *)
+let take_batch t =
+  let rec collect i acc = if i < 0 then acc else collect (i - 1) (t.pending.(i) :: acc) in
+  let batch = collect (t.count - 1) [] in
+  Array.fill t.pending 0 t.count empty;
+  t.count <- 0;
+  Hashtbl.reset t.slots;
+  batch
+
+(** Deliver batches forever; run in a daemon fiber *)
+let run t =
+  let rec loop () =
+    if t.count = 0 then Eio.Condition.await_no_mutex t.ready
+    else begin
+      let n = t.count in
+      let batch = take_batch t in
+      t.batches <- t.batches + 1;
+      t.delivered <- t.delivered + n;
+      (try t.handler batch
+       with Eio.Cancel.Cancelled _ as e -> raise e
+          | e -> Logs.warn (fun m -> m "OSC batch handler failed: %s" (Printexc.to_string e)))
+    end;
+    loop ()
+  in
+  loop ()
+
+(** Feed [transport]'s datagrams into [t] and start delivering batches.
+    Replaces any raw handler already set on the transport. *)
+let attach ~sw t transport =
+  Osc_transport.on_receive_raw transport (push_datagram t);
+  Eio.Fiber.fork_daemon ~sw (fun () -> run t)
+
+(** Snapshot of the counters *)
+let stats (t : t) : stats = {
+  received = t.received;
+  delivered = t.delivered;
+  coalesced = t.coalesced;
+  dropped = t.dropped;
+  decode_errors = t.decode_errors;
+  batches = t.batches;
+  backlog = t.count;
+  max_backlog = t.max_backlog;
+}
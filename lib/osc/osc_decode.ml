@@ -0,0 +1,226 @@
+(** OSC Decoder - Zero-copy parser over Cstruct
+
+    Decodes OSC 1.0 packets directly from a receive buffer with offset
+    arithmetic. Bundle elements are decoded from sub-views of the same
+    buffer (no intermediate strings), and messages can be inspected lazily
+    through a [view] so handlers that only need the address never decode
+    their arguments.
+*)
+
+open Osc_types
+
+(** Raised on malformed input; converted to [Error] at the entry points *)
+exception Malformed of string
+
+let malformed fmt = Printf.ksprintf (fun msg -> raise (Malformed msg)) fmt
+
+(** Fail unless [n] bytes are available at [off] *)
+let need cs off n what =
+  if off < 0 || off + n > Cstruct.length cs then
+    malformed "Truncated %s at offset %d" what off
+
+(** Length of the NUL-terminated string at [off] (without the NUL) *)
+let string_len cs off =
+  let len = Cstruct.length cs in
+  let rec scan i =
+    if i >= len then malformed "Unterminated OSC string at offset %d" off
+    else if Cstruct.get_char cs i = '\x00' then i - off
+    else scan (i + 1)
+  in
+  scan off
+
+(** Offset just past the padded string at [off] *)
+let string_end cs off n =
+  let next = off + pad4 (n + 1) in
+  if next > Cstruct.length cs then
+    malformed "Truncated OSC string padding at offset %d" off;
+  next
+
+let get_string cs off n =
+  Cstruct.to_string (Cstruct.sub cs off n)
+
+(** Decode one argument; returns the argument and the next offset *)
+let decode_arg cs off = function
+  | 'i' -> need cs off 4 "int32"; (Int32 (Cstruct.BE.get_uint32 cs off), off + 4)
+  | 'f' ->
+    need cs off 4 "float32";
+    (Float32 (Int32.float_of_bits (Cstruct.BE.get_uint32 cs off)), off + 4)
+  | 's' ->
+    let n = string_len cs off in
+    (String (get_string cs off n), string_end cs off n)
+  | 'b' ->
+    need cs off 4 "blob size";
+    let size = Int32.to_int (Cstruct.BE.get_uint32 cs off) in
+    if size < 0 then malformed "Negative blob size %d" size;
+    need cs (off + 4) (pad4 size) "blob";
+    (Blob (Cstruct.to_bytes (Cstruct.sub cs (off + 4) size)), off + 4 + pad4 size)
+  | 'h' -> need cs off 8 "int64"; (Int64 (Cstruct.BE.get_uint64 cs off), off + 8)
+  | 't' -> need cs off 8 "timetag"; (Timetag (Cstruct.BE.get_uint64 cs off), off + 8)
+  | 'd' ->
+    need cs off 8 "float64";
+    (Double (Int64.float_of_bits (Cstruct.BE.get_uint64 cs off)), off + 8)
+  | 'c' ->
+    need cs off 4 "char";
+    (Char (Char.chr (Int32.to_int (Cstruct.BE.get_uint32 cs off) land 0xFF)), off + 4)
+  | 'r' -> need cs off 4 "color"; (Color (Cstruct.BE.get_uint32 cs off), off + 4)
+  | 'm' -> need cs off 4 "midi"; (Midi (Cstruct.to_bytes (Cstruct.sub cs off 4)), off + 4)
+  | 'T' -> (True, off)
+  | 'F' -> (False, off)
+  | 'N' -> (Nil, off)
+  | 'I' -> (Infinitum, off)
+  | c -> malformed "Unknown OSC type tag: %c" c
+
+(** Offset past one argument without decoding it *)
+let skip_arg cs off = function
+  | 'i' | 'f' | 'c' | 'r' | 'm' -> need cs off 4 "argument"; off + 4
+  | 'h' | 't' | 'd' -> need cs off 8 "argument"; off + 8
+  | 's' -> string_end cs off (string_len cs off)
+  | 'b' ->
+    need cs off 4 "blob size";
+    let size = Int32.to_int (Cstruct.BE.get_uint32 cs off) in
+    if size < 0 then malformed "Negative blob size %d" size;
+    need cs (off + 4) (pad4 size) "blob";
+    off + 4 + pad4 size
+  | 'T' | 'F' | 'N' | 'I' -> off
+  | c -> malformed "Unknown OSC type tag: %c" c
+
+(** {1 Message views} *)
+
+(** Undecoded message: offsets into the receive buffer.
+    Only valid while the underlying buffer is not reused. *)
+type view = {
+  buf : Cstruct.t;
+  address_len : int;  (** address starts at offset 0 *)
+  tags_off : int;     (** first type tag (after ',') *)
+  tags_len : int;
+  args_off : int;
+}
+
+let view_exn cs =
+  need cs 0 1 "message";
+  if Cstruct.get_char cs 0 <> '/' then
+    malformed "Invalid OSC message start: %c" (Cstruct.get_char cs 0);
+  let address_len = string_len cs 0 in
+  let tags_start = string_end cs 0 address_len in
+  if tags_start >= Cstruct.length cs then
+    (* Type tag string omitted (pre-1.0 senders): no arguments *)
+    { buf = cs; address_len; tags_off = tags_start; tags_len = 0; args_off = tags_start }
+  else begin
+    let n = string_len cs tags_start in
+    let args_off = string_end cs tags_start n in
+    if n > 0 && Cstruct.get_char cs tags_start = ',' then
+      { buf = cs; address_len; tags_off = tags_start + 1; tags_len = n - 1; args_off }
+    else
+      { buf = cs; address_len; tags_off = tags_start; tags_len = n; args_off }
+  end
+
+(** Address as a fresh string *)
+let address v = get_string v.buf 0 v.address_len
+
+(** Compare the address without allocating *)
+let address_equal v s =
+  String.length s = v.address_len &&
+  (let rec go i = i >= v.address_len || (Cstruct.get_char v.buf i = s.[i] && go (i + 1)) in
+   go 0)
+
+(** Number of arguments *)
+let arg_count v = v.tags_len
+
+(** Type tag of argument [i] *)
+let type_tag v i =
+  if i < 0 || i >= v.tags_len then invalid_arg "Osc_decode.type_tag";
+  Cstruct.get_char v.buf (v.tags_off + i)
+
+let decode_args_exn v =
+  let rec go i off acc =
+    if i >= v.tags_len then (List.rev acc, off)
+    else
+      let arg, off = decode_arg v.buf off (Cstruct.get_char v.buf (v.tags_off + i)) in
+      go (i + 1) off (arg :: acc)
+  in
+  go 0 v.args_off []
+
+let arg_exn v i =
+  if i < 0 || i >= v.tags_len then invalid_arg "Osc_decode.arg";
+  let rec seek j off =
+    let tag = Cstruct.get_char v.buf (v.tags_off + j) in
+    if j = i then fst (decode_arg v.buf off tag)
+    else seek (j + 1) (skip_arg v.buf off tag)
+  in
+  seek 0 v.args_off
+
+(** {1 Packets} *)
+
+let bundle_tag = "#bundle\x00"
+
+let is_bundle_header cs =
+  Cstruct.length cs >= 16 &&
+  (let rec go i = i >= 8 || (Cstruct.get_char cs i = bundle_tag.[i] && go (i + 1)) in
+   go 0)
+
+(** Fold over the elements of a bundle as sub-views of [cs] *)
+let fold_elements f acc cs =
+  let len = Cstruct.length cs in
+  let rec go off acc =
+    if off >= len then acc
+    else begin
+      need cs off 4 "bundle element size";
+      let size = Int32.to_int (Cstruct.BE.get_uint32 cs off) in
+      if size < 0 || off + 4 + size > len then
+        malformed "Bundle element size %d out of range at offset %d" size off;
+      go (off + 4 + size) (f acc (Cstruct.sub cs (off + 4) size))
+    end
+  in
+  go 16 acc
+
+let rec decode_packet cs =
+  if Cstruct.length cs = 0 then malformed "Empty OSC packet";
+  match Cstruct.get_char cs 0 with
+  | '/' ->
+    let v = view_exn cs in
+    let args, off = decode_args_exn v in
+    if off <> Cstruct.length cs then
+      malformed "Trailing %d bytes after OSC message" (Cstruct.length cs - off);
+    Message { address = address v; args }
+  | '#' ->
+    if not (is_bundle_header cs) then malformed "Invalid OSC bundle header";
+    let timetag = Cstruct.BE.get_uint64 cs 8 in
+    let elements = fold_elements (fun acc el -> decode_packet el :: acc) [] cs in
+    Bundle { timetag; elements = List.rev elements }
+  | c -> malformed "Invalid OSC packet start: %c" c
+
+let protect f =
+  match f () with
+  | v -> Ok v
+  | exception Malformed msg -> Error msg
+  | exception Invalid_argument msg -> Error msg
+
+(** Decode a complete packet from [cs] *)
+let decode cs = protect (fun () -> decode_packet cs)
+
+(** Decode from a string (copies into a Cstruct first) *)
+let decode_string s = decode (Cstruct.of_string s)
+
+(** View a single message without decoding its arguments *)
+let view cs = protect (fun () -> view_exn cs)
+
+(** Decode all arguments of a view *)
+let args v = protect (fun () -> fst (decode_args_exn v))
+
+(** Decode argument [i] of a view, skipping earlier ones without decoding *)
+let arg v i = protect (fun () -> arg_exn v i)
+
+(** Fold [f] over every message in [cs], descending into nested bundles.
+    Messages are passed as views into [cs]; nothing is decoded unless [f]
+    asks for it. *)
+let fold_messages f init cs =
+  let rec go acc cs =
+    if Cstruct.length cs = 0 then malformed "Empty OSC packet";
+    match Cstruct.get_char cs 0 with
+    | '/' -> f acc (view_exn cs)
+    | '#' ->
+      if not (is_bundle_header cs) then malformed "Invalid OSC bundle header";
+      fold_elements go acc cs
+    | c -> malformed "Invalid OSC packet start: %c" c
+  in
+  protect (fun () -> go init cs)
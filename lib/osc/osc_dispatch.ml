@@ -0,0 +1,240 @@
+(** OSC Dispatch - Address-pattern routing for inbound messages
+
+    Handler addresses are compiled segment by segment into a trie:
+
+    - literal segments ([/track]) are looked up in a hash table,
+    - [%d] matches a decimal segment and captures it as an integer,
+    - any other segment using the OSC 1.0 pattern language
+      ([*], [?], [[a-z]], [[!0-9]], [{foo,bar}]) captures the matched text.
+
+    Dispatch walks one trie level per address segment, so its cost depends
+    on the address depth rather than on how many handlers are registered.
+
+    Incoming addresses may themselves be patterns (OSC 1.0 semantics: the
+    sender addresses every method that matches). A pattern segment in an
+    incoming address is expanded over the literal children of the current
+    node; it does not match [%d] or pattern segments of registered handlers.
+*)
+
+open Osc_types
+
+(** {1 Segment patterns} *)
+
+type token =
+  | Lit of char
+  | Any                 (** [?] *)
+  | Star                (** [*] *)
+  | Set of Bytes.t      (** [[...]]: 256-entry membership table *)
+  | Alt of string list  (** [{a,b}] *)
+
+let is_pattern_char = function
+  | '*' | '?' | '[' | ']' | '{' | '}' -> true
+  | _ -> false
+
+let has_pattern s =
+  let rec go i = i < String.length s && (is_pattern_char s.[i] || go (i + 1)) in
+  go 0
+
+(** Compile one address segment; raises [Invalid_argument] on unbalanced brackets *)
+let compile_segment seg =
+  let len = String.length seg in
+  let rec close_at c i =
+    if i >= len then invalid_arg (Printf.sprintf "Osc_dispatch: unclosed pattern in %S" seg)
+    else if seg.[i] = c then i
+    else close_at c (i + 1)
+  in
+  let rec go i acc =
+    if i >= len then List.rev acc
+    else match seg.[i] with
+      | '?' -> go (i + 1) (Any :: acc)
+      | '*' ->
+        (* Consecutive stars are equivalent to one *)
+        (match acc with
+         | Star :: _ -> go (i + 1) acc
+         | _ -> go (i + 1) (Star :: acc))
+      | '[' ->
+        let stop = close_at ']' (i + 1) in
+        let negate = stop > i + 1 && seg.[i + 1] = '!' in
+        let first = if negate then i + 2 else i + 1 in
+        let table = Bytes.make 256 (if negate then '\001' else '\000') in
+        let mark = if negate then '\000' else '\001' in
+        let rec fill j =
+          if j < stop then
+            if j + 2 < stop && seg.[j + 1] = '-' then begin
+              for c = Char.code seg.[j] to Char.code seg.[j + 2] do
+                Bytes.set table c mark
+              done;
+              fill (j + 3)
+            end else begin
+              Bytes.set table (Char.code seg.[j]) mark;
+              fill (j + 1)
+            end
+        in
+        fill first;
+        go (stop + 1) (Set table :: acc)
+      | '{' ->
+        let stop = close_at '}' (i + 1) in
+        let alts = String.split_on_char ',' (String.sub seg (i + 1) (stop - i - 1)) in
+        go (stop + 1) (Alt alts :: acc)
+      | ']' | '}' ->
+        invalid_arg (Printf.sprintf "Osc_dispatch: unbalanced pattern in %S" seg)
+      | c -> go (i + 1) (Lit c :: acc)
+  in
+  go 0 []
+
+let has_prefix_at s i p =
+  let n = String.length p in
+  i + n <= String.length s &&
+  (let rec go k = k >= n || (s.[i + k] = p.[k] && go (k + 1)) in
+   go 0)
+
+(** Match compiled tokens against the whole of [s] *)
+let matches tokens s =
+  let len = String.length s in
+  let rec m toks i =
+    match toks with
+    | [] -> i = len
+    | Lit c :: rest -> i < len && s.[i] = c && m rest (i + 1)
+    | Any :: rest -> i < len && m rest (i + 1)
+    | Set table :: rest ->
+      i < len && Bytes.get table (Char.code s.[i]) <> '\000' && m rest (i + 1)
+    | Alt alts :: rest ->
+      List.exists (fun a -> has_prefix_at s i a && m rest (i + String.length a)) alts
+    | Star :: [] -> true
+    | Star :: rest ->
+      let rec try_from j = j <= len && (m rest j || try_from (j + 1)) in
+      try_from i
+  in
+  m tokens 0
+
+(** Whether the OSC address pattern [pattern] matches [address] *)
+let pattern_matches ~pattern address =
+  let p = String.split_on_char '/' pattern in
+  let a = String.split_on_char '/' address in
+  List.length p = List.length a &&
+  List.for_all2 (fun ps seg ->
+    if has_pattern ps then matches (compile_segment ps) seg else ps = seg) p a
+
+let is_decimal s =
+  let len = String.length s in
+  len > 0 &&
+  (let rec go i = i >= len || (match s.[i] with '0' .. '9' -> go (i + 1) | _ -> false) in
+   go 0)
+
+(** {1 Dispatch trie} *)
+
+(** Value captured by a non-literal segment *)
+type capture =
+  | Int of int        (** [%d] segment *)
+  | Segment of string (** pattern segment *)
+
+type 'a handler = capture list -> 'a -> unit
+
+type 'a node = {
+  literals : (string, 'a node) Hashtbl.t;
+  mutable int_child : 'a node option;
+  mutable patterns : (token list * 'a node) list;
+  mutable handlers : 'a handler list;  (** in registration order *)
+}
+
+(** Dispatcher over payloads of type ['a] *)
+type 'a t = { root : 'a node }
+
+let make_node () =
+  { literals = Hashtbl.create 8; int_child = None; patterns = []; handlers = [] }
+
+(** Create an empty dispatcher *)
+let create () = { root = make_node () }
+
+(** Address segments, without the leading empty segment *)
+let segments address =
+  match String.split_on_char '/' address with
+  | "" :: rest -> rest
+  | _ -> invalid_arg (Printf.sprintf "Osc_dispatch: address must start with '/': %S" address)
+
+let child node seg =
+  if seg = "%d" then
+    match node.int_child with
+    | Some c -> c
+    | None -> let c = make_node () in node.int_child <- Some c; c
+  else if has_pattern seg then
+    (* Identical patterns share a node; compiled tokens are structural values *)
+    let tokens = compile_segment seg in
+    match List.assoc_opt tokens node.patterns with
+    | Some c -> c
+    | None ->
+      let c = make_node () in
+      node.patterns <- node.patterns @ [(tokens, c)];
+      c
+  else
+    match Hashtbl.find_opt node.literals seg with
+    | Some c -> c
+    | None -> let c = make_node () in Hashtbl.replace node.literals seg c; c
+
+(** Register [handler] for an address pattern such as [/track/%d/volume].
+    Captures are passed to the handler in segment order. *)
+let add t address handler =
+  let node = List.fold_left child t.root (segments address) in
+  node.handlers <- node.handlers @ [handler]
+
+(** Remove every handler *)
+let clear t =
+  Hashtbl.reset t.root.literals;
+  t.root.int_child <- None;
+  t.root.patterns <- [];
+  t.root.handlers <- []
+
+(** Segment of an incoming address, compiled before the walk *)
+type incoming =
+  | Text of string
+  | Pattern of token list
+
+(** Raises [Invalid_argument] on a malformed address or pattern *)
+let compile_address address =
+  List.map (fun seg -> if has_pattern seg then Pattern (compile_segment seg) else Text seg)
+    (segments address)
+
+(** Deliver [payload] to every handler matching [address].
+    Returns the number of handlers invoked; a malformed address or
+    pattern matches nothing. *)
+let dispatch t address payload =
+  let count = ref 0 in
+  let rec walk node segs caps =
+    match segs with
+    | [] ->
+      List.iter (fun h -> incr count; h (List.rev caps) payload) node.handlers
+    | Pattern tokens :: rest ->
+      Hashtbl.iter (fun key c -> if matches tokens key then walk c rest caps) node.literals
+    | Text seg :: rest ->
+      (match Hashtbl.find_opt node.literals seg with
+       | Some c -> walk c rest caps
+       | None -> ());
+      (match node.int_child with
+       | Some c when is_decimal seg ->
+         (match int_of_string_opt seg with
+          | Some n -> walk c rest (Int n :: caps)
+          | None -> ())
+       | _ -> ());
+      List.iter (fun (tokens, c) ->
+        if matches tokens seg then walk c rest (Segment seg :: caps)) node.patterns
+  in
+  (match compile_address address with
+   | segs -> walk t.root segs []
+   | exception Invalid_argument _ -> ());
+  !count
+
+(** Dispatch every message of a decoded packet, descending into bundles *)
+let rec dispatch_packet t = function
+  | Message msg -> ignore (dispatch t msg.address msg)
+  | Bundle { elements; _ } -> List.iter (dispatch_packet t) elements
+
+(** Route a transport's inbound datagrams through [t]. Handlers receive
+    undecoded message views, valid only for the duration of the call. *)
+let attach t transport =
+  Osc_transport.on_receive_raw transport (fun data ->
+    match
+      Osc_decode.fold_messages
+        (fun () v -> ignore (dispatch t (Osc_decode.address v) v)) () data
+    with
+    | Ok () -> ()
+    | Error msg -> Logs.warn (fun m -> m "OSC parse error: %s" msg))
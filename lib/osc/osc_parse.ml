@@ -127,6 +127,6 @@ let () = osc_packet_parser := parse_packet
 let parse data =
   parse_string ~consume:All parse_packet data
 
-(** Parse from Cstruct *)
+(** Parse from Cstruct without copying (see [Osc_decode]) *)
 let parse_cstruct cs =
-  parse (Cstruct.to_string cs)
+  Osc_decode.decode cs
@@ -0,0 +1,234 @@
+(** OSC Schedule - Timetag-scheduled bundles
+
+    Queues bundles for future execution and releases them from a fiber:
+
+    - [Timetag] mode sends each bundle [lookahead] seconds early, stamped
+      with the NTP timetag of its due time, so a DAW that honours timetags
+      executes it sample-accurately regardless of network jitter.
+    - [Local] mode is for DAWs that ignore timetags: the bundle is held
+      until its due time and sent as "immediately".
+
+    Musical positions are converted to wall-clock time with a [tempo_map]
+    anchored on a transport reading (position + tempo at a known instant).
+
+    Not domain-safe: use a scheduler from the domain that runs it.
+*)
+
+open Osc_types
+
+(** {1 Tempo map} *)
+
+(** Transport reading: at wall time [anchor_time] the playhead was at
+    [anchor_beat] (quarter notes from the start of bar 1) *)
+type tempo_map = {
+  anchor_time : float;
+  anchor_beat : float;
+  bpm : float;
+  beats_per_bar : int;
+}
+
+(** Anchor a tempo map on a transport position read at [now].
+    Bars and beats are 1-based as displayed by DAWs. *)
+let anchor ~now ~bpm ?(beats_per_bar = 4) ?(ticks_per_beat = 960) ?(tick = 0) ~bar ~beat () =
+  if bpm <= 0.0 then invalid_arg "Osc_schedule.anchor: bpm must be positive";
+  let anchor_beat =
+    float_of_int ((bar - 1) * beats_per_bar + (beat - 1))
+    +. float_of_int tick /. float_of_int ticks_per_beat
+  in
+  { anchor_time = now; anchor_beat; bpm; beats_per_bar }
+
+(** Anchor a tempo map on a transport time in seconds from the start *)
+let anchor_seconds ~now ~bpm ?(beats_per_bar = 4) seconds =
+  if bpm <= 0.0 then invalid_arg "Osc_schedule.anchor_seconds: bpm must be positive";
+  { anchor_time = now; anchor_beat = seconds *. bpm /. 60.0; bpm; beats_per_bar }
+
+(** Wall-clock time at which the playhead reaches [beat] *)
+let time_of_beat map beat =
+  map.anchor_time +. (beat -. map.anchor_beat) *. 60.0 /. map.bpm
+
+(** Wall-clock time of a 1-based bar/beat position *)
+let time_of_position map ~bar ?(beat = 1) () =
+  time_of_beat map (float_of_int ((bar - 1) * map.beats_per_bar + (beat - 1)))
+
+(** {1 Priority queue} *)
+
+type entry = {
+  id : int;
+  due : float;
+  packets : osc_packet list;
+  mutable pos : int;  (** index in the heap, -1 once removed *)
+}
+
+(** Binary min-heap ordered by due time, then by insertion order *)
+type heap = {
+  mutable items : entry array;
+  mutable size : int;
+}
+
+(** Filler for slots past [size], so the heap keeps no removed bundle alive *)
+let vacant = { id = -1; due = infinity; packets = []; pos = -1 }
+
+let earlier a b = a.due < b.due || (a.due = b.due && a.id < b.id)
+
+let set h i e =
+  h.items.(i) <- e;
+  e.pos <- i
+
+let swap h i j =
+  let tmp = h.items.(i) in
+  set h i h.items.(j);
+  set h j tmp
+
+let rec sift_up h i =
+  let parent = (i - 1) / 2 in
+  if i > 0 && earlier h.items.(i) h.items.(parent) then begin
+    swap h i parent;
+    sift_up h parent
+  end
+
+let rec sift_down h i =
+  let l = 2 * i + 1 and r = 2 * i + 2 in
+  let smallest = if l < h.size && earlier h.items.(l) h.items.(i) then l else i in
+  let smallest = if r < h.size && earlier h.items.(r) h.items.(smallest) then r else smallest in
+  if smallest <> i then begin
+    swap h i smallest;
+    sift_down h smallest
+  end
+
+let heap_push h e =
+  if h.size = Array.length h.items then begin
+    let items = Array.make (max 16 (2 * h.size)) vacant in
+    Array.blit h.items 0 items 0 h.size;
+    h.items <- items
+  end;
+  set h h.size e;
+  h.size <- h.size + 1;
+  sift_up h (h.size - 1)
+
+(** Remove the entry at index [i], moving the last entry into its place *)
+let heap_remove h i =
+  let e = h.items.(i) in
+  h.size <- h.size - 1;
+  if i < h.size then begin
+    set h i h.items.(h.size);
+    sift_down h i;
+    sift_up h h.items.(i).pos
+  end;
+  h.items.(h.size) <- vacant;
+  e.pos <- -1;
+  e
+
+let heap_pop h = heap_remove h 0
+
+(** {1 Scheduler} *)
+
+type mode =
+  | Timetag  (** send early with the due time as timetag *)
+  | Local    (** hold until due, send as immediate *)
+
+type t = {
+  heap : heap;
+  by_id : (int, entry) Hashtbl.t;
+  mutable next_id : int;
+  mutable lookahead : float;
+  mode : mode;
+  send : osc_packet -> unit;
+  wake : Eio.Condition.t;
+}
+
+(** Default lookahead for [Timetag] mode (seconds) *)
+let default_lookahead = 0.1
+
+(** Create a scheduler; [send] transmits a packet (usually
+    [Osc_transport.send client]) *)
+let create ?(lookahead = default_lookahead) ?(mode = Timetag) ~send () =
+  {
+    heap = { items = [||]; size = 0 };
+    by_id = Hashtbl.create 16;
+    next_id = 0;
+    lookahead;
+    mode;
+    send;
+    wake = Eio.Condition.create ();
+  }
+
+(** Change the lookahead; takes effect on the next wake-up *)
+let set_lookahead t seconds =
+  t.lookahead <- seconds;
+  Eio.Condition.broadcast t.wake
+
+(** Schedule [packets] as one bundle due at Unix time [time]; returns an id *)
+let at t time packets =
+  let id = t.next_id in
+  t.next_id <- id + 1;
+  let e = { id; due = time; packets; pos = -1 } in
+  heap_push t.heap e;
+  Hashtbl.replace t.by_id id e;
+  Eio.Condition.broadcast t.wake;
+  id
+
+(** Schedule [packets] for a 1-based bar/beat position *)
+let at_position t map ~bar ?beat packets =
+  at t (time_of_position map ~bar ?beat ()) packets
+
+(** Cancel a pending bundle and drop it from the queue; [false] if it was
+    already sent or unknown *)
+let cancel t id =
+  match Hashtbl.find_opt t.by_id id with
+  | Some e ->
+    ignore (heap_remove t.heap e.pos);
+    Hashtbl.remove t.by_id id;
+    Eio.Condition.broadcast t.wake;
+    true
+  | None -> false
+
+(** Number of bundles still pending *)
+let pending t = Hashtbl.length t.by_id
+
+(** When the entry should leave the queue *)
+let release_time t e =
+  match t.mode with
+  | Timetag -> e.due -. t.lookahead
+  | Local -> e.due
+
+(** Send every bundle whose release time has passed at [now]. Returns the
+    release time of the next pending bundle, if any. *)
+let poll t ~now =
+  let rec go () =
+    if t.heap.size = 0 then None
+    else
+      let top = t.heap.items.(0) in
+      if release_time t top <= now then begin
+        ignore (heap_pop t.heap);
+        Hashtbl.remove t.by_id top.id;
+        let timetag =
+          match t.mode with
+          | Timetag -> timetag_of_unix top.due
+          | Local -> timetag_immediately
+        in
+        (try t.send (Bundle { timetag; elements = top.packets })
+         with Eio.Cancel.Cancelled _ as e -> raise e
+            | e -> Logs.warn (fun m -> m "OSC scheduled send failed: %s" (Printexc.to_string e)));
+        go ()
+      end
+      else Some (release_time t top)
+  in
+  go ()
+
+(** Scheduler loop; never returns. Run it in a daemon fiber. *)
+let run t ~clock =
+  let rec loop () =
+    (match poll t ~now:(Eio.Time.now clock) with
+     | None -> Eio.Condition.await_no_mutex t.wake
+     | Some next ->
+       (* A new, earlier bundle or a cancellation interrupts the sleep *)
+       Eio.Fiber.first
+         (fun () -> Eio.Time.sleep_until clock next)
+         (fun () -> Eio.Condition.await_no_mutex t.wake));
+    loop ()
+  in
+  loop ()
+
+(** Start the scheduler loop in a daemon fiber *)
+let start ~sw ~clock t =
+  Eio.Fiber.fork_daemon ~sw (fun () -> run t ~clock)
@@ -1,106 +1,211 @@
-(** OSC Serializer - Pure OCaml using Faraday
+(** OSC Serializer - Single-pass encoder over Cstruct
 
     Serializes OCaml types to OSC 1.0 binary format.
     All data is big-endian and aligned to 4-byte boundaries.
+
+    Packets are written into a growable, reusable [buffer] with native
+    big-endian stores. Bundle element sizes are reserved up front and
+    backpatched once the element is written, so nested bundles are encoded
+    in one pass without intermediate copies. Buffers are pooled so that
+    steady-state sends do not allocate output storage.
 *)
 
-open Faraday
 open Osc_types
 
-(** Write big-endian int32 *)
-let write_be_int32 t v =
-  write_uint8 t (Int32.to_int (Int32.shift_right_logical v 24) land 0xFF);
-  write_uint8 t (Int32.to_int (Int32.shift_right_logical v 16) land 0xFF);
-  write_uint8 t (Int32.to_int (Int32.shift_right_logical v 8) land 0xFF);
-  write_uint8 t (Int32.to_int v land 0xFF)
-
-(** Write big-endian int64 *)
-let write_be_int64 t v =
-  for i = 7 downto 0 do
-    write_uint8 t (Int64.to_int (Int64.shift_right_logical v (i * 8)) land 0xFF)
+(** {1 Buffers} *)
+
+(** Growable output buffer; [pos] is the end of the encoded data *)
+type buffer = {
+  mutable buf : Cstruct.t;
+  mutable pos : int;
+}
+
+let default_size = 1024
+
+(** Create an empty buffer *)
+let create_buffer ?(size = default_size) () =
+  { buf = Cstruct.create (max size 16); pos = 0 }
+
+(** Make room for [n] more bytes, doubling the capacity if needed *)
+let reserve b n =
+  let need = b.pos + n in
+  let cap = Cstruct.length b.buf in
+  if need > cap then begin
+    let rec grow c = if c >= need then c else grow (c * 2) in
+    let buf = Cstruct.create (grow cap) in
+    Cstruct.blit b.buf 0 buf 0 b.pos;
+    b.buf <- buf
+  end
+
+(** Zero [n] bytes at [off]; reused buffers hold stale data *)
+let zero b off n =
+  for i = off to off + n - 1 do
+    Cstruct.set_uint8 b.buf i 0
   done
 
-(** Write big-endian float32 *)
-let write_be_float32 t v =
-  write_be_int32 t (Int32.bits_of_float v)
+let put_int32 b v =
+  reserve b 4;
+  Cstruct.BE.set_uint32 b.buf b.pos v;
+  b.pos <- b.pos + 4
 
-(** Write big-endian float64 *)
-let write_be_float64 t v =
-  write_be_int64 t (Int64.bits_of_float v)
+let put_int64 b v =
+  reserve b 8;
+  Cstruct.BE.set_uint64 b.buf b.pos v;
+  b.pos <- b.pos + 8
 
 (** Write null-terminated string, padded to 4 bytes *)
-let write_osc_string t s =
-  write_string t s;
-  write_uint8 t 0;  (* null terminator *)
-  let total = String.length s + 1 in
-  let padding = padding_for total in
-  for _ = 1 to padding do
-    write_uint8 t 0
-  done
+let put_string b s =
+  let len = String.length s in
+  let total = pad4 (len + 1) in
+  reserve b total;
+  Cstruct.blit_from_string s 0 b.buf b.pos len;
+  zero b (b.pos + len) (total - len);
+  b.pos <- b.pos + total
 
 (** Write blob: int32 size + data + padding *)
-let write_osc_blob t b =
-  let len = Bytes.length b in
-  write_be_int32 t (Int32.of_int len);
-  write_bytes t b;
-  let padding = padding_for len in
-  for _ = 1 to padding do
-    write_uint8 t 0
-  done
+let put_blob b data =
+  let len = Bytes.length data in
+  put_int32 b (Int32.of_int len);
+  let total = pad4 len in
+  reserve b total;
+  Cstruct.blit_from_bytes data 0 b.buf b.pos len;
+  zero b (b.pos + len) (total - len);
+  b.pos <- b.pos + total
+
+(** Write MIDI message: exactly 4 bytes *)
+let put_midi b data =
+  let len = min 4 (Bytes.length data) in
+  reserve b 4;
+  Cstruct.blit_from_bytes data 0 b.buf b.pos len;
+  zero b (b.pos + len) (4 - len);
+  b.pos <- b.pos + 4
+
+(** Write ",<tags>" directly from the argument list *)
+let put_type_tags b args =
+  let total = pad4 (List.length args + 2) in
+  reserve b total;
+  Cstruct.set_char b.buf b.pos ',';
+  let rec tags off = function
+    | [] -> off
+    | arg :: rest ->
+      Cstruct.set_char b.buf off (type_tag_of_arg arg);
+      tags (off + 1) rest
+  in
+  let stop = tags (b.pos + 1) args in
+  zero b stop (b.pos + total - stop);
+  b.pos <- b.pos + total
 
 (** Write single OSC argument *)
-let write_arg t = function
-  | Int32 v -> write_be_int32 t v
-  | Float32 v -> write_be_float32 t v
-  | String v -> write_osc_string t v
-  | Blob v -> write_osc_blob t v
-  | Int64 v -> write_be_int64 t v
-  | Timetag v -> write_be_int64 t v
-  | Double v -> write_be_float64 t v
-  | Char c -> write_be_int32 t (Int32.of_int (Char.code c))
-  | Color v -> write_be_int32 t v
-  | Midi v -> write_bytes t v
+let put_arg b = function
+  | Int32 v -> put_int32 b v
+  | Float32 v -> put_int32 b (Int32.bits_of_float v)
+  | String v -> put_string b v
+  | Blob v -> put_blob b v
+  | Int64 v -> put_int64 b v
+  | Timetag v -> put_int64 b v
+  | Double v -> put_int64 b (Int64.bits_of_float v)
+  | Char c -> put_int32 b (Int32.of_int (Char.code c))
+  | Color v -> put_int32 b v
+  | Midi v -> put_midi b v
   | True | False | Nil | Infinitum -> ()  (* No data for these types *)
 
+let rec put_args b = function
+  | [] -> ()
+  | arg :: rest -> put_arg b arg; put_args b rest
+
 (** Write OSC message *)
-let write_message t { address; args } =
-  write_osc_string t address;
-  write_osc_string t (make_type_tag args);
-  List.iter (write_arg t) args
-
-(** Forward declaration for recursive serialization *)
-let rec write_packet t = function
-  | Message msg -> write_message t msg
-  | Bundle bundle -> write_bundle t bundle
-
-(** Write bundle element with size prefix *)
-and write_bundle_element t packet =
-  (* First serialize to get size *)
-  let inner = create 256 in
-  write_packet inner packet;
-  let data = serialize_to_string inner in
-  write_be_int32 t (Int32.of_int (String.length data));
-  write_string t data
+let put_message b { address; args } =
+  put_string b address;
+  put_type_tags b args;
+  put_args b args
+
+let rec put_packet b = function
+  | Message msg -> put_message b msg
+  | Bundle bundle -> put_bundle b bundle
+
+(** Write bundle element: reserve the size prefix, write, then backpatch *)
+and put_element b packet =
+  reserve b 4;
+  let size_at = b.pos in
+  b.pos <- b.pos + 4;
+  put_packet b packet;
+  Cstruct.BE.set_uint32 b.buf size_at (Int32.of_int (b.pos - size_at - 4))
 
 (** Write OSC bundle *)
-and write_bundle t { timetag; elements } =
-  write_string t "#bundle\x00";
-  write_be_int64 t timetag;
-  List.iter (write_bundle_element t) elements
+and put_bundle b { timetag; elements } =
+  put_string b "#bundle";
+  put_int64 b timetag;
+  put_elements b elements
+
+and put_elements b = function
+  | [] -> ()
+  | el :: rest -> put_element b el; put_elements b rest
+
+(** Encode [packet] into [b], replacing its contents. The result is a view
+    into [b]: it is only valid until [b] is reused or released. *)
+let encode b packet =
+  b.pos <- 0;
+  put_packet b packet;
+  Cstruct.sub b.buf 0 b.pos
+
+(** {1 Buffer pool} *)
+
+(** Buffers grown past this size are dropped instead of pooled *)
+let max_pooled_size = 65536
+
+let max_pooled = 32
+let pool_lock = Mutex.create ()
+let pool = Array.make max_pooled (create_buffer ~size:16 ())
+let pool_len = ref 0
+
+(** Take a buffer from the pool, or create one *)
+let acquire () =
+  Mutex.lock pool_lock;
+  if !pool_len > 0 then begin
+    decr pool_len;
+    let b = pool.(!pool_len) in
+    Mutex.unlock pool_lock;
+    b
+  end else begin
+    Mutex.unlock pool_lock;
+    create_buffer ()
+  end
+
+(** Return a buffer to the pool *)
+let release b =
+  if Cstruct.length b.buf <= max_pooled_size then begin
+    Mutex.lock pool_lock;
+    if !pool_len < max_pooled then begin
+      pool.(!pool_len) <- b;
+      incr pool_len
+    end;
+    Mutex.unlock pool_lock
+  end
+
+(** Run [f] with a pooled buffer *)
+let with_buffer f =
+  let b = acquire () in
+  match f b with
+  | v -> release b; v
+  | exception e -> release b; raise e
+
+(** {1 Convenience} *)
 
 (** Main entry point: serialize OSC packet to string *)
 let serialize packet =
-  let t = create 256 in
-  write_packet t packet;
-  serialize_to_string t
+  with_buffer (fun b -> Cstruct.to_string (encode b packet))
 
 (** Serialize to bytes *)
 let serialize_bytes packet =
-  Bytes.of_string (serialize packet)
+  with_buffer (fun b -> Cstruct.to_bytes (encode b packet))
 
-(** Serialize to Cstruct *)
+(** Serialize to a fresh Cstruct *)
 let serialize_cstruct packet =
-  Cstruct.of_string (serialize packet)
+  with_buffer (fun b ->
+    let cs = encode b packet in
+    let out = Cstruct.create_unsafe (Cstruct.length cs) in
+    Cstruct.blit cs 0 out 0 (Cstruct.length cs);
+    out)
 
 (** Convenience: serialize message directly *)
 let serialize_message address args =
@@ -0,0 +1,272 @@
+(** OSC Stream - OSC 1.1 over TCP and Unix stream sockets
+
+    Stream transports need framing to delimit packets:
+
+    - [Slip]: RFC 1055 SLIP with an END byte before and after each packet
+      (the OSC 1.1 recommendation),
+    - [Length_prefix]: each packet preceded by its size as a big-endian
+      int32 (OSC 1.0 stream convention).
+
+    Frames are decoded in place in the receive buffer: length-prefixed
+    frames are handed out as sub-views, SLIP frames are unescaped over the
+    bytes they were read from. Packets are encoded into pooled buffers, so
+    neither direction copies per packet beyond SLIP escaping.
+*)
+
+open Osc_types
+
+type framing = Slip | Length_prefix
+
+let slip_end = '\xC0'
+let slip_esc = '\xDB'
+let slip_esc_end = '\xDC'
+let slip_esc_esc = '\xDD'
+
+(** Frames larger than this close the connection *)
+let max_frame_size = 16 * 1024 * 1024
+
+(** OSC stream client *)
+type 'a stream = {
+  flow : 'a Eio.Net.stream_socket;
+  framing : framing;
+  write_lock : Eio.Mutex.t;
+  header : Cstruct.t;                (** length prefix scratch *)
+  escaped : Osc_serialize.buffer;    (** SLIP output scratch *)
+  mutable receive_handler : (osc_packet -> unit) option;
+  mutable raw_handler : (Cstruct.t -> unit) option;
+  mutable broken : bool;             (** a write was interrupted mid-frame *)
+}
+
+(** Existential wrapper for stream *)
+type t = Stream : 'a stream -> t
+
+let of_flow ~framing flow =
+  Stream {
+    flow;
+    framing;
+    write_lock = Eio.Mutex.create ();
+    header = Cstruct.create 4;
+    escaped = Osc_serialize.create_buffer ();
+    receive_handler = None;
+    raw_handler = None;
+    broken = false;
+  }
+
+(** Connect over TCP to host:port *)
+let connect_tcp ~sw ~net ~framing ~host ~port =
+  let addr =
+    match Eio.Net.getaddrinfo_stream ~service:(string_of_int port) net host with
+    | addr :: _ -> addr
+    | [] -> invalid_arg ("Osc_stream.connect_tcp: could not resolve host: " ^ host)
+  in
+  of_flow ~framing (Eio.Net.connect ~sw net addr)
+
+(** Connect to a Unix domain socket *)
+let connect_unix ~sw ~net ~framing path =
+  of_flow ~framing (Eio.Net.connect ~sw net (`Unix path))
+
+(** SLIP-escape [payload] into [b], with END on both sides *)
+let slip_encode (b : Osc_serialize.buffer) payload =
+  let open Osc_serialize in
+  let len = Cstruct.length payload in
+  b.pos <- 0;
+  (* Worst case every byte is escaped *)
+  Osc_serialize.reserve b (2 * len + 2);
+  let out = b.buf in
+  Cstruct.set_char out 0 slip_end;
+  let rec go i o =
+    if i >= len then o
+    else match Cstruct.get_char payload i with
+      | c when c = slip_end ->
+        Cstruct.set_char out o slip_esc;
+        Cstruct.set_char out (o + 1) slip_esc_end;
+        go (i + 1) (o + 2)
+      | c when c = slip_esc ->
+        Cstruct.set_char out o slip_esc;
+        Cstruct.set_char out (o + 1) slip_esc_esc;
+        go (i + 1) (o + 2)
+      | c ->
+        Cstruct.set_char out o c;
+        go (i + 1) (o + 1)
+  in
+  let o = go 0 1 in
+  Cstruct.set_char out o slip_end;
+  b.pos <- o + 1;
+  Cstruct.sub out 0 b.pos
+
+(** Send OSC packet as one frame. The write can be cancelled (e.g. by a
+    request deadline while the peer is stalled); a frame cut short that
+    way breaks the framing, so later sends fail. *)
+let send (Stream s) packet =
+  Osc_serialize.with_buffer (fun b ->
+    let payload = Osc_serialize.encode b packet in
+    Eio.Mutex.lock s.write_lock;
+    Fun.protect ~finally:(fun () -> Eio.Mutex.unlock s.write_lock) (fun () ->
+      if s.broken then failwith "Osc_stream.send: stream broken by an interrupted write";
+      try
+        match s.framing with
+        | Length_prefix ->
+          Cstruct.BE.set_uint32 s.header 0 (Int32.of_int (Cstruct.length payload));
+          Eio.Flow.write s.flow [s.header; payload]
+        | Slip ->
+          Eio.Flow.write s.flow [slip_encode s.escaped payload]
+      with exn ->
+        s.broken <- true;
+        raise exn))
+
+(** Set receive handler *)
+let on_receive (Stream s) handler =
+  s.receive_handler <- Some handler
+
+(** Set raw receive handler; the frame view is only valid during the call *)
+let on_receive_raw (Stream s) handler =
+  s.raw_handler <- Some handler
+
+let deliver s frame =
+  (match s.raw_handler with
+   | Some handler -> handler frame
+   | None -> ());
+  match s.receive_handler with
+  | None -> ()
+  | Some handler ->
+    match Osc_decode.decode frame with
+    | Ok packet -> handler packet
+    | Error msg -> Logs.warn (fun m -> m "OSC parse error: %s" msg)
+
+(** Incremental frame decoder over a growable buffer.
+    Bytes [[0, len)] are buffered; [pos] is the next unread byte. For SLIP,
+    [frame_start, out)] holds the unescaped bytes of the current frame
+    ([out <= pos], so unescaping can overwrite consumed input). *)
+type decoder = {
+  framing : framing;
+  mutable buf : Cstruct.t;
+  mutable len : int;
+  mutable pos : int;
+  mutable frame_start : int;
+  mutable out : int;
+  mutable escaping : bool;
+}
+
+let create_decoder ?(size = 65536) framing =
+  { framing; buf = Cstruct.create size; len = 0; pos = 0; frame_start = 0; out = 0; escaping = false }
+
+exception Frame_too_large of int
+
+(** Consume buffered bytes, calling [emit] on each complete frame *)
+let decode_frames d emit =
+  match d.framing with
+  | Length_prefix ->
+    let rec go () =
+      if d.len - d.pos >= 4 then begin
+        let size = Int32.to_int (Cstruct.BE.get_uint32 d.buf d.pos) land 0xFFFF_FFFF in
+        if size > max_frame_size then raise (Frame_too_large size);
+        if d.len - d.pos - 4 >= size then begin
+          emit (Cstruct.sub d.buf (d.pos + 4) size);
+          d.pos <- d.pos + 4 + size;
+          go ()
+        end
+      end
+    in
+    go ()
+  | Slip ->
+    while d.pos < d.len do
+      let c = Cstruct.get_char d.buf d.pos in
+      d.pos <- d.pos + 1;
+      if d.escaping then begin
+        d.escaping <- false;
+        let c = if c = slip_esc_end then slip_end else if c = slip_esc_esc then slip_esc else c in
+        Cstruct.set_char d.buf d.out c;
+        d.out <- d.out + 1
+      end
+      else if c = slip_end then begin
+        (* Empty frames (back-to-back END bytes) are skipped *)
+        if d.out > d.frame_start then
+          emit (Cstruct.sub d.buf d.frame_start (d.out - d.frame_start));
+        d.frame_start <- d.pos;
+        d.out <- d.pos
+      end
+      else if c = slip_esc then d.escaping <- true
+      else begin
+        Cstruct.set_char d.buf d.out c;
+        d.out <- d.out + 1
+      end
+    done;
+    if d.out - d.frame_start > max_frame_size then raise (Frame_too_large (d.out - d.frame_start))
+
+(** Move undecoded bytes to the front and make room for the next read *)
+let compact d =
+  (match d.framing with
+   | Length_prefix ->
+     let rest = d.len - d.pos in
+     if d.pos > 0 then Cstruct.blit d.buf d.pos d.buf 0 rest;
+     d.len <- rest;
+     d.pos <- 0
+   | Slip ->
+     (* All input is consumed; keep the partial unescaped frame *)
+     let partial = d.out - d.frame_start in
+     if d.frame_start > 0 then Cstruct.blit d.buf d.frame_start d.buf 0 partial;
+     d.len <- partial;
+     d.pos <- partial;
+     d.frame_start <- 0;
+     d.out <- partial);
+  if d.len = Cstruct.length d.buf then begin
+    let bigger = Cstruct.create (2 * Cstruct.length d.buf) in
+    Cstruct.blit d.buf 0 bigger 0 d.len;
+    d.buf <- bigger
+  end
+
+(** Append [chunk] and emit every frame it completes. Frame views are
+    only valid during [emit]. Raises [Frame_too_large]. *)
+let feed d chunk emit =
+  let n = Cstruct.length chunk in
+  let off = ref 0 in
+  while !off < n do
+    let room = Cstruct.length d.buf - d.len in
+    let k = min room (n - !off) in
+    Cstruct.blit chunk !off d.buf d.len k;
+    d.len <- d.len + k;
+    off := !off + k;
+    decode_frames d emit;
+    compact d
+  done
+
+(** Frame a single encoded packet (allocates; [send] uses scratch buffers) *)
+let frame framing payload =
+  match framing with
+  | Length_prefix ->
+    let len = Cstruct.length payload in
+    let out = Cstruct.create (4 + len) in
+    Cstruct.BE.set_uint32 out 0 (Int32.of_int len);
+    Cstruct.blit payload 0 out 4 len;
+    out
+  | Slip ->
+    let b = Osc_serialize.create_buffer ~size:(2 * Cstruct.length payload + 2) () in
+    let framed = slip_encode b payload in
+    let out = Cstruct.create (Cstruct.length framed) in
+    Cstruct.blit framed 0 out 0 (Cstruct.length framed);
+    out
+
+(** Receive loop - returns when the peer closes the connection or sends
+    a frame over [max_frame_size] *)
+let receive_loop (Stream s) =
+  let d = create_decoder s.framing in
+  let rec loop () =
+    (* Read straight into the decoder's buffer *)
+    match Eio.Flow.single_read s.flow (Cstruct.sub d.buf d.len (Cstruct.length d.buf - d.len)) with
+    | n ->
+      d.len <- d.len + n;
+      (match decode_frames d (deliver s); compact d with
+       | () -> loop ()
+       | exception Frame_too_large size ->
+         Logs.err (fun m -> m "OSC stream frame of %d bytes exceeds limit; stopping receive" size))
+    | exception End_of_file -> ()
+  in
+  loop ()
+
+(** Start receiving in background fiber *)
+let start_receiving ~sw t =
+  Eio.Fiber.fork ~sw (fun () -> receive_loop t)
+
+(** Close connection *)
+let close (Stream s) =
+  Eio.Flow.close s.flow
@@ -1,6 +1,7 @@
-(** OSC Transport - UDP socket using Eio
+(** OSC Transport - UDP, TCP and Unix sockets using Eio
 
-    Sends and receives OSC packets over UDP using Eio direct-style I/O.
+    Sends and receives OSC packets using Eio direct-style I/O. UDP is the
+    default; stream transports (see [Osc_stream]) expose the same API.
 *)
 
 open Osc_types
@@ -10,10 +11,22 @@ type 'a client = {
   socket : 'a Eio.Net.datagram_socket;
   remote_addr : Eio.Net.Sockaddr.datagram;
   mutable receive_handler : (osc_packet -> unit) option;
+  mutable raw_handler : (Cstruct.t -> unit) option;
 }
 
-(** Existential wrapper for client *)
-type t = Client : 'a client -> t
+(** Transport handle: UDP client or framed stream *)
+type t =
+  | Client : 'a client -> t
+  | Stream of Osc_stream.t
+
+(** Stream framing *)
+type framing = Osc_stream.framing = Slip | Length_prefix
+
+(** Where and how to reach an OSC peer *)
+type endpoint =
+  | Udp of { host : string; port : int }
+  | Tcp of { host : string; port : int; framing : framing }
+  | Unix_socket of { path : string; framing : framing }
 
 (** Create OSC client connected to remote host:port *)
 let create ~sw ~net ~host ~port =
@@ -24,49 +37,82 @@ let create ~sw ~net ~host ~port =
     | addr :: _ -> addr
     | [] -> invalid_arg ("Osc_transport.create: could not resolve host: " ^ host)
   in
-  Client { socket; remote_addr; receive_handler = None }
+  Client { socket; remote_addr; receive_handler = None; raw_handler = None }
+
+(** Connect to an endpoint over its transport *)
+let connect ~sw ~net = function
+  | Udp { host; port } -> create ~sw ~net ~host ~port
+  | Tcp { host; port; framing } -> Stream (Osc_stream.connect_tcp ~sw ~net ~framing ~host ~port)
+  | Unix_socket { path; framing } -> Stream (Osc_stream.connect_unix ~sw ~net ~framing path)
 
 (** Send OSC packet *)
-let send (Client t) packet =
-  let data = Osc_serialize.serialize packet in
-  let buf = Cstruct.of_string data in
-  Eio.Net.send t.socket ~dst:t.remote_addr [buf]
+let send t packet =
+  match t with
+  | Client t ->
+    let b = Osc_serialize.acquire () in
+    (match Eio.Net.send t.socket ~dst:t.remote_addr [Osc_serialize.encode b packet] with
+     | () -> Osc_serialize.release b
+     | exception e -> Osc_serialize.release b; raise e)
+  | Stream s -> Osc_stream.send s packet
 
 (** Send OSC message (convenience) *)
 let send_message t address args =
   send t (Message { address; args })
 
 (** Send multiple messages as bundle *)
-let send_bundle t packets =
-  send t (Bundle { timetag = timetag_immediately; elements = packets })
+let send_bundle ?(timetag = timetag_immediately) t packets =
+  send t (Bundle { timetag; elements = packets })
 
 (** Set receive handler *)
-let on_receive (Client t) handler =
-  t.receive_handler <- Some handler
+let on_receive t handler =
+  match t with
+  | Client t -> t.receive_handler <- Some handler
+  | Stream s -> Osc_stream.on_receive s handler
+
+(** Set raw receive handler. The datagram view is only valid during the
+    call; decode lazily with [Osc_decode.view]/[Osc_decode.fold_messages]. *)
+let on_receive_raw t handler =
+  match t with
+  | Client t -> t.raw_handler <- Some handler
+  | Stream s -> Osc_stream.on_receive_raw s handler
 
 (** Receive loop - call in a fiber *)
-let receive_loop (Client t) =
+let receive_loop (t : _ client) =
   let buf = Cstruct.create 65536 in  (* Max UDP packet size *)
   while true do
     let addr, len = Eio.Net.recv t.socket buf in
     ignore addr;
-    let data = Cstruct.sub buf 0 len |> Cstruct.to_string in
-    match Osc_parse.parse data with
-    | Ok packet ->
-      (match t.receive_handler with
-       | Some handler -> handler packet
-       | None -> ())
-    | Error msg ->
-      Logs.warn (fun m -> m "OSC parse error: %s" msg)
+    let data = Cstruct.sub buf 0 len in
+    (match t.raw_handler with
+     | Some handler -> handler data
+     | None -> ());
+    match t.receive_handler with
+    | None -> ()
+    | Some handler ->
+      match Osc_decode.decode data with
+      | Ok packet -> handler packet
+      | Error msg ->
+        Logs.warn (fun m -> m "OSC parse error: %s" msg)
   done
 
 (** Start receiving in background fiber *)
 let start_receiving ~sw t =
-  Eio.Fiber.fork ~sw (fun () -> receive_loop t)
+  match t with
+  | Client c -> Eio.Fiber.fork ~sw (fun () -> receive_loop c)
+  | Stream s -> Osc_stream.start_receiving ~sw s
+
+(** Stream framing codec *)
+module Frame = struct
+  type decoder = Osc_stream.decoder
+  let create ?size framing = Osc_stream.create_decoder ?size framing
+  let feed = Osc_stream.feed
+  let frame = Osc_stream.frame
+end
 
 (** Close connection *)
-let close (Client t) =
-  Eio.Net.close t.socket
+let close = function
+  | Client t -> Eio.Net.close t.socket
+  | Stream s -> Osc_stream.close s
 
 (** Common OSC addresses for DAWs *)
 module Addr = struct
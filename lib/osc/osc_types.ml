@@ -68,10 +68,10 @@ let type_tag_of_arg = function
 
 (** Generate type tag string from arguments *)
 let make_type_tag args =
-  let tags = List.map type_tag_of_arg args in
-  String.init (List.length tags + 1) (function
-    | 0 -> ','
-    | n -> List.nth tags (n - 1))
+  let b = Bytes.create (List.length args + 1) in
+  Bytes.set b 0 ',';
+  List.iteri (fun i arg -> Bytes.set b (i + 1) (type_tag_of_arg arg)) args;
+  Bytes.unsafe_to_string b
 
 (** Helper: pad size to 4-byte boundary *)
 let pad4 n =
@@ -88,3 +88,23 @@ let message address args = Message { address; args }
 
 (** Create a bundle with immediate execution *)
 let bundle_now elements = Bundle { timetag = timetag_immediately; elements }
+
+(** Seconds between the NTP epoch (1900) and the Unix epoch (1970) *)
+let ntp_unix_offset = 2208988800.0
+
+(** NTP timetag for a Unix timestamp: 32.32 fixed-point seconds since 1900 *)
+let timetag_of_unix t =
+  let ntp = t +. ntp_unix_offset in
+  let secs = Float.of_int (int_of_float ntp) in
+  let frac = Int64.of_float ((ntp -. secs) *. 4294967296.0) in
+  let frac = if frac > 0xFFFFFFFFL then 0xFFFFFFFFL else frac in
+  Int64.(logor (shift_left (of_float secs) 32) frac)
+
+(** Unix timestamp of an NTP timetag *)
+let unix_of_timetag tt =
+  let secs = Int64.shift_right_logical tt 32 in
+  let frac = Int64.logand tt 0xFFFFFFFFL in
+  Int64.to_float secs +. Int64.to_float frac /. 4294967296.0 -. ntp_unix_offset
+
+(** Create a bundle executed at a Unix timestamp *)
+let bundle_at time elements = Bundle { timetag = timetag_of_unix time; elements }
@@ -0,0 +1,266 @@
+(** Broadcast - Slow-consumer-safe fan-out to SSE clients
+
+    Every client has its own bounded outbound queue drained by its own
+    writer fiber, so publishing never blocks on a socket and one stalled
+    client cannot delay the others. What happens when a client falls
+    behind depends on the event class:
+
+    - [Notification]: never dropped. If the client's queue is full the
+      client is evicted (its writer is cancelled and the connection
+      closed) so it reconnects instead of silently missing messages.
+    - [Meter]: coalesced. Each client has a single meter slot that a new
+      frame overwrites, so a slow client gets the latest frame rather
+      than a backlog. Queued notifications are written before it.
+    - [Keepalive]: only sent to clients with nothing queued.
+
+    Notifications get ids from a [Replay] ring holding their encoded
+    bytes, so a client reconnecting with [Last-Event-ID] is sent just the
+    notifications it missed, or a state snapshot if they have left the
+    ring.
+
+    Keepalives come from one shared timer wheel rather than a sleep loop
+    per connection: clients are spread over [keepalive / resolution]
+    slots and each tick visits one slot, pinging the clients in it that
+    have written nothing for a full period.
+
+    All operations run on the domain that owns the clients' fibers.
+*)
+
+type event_class = Notification | Meter | Keepalive
+
+let class_index = function Notification -> 0 | Meter -> 1 | Keepalive -> 2
+
+exception Evicted
+
+type client = {
+  id : int;
+  queue : string Queue.t;             (** notifications and keepalives *)
+  mutable meter : string option;      (** coalesced meter slot *)
+  wake : Eio.Condition.t;
+  slot : int;                         (** keepalive wheel slot *)
+  mutable last_active : int;          (** wheel tick of the last write *)
+  mutable closed : bool;
+  mutable cancel : unit -> unit;      (** abort a write in progress *)
+}
+
+type t = {
+  capacity : int;                     (** queued events per client *)
+  resolution : float;                 (** seconds per wheel tick *)
+  clients : (int, client) Hashtbl.t;
+  wheel : (int, client) Hashtbl.t array;
+  mutable tick : int;
+  mutable next_id : int;
+  published : int array;              (** per event class *)
+  mutable delivered : int;
+  mutable coalesced : int;
+  mutable keepalives : int;           (** keepalives queued *)
+  mutable evictions : int;
+  mutable write_errors : int;
+  mutable high_water : int;           (** deepest queue seen *)
+  ring : Replay.t;                    (** recent notifications *)
+  mutable replayed : int;
+  mutable snapshots : int;
+}
+
+(** Create a hub. [capacity] bounds each client's queue (default 64);
+    the last [replay] notifications are kept for resumption (default
+    256); keepalives go out after [keepalive] idle seconds (default 15),
+    checked every [resolution] seconds (default 1). *)
+let create ?(capacity = 64) ?(replay = 256) ?(keepalive = 15.0) ?(resolution = 1.0) () =
+  if capacity < 1 then invalid_arg "Broadcast.create: capacity must be positive";
+  if resolution <= 0.0 || keepalive < resolution then invalid_arg "Broadcast.create: keepalive";
+  let slots = max 1 (int_of_float (Float.round (keepalive /. resolution))) in
+  {
+    capacity;
+    resolution;
+    clients = Hashtbl.create 16;
+    wheel = Array.init slots (fun _ -> Hashtbl.create 4);
+    tick = 0;
+    next_id = 0;
+    published = Array.make 3 0;
+    delivered = 0;
+    coalesced = 0;
+    keepalives = 0;
+    evictions = 0;
+    write_errors = 0;
+    high_water = 0;
+    ring = Replay.create ~capacity:replay ();
+    replayed = 0;
+    snapshots = 0;
+  }
+
+let slots t = Array.length t.wheel
+
+(** Connected clients *)
+let clients t = Hashtbl.length t.clients
+
+let depth c = Queue.length c.queue + (if Option.is_some c.meter then 1 else 0)
+
+let detach t c =
+  if Hashtbl.mem t.clients c.id then begin
+    Hashtbl.remove t.clients c.id;
+    Hashtbl.remove t.wheel.(c.slot) c.id
+  end;
+  c.closed <- true;
+  Eio.Condition.broadcast c.wake
+
+let evict t c =
+  t.evictions <- t.evictions + 1;
+  detach t c;
+  c.cancel ()
+
+let note_depth t c =
+  let d = depth c in
+  if d > t.high_water then t.high_water <- d
+
+(** Queue [text] for every client according to its class's policy.
+    Notifications are given the next replay id. *)
+let publish t cls text =
+  t.published.(class_index cls) <- t.published.(class_index cls) + 1;
+  let text =
+    match cls with
+    | Notification -> Replay.push t.ring (fun id -> Printf.sprintf "id: %d\n%s" id text)
+    | Meter | Keepalive -> text
+  in
+  let overflowed = ref [] in
+  Hashtbl.iter (fun _ c ->
+    match cls with
+    | Notification ->
+      if Queue.length c.queue >= t.capacity then overflowed := c :: !overflowed
+      else begin
+        Queue.add text c.queue;
+        note_depth t c;
+        Eio.Condition.broadcast c.wake
+      end
+    | Meter ->
+      if Option.is_some c.meter then t.coalesced <- t.coalesced + 1;
+      c.meter <- Some text;
+      note_depth t c;
+      Eio.Condition.broadcast c.wake
+    | Keepalive ->
+      if depth c = 0 then begin
+        Queue.add text c.queue;
+        t.keepalives <- t.keepalives + 1;
+        Eio.Condition.broadcast c.wake
+      end) t.clients;
+  List.iter (evict t) !overflowed
+
+(** Next event for a client's writer: [Some (Some text)], [Some None]
+    once closed, [None] to keep waiting *)
+let next c =
+  if c.closed then Some None
+  else if not (Queue.is_empty c.queue) then Some (Some (Queue.pop c.queue))
+  else match c.meter with
+    | Some text -> c.meter <- None; Some (Some text)
+    | None -> None
+
+(** Catch-up for a client resuming after [id]: the missed notifications,
+    or a [snapshot] event (data from [snapshot]) carrying the latest id *)
+let resume t ?snapshot id =
+  match Replay.since t.ring id, snapshot with
+  | Replay.Missed events, _ ->
+    t.replayed <- t.replayed + List.length events;
+    events
+  | Replay.Snapshot, Some snapshot ->
+    t.snapshots <- t.snapshots + 1;
+    [Printf.sprintf "event: snapshot\nid: %d\ndata: %s\n\n" (Replay.last_id t.ring) (snapshot ())]
+  | Replay.Snapshot, None -> []
+
+(** Register a client writing with [write] and run its writer in the
+    calling fiber. A client reconnecting with [last_event_id] first gets
+    what it missed (see [resume]). Returns when the client is evicted or
+    [write] fails with [Eio.Io] or [End_of_file]; the client is
+    unregistered either way. *)
+let serve ?last_event_id ?snapshot t write =
+  t.next_id <- t.next_id + 1;
+  let c = {
+    id = t.next_id;
+    queue = Queue.create ();
+    meter = None;
+    wake = Eio.Condition.create ();
+    slot = t.tick mod slots t;
+    last_active = t.tick;
+    closed = false;
+    cancel = ignore;
+  } in
+  Option.iter (fun id -> List.iter (fun e -> Queue.add e c.queue) (resume t ?snapshot id)) last_event_id;
+  Hashtbl.replace t.clients c.id c;
+  Hashtbl.replace t.wheel.(c.slot) c.id c;
+  Fun.protect ~finally:(fun () -> c.cancel <- ignore; detach t c) @@ fun () ->
+  try
+    Eio.Switch.run @@ fun sw ->
+    c.cancel <- (fun () -> Eio.Switch.fail sw Evicted);
+    let rec loop () =
+      match Eio.Condition.loop_no_mutex c.wake (fun () -> next c) with
+      | None -> ()
+      | Some text ->
+        write text;
+        c.last_active <- t.tick;
+        t.delivered <- t.delivered + 1;
+        loop ()
+    in
+    loop ()
+  with
+  | Evicted -> ()
+  | Eio.Io _ | End_of_file -> t.write_errors <- t.write_errors + 1
+
+let ping now = Printf.sprintf "event: ping\ndata: %s\n\n" (string_of_float now)
+
+(** Advance the keepalive wheel one tick and ping the idle clients in
+    the slot it reaches *)
+let keepalive_tick t ~now =
+  t.tick <- t.tick + 1;
+  let period = slots t in
+  Hashtbl.iter (fun _ c ->
+    if t.tick - c.last_active >= period && depth c = 0 then begin
+      Queue.add (ping now) c.queue;
+      t.keepalives <- t.keepalives + 1;
+      Eio.Condition.broadcast c.wake
+    end) t.wheel.(t.tick mod period)
+
+(** Drive the keepalive wheel forever; run in a daemon fiber *)
+let run_keepalive t ~clock =
+  let rec loop () =
+    Eio.Time.sleep clock t.resolution;
+    keepalive_tick t ~now:(Eio.Time.now clock);
+    loop ()
+  in
+  loop ()
+
+(** Disconnect every client; their [serve] calls return *)
+let close t =
+  List.iter (detach t) (Hashtbl.fold (fun _ c acc -> c :: acc) t.clients [])
+
+(** Queued events across all clients *)
+let total_depth t = Hashtbl.fold (fun _ c acc -> acc + depth c) t.clients 0
+
+(** Wait until every queue is empty, or [timeout] seconds *)
+let flush t ~clock ~timeout =
+  let deadline = Eio.Time.now clock +. timeout in
+  while total_depth t > 0 && Eio.Time.now clock < deadline do
+    Eio.Time.sleep clock 0.01
+  done
+
+(** Clients, queue depths and per-policy counters *)
+let stats t =
+  let max_depth = Hashtbl.fold (fun _ c acc -> max acc (depth c)) t.clients 0 in
+  `Assoc [
+    ("clients", `Int (clients t));
+    ("queued", `Int (total_depth t));
+    ("max_depth", `Int max_depth);
+    ("high_water", `Int t.high_water);
+    ("capacity", `Int t.capacity);
+    ("published", `Assoc [
+      ("notification", `Int t.published.(0));
+      ("meter", `Int t.published.(1));
+      ("keepalive", `Int t.published.(2));
+    ]);
+    ("delivered", `Int t.delivered);
+    ("coalesced", `Int t.coalesced);
+    ("keepalives", `Int t.keepalives);
+    ("evictions", `Int t.evictions);
+    ("write_errors", `Int t.write_errors);
+    ("last_event_id", `Int (Replay.last_id t.ring));
+    ("replayed", `Int t.replayed);
+    ("snapshots", `Int t.snapshots);
+  ]
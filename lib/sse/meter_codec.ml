@@ -0,0 +1,351 @@
+(** Meter Codec - Compact delta encoding of meter frames
+
+    Each tick's frames are packed into one binary packet. Values are
+    quantized to int16 (dB and LUFS in 0.1 steps, correlation, balance and
+    width in 0.001 steps) and sent as the difference from the value last
+    sent for that track, zigzag varint coded, so a steady meter costs a
+    byte or two per field and an unchanged track costs nothing: only
+    changed fields of changed tracks are written. Every
+    [keyframe_interval] ticks, or on [force_keyframe] (a new subscriber),
+    a keyframe carries every present field of every track as an absolute
+    value. A track's first appearance is a delta from all-absent.
+
+    Packet layout (multi-byte values little-endian):
+
+    {v
+    'M' version flags(bit 0 = keyframe) varint:sequence f64:timestamp
+    varint:tracks { varint:track_index varint:field_mask { zigzag:value }* }*
+    v}
+
+    Field order: output L rms/peak, R rms/peak, mono rms/peak (0-5), the
+    same for input (6-11), correlation, balance, mid/side dB, width, mono
+    loss dB (12-16), momentary, short-term and integrated LUFS (17-19).
+    Missing values use the [absent] sentinel.
+*)
+
+let magic = 'M'
+let version = 1
+let fields = 20
+
+(** Quantized value of a missing field *)
+let absent = -32768
+
+(** {1 Quantization} *)
+
+let[@inline] quantize scale v =
+  if Float.is_nan v then absent
+  else if not (Float.is_finite v) then (if v > 0.0 then 32767 else -32767)
+  else begin
+    let q = int_of_float (Float.round (v *. scale)) in
+    if q > 32767 then 32767 else if q < -32767 then -32767 else q
+  end
+
+let[@inline] dequantize scale q = Float.of_int q /. scale
+
+let db_scale = 10.0
+let unit_scale = 1000.0
+
+let scale_of_field i =
+  match i with
+  | 12 | 13 | 15 -> unit_scale
+  | _ -> db_scale
+
+let opt_quantize scale = function
+  | Some v -> quantize scale v
+  | None -> absent
+
+(** Fill [q] with the quantized fields of [frame] *)
+let quantize_frame ~include_input q (frame : Metering.meter_frame) =
+  let channel base (c : Metering.channel_meter) =
+    q.(base) <- quantize db_scale c.rms_db;
+    q.(base + 1) <- quantize db_scale c.peak_db
+  in
+  let stereo base (s : Metering.stereo_meter) =
+    channel base s.left;
+    channel (base + 2) s.right;
+    channel (base + 4) s.mono_sum
+  in
+  stereo 0 frame.output;
+  (match frame.input with
+   | Some input when include_input -> stereo 6 input
+   | _ -> Array.fill q 6 6 absent);
+  (match frame.field with
+   | Some f ->
+     q.(12) <- quantize unit_scale f.correlation;
+     q.(13) <- quantize unit_scale f.balance;
+     q.(14) <- quantize db_scale f.mid_side_db;
+     q.(15) <- quantize unit_scale f.width;
+     q.(16) <- quantize db_scale f.mono_loss_db
+   | None -> Array.fill q 12 5 absent);
+  match frame.loudness with
+  | Some r ->
+    q.(17) <- opt_quantize db_scale r.momentary;
+    q.(18) <- opt_quantize db_scale r.short_term;
+    q.(19) <- opt_quantize db_scale r.integrated
+  | None -> Array.fill q 17 3 absent
+
+(** {1 Varints} *)
+
+let add_varint buf n =
+  let n = ref n in
+  while !n >= 0x80 do
+    Buffer.add_char buf (Char.unsafe_chr (0x80 lor (!n land 0x7f)));
+    n := !n lsr 7
+  done;
+  Buffer.add_char buf (Char.unsafe_chr !n)
+
+let[@inline] zigzag n = (n lsl 1) lxor (n asr (Sys.int_size - 1))
+let[@inline] unzigzag n = (n lsr 1) lxor (- (n land 1))
+
+(** {1 Encoder} *)
+
+type encoder = {
+  include_input : bool;
+  keyframe_interval : int;
+  last : (int, int array) Hashtbl.t;  (** track -> values last sent *)
+  scratch : int array;
+  body : Buffer.t;                    (** track records of the packet being built *)
+  buf : Buffer.t;
+  mutable sequence : int;
+  mutable ticks : int;                (** ticks since the last keyframe *)
+  mutable keyframe_due : bool;
+}
+
+(** Create an encoder. The first packet is a keyframe. *)
+let create_encoder ?(include_input = false) ?(keyframe_interval = 60) () =
+  if keyframe_interval <= 0 then invalid_arg "Meter_codec.create_encoder: keyframe_interval";
+  {
+    include_input;
+    keyframe_interval;
+    last = Hashtbl.create 64;
+    scratch = Array.make fields 0;
+    body = Buffer.create 1024;
+    buf = Buffer.create 1024;
+    sequence = 0;
+    ticks = 0;
+    keyframe_due = true;
+  }
+
+(** Make the next packet a keyframe *)
+let force_keyframe enc = enc.keyframe_due <- true
+
+(** Encode one tick. Returns [None] when nothing changed and no keyframe
+    is due; the sequence number only advances for emitted packets. *)
+let encode enc ~timestamp (frames : Metering.meter_frame list) =
+  enc.ticks <- enc.ticks + 1;
+  let keyframe = enc.keyframe_due || enc.ticks >= enc.keyframe_interval in
+  if keyframe then Hashtbl.reset enc.last;
+  let body = enc.body in
+  Buffer.clear body;
+  let count = ref 0 in
+  let q = enc.scratch in
+  List.iter (fun (frame : Metering.meter_frame) ->
+    if frame.track_index < 0 then invalid_arg "Meter_codec.encode: negative track index";
+    quantize_frame ~include_input:enc.include_input q frame;
+    let prev =
+      match Hashtbl.find_opt enc.last frame.track_index with
+      | Some p -> p
+      | None ->
+        let p = Array.make fields absent in
+        Hashtbl.replace enc.last frame.track_index p;
+        p
+    in
+    let mask = ref 0 in
+    for i = 0 to fields - 1 do
+      if q.(i) <> prev.(i) then mask := !mask lor (1 lsl i)
+    done;
+    if !mask <> 0 then begin
+      incr count;
+      add_varint body frame.track_index;
+      add_varint body !mask;
+      for i = 0 to fields - 1 do
+        if !mask land (1 lsl i) <> 0 then begin
+          add_varint body (zigzag (if keyframe then q.(i) else q.(i) - prev.(i)));
+          prev.(i) <- q.(i)
+        end
+      done
+    end) frames;
+  if !count = 0 && not keyframe then None
+  else begin
+    let buf = enc.buf in
+    Buffer.clear buf;
+    Buffer.add_char buf magic;
+    Buffer.add_char buf (Char.chr version);
+    Buffer.add_char buf (if keyframe then '\001' else '\000');
+    enc.sequence <- enc.sequence + 1;
+    add_varint buf enc.sequence;
+    Buffer.add_int64_le buf (Int64.bits_of_float timestamp);
+    add_varint buf !count;
+    Buffer.add_buffer buf body;
+    if keyframe then begin
+      enc.keyframe_due <- false;
+      enc.ticks <- 0
+    end;
+    Some (Buffer.contents buf)
+  end
+
+(** {1 Decoder} *)
+
+type decoder = {
+  values : (int, int array) Hashtbl.t;
+  mutable expected : int;  (** next sequence number; 0 before a keyframe *)
+}
+
+(** A decoded packet: frames for the tracks it carried *)
+type packet = {
+  sequence : int;
+  keyframe : bool;
+  timestamp : float;
+  frames : Metering.meter_frame list;
+}
+
+let create_decoder () = { values = Hashtbl.create 64; expected = 0 }
+
+exception Malformed of string
+
+let frame_of_values ~timestamp track_index v =
+  let channel base : Metering.channel_meter =
+    let rms_db = dequantize db_scale v.(base) and peak_db = dequantize db_scale v.(base + 1) in
+    { Metering.rms_linear = Metering.db_to_linear rms_db; peak_linear = Metering.db_to_linear peak_db; rms_db; peak_db }
+  in
+  let stereo base : Metering.stereo_meter =
+    { Metering.left = channel base; right = channel (base + 2); mono_sum = channel (base + 4) }
+  in
+  let opt i = if v.(i) = absent then None else Some (dequantize (scale_of_field i) v.(i)) in
+  let input = if v.(6) = absent then None else Some (stereo 6) in
+  let field : Metering.stereo_field option =
+    if v.(12) = absent then None
+    else Some {
+      Metering.correlation = dequantize unit_scale v.(12);
+      balance = dequantize unit_scale v.(13);
+      mid_side_db = dequantize db_scale v.(14);
+      width = dequantize unit_scale v.(15);
+      mono_loss_db = dequantize db_scale v.(16);
+    }
+  in
+  let loudness : Metering.Loudness.reading option =
+    match opt 17, opt 18, opt 19 with
+    | None, None, None -> None
+    | momentary, short_term, integrated ->
+      Some { Metering.Loudness.momentary; short_term; integrated; range = None; max_momentary = None; max_short_term = None }
+  in
+  Metering.create_frame ~timestamp ~track_index ?input ~output:(stereo 0) ?loudness ?field ()
+
+(** Decode a packet, updating the decoder's per-track values. Delta
+    packets are rejected until a keyframe arrives and after a gap in the
+    sequence; the caller should then wait for (or request) a keyframe.
+    Loudness range and maxima are not carried and decode as [None]. *)
+let decode dec payload =
+  let len = String.length payload in
+  let pos = ref 0 in
+  let byte () =
+    if !pos >= len then raise (Malformed "truncated packet");
+    let c = Char.code payload.[!pos] in
+    incr pos;
+    c
+  in
+  let varint () =
+    let rec go shift acc =
+      if shift > 56 then raise (Malformed "varint too long");
+      let b = byte () in
+      let acc = acc lor ((b land 0x7f) lsl shift) in
+      if b land 0x80 = 0 then acc else go (shift + 7) acc
+    in
+    go 0 0
+  in
+  try
+    if byte () <> Char.code magic then raise (Malformed "bad magic");
+    if byte () <> version then raise (Malformed "unsupported version");
+    let keyframe = byte () land 1 = 1 in
+    let sequence = varint () in
+    if !pos + 8 > len then raise (Malformed "truncated packet");
+    let timestamp = Int64.float_of_bits (String.get_int64_le payload !pos) in
+    pos := !pos + 8;
+    if not keyframe && (dec.expected = 0 || sequence <> dec.expected) then
+      raise (Malformed "sequence gap: keyframe required");
+    if keyframe then Hashtbl.reset dec.values;
+    let count = varint () in
+    let frames = List.init count (fun _ ->
+      let track_index = varint () in
+      let mask = varint () in
+      if mask lsr fields <> 0 then raise (Malformed "unknown fields in mask");
+      let v =
+        match Hashtbl.find_opt dec.values track_index with
+        | Some v -> v
+        | None ->
+          let v = Array.make fields absent in
+          Hashtbl.replace dec.values track_index v;
+          v
+      in
+      for i = 0 to fields - 1 do
+        if mask land (1 lsl i) <> 0 then begin
+          let x = unzigzag (varint ()) in
+          v.(i) <- (if keyframe then x else v.(i) + x)
+        end
+      done;
+      frame_of_values ~timestamp track_index v)
+    in
+    if !pos <> len then raise (Malformed "trailing bytes");
+    dec.expected <- sequence + 1;
+    Ok { sequence; keyframe; timestamp; frames }
+  with Malformed msg ->
+    (* Values may be half-applied: only a keyframe can resync *)
+    dec.expected <- 0;
+    Error msg
+
+(** {1 Base64} *)
+
+let alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"
+
+(** Standard base64 with padding, for text transports such as SSE *)
+let base64_encode s =
+  let len = String.length s in
+  let out = Bytes.create ((len + 2) / 3 * 4) in
+  let get i = if i < len then Char.code (String.unsafe_get s i) else 0 in
+  let i = ref 0 and o = ref 0 in
+  while !i < len do
+    let n = (get !i lsl 16) lor (get (!i + 1) lsl 8) lor get (!i + 2) in
+    Bytes.unsafe_set out !o alphabet.[(n lsr 18) land 63];
+    Bytes.unsafe_set out (!o + 1) alphabet.[(n lsr 12) land 63];
+    Bytes.unsafe_set out (!o + 2) (if !i + 1 < len then alphabet.[(n lsr 6) land 63] else '=');
+    Bytes.unsafe_set out (!o + 3) (if !i + 2 < len then alphabet.[n land 63] else '=');
+    i := !i + 3;
+    o := !o + 4
+  done;
+  Bytes.unsafe_to_string out
+
+let base64_decode s =
+  let value c =
+    match c with
+    | 'A' .. 'Z' -> Char.code c - 65
+    | 'a' .. 'z' -> Char.code c - 71
+    | '0' .. '9' -> Char.code c + 4
+    | '+' -> 62
+    | '/' -> 63
+    | _ -> raise (Malformed "invalid base64")
+  in
+  let len = String.length s in
+  if len mod 4 <> 0 then Error "invalid base64 length"
+  else
+    try
+      let buf = Buffer.create (len / 4 * 3) in
+      let i = ref 0 in
+      while !i < len do
+        (* Padding only ends the last quad, as "xx==" or "xxx=" *)
+        let pad =
+          match s.[!i + 2], s.[!i + 3] with
+          | '=', '=' -> 2
+          | _, '=' -> 1
+          | '=', _ -> raise (Malformed "invalid base64 padding")
+          | _ -> 0
+        in
+        if pad > 0 && !i + 4 < len then raise (Malformed "invalid base64 padding");
+        let v k = if k >= 4 - pad then 0 else value s.[!i + k] in
+        let n = (v 0 lsl 18) lor (v 1 lsl 12) lor (v 2 lsl 6) lor v 3 in
+        Buffer.add_char buf (Char.chr ((n lsr 16) land 255));
+        if pad < 2 then Buffer.add_char buf (Char.chr ((n lsr 8) land 255));
+        if pad < 1 then Buffer.add_char buf (Char.chr (n land 255));
+        i := !i + 4
+      done;
+      Ok (Buffer.contents buf)
+    with Malformed msg -> Error msg
@@ -0,0 +1,59 @@
+(** Replay - Ring of recent SSE events for Last-Event-ID resumption
+
+    The ring assigns event ids itself (after + 1, after + 2, ...) so they
+    are contiguous, and keeps the last [capacity] events as the exact bytes
+    that were sent. A reconnecting client's [Last-Event-ID] then maps
+    straight to the slots it missed and the replay is a list of
+    pre-encoded strings, with no re-serialization. When the id has
+    already left the ring (or was never issued by it, e.g. from before a
+    restart) the caller sends a state snapshot instead.
+*)
+
+type t = {
+  events : string array;
+  first : int;          (** ids at or below this were not issued by the ring *)
+  mutable last : int;   (** id of the newest event, [first] before the first *)
+}
+
+(** What a client resuming after some id needs *)
+type resume =
+  | Missed of string list  (** these events, oldest first (maybe none) *)
+  | Snapshot               (** too far behind: send current state *)
+
+(** A ring whose first event gets id [after + 1] (default 1) *)
+let create ?(after = 0) ~capacity () =
+  if capacity < 1 then invalid_arg "Replay.create: capacity must be positive";
+  if after < 0 then invalid_arg "Replay.create: negative first id";
+  { events = Array.make capacity ""; first = after; last = after }
+
+let capacity t = Array.length t.events
+
+(** Id of the newest event ([after] if none) *)
+let last_id t = t.last
+
+(** Events still replayable *)
+let length t = min (t.last - t.first) (capacity t)
+
+(** Assign the next id, format the event with it and keep the bytes *)
+let push t format =
+  let id = t.last + 1 in
+  let text = format id in
+  t.events.((id - 1) mod capacity t) <- text;
+  t.last <- id;
+  text
+
+(** Events after [id] *)
+let since t id =
+  if id = t.last then Missed []
+  else if id < t.first || id > t.last || t.last - id > capacity t then Snapshot
+  else
+    let rec collect k acc =
+      if k <= id then acc else collect (k - 1) (t.events.((k - 1) mod capacity t) :: acc)
+    in
+    Missed (collect t.last [])
+
+(** Parse a [Last-Event-ID] value issued by a ring *)
+let parse_id s =
+  match int_of_string_opt (String.trim s) with
+  | Some id when id >= 0 -> Some id
+  | _ -> None
@@ -4,6 +4,18 @@
     to clients in real-time.
 *)
 
+(** Compact meter frame encoding *)
+module Meter_codec = Meter_codec
+
+(** Recent events for Last-Event-ID resumption *)
+module Replay = Replay
+
+(** Shared tick source and frame schedules *)
+module Ticker = Ticker
+
+(** Per-client fan-out with bounded queues *)
+module Broadcast = Broadcast
+
 (** SSE event types *)
 type event_type =
   | Meter
@@ -48,17 +60,46 @@ let format_event event =
   Buffer.add_string buf (Printf.sprintf "data: %s\n\n" (Yojson.Safe.to_string event.data));
   Buffer.contents buf
 
+(** Format a compact meter packet as an SSE event. SSE data is text, so
+    the packet is base64-encoded. *)
+let format_compact_event ?id packet =
+  let buf = Buffer.create (String.length packet * 4 / 3 + 48) in
+  Buffer.add_string buf "event: meter_compact\n";
+  (match id with
+   | Some id -> Buffer.add_string buf "id: "; Buffer.add_string buf id; Buffer.add_char buf '\n'
+   | None -> ());
+  Buffer.add_string buf "data: ";
+  Buffer.add_string buf (Meter_codec.base64_encode packet);
+  Buffer.add_string buf "\n\n";
+  Buffer.contents buf
+
+(** Meter frame encoding on a stream *)
+type encoding =
+  | Json     (** one JSON object per frame *)
+  | Compact  (** one [Meter_codec] packet per tick, base64 in a [meter_compact] event *)
+
+let encoding_to_string = function
+  | Json -> "json"
+  | Compact -> "compact"
+
+let encoding_of_string = function
+  | "json" -> Some Json
+  | "compact" -> Some Compact
+  | _ -> None
+
 (** SSE stream configuration *)
 type stream_config = {
   frame_rate : int;  (** frames per second (30 or 60) *)
   include_input : bool;
   track_indices : int list option;  (** None = all tracks *)
+  encoding : encoding;
 }
 
 let default_config = {
   frame_rate = 30;
   include_input = false;
   track_indices = None;
+  encoding = Json;
 }
 
 (** Frame interval in seconds *)
@@ -70,20 +111,31 @@ type stream_state = {
   config : stream_config;
   mutable running : bool;
   mutable event_id : int;
-  mutable last_frame_time : float;
+  encoder : Meter_codec.encoder;  (** used when [config.encoding = Compact] *)
+  schedule : Ticker.schedule;     (** frame deadlines on the tick source *)
+  own_ticker : bool;              (** [schedule]'s ticker is private to this stream *)
+  mutable ticking : bool;         (** private ticker fiber started *)
   sw : Eio.Switch.t;
   clock : float Eio.Time.clock_ty Eio.Time.clock;
 }
 
-(** Create a new stream state *)
-let create_stream ~sw ~clock ?(config = default_config) () = {
-  config;
-  running = false;
-  event_id = 0;
-  last_frame_time = 0.0;
-  sw;
-  clock;
-}
+(** Create a new stream state. Frames are timed by [ticker], normally one
+    monotonic [Ticker.t] shared by every stream; without it the stream
+    runs a private ticker on [clock] once started. *)
+let create_stream ~sw ~clock ?ticker ?catch_up ?(config = default_config) () =
+  let own_ticker = Option.is_none ticker in
+  let ticker = match ticker with Some t -> t | None -> Ticker.of_clock ~rate:(max 1 config.frame_rate) clock in
+  {
+    config;
+    running = false;
+    event_id = 0;
+    encoder = Meter_codec.create_encoder ~include_input:config.include_input ();
+    schedule = Ticker.schedule ?policy:catch_up ticker ~fps:(max 1 config.frame_rate);
+    own_ticker;
+    ticking = false;
+    sw;
+    clock;
+  }
 
 (** Generate next event ID *)
 let next_event_id state =
@@ -99,6 +151,38 @@ let meter_event_of_frame ~state (frame : Metering.meter_frame) =
     ~id
     ()
 
+let subscribed state (frames : Metering.meter_frame list) =
+  match state.config.track_indices with
+  | None -> frames
+  | Some wanted -> List.filter (fun (f : Metering.meter_frame) -> List.mem f.track_index wanted) frames
+
+(** Create one meter event carrying a batch of frames, filtered by the
+    stream's [track_indices] *)
+let meter_batch_event ~state (frames : Metering.meter_frame list) =
+  let frames = subscribed state frames in
+  let id = next_event_id state in
+  create_event
+    ~event_type:Meter
+    ~data:(`Assoc [("frames", `List (List.map Metering.frame_to_json frames))])
+    ~id
+    ()
+
+(** One tick of meter frames as SSE text in the stream's encoding: a JSON
+    batch event, or a compact packet of the subscribed tracks that changed
+    ([""] when none did and no keyframe is due) *)
+let meter_tick ~state (frames : Metering.meter_frame list) =
+  match state.config.encoding with
+  | Json -> format_event (meter_batch_event ~state frames)
+  | Compact ->
+    let frames = subscribed state frames in
+    let timestamp = match frames with f :: _ -> f.timestamp | [] -> 0.0 in
+    match Meter_codec.encode state.encoder ~timestamp frames with
+    | Some packet -> format_compact_event ~id:(next_event_id state) packet
+    | None -> ""
+
+(** Make the next compact packet a keyframe (e.g. for a new subscriber) *)
+let request_keyframe state = Meter_codec.force_keyframe state.encoder
+
 (** Create ping event (keepalive) *)
 let ping_event ~state =
   let id = next_event_id state in
@@ -128,10 +212,15 @@ let sse_headers = [
   ("X-Accel-Buffering", "no");  (* Disable nginx buffering *)
 ]
 
-(** Start streaming (for integration with HTTP server) *)
+(** Start streaming (for integration with HTTP server): frame 0 is due
+    at once *)
 let start_stream state =
+  if state.own_ticker && not state.ticking then begin
+    state.ticking <- true;
+    Eio.Fiber.fork_daemon ~sw:state.sw (fun () -> Ticker.run state.schedule.Ticker.ticker)
+  end;
   state.running <- true;
-  state.last_frame_time <- Daw_drivers.Time_compat.now ()
+  Ticker.restart state.schedule
 
 (** Stop streaming *)
 let stop_stream state =
@@ -143,44 +232,45 @@ let is_running state = state.running
 (** Get stream config *)
 let get_config state = state.config
 
-(** Check if should emit frame based on frame rate *)
+(** Claim the next frame if it is due (applying the catch-up policy);
+    does not block *)
 let should_emit_frame state =
-  let now = Daw_drivers.Time_compat.now () in
-  let interval = frame_interval state.config in
-  if now -. state.last_frame_time >= interval then begin
-    state.last_frame_time <- now;
+  if Ticker.due state.schedule then begin
+    Ticker.take state.schedule;
     true
   end else
     false
 
-(** Sleep until next frame *)
-let sleep_until_next_frame state =
-  let now = Daw_drivers.Time_compat.now () in
-  let interval = frame_interval state.config in
-  let elapsed = now -. state.last_frame_time in
-  let remaining = interval -. elapsed in
-  if remaining > 0.0 then
-    Eio.Time.sleep state.clock remaining
+(** Block until the next frame is due *)
+let sleep_until_next_frame state = Ticker.await state.schedule
 
-(** Stream meter data (generator function for use with Eio) *)
+(** Achieved frame rate, jitter, dropped frames and lateness *)
+let stream_stats state = Ticker.schedule_to_json state.schedule
+
+(** Stream meter data (generator function for use with Eio). Each element
+    is one frame's event, sent on that frame's deadline; compact ticks
+    with nothing to send are skipped rather than yielded as [""]. *)
 let generate_meter_events ~state ~get_meter_frame () =
-  Seq.unfold (fun () ->
+  let rec next () =
     if not state.running then None
     else begin
-      sleep_until_next_frame state;
-      if should_emit_frame state then
-        match get_meter_frame () with
+      Ticker.next_frame state.schedule;
+      if not state.running then None
+      else match get_meter_frame () with
         | Some frame ->
-          let event = meter_event_of_frame ~state frame in
-          Some (format_event event, ())
+          (match state.config.encoding with
+           | Json -> Some (format_event (meter_event_of_frame ~state frame), ())
+           | Compact ->
+             (match meter_tick ~state [frame] with
+              | "" -> next ()
+              | text -> Some (text, ())))
         | None ->
           (* No data, send ping *)
           let event = ping_event ~state in
           Some (format_event event, ())
-      else
-        Some ("", ())  (* Skip frame *)
     end
-  ) ()
+  in
+  Seq.unfold next ()
 
 (** Meter stream configuration from JSON *)
 let config_of_json json =
@@ -193,7 +283,11 @@ let config_of_json json =
     | `List l -> Some (List.map to_int l)
     | _ -> None
   in
-  { frame_rate; include_input; track_indices }
+  let encoding =
+    Option.bind (json |> member "encoding" |> to_string_option) encoding_of_string
+    |> Option.value ~default:Json
+  in
+  { frame_rate; include_input; track_indices; encoding }
 
 (** MCP tool for meter streaming *)
 let meter_stream_tool = {|{
@@ -217,6 +311,12 @@ let meter_stream_tool = {|{
         "type": "array",
         "items": {"type": "integer"},
         "description": "Track indices to monitor (null for all)"
+      },
+      "encoding": {
+        "type": "string",
+        "description": "Frame encoding: json objects, or compact base64 delta packets (meter_compact events)",
+        "default": "json",
+        "enum": ["json", "compact"]
       }
     }
   }
@@ -249,3 +349,332 @@ let automation_event ~state ~track_index ~param_name ~points =
     ])
     ~id
     ()
+
+(** {1 Meter Hub}
+
+    One producer meters every track once per tick (a [Metering.bank] fed
+    by [source]) and fans the result out to all subscribers. Subscribers
+    with the same configuration (frame rate, tracks, encoding) share a
+    group, and each group encodes its event once per tick, so the cost of
+    a tick grows with the number of tracks and groups rather than tracks
+    times clients. In JSON groups each track's frame is serialized at most
+    once per tick and reused by every group that selects it. Groups are
+    downsampled from the producer rate to their own frame rate.
+
+    Subscriber queues are bounded; when one is full the event is dropped
+    for that subscriber (meter frames are superseded by the next tick).
+    A compact delta lost this way would leave the client's decoder
+    rejecting every later delta, so a drop in a compact group makes the
+    group's next packet a keyframe. *)
+
+(** Fill an interleaved stereo block for a track *)
+type source = int -> Metering.float32_buffer -> unit
+
+type subscriber = {
+  sub_id : int;
+  queue : string Eio.Stream.t;
+  group_key : string;
+  raw : bool;                      (** payload only, no SSE framing *)
+  mutable dropped : int;
+}
+
+type group = {
+  group_config : stream_config;
+  divisor : int;                   (** producer ticks per group frame *)
+  selected : int array;            (** track indices, in order *)
+  group_encoder : Meter_codec.encoder;
+  ring : Replay.t;                 (** recent events; issues their ids *)
+  mutable members : subscriber list;
+  mutable idle_since : int;        (** tick the last member left *)
+}
+
+type hub = {
+  rate : int;                      (** producer ticks per second *)
+  tracks : int;
+  bank : Metering.bank;
+  blocks : Metering.float32_buffer array;
+  source : source;
+  latest : Metering.meter_frame option array;
+  block_frames : int;
+  history : (Metering.History.t * Metering.History.t) array;  (** per-track L/R, one value per tick *)
+  json : string array;             (** per-track JSON of the current tick *)
+  json_tick : int array;           (** tick each [json] entry was encoded at *)
+  groups : (string, group) Hashtbl.t;
+  streams : (string, stream_config) Hashtbl.t;
+  queue_capacity : int;
+  replay_capacity : int;           (** events kept per group *)
+  keepalive_ticks : int;
+  mutable tick : int;
+  mutable next_sub : int;
+  mutable next_stream : int;
+  mutable event_id : int;          (** newest event id issued by any group *)
+  mutable encodes : int;           (** frames serialized to JSON *)
+  mutable events : int;            (** group events built *)
+  mutable replayed : int;          (** events resent on resumption *)
+  mutable dropped : int;           (** events dropped for full queues, ever *)
+  mutable schedule : Ticker.schedule option;  (** set by [run_hub] *)
+}
+
+(** History levels and nodes per level kept per track and channel: at
+    60 ticks per second the coarsest level spans about 9.7 hours *)
+let history_levels = 12
+let history_capacity = 1024
+
+(** Create a hub metering [tracks] stereo tracks at [rate] ticks per
+    second (default 60) from [source], in blocks of [sample_rate / rate]
+    frames. With [history] (default true) every tick is also recorded in
+    a per-track [Metering.History]. [domains] extra domains (default 0)
+    share the bank pass once the track count reaches the bank's parallel
+    threshold; release them with [shutdown_hub]. *)
+let create_hub ?(rate = 60) ?(queue_capacity = 16) ?(replay = 2 * rate) ?(keepalive = 15.0)
+    ?(history = true) ?domains ~sample_rate ~tracks ~source () =
+  if rate <= 0 || tracks <= 0 then invalid_arg "Sse.create_hub";
+  let block_frames = max 1 (int_of_float (sample_rate /. Float.of_int rate)) in
+  {
+    rate;
+    tracks;
+    bank = Metering.create_bank ?domains ~sample_rate ~tracks ();
+    blocks = Array.init tracks (fun _ ->
+      Bigarray.Array1.create Bigarray.float32 Bigarray.c_layout (2 * block_frames));
+    source;
+    latest = Array.make tracks None;
+    block_frames;
+    history =
+      if history then
+        Array.init tracks (fun _ ->
+          let make () =
+            Metering.History.create ~levels:history_levels ~capacity:history_capacity
+              ~rate:(Float.of_int rate) ()
+          in
+          (make (), make ()))
+      else [||];
+    json = Array.make tracks "";
+    json_tick = Array.make tracks (-1);
+    groups = Hashtbl.create 8;
+    streams = Hashtbl.create 8;
+    queue_capacity;
+    replay_capacity = max 1 replay;
+    keepalive_ticks = max 1 (int_of_float (keepalive *. Float.of_int rate));
+    tick = 0;
+    next_sub = 0;
+    next_stream = 0;
+    event_id = 0;
+    encodes = 0;
+    events = 0;
+    replayed = 0;
+    dropped = 0;
+    schedule = None;
+  }
+
+let group_key (config : stream_config) =
+  Printf.sprintf "%d|%b|%s|%s" config.frame_rate config.include_input
+    (encoding_to_string config.encoding)
+    (match config.track_indices with
+     | None -> "*"
+     | Some l -> String.concat "," (List.map string_of_int l))
+
+(** Register a meter stream and return its id *)
+let open_meter_stream hub config =
+  hub.next_stream <- hub.next_stream + 1;
+  let id = Printf.sprintf "meter_%d" hub.next_stream in
+  Hashtbl.replace hub.streams id config;
+  id
+
+(** Forget a meter stream; connected subscribers keep their group *)
+let close_meter_stream hub id =
+  let known = Hashtbl.mem hub.streams id in
+  Hashtbl.remove hub.streams id;
+  known
+
+let meter_stream_config hub id = Hashtbl.find_opt hub.streams id
+
+(** Add a subscriber for [config]. With [last_event_id], the group's
+    events after it are queued first (pre-encoded, from its replay ring)
+    if they fit in the subscriber queue; otherwise, and for new
+    subscribers, compact groups restart with a keyframe so the newcomer
+    can decode. JSON events are full frames and need no catch-up. *)
+let subscribe ?last_event_id ?(raw = false) hub config =
+  let key = group_key config in
+  let group =
+    match Hashtbl.find_opt hub.groups key with
+    | Some g -> g
+    | None ->
+      let selected =
+        match config.track_indices with
+        | None -> Array.init hub.tracks Fun.id
+        | Some l -> Array.of_list (List.filter (fun i -> i >= 0 && i < hub.tracks) l)
+      in
+      let g = {
+        group_config = config;
+        divisor = max 1 (hub.rate / max 1 config.frame_rate);
+        selected;
+        group_encoder = Meter_codec.create_encoder ~include_input:config.include_input ();
+        (* Ids continue from the hub, so a recreated group never reissues
+           ids a client of its previous incarnation may resume from *)
+        ring = Replay.create ~after:hub.event_id ~capacity:hub.replay_capacity ();
+        members = [];
+        idle_since = hub.tick;
+      } in
+      Hashtbl.replace hub.groups key g;
+      g
+  in
+  hub.next_sub <- hub.next_sub + 1;
+  let sub = {
+    sub_id = hub.next_sub;
+    queue = Eio.Stream.create hub.queue_capacity;
+    group_key = key;
+    raw;
+    dropped = 0;
+  } in
+  group.members <- sub :: group.members;
+  let resumed =
+    match Option.map (Replay.since group.ring) (if raw then None else last_event_id) with
+    | Some (Replay.Missed events) when List.length events <= hub.queue_capacity ->
+      List.iter (Eio.Stream.add sub.queue) events;
+      hub.replayed <- hub.replayed + List.length events;
+      true
+    | Some (Replay.Missed _ | Replay.Snapshot) | None -> false
+  in
+  if not resumed then Meter_codec.force_keyframe group.group_encoder;
+  sub
+
+(** Remove a subscriber. An empty group keeps producing into its replay
+    ring for one ring's worth of events, so clients dropped together by
+    a network blip can resume, and is then dropped by [hub_tick]. *)
+let unsubscribe hub sub =
+  match Hashtbl.find_opt hub.groups sub.group_key with
+  | None -> ()
+  | Some g ->
+    g.members <- List.filter (fun s -> s.sub_id <> sub.sub_id) g.members;
+    if g.members = [] then g.idle_since <- hub.tick
+
+(** Next SSE text for a subscriber (blocks until available) *)
+let next_event sub = Eio.Stream.take sub.queue
+
+(** Queue [text] for [sub]; [false] if its queue was full and the event
+    was dropped *)
+let offer hub sub text =
+  if Eio.Stream.length sub.queue < hub.queue_capacity then begin
+    Eio.Stream.add sub.queue text;
+    true
+  end else begin
+    sub.dropped <- sub.dropped + 1;
+    hub.dropped <- hub.dropped + 1;
+    false
+  end
+
+let track_json hub i (frame : Metering.meter_frame) =
+  if hub.json_tick.(i) <> hub.tick then begin
+    hub.json.(i) <- Yojson.Safe.to_string (Metering.frame_to_json frame);
+    hub.json_tick.(i) <- hub.tick;
+    hub.encodes <- hub.encodes + 1
+  end;
+  hub.json.(i)
+
+(** A group's event for this tick as [(sse_text, payload)], where the
+    payload is the JSON data or the raw compact packet *)
+let group_event hub g ~timestamp =
+  match g.group_config.encoding with
+  | Json ->
+    let buf = Buffer.create 256 in
+    Buffer.add_string buf "{\"frames\":[";
+    let first = ref true in
+    Array.iter (fun i ->
+      match hub.latest.(i) with
+      | Some frame ->
+        if not !first then Buffer.add_char buf ',';
+        first := false;
+        Buffer.add_string buf (track_json hub i frame)
+      | None -> ()) g.selected;
+    Buffer.add_string buf "]}";
+    let data = Buffer.contents buf in
+    Some (Replay.push g.ring (fun id -> Printf.sprintf "event: meter\nid: %d\ndata: %s\n\n" id data), data)
+  | Compact ->
+    let frames = Array.fold_right (fun i acc ->
+      match hub.latest.(i) with Some f -> f :: acc | None -> acc) g.selected [] in
+    match Meter_codec.encode g.group_encoder ~timestamp frames with
+    | Some packet ->
+      Some (Replay.push g.ring (fun id -> format_compact_event ~id:(string_of_int id) packet), packet)
+    | None -> None
+
+(** Run one producer tick: meter every track and fan out to the groups
+    due at this tick *)
+let hub_tick hub ~timestamp =
+  Array.iteri (fun i block -> hub.source i block) hub.blocks;
+  Metering.process_bank hub.bank hub.blocks;
+  List.iter (fun (frame : Metering.meter_frame) ->
+    hub.latest.(frame.track_index) <- Some frame;
+    if frame.track_index < Array.length hub.history then begin
+      let left, right = hub.history.(frame.track_index) in
+      Metering.record_frame ~frames:hub.block_frames ~left ~right frame
+    end) (Metering.bank_frames hub.bank ~timestamp);
+  let expired = ref [] in
+  Hashtbl.iter (fun key g ->
+    if g.members = [] && hub.tick - g.idle_since >= hub.replay_capacity * g.divisor then
+      expired := key :: !expired
+    else if hub.tick mod g.divisor = 0 then
+      match group_event hub g ~timestamp with
+      | Some (text, payload) ->
+        hub.events <- hub.events + 1;
+        hub.event_id <- max hub.event_id (Replay.last_id g.ring);
+        let delivered =
+          List.fold_left (fun ok sub -> offer hub sub (if sub.raw then payload else text) && ok)
+            true g.members
+        in
+        (* Resync clients that lost a delta *)
+        if not delivered && g.group_config.encoding = Compact then
+          Meter_codec.force_keyframe g.group_encoder
+      | None -> ()) hub.groups;
+  List.iter (Hashtbl.remove hub.groups) !expired;
+  if hub.tick > 0 && hub.tick mod hub.keepalive_ticks = 0 then
+    Hashtbl.iter (fun _ g ->
+      List.iter (fun sub -> if not sub.raw then ignore (offer hub sub ": keepalive\n\n")) g.members) hub.groups;
+  hub.tick <- hub.tick + 1
+
+(** Latest frame of a track, if the producer has run *)
+let latest_frame hub track =
+  if track < 0 || track >= hub.tracks then None else hub.latest.(track)
+
+(** A track's meter history over the last [seconds] as up to [points]
+    min/max/RMS points per channel; [None] for an unknown track or a hub
+    without history *)
+let history_json hub ~track ~seconds ~points =
+  if track < 0 || track >= Array.length hub.history then None
+  else begin
+    let left, right = hub.history.(track) in
+    let stop = Metering.History.length left in
+    let start = stop - int_of_float (Float.ceil (seconds *. Float.of_int hub.rate)) in
+    let channel h = Metering.History.query_to_json h ~start ~stop (Metering.History.query h ~start ~stop ~points) in
+    Some (`Assoc [("track", `Int track); ("left", channel left); ("right", channel right)])
+  end
+
+(** Stop the hub's worker domains, if any *)
+let shutdown_hub hub = Metering.shutdown_bank hub.bank
+
+(** Tick forever at the hub rate on the shared [ticker]; run in a daemon
+    fiber. After a stall missed ticks are dropped rather than burst. *)
+let run_hub hub ~ticker =
+  let schedule = Ticker.schedule ~policy:Ticker.Skip ticker ~fps:hub.rate in
+  hub.schedule <- Some schedule;
+  let rec loop () =
+    Ticker.next_frame schedule;
+    hub_tick hub ~timestamp:(Daw_drivers.Time_compat.now ());
+    loop ()
+  in
+  loop ()
+
+(** Hub counters *)
+let hub_stats hub =
+  let subscribers = Hashtbl.fold (fun _ g n -> n + List.length g.members) hub.groups 0 in
+  `Assoc [
+    ("ticks", `Int hub.tick);
+    ("tracks", `Int hub.tracks);
+    ("groups", `Int (Hashtbl.length hub.groups));
+    ("subscribers", `Int subscribers);
+    ("streams", `Int (Hashtbl.length hub.streams));
+    ("frames_encoded", `Int hub.encodes);
+    ("events", `Int hub.events);
+    ("dropped", `Int hub.dropped);
+    ("replayed", `Int hub.replayed);
+    ("schedule", match hub.schedule with Some s -> Ticker.schedule_to_json s | None -> `Null);
+  ]
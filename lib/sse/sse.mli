@@ -1,5 +1,199 @@
 (** SSE (Server-Sent Events) - Real-time streaming interface *)
 
+(** {1 Compact Encoding} *)
+
+(** Compact delta encoding of meter frames: values quantized to int16
+    (0.1 dB / 0.1 LU, 0.001 for correlation, balance and width) and sent
+    as zigzag-varint deltas from the last value sent, with only changed
+    fields of changed tracks written and periodic keyframes. *)
+module Meter_codec : sig
+  val version : int
+  val fields : int
+
+  val absent : int
+  (** Quantized value of a missing field *)
+
+  type encoder
+
+  val create_encoder : ?include_input:bool -> ?keyframe_interval:int -> unit -> encoder
+  (** Create an encoder; the first packet, and one every
+      [keyframe_interval] ticks (default 60), is a keyframe *)
+
+  val force_keyframe : encoder -> unit
+  (** Make the next packet a keyframe *)
+
+  val encode : encoder -> timestamp:float -> Metering.meter_frame list -> string option
+  (** Binary packet for one tick, or [None] when nothing changed and no
+      keyframe is due. Raises [Invalid_argument] on a negative track index. *)
+
+  type decoder
+
+  type packet = {
+    sequence : int;
+    keyframe : bool;
+    timestamp : float;
+    frames : Metering.meter_frame list;
+  }
+  (** A decoded packet: frames for the tracks it carried *)
+
+  val create_decoder : unit -> decoder
+
+  val decode : decoder -> string -> (packet, string) result
+  (** Decode a packet. Delta packets are rejected before the first
+      keyframe and after a sequence gap. Loudness range and maxima are not
+      carried and decode as [None]. *)
+
+  val base64_encode : string -> string
+  val base64_decode : string -> (string, string) result
+end
+
+(** {1 Replay} *)
+
+(** Ring of recent events for [Last-Event-ID] resumption. The ring
+    issues contiguous ids and keeps the encoded bytes, so a resuming
+    client is sent exactly what it missed without re-serialization. *)
+module Replay : sig
+  type t
+
+  type resume =
+    | Missed of string list  (** events after the client's id, oldest first *)
+    | Snapshot               (** id no longer (or never) in the ring *)
+
+  val create : ?after:int -> capacity:int -> unit -> t
+  (** Ring whose first event gets id [after + 1] (default 1); earlier
+      ids resume as [Snapshot] *)
+  val capacity : t -> int
+
+  val last_id : t -> int
+  (** Id of the newest event, [after] before the first *)
+
+  val length : t -> int
+  (** Events still replayable *)
+
+  val push : t -> (int -> string) -> string
+  (** Assign the next id, format the event with it, keep and return it *)
+
+  val since : t -> int -> resume
+
+  val parse_id : string -> int option
+  (** Parse a [Last-Event-ID] header value *)
+end
+
+(** {1 Tick Source} *)
+
+(** One fiber ticks at a fixed rate on absolute monotonic deadlines and
+    wakes every stream waiting on it. A [schedule] places a stream's
+    frames on those ticks without drift, handles backlog by its catch-up
+    policy and measures achieved fps, interval jitter and lateness. *)
+module Ticker : sig
+  type t
+
+  val create : ?rate:int -> _ Eio.Time.Mono.t -> t
+  (** Ticker on the monotonic clock (default 60 Hz) *)
+
+  val of_clock : ?rate:int -> _ Eio.Time.clock -> t
+  (** Ticker on a wall clock *)
+
+  val manual : ?rate:int -> unit -> t
+  (** Ticker moved only by [advance], for tests and offline rendering *)
+
+  val rate : t -> int
+  val ticks : t -> int
+
+  val now : t -> float
+  (** Seconds since the ticker started *)
+
+  val advance : t -> int -> unit
+  (** Move a manual ticker forward by some ticks *)
+
+  val run : t -> 'a
+  (** Tick forever; run in a daemon fiber. Ticks missed while the fiber
+      was held up are skipped and counted as overruns. *)
+
+  val to_json : t -> Yojson.Safe.t
+
+  type catch_up =
+    | Skip          (** drop missed frames, send only the current one *)
+    | Burst of int  (** send up to [n] missed frames back-to-back *)
+
+  type schedule
+
+  val schedule : ?policy:catch_up -> t -> fps:int -> schedule
+  (** Frames at [fps] starting on the current tick (default policy [Skip]) *)
+
+  val restart : schedule -> unit
+  val due : schedule -> bool
+
+  val await : schedule -> unit
+  (** Block until the next frame is due *)
+
+  val take : schedule -> unit
+  (** Claim the due frame, dropping backlog beyond the policy *)
+
+  val next_frame : schedule -> unit
+  (** [await] then [take] *)
+
+  val frames : schedule -> int
+  val dropped : schedule -> int
+
+  val achieved_fps : schedule -> float
+
+  val jitter : schedule -> float
+  (** Standard deviation of frame intervals, in seconds *)
+
+  val schedule_to_json : schedule -> Yojson.Safe.t
+end
+
+(** {1 Broadcast} *)
+
+(** Fan-out to SSE clients with a bounded queue and writer fiber per
+    client. Notifications are never dropped (a client whose queue fills
+    is evicted), meter frames are coalesced to the latest per client,
+    and keepalives from a shared timer wheel only reach idle clients. *)
+module Broadcast : sig
+  type event_class = Notification | Meter | Keepalive
+
+  type t
+
+  val create : ?capacity:int -> ?replay:int -> ?keepalive:float -> ?resolution:float -> unit -> t
+  (** [capacity] bounds each client's queue (default 64); the last
+      [replay] notifications are kept for resumption (default 256); idle
+      clients are pinged every [keepalive] seconds (default 15), checked
+      every [resolution] seconds (default 1) *)
+
+  val serve : ?last_event_id:int -> ?snapshot:(unit -> string) -> t -> (string -> unit) -> unit
+  (** Register a client and run its writer in the calling fiber until it
+      is evicted or the write fails with [Eio.Io] or [End_of_file]. With
+      [last_event_id] the client first gets the notifications it missed,
+      or, if they have left the ring, a [snapshot] event whose data is
+      [snapshot ()]. *)
+
+  val publish : t -> event_class -> string -> unit
+  (** Queue SSE text for every client; never blocks. Notifications get
+      an [id:] line from the replay ring. *)
+
+  val clients : t -> int
+
+  val keepalive_tick : t -> now:float -> unit
+  (** Advance the keepalive wheel by one tick *)
+
+  val run_keepalive : t -> clock:_ Eio.Time.clock -> 'a
+  (** Drive the keepalive wheel; run in a daemon fiber *)
+
+  val flush : t -> clock:_ Eio.Time.clock -> timeout:float -> unit
+  (** Wait until every queue is empty, at most [timeout] seconds *)
+
+  val close : t -> unit
+  (** Disconnect every client *)
+
+  val total_depth : t -> int
+
+  val stats : t -> Yojson.Safe.t
+  (** Clients, queue depth, high-water mark, published, delivered,
+      coalesced, keepalives, evictions, write errors, last event id,
+      replayed events and snapshots *)
+end
+
 (** {1 Event Types} *)
 
 type event_type =
@@ -30,12 +224,23 @@ val create_event :
 val format_event : event -> string
 (** Format an event as SSE text (event: ... \n data: ... \n\n) *)
 
+val format_compact_event : ?id:string -> string -> string
+(** Format a [Meter_codec] packet as a [meter_compact] event with base64 data *)
+
 (** {1 Stream Configuration} *)
 
+type encoding =
+  | Json     (** one JSON object per frame *)
+  | Compact  (** one [Meter_codec] packet per tick *)
+
+val encoding_to_string : encoding -> string
+val encoding_of_string : string -> encoding option
+
 type stream_config = {
   frame_rate : int;
   include_input : bool;
   track_indices : int list option;
+  encoding : encoding;
 }
 
 val default_config : stream_config
@@ -49,21 +254,46 @@ type stream_state
 val create_stream :
   sw:Eio.Switch.t ->
   clock:float Eio.Time.clock_ty Eio.Time.clock ->
+  ?ticker:Ticker.t ->
+  ?catch_up:Ticker.catch_up ->
   ?config:stream_config ->
   unit -> stream_state
+(** Frames are timed by [ticker] (normally one monotonic ticker shared by
+    all streams); without it the stream runs a private ticker on [clock]
+    from [start_stream]. [catch_up] defaults to [Skip]. *)
 
 val start_stream : stream_state -> unit
 val stop_stream : stream_state -> unit
 val is_running : stream_state -> bool
 val get_config : stream_state -> stream_config
+
 val should_emit_frame : stream_state -> bool
+(** Claim the next frame if its deadline has passed; never blocks *)
+
 val sleep_until_next_frame : stream_state -> unit
+(** Block until the next frame's deadline *)
+
+val stream_stats : stream_state -> Yojson.Safe.t
+(** Target and achieved fps, frames, dropped frames, interval jitter and
+    worst lateness *)
 
 (** {1 Event Generators} *)
 
 val meter_event_of_frame :
   state:stream_state -> Metering.meter_frame -> event
 
+val meter_batch_event :
+  state:stream_state -> Metering.meter_frame list -> event
+(** One meter event carrying a batch of frames (e.g. from
+    [Metering.bank_frames]), filtered by the stream's [track_indices] *)
+
+val meter_tick : state:stream_state -> Metering.meter_frame list -> string
+(** One tick of frames as SSE text in the stream's encoding, filtered by
+    [track_indices]. With [Compact], [""] when nothing changed. *)
+
+val request_keyframe : stream_state -> unit
+(** Make the next compact packet a keyframe (e.g. for a new subscriber) *)
+
 val ping_event : state:stream_state -> event
 val error_event : state:stream_state -> message:string -> event
 
@@ -85,7 +315,8 @@ val generate_meter_events :
   state:stream_state ->
   get_meter_frame:(unit -> Metering.meter_frame option) ->
   unit -> string Seq.t
-(** Generate meter events as SSE-formatted strings *)
+(** Generate meter events as SSE-formatted strings, one per frame
+    deadline *)
 
 (** {1 HTTP Helpers} *)
 
@@ -94,3 +325,75 @@ val sse_headers : (string * string) list
 
 val meter_stream_tool : string
 (** MCP tool definition JSON *)
+
+(** {1 Meter Hub} *)
+
+(** One producer meters every track per tick and fans events out to
+    subscribers. Subscribers with the same configuration share a group
+    whose event is encoded once per tick (per-track JSON is serialized at
+    most once per tick across groups), downsampled to the group's frame
+    rate and filtered by its [track_indices]. When a full subscriber
+    queue drops a compact delta, the group's next packet is a keyframe
+    so that client's decoder can resync. *)
+
+type source = int -> Metering.float32_buffer -> unit
+(** Fill an interleaved stereo block for a track *)
+
+type hub
+type subscriber
+
+val create_hub : ?rate:int -> ?queue_capacity:int -> ?replay:int -> ?keepalive:float ->
+  ?history:bool -> ?domains:int -> sample_rate:float -> tracks:int -> source:source -> unit -> hub
+(** Create a hub metering [tracks] tracks at [rate] ticks per second
+    (default 60). Subscriber queues hold [queue_capacity] events (default
+    16); each group keeps its last [replay] events for resumption
+    (default two seconds' worth); a keepalive comment goes out every
+    [keepalive] seconds (default 15). With [history] (default true) each
+    tick is recorded per track for [history_json]. [domains] extra
+    domains (default 0) share the meter pass once there are enough
+    tracks (see [Metering.create_bank]). *)
+
+val shutdown_hub : hub -> unit
+(** Stop the hub's worker domains *)
+
+val open_meter_stream : hub -> stream_config -> string
+(** Register a meter stream configuration and return its id *)
+
+val close_meter_stream : hub -> string -> bool
+(** Forget a stream id; [false] if it was unknown *)
+
+val meter_stream_config : hub -> string -> stream_config option
+
+val subscribe : ?last_event_id:int -> ?raw:bool -> hub -> stream_config -> subscriber
+(** Join (or create) the group for a configuration. With
+    [last_event_id], missed events are queued from the group's replay
+    ring when they fit; otherwise compact groups send a keyframe. [raw]
+    subscribers (e.g. WebSocket) get payloads without SSE framing: the
+    JSON data, or the binary [Meter_codec] packet for compact groups. *)
+
+val unsubscribe : hub -> subscriber -> unit
+(** Leave a group; an empty group lives on for one replay ring's worth
+    of events so clients dropped together can resume *)
+
+val next_event : subscriber -> string
+(** Next SSE text (or raw payload) for a subscriber; blocks until one is
+    queued *)
+
+val hub_tick : hub -> timestamp:float -> unit
+(** Run one producer tick and fan out to the groups due at it *)
+
+val run_hub : hub -> ticker:Ticker.t -> 'a
+(** Tick forever at the hub rate on [ticker]; run in a daemon fiber *)
+
+val latest_frame : hub -> int -> Metering.meter_frame option
+(** Latest frame of a track, once the producer has run *)
+
+val history_json : hub -> track:int -> seconds:float -> points:int -> Yojson.Safe.t option
+(** A track's meter history over the last [seconds], as up to [points]
+    min/max/RMS points per channel (peak envelope and block RMS, one
+    value per tick). [None] for an unknown track or a hub created
+    without history. *)
+
+val hub_stats : hub -> Yojson.Safe.t
+(** Ticks, groups, subscribers, frames encoded, events built, drops,
+    replayed events and the producer's schedule statistics *)
@@ -0,0 +1,187 @@
+(** Ticker - Shared monotonic tick source and per-stream frame schedules
+
+    One fiber ([run]) advances a tick counter at [rate] Hz on absolute
+    deadlines ([tick * period] from the start, on the monotonic clock),
+    so sleep overshoot never accumulates into drift. If the fiber itself
+    is held up it jumps straight to the current tick and counts the
+    skipped ones as overruns. Every tick wakes the fibers waiting on it.
+
+    A [schedule] maps a stream's frame rate onto the ticks: frame [n] is
+    due at the first tick at or after [n / fps] seconds from the
+    schedule's start, so integer-ratio rates (30 or 60 fps on a 60 Hz
+    ticker) land on exact ticks and other rates are quantized to the
+    nearest following tick without drifting. When a consumer falls
+    behind by several frames, the catch-up policy decides whether the
+    missed frames are dropped ([Skip]) or up to [n] of them are sent
+    back-to-back ([Burst n]); dropped frames are counted.
+
+    Each schedule measures its achieved frame rate, the jitter (standard
+    deviation) of the intervals between frames and the worst lateness
+    against the ideal deadline.
+*)
+
+type source =
+  | Manual                                               (** advanced by [advance] *)
+  | Timed of { now : unit -> float; sleep : float -> unit }
+
+type t = {
+  rate : int;
+  period : float;
+  source : source;
+  wake : Eio.Condition.t;
+  mutable tick : int;
+  mutable overruns : int;   (** ticks skipped after a stall *)
+}
+
+let make ~rate source =
+  if rate <= 0 then invalid_arg "Ticker: rate must be positive";
+  { rate; period = 1.0 /. Float.of_int rate; source; wake = Eio.Condition.create (); tick = 0; overruns = 0 }
+
+(** Ticker on the monotonic clock (default 60 Hz) *)
+let create ?(rate = 60) clock =
+  let origin = Eio.Time.Mono.now clock in
+  make ~rate (Timed {
+    now = (fun () -> Mtime.Span.to_float_ns (Mtime.span origin (Eio.Time.Mono.now clock)) *. 1e-9);
+    sleep = Eio.Time.Mono.sleep clock;
+  })
+
+(** Ticker on a wall clock, for callers without a monotonic one *)
+let of_clock ?(rate = 60) clock =
+  let origin = Eio.Time.now clock in
+  make ~rate (Timed { now = (fun () -> Eio.Time.now clock -. origin); sleep = Eio.Time.sleep clock })
+
+(** Ticker that only moves on [advance]; its time is [tick / rate] *)
+let manual ?(rate = 60) () = make ~rate Manual
+
+let rate t = t.rate
+let ticks t = t.tick
+
+(** Seconds since the ticker started *)
+let now t =
+  match t.source with
+  | Manual -> Float.of_int t.tick *. t.period
+  | Timed c -> c.now ()
+
+(** Move a manual ticker forward [n] ticks at once (as after a stall) *)
+let advance t n =
+  if n > 0 then begin
+    t.tick <- t.tick + n;
+    Eio.Condition.broadcast t.wake
+  end
+
+(** Tick forever on absolute deadlines; run in a daemon fiber *)
+let run t =
+  match t.source with
+  | Manual -> invalid_arg "Ticker.run: manual ticker"
+  | Timed c ->
+    let rec loop () =
+      let next = t.tick + 1 in
+      let remaining = Float.of_int next *. t.period -. c.now () in
+      if remaining > 0.0 then c.sleep remaining;
+      let reached = max next (int_of_float (c.now () /. t.period)) in
+      t.overruns <- t.overruns + (reached - next);
+      t.tick <- reached;
+      Eio.Condition.broadcast t.wake;
+      loop ()
+    in
+    loop ()
+
+let to_json t =
+  `Assoc [("rate", `Int t.rate); ("ticks", `Int t.tick); ("overruns", `Int t.overruns)]
+
+(** {1 Frame Schedules} *)
+
+type catch_up =
+  | Skip        (** drop missed frames, send only the current one *)
+  | Burst of int  (** send up to [n] missed frames immediately *)
+
+type schedule = {
+  ticker : t;
+  fps : int;
+  policy : catch_up;
+  mutable origin : int;          (** ticker tick of frame 0 *)
+  mutable frame : int;           (** next frame index *)
+  mutable emitted : int;
+  mutable dropped : int;
+  mutable first_emit : float;
+  mutable last_emit : float;
+  mutable mean_interval : float;
+  mutable m2 : float;            (** Welford sum of squared interval deviations *)
+  mutable max_late : float;
+}
+
+(** Schedule [fps] frames per second on [ticker], starting now *)
+let schedule ?(policy = Skip) ticker ~fps =
+  if fps <= 0 then invalid_arg "Ticker.schedule: fps must be positive";
+  {
+    ticker; fps; policy;
+    origin = ticker.tick; frame = 0;
+    emitted = 0; dropped = 0;
+    first_emit = 0.0; last_emit = 0.0; mean_interval = 0.0; m2 = 0.0; max_late = 0.0;
+  }
+
+(** Restart at frame 0 on the current tick; statistics are kept *)
+let restart s =
+  s.origin <- s.ticker.tick;
+  s.frame <- 0
+
+let due_tick s n = s.origin + (n * s.ticker.rate + s.fps - 1) / s.fps
+
+(** Whether the next frame is due *)
+let due s = s.ticker.tick >= due_tick s s.frame
+
+(** Block until the next frame is due *)
+let await s = Eio.Condition.loop_no_mutex s.ticker.wake (fun () -> if due s then Some () else None)
+
+(** Claim the due frame, applying the catch-up policy to any backlog *)
+let take s =
+  let latest = (s.ticker.tick - s.origin) * s.fps / s.ticker.rate in
+  let backlog = latest - s.frame in
+  let keep = match s.policy with Skip -> 0 | Burst n -> max 0 n in
+  if backlog > keep then begin
+    s.dropped <- s.dropped + (backlog - keep);
+    s.frame <- latest - keep
+  end;
+  let now = now s.ticker in
+  let ideal = Float.of_int s.origin *. s.ticker.period +. Float.of_int s.frame /. Float.of_int s.fps in
+  s.max_late <- Float.max s.max_late (now -. ideal);
+  if s.emitted > 0 then begin
+    let x = now -. s.last_emit in
+    let d = x -. s.mean_interval in
+    s.mean_interval <- s.mean_interval +. d /. Float.of_int s.emitted;
+    s.m2 <- s.m2 +. d *. (x -. s.mean_interval)
+  end else s.first_emit <- now;
+  s.last_emit <- now;
+  s.emitted <- s.emitted + 1;
+  s.frame <- s.frame + 1
+
+(** Wait for and claim the next frame *)
+let next_frame s =
+  await s;
+  take s
+
+let frames s = s.emitted
+let dropped s = s.dropped
+
+(** Frames per second actually delivered *)
+let achieved_fps s =
+  let span = s.last_emit -. s.first_emit in
+  if s.emitted < 2 || span <= 0.0 then 0.0 else Float.of_int (s.emitted - 1) /. span
+
+(** Standard deviation of the intervals between frames, in seconds *)
+let jitter s = if s.emitted < 2 then 0.0 else Float.sqrt (s.m2 /. Float.of_int (s.emitted - 1))
+
+let policy_to_string = function
+  | Skip -> "skip"
+  | Burst n -> Printf.sprintf "burst:%d" n
+
+let schedule_to_json s =
+  `Assoc [
+    ("target_fps", `Int s.fps);
+    ("achieved_fps", `Float (achieved_fps s));
+    ("frames", `Int s.emitted);
+    ("dropped", `Int s.dropped);
+    ("jitter_ms", `Float (jitter s *. 1000.0));
+    ("max_late_ms", `Float (s.max_late *. 1000.0));
+    ("catch_up", `String (policy_to_string s.policy));
+  ]
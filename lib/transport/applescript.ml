@@ -21,9 +21,49 @@ let read_all_lines ic =
    with End_of_file -> ());
   Buffer.contents buf
 
-(** Execute osascript and return (stdout, stderr, status).
-    Raises on process creation errors. *)
-let run_osascript argv =
+(** Process manager for cancellable runs; set at server startup *)
+let process_mgr : Eio.Process.mgr_ty Eio.Resource.t option ref = ref None
+
+(** Run osascript through Eio's process manager from now on, so a
+    cancelled caller (a [notifications/cancelled] or a deadline) kills
+    the child instead of waiting for it. Without one, osascript runs as
+    a blocking child process. *)
+let set_process_mgr mgr =
+  process_mgr := Some (mgr :> Eio.Process.mgr_ty Eio.Resource.t)
+
+let clear_process_mgr () =
+  process_mgr := None
+
+let killed_count = ref 0
+
+(** Children killed because their caller was cancelled *)
+let killed () = !killed_count
+
+(** Run osascript as an Eio child process. Cancellation of the calling
+    fiber sends SIGKILL and re-raises. *)
+let run_osascript_eio mgr argv =
+  Eio.Switch.run @@ fun sw ->
+  let stdout_r, stdout_w = Eio.Process.pipe ~sw mgr in
+  let stderr_r, stderr_w = Eio.Process.pipe ~sw mgr in
+  let child = Eio.Process.spawn ~sw mgr ~stdout:stdout_w ~stderr:stderr_w (Array.to_list argv) in
+  Eio.Flow.close stdout_w;
+  Eio.Flow.close stderr_w;
+  let read r = Eio.Buf_read.(parse_exn take_all) ~max_size:16_000_000 r in
+  try
+    let stdout, stderr = Eio.Fiber.pair (fun () -> read stdout_r) (fun () -> read stderr_r) in
+    let status =
+      match Eio.Process.await child with
+      | `Exited code -> Unix.WEXITED code
+      | `Signaled signal -> Unix.WSIGNALED signal
+    in
+    (stdout, stderr, status)
+  with Eio.Cancel.Cancelled _ as exn ->
+    incr killed_count;
+    (try Eio.Process.signal child Sys.sigkill with _ -> ());
+    raise exn
+
+(** Run osascript as a blocking child process *)
+let run_osascript_blocking argv =
   let env = Unix.environment () in
   let stdout_ic, stdin_oc, stderr_ic =
     Unix.open_process_args_full "osascript" argv env
@@ -48,6 +88,13 @@ let run_osascript argv =
       in
       (stdout, stderr, status))
 
+(** Execute osascript and return (stdout, stderr, status).
+    Raises on process creation errors. *)
+let run_osascript argv =
+  match !process_mgr with
+  | Some mgr -> run_osascript_eio mgr argv
+  | None -> run_osascript_blocking argv
+
 (** Execute AppleScript code and return result *)
 let execute script =
   try
@@ -73,6 +120,7 @@ let execute script =
     | Unix.WSTOPPED _ ->
         { success = false; output = ""; error = Some "Process stopped" }
   with
+  | Eio.Cancel.Cancelled _ as exn -> raise exn
   | Unix.Unix_error (err, fn, arg) ->
       { success = false;
         output = "";
@@ -97,6 +145,7 @@ let execute_file path =
     | Unix.WEXITED 0 -> { success = true; output; error = None }
     | _ -> { success = false; output = ""; error = Some output }
   with
+  | Eio.Cancel.Cancelled _ as exn -> raise exn
   | Unix.Unix_error (err, fn, arg) ->
       { success = false;
         output = "";
@@ -7,6 +7,16 @@ type result = {
   error : string option;
 }
 
+val set_process_mgr : _ Eio.Process.mgr -> unit
+(** Run osascript through Eio from now on, so cancelling the calling
+    fiber (client cancellation or a deadline) kills the child process.
+    Without a process manager osascript runs as a blocking child. *)
+
+val clear_process_mgr : unit -> unit
+
+val killed : unit -> int
+(** osascript children killed because their caller was cancelled *)
+
 (** Execute AppleScript code and return result *)
 val execute : string -> result
 
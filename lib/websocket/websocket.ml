@@ -0,0 +1,266 @@
+(** WebSocket - RFC 6455 server side over Eio flows
+
+    One persistent connection carries JSON-RPC in both directions as text
+    messages (one message per JSON-RPC object, so the frame length is the
+    only framing and nothing is parsed per message beyond the 2-14 byte
+    frame header) and meter packets as binary messages.
+
+    Reading reassembles fragmented messages and answers pings itself.
+    Writes are serialized with a mutex so responses, notifications and
+    meter frames from different fibers never interleave; each frame goes
+    out as a single write of header and payload.
+*)
+
+(** {1 Handshake} *)
+
+let guid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+(** SHA-1 digest (20 raw bytes); only needed for the handshake *)
+let sha1 s =
+  let mask = 0xFFFFFFFF in
+  let rotl x n = ((x lsl n) lor (x lsr (32 - n))) land mask in
+  let len = String.length s in
+  let padded = ((len + 8) / 64 + 1) * 64 in
+  let msg = Bytes.make padded '\000' in
+  Bytes.blit_string s 0 msg 0 len;
+  Bytes.set msg len '\x80';
+  let bits = len * 8 in
+  for i = 0 to 7 do
+    Bytes.set msg (padded - 1 - i) (Char.chr ((bits lsr (8 * i)) land 0xFF))
+  done;
+  let h = [| 0x67452301; 0xEFCDAB89; 0x98BADCFE; 0x10325476; 0xC3D2E1F0 |] in
+  let w = Array.make 80 0 in
+  for chunk = 0 to padded / 64 - 1 do
+    for i = 0 to 15 do
+      let o = chunk * 64 + i * 4 in
+      let byte k = Char.code (Bytes.get msg (o + k)) in
+      w.(i) <- (byte 0 lsl 24) lor (byte 1 lsl 16) lor (byte 2 lsl 8) lor byte 3
+    done;
+    for i = 16 to 79 do
+      w.(i) <- rotl (w.(i - 3) lxor w.(i - 8) lxor w.(i - 14) lxor w.(i - 16)) 1
+    done;
+    let a = ref h.(0) and b = ref h.(1) and c = ref h.(2) and d = ref h.(3) and e = ref h.(4) in
+    for i = 0 to 79 do
+      let f, k =
+        if i < 20 then ((!b land !c) lor ((lnot !b) land !d)) land mask, 0x5A827999
+        else if i < 40 then !b lxor !c lxor !d, 0x6ED9EBA1
+        else if i < 60 then (!b land !c) lor (!b land !d) lor (!c land !d), 0x8F1BBCDC
+        else !b lxor !c lxor !d, 0xCA62C1D6
+      in
+      let temp = (rotl !a 5 + f + !e + k + w.(i)) land mask in
+      e := !d;
+      d := !c;
+      c := rotl !b 30;
+      b := !a;
+      a := temp
+    done;
+    h.(0) <- (h.(0) + !a) land mask;
+    h.(1) <- (h.(1) + !b) land mask;
+    h.(2) <- (h.(2) + !c) land mask;
+    h.(3) <- (h.(3) + !d) land mask;
+    h.(4) <- (h.(4) + !e) land mask
+  done;
+  String.init 20 (fun i -> Char.chr ((h.(i / 4) lsr (24 - 8 * (i mod 4))) land 0xFF))
+
+let base64 s =
+  let alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/" in
+  let len = String.length s in
+  let buf = Buffer.create ((len + 2) / 3 * 4) in
+  let byte i = if i < len then Char.code s.[i] else 0 in
+  let rec go i =
+    if i < len then begin
+      let n = (byte i lsl 16) lor (byte (i + 1) lsl 8) lor byte (i + 2) in
+      Buffer.add_char buf alphabet.[(n lsr 18) land 63];
+      Buffer.add_char buf alphabet.[(n lsr 12) land 63];
+      Buffer.add_char buf (if i + 1 < len then alphabet.[(n lsr 6) land 63] else '=');
+      Buffer.add_char buf (if i + 2 < len then alphabet.[n land 63] else '=');
+      go (i + 3)
+    end
+  in
+  go 0;
+  Buffer.contents buf
+
+(** [Sec-WebSocket-Accept] for a client's [Sec-WebSocket-Key] *)
+let accept_key key = base64 (sha1 (String.trim key ^ guid))
+
+let header headers name = List.assoc_opt name headers |> Option.map String.trim
+
+let has_token value token =
+  List.exists (fun t -> String.lowercase_ascii (String.trim t) = token) (String.split_on_char ',' value)
+
+(** Whether request headers (lowercase names) ask for a WebSocket upgrade;
+    returns the client key *)
+let upgrade_key headers =
+  match header headers "upgrade", header headers "connection", header headers "sec-websocket-key" with
+  | Some upgrade, Some connection, Some key
+    when String.lowercase_ascii upgrade = "websocket" && has_token connection "upgrade" ->
+    Some key
+  | _ -> None
+
+(** 101 response completing the handshake *)
+let handshake_response ~key =
+  String.concat "\r\n" [
+    "HTTP/1.1 101 Switching Protocols";
+    "Upgrade: websocket";
+    "Connection: Upgrade";
+    "Sec-WebSocket-Accept: " ^ accept_key key;
+    "\r\n"
+  ]
+
+(** {1 Frames} *)
+
+let op_continuation = 0x0
+let op_text = 0x1
+let op_binary = 0x2
+let op_close = 0x8
+let op_ping = 0x9
+let op_pong = 0xA
+
+(** Encode one frame. Servers send unmasked frames; clients pass a
+    4-byte [mask]. *)
+let encode_frame ?(fin = true) ?mask ~opcode payload =
+  let len = String.length payload in
+  let buf = Buffer.create (len + 14) in
+  Buffer.add_char buf (Char.chr ((if fin then 0x80 else 0) lor opcode));
+  let mask_bit = if Option.is_some mask then 0x80 else 0 in
+  if len < 126 then Buffer.add_char buf (Char.chr (mask_bit lor len))
+  else if len < 0x10000 then begin
+    Buffer.add_char buf (Char.chr (mask_bit lor 126));
+    Buffer.add_uint16_be buf len
+  end else begin
+    Buffer.add_char buf (Char.chr (mask_bit lor 127));
+    Buffer.add_int64_be buf (Int64.of_int len)
+  end;
+  (match mask with
+   | None -> Buffer.add_string buf payload
+   | Some key ->
+     if String.length key <> 4 then invalid_arg "Websocket.encode_frame: mask must be 4 bytes";
+     Buffer.add_string buf key;
+     String.iteri (fun i c ->
+       Buffer.add_char buf (Char.chr (Char.code c lxor Char.code key.[i land 3]))) payload);
+  Buffer.contents buf
+
+exception Protocol_error of int * string
+
+type message =
+  | Text of string
+  | Binary of string
+  | Close of int option  (** status code sent by the peer *)
+
+type t = {
+  input : Eio.Buf_read.t;
+  output : Eio.Flow.sink_ty Eio.Resource.t;
+  write_lock : Eio.Mutex.t;
+  max_message : int;
+  require_mask : bool;
+  mutable closed : bool;   (** close frame sent *)
+  mutable frames_in : int;
+  mutable frames_out : int;
+}
+
+(** Wrap an upgraded connection. Client frames must be masked unless
+    [require_mask] is false; messages over [max_message] bytes are
+    refused with status 1009. *)
+let create ?(max_message = 1_000_000) ?(require_mask = true) input (output : _ Eio.Flow.sink) =
+  {
+    input;
+    output = (output :> Eio.Flow.sink_ty Eio.Resource.t);
+    write_lock = Eio.Mutex.create ();
+    max_message;
+    require_mask;
+    closed = false;
+    frames_in = 0;
+    frames_out = 0;
+  }
+
+let write_frame t ~opcode payload =
+  let frame = encode_frame ~opcode payload in
+  Eio.Mutex.use_rw ~protect:true t.write_lock (fun () ->
+    if not t.closed then begin
+      if opcode = op_close then t.closed <- true;
+      Eio.Flow.copy_string frame t.output;
+      t.frames_out <- t.frames_out + 1
+    end)
+
+let send_text t s = write_frame t ~opcode:op_text s
+let send_binary t s = write_frame t ~opcode:op_binary s
+let send_ping t s = write_frame t ~opcode:op_ping s
+
+(** Send a close frame with [code] (default 1000); later sends are ignored *)
+let close ?(code = 1000) t =
+  let payload = Bytes.create 2 in
+  Bytes.set_uint16_be payload 0 code;
+  write_frame t ~opcode:op_close (Bytes.to_string payload)
+
+let is_closed t = t.closed
+
+type frame = { fin : bool; opcode : int; payload : string }
+
+let read_frame t =
+  let b0 = Char.code (Eio.Buf_read.any_char t.input) in
+  let b1 = Char.code (Eio.Buf_read.any_char t.input) in
+  if b0 land 0x70 <> 0 then raise (Protocol_error (1002, "reserved bits set"));
+  let masked = b1 land 0x80 <> 0 in
+  if t.require_mask && not masked then raise (Protocol_error (1002, "unmasked client frame"));
+  let len =
+    match b1 land 0x7F with
+    | 126 -> String.get_uint16_be (Eio.Buf_read.take 2 t.input) 0
+    | 127 ->
+      let n = String.get_int64_be (Eio.Buf_read.take 8 t.input) 0 in
+      if Int64.compare n 0L < 0 || Int64.compare n (Int64.of_int t.max_message) > 0 then
+        raise (Protocol_error (1009, "frame too large"));
+      Int64.to_int n
+    | n -> n
+  in
+  if len > t.max_message then raise (Protocol_error (1009, "frame too large"));
+  let key = if masked then Eio.Buf_read.take 4 t.input else "" in
+  let data = Eio.Buf_read.take len t.input in
+  let payload =
+    if not masked then data
+    else String.mapi (fun i c -> Char.chr (Char.code c lxor Char.code key.[i land 3])) data
+  in
+  t.frames_in <- t.frames_in + 1;
+  { fin = b0 land 0x80 <> 0; opcode = b0 land 0x0F; payload }
+
+(** Next data message. Fragments are reassembled, pings answered and
+    pongs skipped. A close frame is answered and returned as [Close].
+    Protocol violations close the connection with their status code and
+    also return [Close]. Raises [End_of_file] if the peer disconnects. *)
+let read_message t =
+  let pending = Buffer.create 256 in
+  let rec next started =
+    let f = read_frame t in
+    if f.opcode = op_ping then begin
+      write_frame t ~opcode:op_pong f.payload;
+      next started
+    end
+    else if f.opcode = op_pong then next started
+    else if f.opcode = op_close then begin
+      let code =
+        if String.length f.payload >= 2 then Some (String.get_uint16_be f.payload 0) else None
+      in
+      close t;
+      Close code
+    end
+    else begin
+      let started =
+        match started, f.opcode with
+        | None, op when op = op_text || op = op_binary -> Some op
+        | Some _, op when op = op_continuation -> started
+        | _ -> raise (Protocol_error (1002, "unexpected frame"))
+      in
+      if Buffer.length pending + String.length f.payload > t.max_message then
+        raise (Protocol_error (1009, "message too large"));
+      Buffer.add_string pending f.payload;
+      if not f.fin then next started
+      else if started = Some op_text then Text (Buffer.contents pending)
+      else Binary (Buffer.contents pending)
+    end
+  in
+  try next None with Protocol_error (code, _) ->
+    close ~code t;
+    Close (Some code)
+
+(** Frames read and written *)
+let frames_in t = t.frames_in
+let frames_out t = t.frames_out
@@ -0,0 +1,63 @@
+(** WebSocket - RFC 6455 server side over Eio flows
+
+    Carries JSON-RPC as text messages (one object per message, framed
+    only by the WebSocket length prefix) and meter packets as binary
+    messages over one persistent connection. *)
+
+(** {1 Handshake} *)
+
+val sha1 : string -> string
+(** SHA-1 digest, 20 raw bytes *)
+
+val accept_key : string -> string
+(** [Sec-WebSocket-Accept] value for a [Sec-WebSocket-Key] *)
+
+val upgrade_key : (string * string) list -> string option
+(** The client key if request headers (lowercase names) ask for a
+    WebSocket upgrade *)
+
+val handshake_response : key:string -> string
+(** [101 Switching Protocols] response, including the blank line *)
+
+(** {1 Frames} *)
+
+val op_continuation : int
+val op_text : int
+val op_binary : int
+val op_close : int
+val op_ping : int
+val op_pong : int
+
+val encode_frame : ?fin:bool -> ?mask:string -> opcode:int -> string -> string
+(** One frame; clients pass a 4-byte [mask] *)
+
+(** {1 Connections} *)
+
+type t
+
+type message =
+  | Text of string
+  | Binary of string
+  | Close of int option  (** peer's status code, or ours after a protocol error *)
+
+val create : ?max_message:int -> ?require_mask:bool -> Eio.Buf_read.t -> _ Eio.Flow.sink -> t
+(** Wrap an upgraded connection. Client frames must be masked unless
+    [require_mask] is false (default true); messages over [max_message]
+    bytes (default 1 MB) close the connection with status 1009. *)
+
+val read_message : t -> message
+(** Next data message, reassembling fragments and answering pings.
+    Raises [End_of_file] if the peer disconnects. *)
+
+val send_text : t -> string -> unit
+val send_binary : t -> string -> unit
+val send_ping : t -> string -> unit
+(** Sends are serialized across fibers and ignored after [close] *)
+
+val close : ?code:int -> t -> unit
+(** Send a close frame (default status 1000) *)
+
+val is_closed : t -> bool
+
+val frames_in : t -> int
+val frames_out : t -> int
@@ -45,7 +45,7 @@ let test_create_context () =
   Eio.Switch.run @@ fun sw ->
   let net = Eio.Stdenv.net env in
   let clock = Eio.Stdenv.clock env in
-  let ctx = Mcp_server.create_context ~sw ~net ~clock in
+  let ctx = Mcp_server.create_context ~sw ~net ~clock () in
   (* Just check the context was created - more detailed tests would require a running DAW *)
   let integration = ctx.Mcp_server.integration in
   Alcotest.(check bool) "not connected initially" false (Daw_integration.is_connected integration)
@@ -56,7 +56,7 @@ let test_process_daw_status () =
   Eio.Switch.run @@ fun sw ->
   let net = Eio.Stdenv.net env in
   let clock = Eio.Stdenv.clock env in
-  let ctx = Mcp_server.create_context ~sw ~net ~clock in
+  let ctx = Mcp_server.create_context ~sw ~net ~clock () in
   let request = {|{"jsonrpc":"2.0","id":1,"method":"tools/call","params":{"name":"daw_status","arguments":{}}}|} in
   let response = Mcp_server.process_json_with_context ~ctx request in
   let open Yojson.Safe.Util in
@@ -76,14 +76,14 @@ let test_process_tools_list_with_context () =
   Eio.Switch.run @@ fun sw ->
   let net = Eio.Stdenv.net env in
   let clock = Eio.Stdenv.clock env in
-  let ctx = Mcp_server.create_context ~sw ~net ~clock in
+  let ctx = Mcp_server.create_context ~sw ~net ~clock () in
   let request = {|{"jsonrpc":"2.0","id":1,"method":"tools/list"}|} in
   let response = Mcp_server.process_json_with_context ~ctx request in
   let open Yojson.Safe.Util in
 
   let tools = response |> member "result" |> member "tools" |> to_list in
-  (* 7 base + 5 Phase 6 + 5 Phase 5 tools = 17 total *)
-  Alcotest.(check bool) "has 17 tools" true (List.length tools = 17)
+  (* 7 base + 7 Phase 6 (4 metering, 3 automation) + 5 Phase 5 tools = 19 total *)
+  Alcotest.(check bool) "has 19 tools" true (List.length tools = 19)
 
 (** Test connection error handling *)
 let test_connection_error_handling () =
@@ -91,7 +91,7 @@ let test_connection_error_handling () =
   Eio.Switch.run @@ fun sw ->
   let net = Eio.Stdenv.net env in
   let clock = Eio.Stdenv.clock env in
-  let ctx = Mcp_server.create_context ~sw ~net ~clock in
+  let ctx = Mcp_server.create_context ~sw ~net ~clock () in
   (* Try to play without connecting - should return error *)
   let request = {|{"jsonrpc":"2.0","id":1,"method":"tools/call","params":{"name":"daw_transport","arguments":{"action":"play"}}}|} in
   let response = Mcp_server.process_json_with_context ~ctx request in
@@ -103,6 +103,149 @@ let test_connection_error_handling () =
   let success = inner |> member "success" |> to_bool in
   Alcotest.(check bool) "should fail without connection" false success
 
+(** Test instance id formatting *)
+let test_instance_id () =
+  let open Daw_driver.Driver in
+  Alcotest.(check string) "default endpoint" "reaper" (Daw_integration.instance_id Reaper None);
+  Alcotest.(check string) "custom endpoint" "ableton@10.0.0.2:11000"
+    (Daw_integration.instance_id Ableton (Some { host = "10.0.0.2"; port = 11000; protocol = Udp }));
+  Alcotest.(check string) "tcp endpoint" "reaper@tcp:10.0.0.2:9000"
+    (Daw_integration.instance_id Reaper (Some { host = "10.0.0.2"; port = 9000; protocol = Tcp Slip }))
+
+(** Test two Reaper instances coexist and are routed independently *)
+let test_multiple_instances () =
+  Eio_main.run @@ fun env ->
+  Eio.Switch.run @@ fun sw ->
+  let net = Eio.Stdenv.net env in
+  let clock = Eio.Stdenv.clock env in
+  Daw_integration.register_all_drivers ();
+  let integration = Daw_integration.create () in
+  let open Daw_driver.Driver in
+  let connect port =
+    Daw_integration.connect_to_daw integration ~sw ~net
+      ~endpoint:{ host = "127.0.0.1"; port; protocol = Udp } Reaper
+  in
+  Alcotest.(check bool) "first connected" true (Result.is_ok (connect 19001));
+  Alcotest.(check bool) "second connected" true (Result.is_ok (connect 19002));
+  let instances = Daw_integration.list_instances integration in
+  Alcotest.(check (list string)) "both listed"
+    ["reaper@127.0.0.1:19001"; "reaper@127.0.0.1:19002"]
+    (List.map (fun (i : Daw_integration.instance_info) -> i.instance_id) instances);
+  let target id = Daw_integration.{ daw = None; instance = Some id } in
+  let play id () =
+    Result.is_ok (Daw_integration.Transport.play ~target:(target id) integration ~sw ~net ~clock)
+  in
+  let a, b = Eio.Fiber.pair (play "reaper@127.0.0.1:19001") (play "reaper@127.0.0.1:19002") in
+  Alcotest.(check bool) "first played" true a;
+  Alcotest.(check bool) "second played" true b;
+  match Daw_integration.Transport.play ~target:(target "nope") integration ~sw ~net ~clock with
+  | Error (`Unknown_instance "nope") -> ()
+  | _ -> Alcotest.fail "expected unknown instance error"
+
+(** Test reconnecting an instance closes the driver it replaces *)
+let test_reconnect_closes_driver () =
+  Eio_main.run @@ fun env ->
+  Eio.Switch.run @@ fun sw ->
+  let net = Eio.Stdenv.net env in
+  Daw_integration.register_all_drivers ();
+  let integration = Daw_integration.create () in
+  let connect () =
+    Daw_integration.connect_to_daw integration ~sw ~net
+      ~endpoint:Daw_driver.Driver.{ host = "127.0.0.1"; port = 19003; protocol = Udp } Reaper
+  in
+  let open_fds () = Array.length (Sys.readdir "/dev/fd") in
+  Alcotest.(check bool) "connected" true (Result.is_ok (connect ()));
+  let before = open_fds () in
+  for _ = 1 to 10 do ignore (connect ()) done;
+  Alcotest.(check int) "no descriptors leaked" before (open_fds ())
+
+(** Test disconnect_all releases instances so connect cycles do not leak *)
+let test_disconnect_all_cycles () =
+  Eio_main.run @@ fun env ->
+  Eio.Switch.run @@ fun sw ->
+  let net = Eio.Stdenv.net env in
+  Daw_integration.register_all_drivers ();
+  let integration = Daw_integration.create () in
+  let connect () =
+    Daw_integration.connect_to_daw integration ~sw ~net
+      ~endpoint:Daw_driver.Driver.{ host = "127.0.0.1"; port = 19004; protocol = Udp } Reaper
+  in
+  let open_fds () = Array.length (Sys.readdir "/dev/fd") in
+  let before = open_fds () in
+  for _ = 1 to 10 do
+    Alcotest.(check bool) "connected" true (Result.is_ok (connect ()));
+    Daw_integration.disconnect_all integration
+  done;
+  Alcotest.(check int) "no instances" 0 (List.length (Daw_integration.list_instances integration));
+  Alcotest.(check int) "no descriptors leaked" before (open_fds ())
+
+(** Test tool routing to an unknown instance *)
+let test_unknown_instance_routing () =
+  Eio_main.run @@ fun env ->
+  Eio.Switch.run @@ fun sw ->
+  let net = Eio.Stdenv.net env in
+  let clock = Eio.Stdenv.clock env in
+  let ctx = Mcp_server.create_context ~sw ~net ~clock () in
+  let request = {|{"jsonrpc":"2.0","id":1,"method":"tools/call","params":{"name":"daw_tempo","arguments":{"instance":"reaper@10.9.9.9:1"}}}|} in
+  let response = Mcp_server.process_json_with_context ~ctx request in
+  let open Yojson.Safe.Util in
+  let content = response |> member "result" |> member "content" |> to_list in
+  let inner = List.hd content |> member "text" |> to_string |> Yojson.Safe.from_string in
+  Alcotest.(check bool) "fails" false (inner |> member "success" |> to_bool);
+  Alcotest.(check string) "error" "Unknown instance: reaper@10.9.9.9:1"
+    (inner |> member "error" |> to_string)
+
+(** Call a tool on a fresh context and return its decoded result *)
+let call_tool name arguments =
+  Eio_main.run @@ fun env ->
+  Eio.Switch.run @@ fun sw ->
+  let ctx = Mcp_server.create_context ~sw ~net:(Eio.Stdenv.net env) ~clock:(Eio.Stdenv.clock env) () in
+  let request = Yojson.Safe.to_string (`Assoc [
+    ("jsonrpc", `String "2.0"); ("id", `Int 1); ("method", `String "tools/call");
+    ("params", `Assoc [("name", `String name); ("arguments", arguments)]);
+  ]) in
+  let open Yojson.Safe.Util in
+  Mcp_server.process_json_with_context ~ctx request
+  |> member "result" |> member "content" |> to_list |> List.hd
+  |> member "text" |> to_string |> Yojson.Safe.from_string
+
+(** Test daw_meter rejects an unknown ballistics preset *)
+let test_meter_unknown_ballistics () =
+  let open Yojson.Safe.Util in
+  let inner = call_tool "daw_meter" (`Assoc [("ballistics", `String "bogus")]) in
+  Alcotest.(check bool) "fails" false (inner |> member "success" |> to_bool);
+  Alcotest.(check string) "error" "Unknown ballistics: bogus" (inner |> member "error" |> to_string);
+  let inner = call_tool "daw_meter" (`Assoc [("ballistics", `String "vu"); ("loudness", `Bool false)]) in
+  Alcotest.(check bool) "preset accepted" true (inner |> member "success" |> to_bool)
+
+(** Test daw_spectrum bounds fft_size and points *)
+let test_spectrum_bounds () =
+  let open Yojson.Safe.Util in
+  List.iter (fun size ->
+    let inner = call_tool "daw_spectrum" (`Assoc [("fft_size", `Int size)]) in
+    Alcotest.(check bool) (Printf.sprintf "fft_size %d rejected" size) false
+      (inner |> member "success" |> to_bool)) [1000; 1 lsl 30; 0];
+  let spectrum points =
+    call_tool "daw_spectrum" (`Assoc [("fft_size", `Int 1024); ("points", `Int points)])
+    |> member "analysis" |> member "spectrum" |> to_list |> List.length
+  in
+  Alcotest.(check int) "points capped" 1024 (spectrum 1_000_000);
+  Alcotest.(check int) "at least one point" 1 (spectrum (-5))
+
+(** Test daw_detect rejects incomplete or unknown endpoints *)
+let test_detect_bad_endpoint () =
+  let open Yojson.Safe.Util in
+  List.iter (fun (args, error) ->
+    let inner = call_tool "daw_detect" (`Assoc (("daw", `String "reaper") :: args)) in
+    Alcotest.(check bool) error false (inner |> member "connected" |> to_bool);
+    Alcotest.(check string) "error" error (inner |> member "error" |> to_string))
+    [
+      ([("transport", `String "tcp")], {|transport "tcp" requires port|});
+      ([("transport", `String "unix")], {|transport "unix" requires path|});
+      ([("transport", `String "quic"); ("port", `Int 9000)], "Unknown transport: quic");
+      ([("host", `String "10.0.0.2")], "host requires port");
+    ]
+
 (** All tests *)
 let () =
   Alcotest.run "Integration" [
@@ -111,6 +254,13 @@ let () =
       Alcotest.test_case "status disconnected" `Quick test_status_disconnected;
       Alcotest.test_case "get_driver disconnected" `Quick test_get_driver_disconnected;
       Alcotest.test_case "daw_name" `Quick test_daw_name;
+      Alcotest.test_case "instance_id" `Quick test_instance_id;
+    ];
+    "instances", [
+      Alcotest.test_case "multiple instances" `Quick test_multiple_instances;
+      Alcotest.test_case "unknown instance routing" `Quick test_unknown_instance_routing;
+      Alcotest.test_case "reconnect closes driver" `Quick test_reconnect_closes_driver;
+      Alcotest.test_case "disconnect_all cycles" `Quick test_disconnect_all_cycles;
     ];
     "detection", [
       Alcotest.test_case "detect_running_daws" `Quick test_detect_running_daws;
@@ -121,4 +271,9 @@ let () =
       Alcotest.test_case "process tools/list" `Quick test_process_tools_list_with_context;
       Alcotest.test_case "connection error" `Quick test_connection_error_handling;
     ];
+    "tools", [
+      Alcotest.test_case "daw_meter unknown ballistics" `Quick test_meter_unknown_ballistics;
+      Alcotest.test_case "daw_detect bad endpoint" `Quick test_detect_bad_endpoint;
+      Alcotest.test_case "daw_spectrum bounds" `Quick test_spectrum_bounds;
+    ];
   ]
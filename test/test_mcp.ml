@@ -115,6 +115,181 @@ let test_process_line () =
   let result = response |> member "result" in
   Alcotest.(check bool) "has result" true (result <> `Null)
 
+(** {1 Dispatch Tests} *)
+
+(** Run [f dispatch] with responses collected in order of writing *)
+let with_dispatch ?max_in_flight ?ordering f =
+  Eio_main.run @@ fun _env ->
+  let out = Buffer.create 64 in
+  Eio.Switch.run (fun sw ->
+    let dispatch = Dispatch.create ~sw ?max_in_flight ?ordering (Buffer.add_string out) in
+    f dispatch;
+    Dispatch.drain dispatch;
+    (Buffer.contents out, Dispatch.stats dispatch))
+
+(** Lines named "slow" wait for [release]; others answer at once *)
+let gated_handler release line =
+  if line = "slow" then Eio.Promise.await release;
+  Some line
+
+let test_dispatch_out_of_order () =
+  let (out, _) = with_dispatch (fun d ->
+    let release, resolve = Eio.Promise.create () in
+    Dispatch.submit d (gated_handler release) "slow";
+    Dispatch.submit d (gated_handler release) "fast";
+    Eio.Fiber.yield ();
+    Eio.Promise.resolve resolve ())
+  in
+  Alcotest.(check string) "fast first" "fast\nslow\n" out
+
+let test_dispatch_ordered () =
+  let (out, _) = with_dispatch ~ordering:Dispatch.Ordered (fun d ->
+    let release, resolve = Eio.Promise.create () in
+    Dispatch.submit d (gated_handler release) "slow";
+    Dispatch.submit d (fun _ -> None) "notification";
+    Dispatch.submit d (gated_handler release) "fast";
+    Eio.Fiber.yield ();
+    Eio.Promise.resolve resolve ())
+  in
+  Alcotest.(check string) "request order" "slow\nfast\n" out
+
+let test_dispatch_limit () =
+  let (out, stats) = with_dispatch ~max_in_flight:2 (fun d ->
+    List.iter (Dispatch.submit d (fun line -> Eio.Fiber.yield (); Some line)) ["a"; "b"; "c"; "d"; "e"])
+  in
+  let open Yojson.Safe.Util in
+  Alcotest.(check int) "peak" 2 (stats |> member "peak_in_flight" |> to_int);
+  Alcotest.(check int) "completed" 5 (stats |> member "completed" |> to_int);
+  Alcotest.(check int) "all written" 5 (List.length (String.split_on_char '\n' (String.trim out)))
+
+let test_dispatch_handler_failure () =
+  let (out, stats) = with_dispatch ~ordering:Dispatch.Ordered (fun d ->
+    Dispatch.submit d (fun _ -> failwith "boom") {|{"jsonrpc":"2.0","id":5,"method":"tools/call"}|};
+    Dispatch.submit d (fun _ -> failwith "boom") {|{"jsonrpc":"2.0","method":"notifications/progress"}|};
+    Dispatch.submit d (fun line -> Some line) "good")
+  in
+  match String.split_on_char '\n' out with
+  | [error; "good"; ""] ->
+    let open Yojson.Safe.Util in
+    let json = Yojson.Safe.from_string error in
+    Alcotest.(check int) "request id" 5 (json |> member "id" |> to_int);
+    Alcotest.(check int) "internal error" (-32603) (json |> member "error" |> member "code" |> to_int);
+    Alcotest.(check int) "failed" 2 (stats |> member "failed" |> to_int)
+  | _ -> Alcotest.failf "unexpected output %S" out
+
+let test_dispatch_ping_not_blocked () =
+  (* A ping behind a stalled tool call is answered before the call ends *)
+  let (out, _) = with_dispatch (fun d ->
+    let release, resolve = Eio.Promise.create () in
+    Dispatch.submit d (fun _ -> Eio.Promise.await release; Some "tool") "tool";
+    Dispatch.submit d (fun line -> Some (Mcp_server.process_line line))
+      {|{"jsonrpc":"2.0","id":2,"method":"ping"}|};
+    Eio.Fiber.yield ();
+    Eio.Promise.resolve resolve ())
+  in
+  match String.split_on_char '\n' out with
+  | ping :: _ ->
+    let json = Yojson.Safe.from_string ping in
+    Alcotest.(check int) "ping id" 2 Yojson.Safe.Util.(json |> member "id" |> to_int)
+  | [] -> Alcotest.fail "no output"
+
+let test_dispatch_control_at_limit () =
+  (* With every slot held by a stalled call, ping and cancellation still run *)
+  let cancelled = ref false in
+  let (out, stats) = with_dispatch ~max_in_flight:1 (fun d ->
+    let release, resolve = Eio.Promise.create () in
+    Dispatch.submit d (fun _ -> Eio.Promise.await release; Some "tool") "tool";
+    Dispatch.submit d (fun _ -> cancelled := true; None)
+      {|{"jsonrpc":"2.0","method":"notifications/cancelled","params":{"requestId":1}}|};
+    Dispatch.submit d (fun line -> Some (Mcp_server.process_line line))
+      {|{"jsonrpc":"2.0","id":2,"method":"ping"}|};
+    Eio.Fiber.yield ();
+    Alcotest.(check bool) "cancel handled" true !cancelled;
+    Eio.Promise.resolve resolve ())
+  in
+  Alcotest.(check int) "peak over the limit" 2 Yojson.Safe.Util.(stats |> member "peak_in_flight" |> to_int);
+  match String.split_on_char '\n' out with
+  | ping :: "tool" :: _ ->
+    let json = Yojson.Safe.from_string ping in
+    Alcotest.(check int) "ping id" 2 Yojson.Safe.Util.(json |> member "id" |> to_int)
+  | _ -> Alcotest.failf "unexpected output %S" out
+
+let test_dispatch_ping_behind_child_process () =
+  (* A call waiting on a real child process (as osascript runs through
+     Eio's process manager) must not stall the domain *)
+  Eio_main.run @@ fun env ->
+  let mgr = Eio.Stdenv.process_mgr env in
+  let out = Buffer.create 64 in
+  Eio.Switch.run (fun sw ->
+    let dispatch = Dispatch.create ~sw (Buffer.add_string out) in
+    Dispatch.submit dispatch (fun _ -> Eio.Process.run mgr ["sleep"; "0.2"]; Some "tool") "tool";
+    Dispatch.submit dispatch (fun line -> Some (Mcp_server.process_line line))
+      {|{"jsonrpc":"2.0","id":2,"method":"ping"}|};
+    Dispatch.drain dispatch);
+  match String.split_on_char '\n' (Buffer.contents out) with
+  | ping :: "tool" :: _ ->
+    let json = Yojson.Safe.from_string ping in
+    Alcotest.(check int) "ping id" 2 Yojson.Safe.Util.(json |> member "id" |> to_int)
+  | _ -> Alcotest.failf "unexpected output %S" (Buffer.contents out)
+
+(** {1 Cancellation Tests} *)
+
+let new_requests () = Mcp_server.{ running = Hashtbl.create 4; cancelled = 0; timed_out = 0 }
+
+let error_code response =
+  Yojson.Safe.Util.(response |> member "error" |> member "code" |> to_int)
+
+let test_cancel_request () =
+  Eio_main.run @@ fun env ->
+  let requests = new_requests () in
+  let clock = Eio.Stdenv.clock env in
+  let finished = ref false in
+  let response =
+    Eio.Fiber.first
+      (fun () ->
+        Mcp_server.run_cancellable requests ~session:"a" ~clock ~deadline:10.0 (Some (`Int 7)) (fun () ->
+          Eio.Time.sleep clock 5.0;
+          finished := true;
+          `Null))
+      (fun () ->
+        Eio.Fiber.yield ();
+        Alcotest.(check int) "registered" 1 (Hashtbl.length requests.Mcp_server.running);
+        Mcp_server.cancel_request requests ~session:"b" (Some (`Assoc [("requestId", `Int 7)]));
+        Eio.Fiber.yield ();
+        Alcotest.(check int) "other session cannot cancel" 0 requests.Mcp_server.cancelled;
+        Mcp_server.cancel_request requests ~session:"a"
+          (Some (`Assoc [("requestId", `Int 7); ("reason", `String "user gave up")]));
+        Eio.Fiber.await_cancel ())
+  in
+  Alcotest.(check int) "cancelled code" Mcp_server.cancelled_code (error_code response);
+  Alcotest.(check bool) "work stopped" false !finished;
+  Alcotest.(check int) "unregistered" 0 (Hashtbl.length requests.Mcp_server.running);
+  Alcotest.(check int) "counted" 1 requests.Mcp_server.cancelled
+
+let test_cancel_unknown_request () =
+  let requests = new_requests () in
+  Mcp_server.cancel_request requests ~session:"a" (Some (`Assoc [("requestId", `String "missing")]));
+  Mcp_server.cancel_request requests ~session:"a" None;
+  Alcotest.(check int) "nothing cancelled" 0 requests.Mcp_server.cancelled
+
+let test_deadline () =
+  Eio_main.run @@ fun env ->
+  let requests = new_requests () in
+  let clock = Eio.Stdenv.clock env in
+  let response =
+    Mcp_server.run_cancellable requests ~session:"a" ~clock ~deadline:0.01 (Some (`Int 1)) (fun () ->
+      Eio.Time.sleep clock 5.0;
+      `Null)
+  in
+  Alcotest.(check int) "timeout code" Mcp_server.timeout_code (error_code response);
+  Alcotest.(check int) "counted" 1 requests.Mcp_server.timed_out;
+  Alcotest.(check int) "unregistered" 0 (Hashtbl.length requests.Mcp_server.running)
+
+let test_tool_deadlines () =
+  Alcotest.(check (float 0.0)) "default" Mcp_server.default_tool_deadline (Mcp_server.tool_deadline "daw_tempo");
+  Alcotest.(check bool) "render runs longer" true
+    (Mcp_server.tool_deadline "daw_render" > Mcp_server.default_tool_deadline)
+
 (** All tests *)
 let () =
   Alcotest.run "MCP Server" [
@@ -133,4 +308,19 @@ let () =
       Alcotest.test_case "unknown method" `Quick test_unknown_method;
       Alcotest.test_case "invalid JSON" `Quick test_invalid_json;
     ];
+    "dispatch", [
+      Alcotest.test_case "out of order" `Quick test_dispatch_out_of_order;
+      Alcotest.test_case "ordered" `Quick test_dispatch_ordered;
+      Alcotest.test_case "concurrency limit" `Quick test_dispatch_limit;
+      Alcotest.test_case "handler failure" `Quick test_dispatch_handler_failure;
+      Alcotest.test_case "ping not blocked" `Quick test_dispatch_ping_not_blocked;
+      Alcotest.test_case "control at the limit" `Quick test_dispatch_control_at_limit;
+      Alcotest.test_case "ping behind child process" `Quick test_dispatch_ping_behind_child_process;
+    ];
+    "cancellation", [
+      Alcotest.test_case "notifications/cancelled" `Quick test_cancel_request;
+      Alcotest.test_case "unknown request" `Quick test_cancel_unknown_request;
+      Alcotest.test_case "deadline" `Quick test_deadline;
+      Alcotest.test_case "tool deadlines" `Quick test_tool_deadlines;
+    ];
   ]
@@ -138,6 +138,43 @@ let test_meter_stereo_separate () =
   Alcotest.(check float_approx) "right RMS = 0.4" 0.4 meter.right.rms_linear;
   Alcotest.(check float_approx) "mono = 0.6" 0.6 meter.mono_sum.rms_linear
 
+(** {1 Fused Kernel Tests} *)
+
+let f32_of_array a = Bigarray.Array1.of_array Bigarray.float32 Bigarray.c_layout a
+
+let check_channel name (expected : channel_meter) (actual : channel_meter) =
+  Alcotest.(check bool) (name ^ " rms") true (float_eq ~eps:1e-9 expected.rms_linear actual.rms_linear);
+  Alcotest.(check bool) (name ^ " peak") true (float_eq ~eps:1e-9 expected.peak_linear actual.peak_linear)
+
+let test_fused_matches_naive () =
+  Random.init 42;
+  let frames = 1000 in
+  let inter = f32_of_array (Array.init (2 * frames) (fun _ -> Random.float 2.0 -. 1.0)) in
+  (* Naive reference over the float32-rounded values *)
+  let left = Array.init frames (fun i -> Bigarray.Array1.get inter (2 * i)) in
+  let right = Array.init frames (fun i -> Bigarray.Array1.get inter (2 * i + 1)) in
+  let mono = Array.init frames (fun i -> (left.(i) +. right.(i)) /. 2.0) in
+  let fused = meter_stereo_f32 inter in
+  check_channel "left" (meter_channel left) fused.left;
+  check_channel "right" (meter_channel right) fused.right;
+  check_channel "mono" (meter_channel mono) fused.mono_sum;
+  let planar = meter_stereo_planar_f32 ~left:(f32_of_array left) ~right:(f32_of_array right) in
+  check_channel "planar left" (meter_channel left) planar.left;
+  check_channel "planar mono" (meter_channel mono) planar.mono_sum
+
+let test_fused_blocks () =
+  (* Accumulating in blocks equals one pass over the whole buffer *)
+  let inter = f32_of_array (Array.init 512 (fun i -> Float.sin (Float.of_int i *. 0.1))) in
+  let acc = create_acc () in
+  accumulate_interleaved ~off:0 ~frames:64 acc inter;
+  accumulate_interleaved ~off:128 ~frames:192 acc inter;
+  let blocks = stereo_of_acc acc in
+  let whole = meter_stereo_f32 inter in
+  check_channel "left" whole.left blocks.left;
+  check_channel "mono" whole.mono_sum blocks.mono_sum;
+  Alcotest.check_raises "out of range" (Invalid_argument "Metering.accumulate_interleaved")
+    (fun () -> accumulate_interleaved ~off:500 ~frames:10 acc inter)
+
 (** {1 Peak Hold Tests} *)
 
 let test_peak_hold_attack () =
@@ -197,6 +234,15 @@ let test_processor_create () =
   let meter = process_buffer mp samples in
   Alcotest.(check float_approx) "silence RMS" min_db meter.rms_db
 
+let test_process_meter_envelope () =
+  (* A measured block drives the same envelope as process_buffer *)
+  let mp = create_processor ~sample_rate:48000.0 in
+  let block = meter_channel (Array.make 48000 0.5) in
+  let short = process_meter mp block in
+  Alcotest.(check bool) "one step barely moves" true (short.rms_db < block.rms_db -. 6.0);
+  let long = process_meter ~frames:48000 mp block in
+  Alcotest.(check bool) "settles on the block level" true (Float.abs (long.rms_db -. block.rms_db) < 0.1)
+
 let test_stereo_processor () =
   let sp = create_stereo_processor ~sample_rate:44100.0 in
   let left = Array.init 512 (fun i -> 0.5 *. Float.sin (Float.of_int i *. 0.1)) in
@@ -238,6 +284,476 @@ let test_frame_with_input () =
   let input_json = json |> member "input" in
   Alcotest.(check bool) "has input" true (input_json <> `Null)
 
+(** {1 Loudness Tests} *)
+
+let sine ~amplitude ~seconds =
+  Array.init (int_of_float (seconds *. 48000.0)) (fun i ->
+    amplitude *. Float.sin (2.0 *. Float.pi *. 1000.0 *. Float.of_int i /. 48000.0))
+
+let check_lufs name expected actual =
+  match actual with
+  | Some v -> Alcotest.(check (float 0.1)) name expected v
+  | None -> Alcotest.fail (name ^ ": no reading")
+
+let test_loudness_sine () =
+  (* 1 kHz at -20 dBFS in both channels reads -20 LUFS *)
+  let lm = Loudness.create ~sample_rate:48000.0 ~channels:2 () in
+  let x = sine ~amplitude:0.1 ~seconds:5.0 in
+  Loudness.process_planar_array lm [| x; x |];
+  check_lufs "momentary" (-20.0) (Loudness.momentary lm);
+  check_lufs "short-term" (-20.0) (Loudness.short_term lm);
+  check_lufs "integrated" (-20.0) (Loudness.integrated lm);
+  check_lufs "range" 0.0 (Loudness.range lm)
+
+let test_loudness_mono () =
+  let lm = Loudness.create ~sample_rate:48000.0 ~channels:1 () in
+  Loudness.process_planar_array lm [| sine ~amplitude:0.1 ~seconds:1.0 |];
+  check_lufs "mono" (-23.0) (Loudness.momentary lm)
+
+let test_loudness_windows () =
+  let lm = Loudness.create ~sample_rate:48000.0 ~channels:2 () in
+  let x = sine ~amplitude:0.1 ~seconds:0.3 in
+  Loudness.process_planar_array lm [| x; x |];
+  Alcotest.(check bool) "no momentary before 400 ms" true (Loudness.momentary lm = None);
+  Loudness.process_planar_array lm [| x; x |];
+  Alcotest.(check bool) "momentary after 400 ms" true (Loudness.momentary lm <> None);
+  Alcotest.(check bool) "no short-term before 3 s" true (Loudness.short_term lm = None)
+
+let test_loudness_gating () =
+  (* Silence after the programme is below the absolute gate *)
+  let lm = Loudness.create ~sample_rate:48000.0 ~channels:2 () in
+  let x = sine ~amplitude:0.1 ~seconds:5.0 in
+  Loudness.process_planar_array lm [| x; x |];
+  let silence = Array.make (5 * 48000) 0.0 in
+  Loudness.process_planar_array lm [| silence; silence |];
+  Alcotest.(check bool) "momentary silent" true (Loudness.momentary lm = None);
+  check_lufs "integrated" (-20.1) (Loudness.integrated lm)
+
+let test_loudness_range () =
+  (* 10 s at -20 LUFS then 10 s at -30 LUFS: LRA of 10 LU *)
+  let lm = Loudness.create ~sample_rate:48000.0 ~channels:2 () in
+  let loud = sine ~amplitude:0.1 ~seconds:10.0 in
+  let quiet = sine ~amplitude:(10.0 ** (-1.5)) ~seconds:10.0 in
+  Loudness.process_planar_array lm [| loud; loud |];
+  Loudness.process_planar_array lm [| quiet; quiet |];
+  check_lufs "range" 10.0 (Loudness.range lm);
+  check_lufs "short-term" (-30.0) (Loudness.short_term lm);
+  check_lufs "max momentary" (-20.0) (Loudness.reading lm).Loudness.max_momentary
+
+let test_loudness_interleaved () =
+  (* Odd block sizes across sub-block boundaries match one planar pass *)
+  let x = sine ~amplitude:0.1 ~seconds:4.0 in
+  let planar = Loudness.create ~sample_rate:48000.0 ~channels:2 () in
+  Loudness.process_planar_array planar [| x; x |];
+  let buf = Bigarray.Array1.create Bigarray.float32 Bigarray.c_layout (2 * Array.length x) in
+  Array.iteri (fun i v -> buf.{2 * i} <- v; buf.{2 * i + 1} <- v) x;
+  let inter = Loudness.create ~sample_rate:48000.0 ~channels:2 () in
+  let frames = Array.length x in
+  let rec feed off =
+    if off < frames then begin
+      let n = min 1237 (frames - off) in
+      Loudness.process_interleaved ~off:(2 * off) ~frames:n inter buf;
+      feed (off + n)
+    end
+  in
+  feed 0;
+  match Loudness.short_term planar, Loudness.short_term inter with
+  | Some a, Some b -> Alcotest.(check (float 0.01)) "same short-term" a b
+  | _ -> Alcotest.fail "missing short-term"
+
+let test_frame_loudness_json () =
+  let lm = Loudness.create ~sample_rate:48000.0 ~channels:2 () in
+  let x = sine ~amplitude:0.1 ~seconds:1.0 in
+  Loudness.process_planar_array lm [| x; x |];
+  let output = meter_stereo ~left:x ~right:x in
+  let frame = create_frame ~timestamp:0.0 ~track_index:0 ~output ~loudness:(Loudness.reading lm) () in
+  let open Yojson.Safe.Util in
+  let l = frame_to_json frame |> member "loudness" in
+  Alcotest.(check (float 0.1)) "momentary" (-20.0) (l |> member "momentary_lufs" |> to_float);
+  Alcotest.(check bool) "short-term null" true (l |> member "short_term_lufs" = `Null);
+  let plain = create_frame ~timestamp:0.0 ~track_index:0 ~output () in
+  Alcotest.(check bool) "omitted without loudness" true
+    (frame_to_json plain |> member "loudness" = `Null)
+
+(** {1 True Peak Tests} *)
+
+(* fs/4 at 45 degrees: every sample is at 0.707 of the true amplitude *)
+let quarter_rate = Array.init 4800 (fun i ->
+  0.5 *. Float.sin (Float.pi /. 2.0 *. Float.of_int i +. Float.pi /. 4.0))
+
+let test_true_peak_intersample () =
+  let sample_db = linear_to_db (calculate_peak quarter_rate) in
+  let true_db = linear_to_db (calculate_true_peak quarter_rate) in
+  Alcotest.(check (float 0.05)) "sample peak 3 dB low" (-9.03) sample_db;
+  Alcotest.(check (float 0.2)) "true peak at amplitude" (-6.02) true_db
+
+let test_true_peak_low_freq () =
+  let x = Array.init 4800 (fun i -> 0.5 *. Float.sin (2.0 *. Float.pi *. 1000.0 *. Float.of_int i /. 48000.0)) in
+  Alcotest.(check (float 0.05)) "matches sample peak" (linear_to_db 0.5)
+    (linear_to_db (calculate_true_peak x))
+
+let test_true_peak_blocks () =
+  (* Streaming in odd-sized interleaved blocks matches the one-shot measure *)
+  let frames = Array.length quarter_rate in
+  let buf = Bigarray.Array1.create Bigarray.float32 Bigarray.c_layout (2 * frames) in
+  Array.iteri (fun i v -> buf.{2 * i} <- v; buf.{2 * i + 1} <- 0.5 *. v) quarter_rate;
+  let tp = True_peak.create ~channels:2 () in
+  let rec feed off =
+    if off < frames then begin
+      let n = min 37 (frames - off) in
+      True_peak.process_interleaved ~off:(2 * off) ~frames:n tp buf;
+      feed (off + n)
+    end
+  in
+  feed 0;
+  let expected = calculate_true_peak quarter_rate in
+  Alcotest.(check (float 1e-4)) "left" expected (True_peak.max_peak tp 0);
+  Alcotest.(check (float 1e-4)) "right" (0.5 *. expected) (True_peak.max_peak tp 1);
+  ignore (True_peak.take_peak tp 0);
+  Alcotest.(check (float 0.0)) "take resets block peak" 0.0 (True_peak.take_peak tp 0)
+
+let test_true_peak_processor () =
+  let sp = create_stereo_processor ~sample_rate:48000.0 in
+  let silent = Array.make 4800 0.0 in
+  ignore (process_stereo_buffer sp ~left:quarter_rate ~right:silent);
+  Alcotest.(check (float 0.2)) "left dBTP" (-6.02) (get_true_peak sp.left);
+  Alcotest.(check (float 0.0)) "right silent" min_db (get_true_peak sp.right);
+  ignore (process_stereo_buffer sp ~left:silent ~right:silent);
+  let (lh, _) = get_true_peak_holds sp in
+  Alcotest.(check (float 0.2)) "hold keeps the over" (-6.02) lh
+
+(** {1 Spectrum Tests} *)
+
+let band_level (bands : Spectrum.band array) hz =
+  let b = Array.to_list bands |> List.find (fun (b : Spectrum.band) -> b.center_hz = hz) in
+  b.level_db
+
+let test_spectrum_sine_band () =
+  let plan = Spectrum.create_plan 4096 in
+  let sp = Spectrum.create ~sample_rate:48000.0 plan in
+  Spectrum.process_array sp (sine ~amplitude:0.5 ~seconds:1.0);
+  let bands = Spectrum.bands sp in
+  Alcotest.(check bool) "frames analysed" true (Spectrum.frames sp > 0);
+  Alcotest.(check (float 0.5)) "1 kHz band at -6 dBFS" (-6.02) (band_level bands 1000.0);
+  Alcotest.(check bool) "250 Hz band far below" true (band_level bands 250.0 < -60.0);
+  Alcotest.(check (float 20.0)) "centroid" 1000.0 (Spectrum.centroid sp)
+
+let test_spectrum_windows () =
+  (* Every window reads a sine at the same level *)
+  List.iter (fun window ->
+    let sp = Spectrum.create ~sample_rate:48000.0 (Spectrum.create_plan ~window 2048) in
+    Spectrum.process_array sp (sine ~amplitude:0.5 ~seconds:0.5);
+    Alcotest.(check (float 0.5)) (Spectrum.window_to_string window) (-6.02)
+      (band_level (Spectrum.bands sp) 1000.0))
+    Spectrum.[Rectangular; Hann; Hamming; Blackman_harris]
+
+let test_spectrum_tilt () =
+  (* White noise has equal power per Hz: +3 dB per octave in third-octave bands *)
+  let rng = Random.State.make [| 42 |] in
+  let noise = Array.init (10 * 48000) (fun _ -> Random.State.float rng 2.0 -. 1.0) in
+  let sp = Spectrum.create ~smoothing:0.95 ~sample_rate:48000.0 (Spectrum.create_plan 4096) in
+  Spectrum.process_array sp noise;
+  let tilt = Spectrum.tilt_of_bands (Spectrum.bands sp) in
+  Alcotest.(check bool) (Printf.sprintf "tilt %.2f near +3 dB/oct" tilt) true
+    (tilt > 2.0 && tilt < 4.0)
+
+let test_spectrum_stride () =
+  (* Feeding one channel of an interleaved buffer matches a planar feed *)
+  let x = sine ~amplitude:0.25 ~seconds:0.5 in
+  let buf = Bigarray.Array1.create Bigarray.float32 Bigarray.c_layout (2 * Array.length x) in
+  Array.iteri (fun i v -> buf.{2 * i} <- 0.0; buf.{2 * i + 1} <- v) x;
+  let plan = Spectrum.create_plan 1024 in
+  let a = Spectrum.create ~sample_rate:48000.0 plan in
+  let b = Spectrum.create ~sample_rate:48000.0 plan in
+  Spectrum.process_array a x;
+  Spectrum.process_f32 ~off:1 ~stride:2 b buf;
+  Alcotest.(check int) "same frames" (Spectrum.frames a) (Spectrum.frames b);
+  Alcotest.(check (float 0.01)) "same centroid" (Spectrum.centroid a) (Spectrum.centroid b)
+
+let test_spectrum_json () =
+  let sp = Spectrum.create ~sample_rate:48000.0 (Spectrum.create_plan 1024) in
+  Spectrum.process_array sp (sine ~amplitude:0.5 ~seconds:0.2);
+  let json = Spectrum.analysis_to_json (Spectrum.analysis ~points:16 sp) in
+  let open Yojson.Safe.Util in
+  Alcotest.(check int) "points" 16 (json |> member "spectrum" |> to_list |> List.length);
+  Alcotest.(check bool) "bands" true (json |> member "bands" |> to_list <> [])
+
+(** {1 Envelope Follower Tests} *)
+
+let dc ~level ~seconds = Array.make (int_of_float (seconds *. 48000.0)) level
+
+let test_envelope_block_size () =
+  (* The same audio in 64- and 1024-frame blocks gives the same reading *)
+  let x = sine ~amplitude:0.5 ~seconds:0.5 in
+  let run block =
+    let sp = create_stereo_processor ~sample_rate:48000.0 in
+    let last = ref None in
+    let rec go off =
+      if off < Array.length x then begin
+        let n = min block (Array.length x - off) in
+        let chunk = Array.sub x off n in
+        last := Some (process_stereo_buffer sp ~left:chunk ~right:chunk);
+        go (off + n)
+      end
+    in
+    go 0;
+    Option.get !last
+  in
+  let small = run 64 and large = run 1024 in
+  Alcotest.(check (float 1e-9)) "rms" large.left.rms_db small.left.rms_db;
+  Alcotest.(check (float 1e-9)) "peak" large.left.peak_db small.left.peak_db
+
+let test_envelope_vu () =
+  (* A VU meter reads a sine's RMS and takes 300 ms to get there *)
+  let sp = create_stereo_processor ~sample_rate:48000.0 in
+  set_stereo_ballistics sp vu;
+  let x = sine ~amplitude:0.5 ~seconds:0.1 in
+  let early = process_stereo_buffer sp ~left:x ~right:x in
+  let x = sine ~amplitude:0.5 ~seconds:0.2 in
+  let at_300ms = process_stereo_buffer sp ~left:x ~right:x in
+  let rms_db = linear_to_db (0.5 /. Float.sqrt 2.0) in
+  Alcotest.(check bool) "still rising at 100 ms" true (early.left.rms_db < rms_db -. 1.0);
+  Alcotest.(check (float 0.2)) "settled at 300 ms" rms_db at_300ms.left.rms_db
+
+let test_envelope_ppm () =
+  (* 10 ms bursts: type I reads -1 dB, type II -2.5 dB *)
+  let burst = dc ~level:1.0 ~seconds:0.01 in
+  List.iter (fun (name, preset, expected) ->
+    let mp = create_processor ~sample_rate:48000.0 in
+    set_ballistics mp preset;
+    let m = process_buffer mp burst in
+    Alcotest.(check (float 0.1)) name expected m.rms_db)
+    [("type I", ppm_type_1, -1.0); ("type II", ppm_type_2, -2.5)]
+
+let test_envelope_digital_release () =
+  (* Digital peak falls 20 dB in 1.7 s *)
+  let mp = create_processor ~sample_rate:48000.0 in
+  set_ballistics mp digital_peak;
+  ignore (process_buffer mp (dc ~level:1.0 ~seconds:0.01));
+  let m = process_buffer mp (dc ~level:0.0 ~seconds:1.7) in
+  Alcotest.(check (float 0.1)) "level" (-20.0) m.rms_db;
+  Alcotest.(check (float 0.1)) "peak" (-20.0) m.peak_db
+
+let test_envelope_presets () =
+  Alcotest.(check bool) "vu" true (ballistics_of_string "vu" = Some vu);
+  Alcotest.(check bool) "unknown" true (ballistics_of_string "fast" = None)
+
+(** {1 Stereo Field Tests} *)
+
+let field_of ~left ~right =
+  let acc = create_acc () in
+  accumulate_planar_array acc ~left ~right;
+  stereo_field_of_acc acc
+
+let sine_block ?(gain = 0.5) n = Array.init n (fun i -> gain *. Float.sin (Float.of_int i *. 0.05))
+
+let test_field_mono () =
+  let x = sine_block 4800 in
+  let f = field_of ~left:x ~right:x in
+  Alcotest.(check float_approx) "correlation" 1.0 f.correlation;
+  Alcotest.(check float_approx) "balance" 0.0 f.balance;
+  Alcotest.(check float_approx) "width" 0.0 f.width;
+  Alcotest.(check float_approx) "no mono loss" 0.0 f.mono_loss_db;
+  Alcotest.(check float_approx) "no side" (-. min_db) f.mid_side_db
+
+let test_field_antiphase () =
+  let x = sine_block 4800 in
+  let f = field_of ~left:x ~right:(Array.map Float.neg x) in
+  Alcotest.(check float_approx) "correlation" (-1.0) f.correlation;
+  Alcotest.(check float_approx) "width" 1.0 f.width;
+  Alcotest.(check float_approx) "mono cancels" min_db f.mono_loss_db
+
+let test_field_uncorrelated () =
+  Random.init 3;
+  let noise () = Array.init 48000 (fun _ -> Random.float 2.0 -. 1.0) in
+  let f = field_of ~left:(noise ()) ~right:(noise ()) in
+  Alcotest.(check bool) "near zero correlation" true (Float.abs f.correlation < 0.02);
+  Alcotest.(check bool) "about -3 dB in mono" true (float_eq ~eps:0.1 (-3.01) f.mono_loss_db);
+  Alcotest.(check bool) "equal mid and side" true (Float.abs f.mid_side_db < 0.2)
+
+let test_field_balance () =
+  let x = sine_block 4800 in
+  let f = field_of ~left:x ~right:(Array.make 4800 0.0) in
+  Alcotest.(check float_approx) "hard left" (-1.0) f.balance;
+  Alcotest.(check float_approx) "no correlation" 0.0 f.correlation;
+  let f = field_of ~left:(Array.map (fun v -> v *. 0.5) x) ~right:x in
+  (* Right is 6 dB louder: (1 - 0.25) / (1 + 0.25) *)
+  Alcotest.(check float_approx) "right of centre" 0.6 f.balance;
+  Alcotest.(check bool) "silence" true (field_of ~left:[| 0.0 |] ~right:[| 0.0 |] = field_of ~left:[||] ~right:[||])
+
+let test_field_processor () =
+  let sp = create_stereo_processor ~sample_rate:48000.0 in
+  let g = create_goniometer ~size:17 () in
+  sp.goniometer <- Some g;
+  let x = sine_block ~gain:0.9 4800 in
+  ignore (process_stereo_buffer sp ~left:x ~right:x);
+  Alcotest.(check float_approx) "processor correlation" 1.0 (get_stereo_field sp).correlation;
+  Alcotest.(check int) "plotted every frame" 4800 g.samples;
+  (* L = R puts every sample on the vertical (mid) axis *)
+  let off_axis = ref 0 in
+  Array.iteri (fun k c -> if c > 0 && k mod 17 <> 8 then incr off_axis) g.cells;
+  Alcotest.(check int) "on mid axis" 0 !off_axis;
+  let angles = goniometer_angles ~bins:9 g in
+  Alcotest.(check bool) "mono direction" true (angles.(4) > 0.99);
+  let buf = f32_of_array (Array.concat (Array.to_list (Array.map (fun v -> [| v; -. v |]) x))) in
+  ignore (process_stereo_f32 sp buf);
+  Alcotest.(check float_approx) "f32 correlation" (-1.0) (get_stereo_field sp).correlation;
+  let json = goniometer_to_json ~bins:9 g in
+  let open Yojson.Safe.Util in
+  Alcotest.(check int) "density rows" 17 (json |> member "density" |> to_list |> List.length);
+  Alcotest.(check int) "angle bins" 9 (json |> member "angles" |> to_list |> List.length)
+
+(** {1 History Tests} *)
+
+let brute_point samples a b =
+  let seg = Array.sub samples a (b - a) in
+  let sum_sq = Array.fold_left (fun acc x -> acc +. x *. x) 0.0 seg in
+  (Array.fold_left Float.min Float.infinity seg,
+   Array.fold_left Float.max Float.neg_infinity seg,
+   Float.sqrt (sum_sq /. Float.of_int (b - a)))
+
+let random_samples n = Random.init 11; Array.init n (fun _ -> Random.float 2.0 -. 1.0)
+
+let test_history_exact () =
+  let samples = random_samples 5000 in
+  let h = History.create ~capacity:8192 ~levels:12 ~rate:1000.0 () in
+  History.append_array h samples;
+  Random.init 12;
+  for _ = 1 to 200 do
+    let start = Random.int 5000 in
+    let stop = start + 1 + Random.int (5000 - start) in
+    let points = 1 + Random.int 50 in
+    let result = History.query h ~start ~stop ~points in
+    let n = Array.length result in
+    Alcotest.(check int) "point count" (min points (stop - start)) n;
+    Array.iteri (fun p (pt : History.point) ->
+      let a = start + p * (stop - start) / n and b = start + (p + 1) * (stop - start) / n in
+      let (mn, mx, rms) = brute_point samples a b in
+      Alcotest.(check bool) "min" true (pt.min = mn);
+      Alcotest.(check bool) "max" true (pt.max = mx);
+      Alcotest.(check bool) "rms" true (float_eq ~eps:1e-9 rms pt.rms)) result
+  done
+
+let test_history_retention () =
+  let h = History.create ~capacity:8 ~levels:6 ~rate:1.0 () in
+  let bytes = History.storage_bytes h in
+  let samples = random_samples 1000 in
+  History.append_array h samples;
+  Alcotest.(check int) "storage fixed" bytes (History.storage_bytes h);
+  Alcotest.(check int) "length" 1000 (History.length h);
+  let oldest = History.oldest h in
+  Alcotest.(check bool) "old values evicted" true (oldest > 0 && oldest < 1000);
+  (* Coarse fallback: every point still bounds its own values *)
+  let result = History.query h ~start:0 ~stop:1000 ~points:10 in
+  Alcotest.(check int) "points" 10 (Array.length result);
+  let span = 1000 - oldest in
+  Array.iteri (fun p (pt : History.point) ->
+    let a = oldest + p * span / 10 and b = oldest + (p + 1) * span / 10 in
+    let (mn, mx, _) = brute_point samples a b in
+    Alcotest.(check bool) "min bound" true (pt.min <= mn);
+    Alcotest.(check bool) "max bound" true (pt.max >= mx)) result;
+  Alcotest.(check int) "empty range" 0 (Array.length (History.query h ~start:2000 ~stop:3000 ~points:4))
+
+let test_history_meter_frames () =
+  let left = History.create ~rate:30.0 () and right = History.create ~rate:30.0 () in
+  let quiet = { rms_linear = 0.1; peak_linear = 0.2; rms_db = -20.0; peak_db = -14.0 } in
+  let loud = { rms_linear = 0.5; peak_linear = 0.9; rms_db = -6.0; peak_db = -0.9 } in
+  (* 60 s at 30 fps with a loud stretch from 40 s to 42 s *)
+  for i = 0 to 1799 do
+    let c = if i >= 1200 && i < 1260 then loud else quiet in
+    let output = { left = c; right = quiet; mono_sum = quiet } in
+    record_frame ~frames:1470 ~left ~right
+      (create_frame ~timestamp:(Float.of_int i /. 30.0) ~track_index:0 ~output ())
+  done;
+  let points = History.query_seconds left ~from_s:0.0 ~to_s:60.0 ~points:60 in
+  let loudest = ref 0 in
+  Array.iteri (fun i (p : History.point) -> if p.max > points.(!loudest).max then loudest := i) points;
+  Alcotest.(check int) "loudest second" 40 !loudest;
+  Alcotest.(check float_approx) "peak envelope" 0.9 points.(40).max;
+  Alcotest.(check float_approx) "negative envelope" (-0.9) points.(40).min;
+  Alcotest.(check float_approx) "rms" 0.5 points.(40).rms;
+  Alcotest.(check float_approx) "right untouched" 0.2 (History.query right ~start:0 ~stop:1800 ~points:1).(0).max
+
+let test_history_mmap () =
+  let path = Filename.temp_file "history" ".bin" in
+  Fun.protect ~finally:(fun () -> Sys.remove path) (fun () ->
+    let samples = random_samples 3000 in
+    let mapped = History.create ~file:path ~capacity:512 ~rate:100.0 () in
+    let heap = History.create ~capacity:512 ~rate:100.0 () in
+    History.append_array mapped samples;
+    History.append_array heap samples;
+    Alcotest.(check bool) "same points" true
+      (History.query mapped ~start:0 ~stop:3000 ~points:25 = History.query heap ~start:0 ~stop:3000 ~points:25);
+    History.close mapped)
+
+(** {1 Meter Bank Tests} *)
+
+let bank_blocks ~tracks ~frames ~seed =
+  Random.init seed;
+  Array.init tracks (fun t ->
+    let gain = 0.1 +. 0.8 *. Float.of_int t /. Float.of_int (max 1 tracks) in
+    f32_of_array (Array.init (2 * frames) (fun _ -> gain *. (Random.float 2.0 -. 1.0))))
+
+let check_meter name (expected : stereo_meter) (actual : stereo_meter) =
+  let same a b = float_eq ~eps:1e-9 a b in
+  Alcotest.(check bool) (name ^ " left rms") true (same expected.left.rms_db actual.left.rms_db);
+  Alcotest.(check bool) (name ^ " left peak") true (same expected.left.peak_db actual.left.peak_db);
+  Alcotest.(check bool) (name ^ " right rms") true (same expected.right.rms_db actual.right.rms_db);
+  Alcotest.(check bool) (name ^ " right peak") true (same expected.right.peak_db actual.right.peak_db);
+  check_channel (name ^ " mono") expected.mono_sum actual.mono_sum
+
+let test_bank_matches_processor () =
+  let tracks = 4 in
+  let bank = create_bank ~sample_rate:48000.0 ~tracks () in
+  let procs = Array.init tracks (fun _ -> create_stereo_processor ~sample_rate:48000.0) in
+  (* A loud opening block, then quieter ones: runs past the hold time
+     into the release *)
+  for block = 0 to 99 do
+    let blocks = bank_blocks ~tracks ~frames:480 ~seed:block in
+    if block > 0 then
+      Array.iter (fun (buf : float32_buffer) ->
+        for j = 0 to Bigarray.Array1.dim buf - 1 do
+          buf.{j} <- buf.{j} *. 0.25
+        done) blocks;
+    process_bank bank blocks;
+    Array.iteri (fun i sp ->
+      let expected = process_stereo_f32 sp blocks.(i) in
+      check_meter (Printf.sprintf "track %d" i) expected (bank_meter bank i);
+      Alcotest.(check float_approx) "correlation" (get_stereo_field sp).correlation
+        (bank_field bank i).correlation;
+      let (el, er) = get_peak_holds sp and (al, ar) = bank_peak_holds bank i in
+      Alcotest.(check float_approx) "left hold" el al;
+      Alcotest.(check float_approx) "right hold" er ar) procs
+  done;
+  shutdown_bank bank
+
+let test_bank_parallel () =
+  let tracks = 37 in
+  let seq = create_bank ~sample_rate:48000.0 ~tracks () in
+  let par = create_bank ~domains:2 ~parallel_threshold:1 ~sample_rate:48000.0 ~tracks () in
+  Fun.protect ~finally:(fun () -> shutdown_bank par) (fun () ->
+    for block = 0 to 4 do
+      let blocks = bank_blocks ~tracks ~frames:256 ~seed:(100 + block) in
+      process_bank seq blocks;
+      process_bank par blocks
+    done;
+    for i = 0 to tracks - 1 do
+      check_meter (Printf.sprintf "track %d" i) (bank_meter seq i) (bank_meter par i)
+    done)
+
+let test_bank_frames () =
+  let bank = create_bank ~loudness:true ~sample_rate:48000.0 ~tracks:3 () in
+  process_bank bank (bank_blocks ~tracks:3 ~frames:4800 ~seed:7);
+  let frames = bank_frames ~tracks:[2; 0; 5; -1] bank ~timestamp:1.5 in
+  Alcotest.(check (list int)) "subscribed tracks only" [2; 0]
+    (List.map (fun (f : meter_frame) -> f.track_index) frames);
+  Alcotest.(check int) "all tracks" 3 (List.length (bank_frames bank ~timestamp:1.5));
+  List.iter (fun (f : meter_frame) ->
+    Alcotest.(check bool) "loudness attached" true (Option.is_some f.loudness)) frames;
+  Alcotest.check_raises "block count"
+    (Invalid_argument "Metering.process_bank: one block per track required")
+    (fun () -> process_bank bank [||])
+
 (** All tests *)
 let () =
   Alcotest.run "Metering" [
@@ -269,6 +785,32 @@ let () =
       Alcotest.test_case "interleaved" `Quick test_meter_stereo_interleaved;
       Alcotest.test_case "separate" `Quick test_meter_stereo_separate;
     ];
+    "fused kernel", [
+      Alcotest.test_case "matches naive" `Quick test_fused_matches_naive;
+      Alcotest.test_case "blocks" `Quick test_fused_blocks;
+    ];
+    "loudness", [
+      Alcotest.test_case "1 kHz sine" `Quick test_loudness_sine;
+      Alcotest.test_case "mono" `Quick test_loudness_mono;
+      Alcotest.test_case "windows" `Quick test_loudness_windows;
+      Alcotest.test_case "gating" `Quick test_loudness_gating;
+      Alcotest.test_case "range" `Quick test_loudness_range;
+      Alcotest.test_case "interleaved blocks" `Quick test_loudness_interleaved;
+      Alcotest.test_case "frame json" `Quick test_frame_loudness_json;
+    ];
+    "true peak", [
+      Alcotest.test_case "inter-sample over" `Quick test_true_peak_intersample;
+      Alcotest.test_case "low frequency" `Quick test_true_peak_low_freq;
+      Alcotest.test_case "streaming blocks" `Quick test_true_peak_blocks;
+      Alcotest.test_case "processor and hold" `Quick test_true_peak_processor;
+    ];
+    "spectrum", [
+      Alcotest.test_case "sine band" `Quick test_spectrum_sine_band;
+      Alcotest.test_case "windows" `Quick test_spectrum_windows;
+      Alcotest.test_case "noise tilt" `Quick test_spectrum_tilt;
+      Alcotest.test_case "strided feed" `Quick test_spectrum_stride;
+      Alcotest.test_case "json" `Quick test_spectrum_json;
+    ];
     "peak hold", [
       Alcotest.test_case "attack" `Quick test_peak_hold_attack;
       Alcotest.test_case "hold" `Quick test_peak_hold_hold;
@@ -278,8 +820,34 @@ let () =
       Alcotest.test_case "attack" `Quick test_ballistics_attack;
       Alcotest.test_case "smooth" `Quick test_ballistics_smooth;
     ];
+    "envelope", [
+      Alcotest.test_case "block size" `Quick test_envelope_block_size;
+      Alcotest.test_case "vu" `Quick test_envelope_vu;
+      Alcotest.test_case "ppm" `Quick test_envelope_ppm;
+      Alcotest.test_case "digital release" `Quick test_envelope_digital_release;
+      Alcotest.test_case "presets" `Quick test_envelope_presets;
+    ];
+    "stereo field", [
+      Alcotest.test_case "mono" `Quick test_field_mono;
+      Alcotest.test_case "antiphase" `Quick test_field_antiphase;
+      Alcotest.test_case "uncorrelated" `Quick test_field_uncorrelated;
+      Alcotest.test_case "balance" `Quick test_field_balance;
+      Alcotest.test_case "processor and goniometer" `Quick test_field_processor;
+    ];
+    "history", [
+      Alcotest.test_case "exact ranges" `Quick test_history_exact;
+      Alcotest.test_case "retention" `Quick test_history_retention;
+      Alcotest.test_case "meter frames" `Quick test_history_meter_frames;
+      Alcotest.test_case "mmap" `Quick test_history_mmap;
+    ];
+    "meter bank", [
+      Alcotest.test_case "matches processor" `Quick test_bank_matches_processor;
+      Alcotest.test_case "parallel" `Quick test_bank_parallel;
+      Alcotest.test_case "frames" `Quick test_bank_frames;
+    ];
     "processor", [
       Alcotest.test_case "create" `Quick test_processor_create;
+      Alcotest.test_case "process_meter envelope" `Quick test_process_meter_envelope;
       Alcotest.test_case "stereo" `Quick test_stereo_processor;
     ];
     "frame", [
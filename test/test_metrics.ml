@@ -0,0 +1,182 @@
+(** Metrics Tests - histograms, sharded counters and exposition *)
+
+let contains s sub =
+  try ignore (Str.search_forward (Str.regexp_string sub) s 0); true
+  with Not_found -> false
+
+let check_contains text line =
+  Alcotest.(check bool) line true (contains text line)
+
+(** {1 Bucket Tests} *)
+
+let test_buckets () =
+  Alcotest.(check int) "1us" 0 (Metrics.bucket_index 1e-6);
+  Alcotest.(check int) "below 1us" 0 (Metrics.bucket_index 1e-9);
+  Alcotest.(check int) "1.2us" 1 (Metrics.bucket_index 1.2e-6);
+  Alcotest.(check int) "bound inclusive" 1 (Metrics.bucket_index Metrics.bounds.(1));
+  Alcotest.(check int) "2us" 2 (Metrics.bucket_index 2e-6);
+  Alcotest.(check int) "+Inf" (Array.length Metrics.bounds) (Metrics.bucket_index 1e6);
+  Array.iteri (fun i bound ->
+    if i > 0 then
+      Alcotest.(check bool) "within 50%" true (bound <= 1.5 *. Metrics.bounds.(i - 1) +. 1e-12))
+    Metrics.bounds
+
+(** {1 Recording Tests} *)
+
+let test_histogram () =
+  let h = Metrics.histogram ~label:"op" "test_histogram_seconds" in
+  Metrics.observe h "a" 0.001;
+  Metrics.observe h "a" 0.003;
+  Metrics.observe h "b" 2.0;
+  let count, sum, buckets = Metrics.histogram_stats h "a" in
+  Alcotest.(check int) "count" 2 count;
+  Alcotest.(check (float 1e-9)) "sum" 0.004 sum;
+  Alcotest.(check int) "bucket" 1 buckets.(Metrics.bucket_index 0.001);
+  let result = Metrics.time h "b" (fun () -> 42) in
+  Alcotest.(check int) "time returns" 42 result;
+  let count, _, _ = Metrics.histogram_stats h "b" in
+  Alcotest.(check int) "timed" 2 count;
+  Alcotest.(check bool) "same family" true
+    (Metrics.histogram ~label:"op" "test_histogram_seconds" == h)
+
+let test_counter_domains () =
+  let c = Metrics.counter ~label:"kind" "test_domain_ops_total" in
+  let domains = List.init 4 (fun _ ->
+    Domain.spawn (fun () -> for _ = 1 to 10_000 do Metrics.incr c "x" done)) in
+  List.iter Domain.join domains;
+  Alcotest.(check int) "merged across domains" 40_000 (Metrics.counter_value c "x");
+  Alcotest.(check bool) "one shard per domain" true (Metrics.shard_count () >= 4)
+
+let test_gauge () =
+  let g = Metrics.gauge "test_in_flight" in
+  Metrics.add g "" 1;
+  Metrics.add g "" 1;
+  Metrics.add g "" (-1);
+  Alcotest.(check int) "gauge" 1 (Metrics.gauge_value g "")
+
+let test_series_limit () =
+  let c = Metrics.counter ~label:"name" "test_cardinality_total" in
+  for i = 1 to Metrics.max_series + 10 do Metrics.incr c (string_of_int i) done;
+  Alcotest.(check int) "overflow folded into other" 10 (Metrics.counter_value c "other")
+
+let test_no_allocation () =
+  let h = Metrics.histogram ~label:"op" "test_alloc_seconds" in
+  let c = Metrics.counter ~label:"op" "test_alloc_total" in
+  Metrics.observe h "hot" 0.002;
+  Metrics.incr c "hot";
+  let before = Gc.minor_words () in
+  for _ = 1 to 10_000 do
+    Metrics.observe h "hot" 0.002;
+    Metrics.incr c "hot"
+  done;
+  let words = Gc.minor_words () -. before in
+  Alcotest.(check bool) (Printf.sprintf "allocated %.0f words" words) true (words < 100.0)
+
+(** {1 Exposition Tests} *)
+
+let test_exposition () =
+  let h = Metrics.histogram ~label:"method" ~help:"Test latency" "test_expose_seconds" in
+  Metrics.observe h "tools/call" 1e-6;
+  Metrics.observe h "tools/call" 2.5e-6;
+  let c = Metrics.counter ~label:"op" "test_expose_total" in
+  Metrics.incr c "say \"hi\"";
+  Metrics.sampled ~label:"instance" "test_sampled" (fun () -> [("reaper", 2.0)]);
+  Metrics.sampled ~label:"instance" "test_sampled" (fun () -> [("reaper", 1.0)]);
+  let text = Metrics.expose () in
+  check_contains text "# HELP test_expose_seconds Test latency";
+  check_contains text "# TYPE test_expose_seconds histogram";
+  check_contains text {|test_expose_seconds_bucket{method="tools/call",le="1e-06"} 1|};
+  check_contains text {|test_expose_seconds_bucket{method="tools/call",le="3e-06"} 2|};
+  check_contains text {|test_expose_seconds_bucket{method="tools/call",le="+Inf"} 2|};
+  let bucket_lines =
+    List.filter (fun line -> String.starts_with ~prefix:{|test_expose_seconds_bucket{method="tools/call"|} line)
+      (String.split_on_char '\n' text)
+  in
+  Alcotest.(check int) "full bucket layout" (Array.length Metrics.bounds + 1) (List.length bucket_lines);
+  check_contains text {|test_expose_seconds_count{method="tools/call"} 2|};
+  check_contains text {|test_expose_total{op="say \"hi\""} 1|};
+  check_contains text {|test_sampled{instance="reaper"} 1|};
+  Alcotest.(check bool) "replaced sampled family" false (contains text {|test_sampled{instance="reaper"} 2|});
+  check_contains text "# TYPE ocaml_gc_minor_words_total counter";
+  check_contains text "ocaml_gc_heap_words "
+
+(** {1 Tracing Tests} *)
+
+let trace_events ?traces () =
+  let open Yojson.Safe.Util in
+  Yojson.Safe.from_string (Metrics.Trace.export ?traces ()) |> member "traceEvents" |> to_list
+
+let event_name e = Yojson.Safe.Util.(e |> member "name" |> to_string)
+let event_trace e = Yojson.Safe.Util.(e |> member "tid" |> to_int)
+
+let test_trace_spans () =
+  Eio_main.run @@ fun _env ->
+  Metrics.Trace.configure ~sample:1.0 ();
+  Metrics.Trace.clear ();
+  let result =
+    Metrics.Trace.with_trace "request" (fun () ->
+      let ctx = Metrics.Trace.current () in
+      Alcotest.(check bool) "sampled" true (Option.is_some ctx);
+      let start = Metrics.Trace.now () in
+      Metrics.Trace.span ~cat:"json" "decode" (fun () -> ());
+      Eio.Fiber.both
+        (fun () -> Metrics.Trace.with_context ctx (fun () -> Metrics.Trace.finish "queued" ~start))
+        (fun () -> ());
+      42)
+  in
+  Alcotest.(check int) "result" 42 result;
+  Alcotest.(check bool) "outside trace" true (Metrics.Trace.current () = None);
+  let events = trace_events () in
+  Alcotest.(check (list string)) "spans" ["decode"; "queued"; "request"]
+    (List.sort compare (List.map event_name events));
+  Alcotest.(check int) "one trace" 1 (List.length (List.sort_uniq compare (List.map event_trace events)));
+  List.iter (fun e ->
+    Alcotest.(check string) "complete event" "X" Yojson.Safe.Util.(e |> member "ph" |> to_string)) events;
+  Metrics.Trace.span "untraced" ignore;
+  Alcotest.(check int) "no span outside a trace" 3 (Metrics.Trace.length ())
+
+let test_trace_sampling () =
+  Eio_main.run @@ fun _env ->
+  Metrics.Trace.configure ~sample:0.0 ();
+  Metrics.Trace.clear ();
+  for _ = 1 to 10 do
+    Metrics.Trace.with_trace "request" (fun () -> Metrics.Trace.span "inner" ignore)
+  done;
+  Alcotest.(check int) "disabled" 0 (Metrics.Trace.length ());
+  Metrics.Trace.configure ~sample:0.5 ();
+  for _ = 1 to 10 do Metrics.Trace.with_trace "request" ignore done;
+  Alcotest.(check int) "half sampled" 5 (Metrics.Trace.length ());
+  Alcotest.(check int) "newest traces" 2 (List.length (trace_events ~traces:2 ()));
+  Metrics.Trace.configure ~sample:1.0 ()
+
+let test_trace_ring () =
+  Metrics.Trace.configure ~capacity:8 ~sample:1.0 ();
+  Metrics.Trace.clear ();
+  let before = Metrics.Trace.length () in
+  Domain.join (Domain.spawn (fun () ->
+    Eio_main.run @@ fun _env ->
+    for _ = 1 to 20 do Metrics.Trace.with_trace "request" ignore done));
+  Metrics.Trace.configure ~capacity:4096 ();
+  Alcotest.(check int) "ring keeps the newest" 8 (Metrics.Trace.length () - before)
+
+let () =
+  Alcotest.run "Metrics" [
+    "buckets", [
+      Alcotest.test_case "index" `Quick test_buckets;
+    ];
+    "recording", [
+      Alcotest.test_case "histogram" `Quick test_histogram;
+      Alcotest.test_case "counter across domains" `Quick test_counter_domains;
+      Alcotest.test_case "gauge" `Quick test_gauge;
+      Alcotest.test_case "series limit" `Quick test_series_limit;
+      Alcotest.test_case "no allocation" `Quick test_no_allocation;
+    ];
+    "exposition", [
+      Alcotest.test_case "text format" `Quick test_exposition;
+    ];
+    "tracing", [
+      Alcotest.test_case "nested spans" `Quick test_trace_spans;
+      Alcotest.test_case "sampling" `Quick test_trace_sampling;
+      Alcotest.test_case "ring wraparound" `Quick test_trace_ring;
+    ];
+  ]
@@ -174,6 +174,326 @@ let test_invalid_input () =
   let result2 = Parse.parse "not/osc" in
   Alcotest.(check bool) "invalid start fails" true (Result.is_error result2)
 
+(** Test zero-copy decoder agrees with the Angstrom parser *)
+let test_decode_matches_parse () =
+  let nested = Bundle {
+    timetag = 42L;
+    elements = [
+      Message { address = "/a"; args = [Int32 1l; String "x"] };
+      Bundle {
+        timetag = timetag_immediately;
+        elements = [
+          Message { address = "/b/c"; args = [Double 2.5; Blob (Bytes.of_string "abc")] };
+          Message { address = "/d"; args = [] };
+        ];
+      };
+    ];
+  } in
+  let packets = [
+    Message { address = "/test"; args = [Int32 (-7l); Float32 1.5; String "hello"] };
+    Message { address = "/types"; args = [Int64 9L; Timetag 3L; Char 'z'; Color 0xFF00FF00l;
+                                          Midi (Bytes.of_string "\x90\x3c\x7f\x00");
+                                          True; False; Nil; Infinitum] };
+    nested;
+  ] in
+  List.iter (fun p ->
+    let data = Serialize.serialize p in
+    Alcotest.(check (result osc_packet string)) "decode = parse"
+      (Parse.parse data) (Decode.decode_string data)
+  ) packets
+
+(** Test lazy message view *)
+let test_decode_view () =
+  let data = Serialize.serialize
+    (Message { address = "/track/3/volume"; args = [String "skip"; Float32 0.5; Int32 9l] }) in
+  match Decode.view (Cstruct.of_string data) with
+  | Error e -> Alcotest.fail e
+  | Ok v ->
+    Alcotest.(check string) "address" "/track/3/volume" (Decode.address v);
+    Alcotest.(check bool) "address_equal" true (Decode.address_equal v "/track/3/volume");
+    Alcotest.(check bool) "address_equal prefix" false (Decode.address_equal v "/track/3");
+    Alcotest.(check int) "arg count" 3 (Decode.arg_count v);
+    Alcotest.(check char) "type tag" 'f' (Decode.type_tag v 1);
+    (match Decode.arg v 2 with
+     | Ok (Int32 i) -> Alcotest.(check int32) "third arg" 9l i
+     | _ -> Alcotest.fail "arg 2");
+    Alcotest.(check bool) "out of range" true (Result.is_error (Decode.arg v 3))
+
+(** Test folding over nested bundle messages *)
+let test_decode_fold () =
+  let msg a = Message { address = a; args = [Int32 0l] } in
+  let data = Serialize.serialize (Bundle {
+    timetag = timetag_immediately;
+    elements = [msg "/a"; Bundle { timetag = timetag_immediately; elements = [msg "/b"; msg "/c"] }];
+  }) in
+  match Decode.fold_messages (fun acc v -> Decode.address v :: acc) [] (Cstruct.of_string data) with
+  | Ok addrs -> Alcotest.(check (list string)) "addresses" ["/a"; "/b"; "/c"] (List.rev addrs)
+  | Error e -> Alcotest.fail e
+
+(** Test decoder rejects malformed input *)
+let test_decode_invalid () =
+  let is_error s = Result.is_error (Decode.decode_string s) in
+  Alcotest.(check bool) "empty" true (is_error "");
+  Alcotest.(check bool) "bad start" true (is_error "not/osc");
+  let data = Serialize.serialize (Message { address = "/x"; args = [Int32 1l; String "abc"] }) in
+  (* 4 bytes is a bare address, which pre-1.0 senders emit legally *)
+  for n = 5 to String.length data - 1 do
+    Alcotest.(check bool) (Printf.sprintf "truncated %d" n) true (is_error (String.sub data 0 n))
+  done;
+  let bundle = Serialize.serialize (Bundle { timetag = 1L; elements = [Message { address = "/x"; args = [] }] }) in
+  let corrupt = Bytes.of_string bundle in
+  Bytes.set corrupt 19 '\xff';
+  Alcotest.(check bool) "bad element size" true (is_error (Bytes.to_string corrupt))
+
+(** Test buffer reuse leaves no stale bytes *)
+let test_encode_reuse () =
+  let big = Message { address = "/a/very/long/address/path"; args = [String "xxxxxxxxxxxxxxx"; Int64 (-1L)] } in
+  let small = Message { address = "/b"; args = [String "y"; Int32 5l] } in
+  let b = Serialize.create_buffer ~size:16 () in
+  ignore (Serialize.encode b big);
+  let reused = Cstruct.to_string (Serialize.encode b small) in
+  let fresh = Cstruct.to_string (Serialize.encode (Serialize.create_buffer ()) small) in
+  Alcotest.(check string) "reused = fresh" fresh reused;
+  Alcotest.(check (result osc_packet string)) "decodes" (Ok small) (Parse.parse reused)
+
+(** Test backpatched bundle element sizes *)
+let test_encode_nested_sizes () =
+  let inner = Bundle { timetag = 7L; elements = [Message { address = "/x"; args = [Float32 1.0] }] } in
+  let packet = Bundle { timetag = timetag_immediately; elements = [inner; Message { address = "/y"; args = [] }] } in
+  let data = Serialize.serialize packet in
+  (* header(16) + size(4) + inner[header(16) + size(4) + "/x"(4) + ",f"(4) + f(4)] + size(4) + "/y"(4) + ","(4) *)
+  Alcotest.(check int) "total size" 64 (String.length data);
+  Alcotest.(check int32) "inner size" 32l (Cstruct.BE.get_uint32 (Cstruct.of_string data) 16);
+  Alcotest.(check (result osc_packet string)) "roundtrip" (Ok packet) (Parse.parse data)
+
+(** Test pattern language *)
+let test_pattern_matching () =
+  let check pattern address expected =
+    Alcotest.(check bool) (pattern ^ " ~ " ^ address) expected
+      (Dispatch.pattern_matches ~pattern address)
+  in
+  check "/track/*/volume" "/track/12/volume" true;
+  check "/track/*/volume" "/track/12/pan" false;
+  check "/track/?/mute" "/track/3/mute" true;
+  check "/track/?/mute" "/track/30/mute" false;
+  check "/track/[1-3]/solo" "/track/2/solo" true;
+  check "/track/[!1-3]/solo" "/track/2/solo" false;
+  check "/track/1/{mute,solo}" "/track/1/solo" true;
+  check "/track/1/{mute,solo}" "/track/1/pan" false;
+  check "/a*c" "/abbbc" true;
+  check "/a*c" "/abbbd" false
+
+(** Test trie dispatch with captures *)
+let test_dispatch_captures () =
+  let d = Dispatch.create () in
+  let volumes = ref [] in
+  let selects = ref 0 in
+  Dispatch.add d "/track/%d/volume" (fun caps msg ->
+    match caps, msg.args with
+    | [Dispatch.Int n], [Float32 v] -> volumes := (n, v) :: !volumes
+    | _ -> Alcotest.fail "unexpected captures");
+  Dispatch.add d "/track/*/{select,recarm}" (fun caps _ ->
+    match caps with
+    | [Dispatch.Segment _; Dispatch.Segment _] -> incr selects
+    | _ -> Alcotest.fail "unexpected pattern captures");
+  Dispatch.add d "/play" (fun _ _ -> ());
+  let msg address args = { address; args } in
+  Alcotest.(check int) "volume" 1 (Dispatch.dispatch d "/track/7/volume" (msg "/track/7/volume" [Float32 0.5]));
+  Alcotest.(check int) "non-integer segment" 0 (Dispatch.dispatch d "/track/x/volume" (msg "/track/x/volume" [Float32 0.5]));
+  Alcotest.(check int) "select" 1 (Dispatch.dispatch d "/track/3/select" (msg "/track/3/select" []));
+  Alcotest.(check int) "no match" 0 (Dispatch.dispatch d "/stop" (msg "/stop" []));
+  Alcotest.(check (list (pair int (float 0.0)))) "captured" [(7, 0.5)] !volumes;
+  Alcotest.(check int) "select count" 1 !selects
+
+(** Test incoming address patterns expand over literal handlers *)
+let test_dispatch_incoming_pattern () =
+  let d = Dispatch.create () in
+  let hits = ref [] in
+  List.iter (fun name ->
+    Dispatch.add d ("/fx/" ^ name) (fun _ _ -> hits := name :: !hits)) ["reverb"; "delay"; "chorus"];
+  let n = Dispatch.dispatch d "/fx/{reverb,delay}" () in
+  Alcotest.(check int) "two handlers" 2 n;
+  Alcotest.(check (list string)) "hits" ["delay"; "reverb"] (List.sort compare !hits);
+  let packet = Bundle { timetag = timetag_immediately;
+                        elements = [Message { address = "/fx/*"; args = [] }] } in
+  let md = Dispatch.create () in
+  let count = ref 0 in
+  Dispatch.add md "/fx/reverb" (fun _ _ -> incr count);
+  Dispatch.add md "/fx/delay" (fun _ _ -> incr count);
+  Dispatch.dispatch_packet md packet;
+  Alcotest.(check int) "bundle dispatch" 2 !count
+
+(** Test malformed incoming patterns match nothing instead of raising *)
+let test_dispatch_malformed_pattern () =
+  let d = Dispatch.create () in
+  let count = ref 0 in
+  Dispatch.add d "/x/a" (fun _ _ -> incr count);
+  List.iter (fun address ->
+    Alcotest.(check int) address 0 (Dispatch.dispatch d address ()))
+    ["/x/[ab"; "/x/a}"; "/x/{a"; "x/a"];
+  Alcotest.(check int) "still dispatches" 1 (Dispatch.dispatch d "/x/a" ());
+  Alcotest.(check int) "handler count" 1 !count
+
+(** Test NTP timetag conversion *)
+let test_timetag_conversion () =
+  let t = 1_700_000_000.25 in
+  let tt = timetag_of_unix t in
+  Alcotest.(check (float 1e-6)) "roundtrip" t (unix_of_timetag tt);
+  Alcotest.(check int64) "fraction" 0x40000000L (Int64.logand tt 0xFFFFFFFFL);
+  Alcotest.(check (float 1e-6)) "epoch" 0.0 (unix_of_timetag (timetag_of_unix 0.0))
+
+(** Test tempo map position conversion *)
+let test_tempo_map () =
+  let map = Schedule.anchor ~now:100.0 ~bpm:120.0 ~bar:1 ~beat:1 () in
+  (* 120 bpm, 4/4: one bar = 2 seconds *)
+  Alcotest.(check (float 1e-9)) "bar 17" 132.0 (Schedule.time_of_position map ~bar:17 ());
+  Alcotest.(check (float 1e-9)) "bar 2 beat 3" 103.0 (Schedule.time_of_position map ~bar:2 ~beat:3 ());
+  let map2 = Schedule.anchor_seconds ~now:50.0 ~bpm:60.0 ~beats_per_bar:3 6.0 in
+  Alcotest.(check (float 1e-9)) "seconds anchor" 50.0 (Schedule.time_of_position map2 ~bar:3 ())
+
+(** Test scheduler release in timetag and local modes *)
+let test_schedule_poll () =
+  let sent = ref [] in
+  let send p = sent := p :: !sent in
+  let msg a = Message { address = a; args = [] } in
+  let s = Schedule.create ~lookahead:0.5 ~send () in
+  ignore (Schedule.at s 12.0 [msg "/late"]);
+  ignore (Schedule.at s 10.0 [msg "/early"]);
+  let cancelled = Schedule.at s 11.0 [msg "/cancelled"] in
+  Alcotest.(check bool) "cancel" true (Schedule.cancel s cancelled);
+  Alcotest.(check (option (float 1e-9))) "nothing due" (Some 9.5) (Schedule.poll s ~now:9.0);
+  Alcotest.(check (option (float 1e-9))) "early released" (Some 11.5) (Schedule.poll s ~now:9.6);
+  (match !sent with
+   | [Bundle { timetag; elements = [Message { address = "/early"; _ }] }] ->
+     Alcotest.(check (float 1e-6)) "stamped with due time" 10.0 (unix_of_timetag timetag)
+   | _ -> Alcotest.fail "expected /early bundle");
+  Alcotest.(check int) "pending" 1 (Schedule.pending s);
+  let local = Schedule.create ~mode:Schedule.Local ~lookahead:0.5 ~send () in
+  sent := [];
+  ignore (Schedule.at local 10.0 [msg "/local"]);
+  Alcotest.(check (option (float 1e-9))) "held until due" (Some 10.0) (Schedule.poll local ~now:9.6);
+  Alcotest.(check (option (float 1e-9))) "fired" None (Schedule.poll local ~now:10.0);
+  (match !sent with
+   | [Bundle { timetag; _ }] -> Alcotest.(check int64) "immediate" timetag_immediately timetag
+   | _ -> Alcotest.fail "expected local bundle")
+
+(** Test cancelled bundles leave the queue and the rest keep their order *)
+let test_schedule_cancel () =
+  let sent = ref [] in
+  let send = function
+    | Bundle { elements = [Message { address; _ }]; _ } -> sent := address :: !sent
+    | _ -> Alcotest.fail "expected single-message bundle"
+  in
+  let s = Schedule.create ~mode:Schedule.Local ~send () in
+  let ids = List.init 20 (fun i ->
+    (i, Schedule.at s (Float.of_int (20 - i)) [Message { address = string_of_int i; args = [] }])) in
+  List.iter (fun (i, id) -> if i mod 3 = 0 then ignore (Schedule.cancel s id)) ids;
+  Alcotest.(check bool) "cancelled once" false (Schedule.cancel s (List.assoc 0 ids));
+  Alcotest.(check int) "pending" 13 (Schedule.pending s);
+  Alcotest.(check (option (float 1e-9))) "next live bundle" (Some 3.0) (Schedule.poll s ~now:1.5);
+  Alcotest.(check (option (float 1e-9))) "drained" None (Schedule.poll s ~now:100.0);
+  Alcotest.(check (list string)) "due order, cancelled skipped"
+    (List.filter_map (fun i -> if i mod 3 = 0 then None else Some (string_of_int i))
+       (List.init 20 (fun i -> 19 - i)))
+    (List.rev !sent)
+
+(** Test an oversized frame stops the receive fiber without failing its switch *)
+let test_stream_oversized_frame () =
+  Eio_main.run @@ fun env ->
+  let path = Filename.temp_file "osc" ".sock" in
+  Sys.remove path;
+  Fun.protect ~finally:(fun () -> if Sys.file_exists path then Sys.remove path) @@ fun () ->
+  Eio.Switch.run @@ fun sw ->
+  let net = Eio.Stdenv.net env in
+  let server = Eio.Net.listen ~sw ~backlog:1 net (`Unix path) in
+  let client = Transport.connect ~sw ~net (Transport.Unix_socket { path; framing = Transport.Length_prefix }) in
+  Transport.on_receive client (fun _ -> Alcotest.fail "no packet expected");
+  Transport.start_receiving ~sw client;
+  let peer, _ = Eio.Net.accept ~sw server in
+  (* A length prefix far above the frame limit *)
+  Eio.Flow.copy_string "\x7f\xff\xff\xff" peer;
+  Eio.Time.sleep (Eio.Stdenv.clock env) 0.05;
+  Transport.send_message client "/still/alive" [];
+  let buf = Cstruct.create 64 in
+  Alcotest.(check bool) "client still sends" true (Eio.Flow.single_read peer buf > 0);
+  Transport.close client
+
+(** Feed [chunks] to a fresh decoder and collect decoded packets *)
+let decode_stream ?size framing chunks =
+  let d = Transport.Frame.create ?size framing in
+  let got = ref [] in
+  List.iter (fun chunk ->
+    Transport.Frame.feed d chunk (fun frame ->
+      match Decode.decode frame with
+      | Ok p -> got := p :: !got
+      | Error e -> Alcotest.fail e)) chunks;
+  List.rev !got
+
+(** Split [cs] into single-byte chunks *)
+let bytewise cs = List.init (Cstruct.length cs) (fun i -> Cstruct.sub cs i 1)
+
+(** Test stream framing roundtrips *)
+let test_stream_framing () =
+  let packets = [
+    Message { address = "/blob"; args = [Blob (Bytes.of_string "\xC0\xDB\xC0x\xDB")] };
+    Message { address = "/track/1/volume"; args = [Float32 0.5] };
+    Bundle { timetag = timetag_immediately;
+             elements = [Message { address = "/a"; args = [String (String.make 300 'z')] }] };
+  ] in
+  List.iter (fun (name, framing) ->
+    let framed = List.map (fun p ->
+      Transport.Frame.frame framing (Cstruct.of_string (Serialize.serialize p))) packets in
+    let whole = Cstruct.concat framed in
+    Alcotest.(check (list osc_packet)) (name ^ " one chunk") packets
+      (decode_stream framing [whole]);
+    Alcotest.(check (list osc_packet)) (name ^ " byte by byte") packets
+      (decode_stream framing (bytewise whole));
+    Alcotest.(check (list osc_packet)) (name ^ " growing buffer") packets
+      (decode_stream ~size:16 framing [whole])
+  ) ["slip", Transport.Slip; "length", Transport.Length_prefix]
+
+(** Test SLIP escaping of END/ESC bytes *)
+let test_slip_escaping () =
+  let framed = Transport.Frame.frame Transport.Slip (Cstruct.of_string "a\xC0b\xDBc") in
+  Alcotest.(check string) "escaped" "\xC0a\xDB\xDCb\xDB\xDDc\xC0" (Cstruct.to_string framed)
+
+(** Test batched receive coalescing, ordering and drop counters *)
+let test_batch_coalescing () =
+  let b = Batch.create ~capacity:3 ~coalesce:(Batch.coalesce_patterns ["/track/*/vu"]) ignore in
+  let m address v = { address; args = [Float32 v] } in
+  Batch.push b (m "/track/1/vu" 0.1);
+  Batch.push b (m "/track/1/name" 1.0);
+  Batch.push b (m "/track/1/vu" 0.2);
+  Batch.push b (m "/track/2/vu" 0.3);
+  Batch.push b (m "/track/1/vu" 0.4);
+  (* Backlog is full: new addresses are dropped, existing slots still update *)
+  Batch.push b (m "/play" 1.0);
+  Batch.push b (m "/track/3/vu" 0.5);
+  let stats = Batch.stats b in
+  Alcotest.(check int) "received" 7 stats.Batch.received;
+  Alcotest.(check int) "coalesced" 2 stats.Batch.coalesced;
+  Alcotest.(check int) "dropped" 2 stats.Batch.dropped;
+  Alcotest.(check int) "backlog" 3 stats.Batch.backlog;
+  let batch = Batch.take_batch b in
+  Alcotest.(check (list (pair string (float 0.0)))) "latest values in arrival order"
+    ["/track/1/vu", 0.4; "/track/1/name", 1.0; "/track/2/vu", 0.3]
+    (List.map (fun { address; args } ->
+       match args with [Float32 v] -> (address, v) | _ -> (address, nan)) batch);
+  Alcotest.(check int) "drained" 0 (Batch.stats b).Batch.backlog
+
+(** Test datagram decoding into a batch *)
+let test_batch_datagram () =
+  let b = Batch.create ignore in
+  let bundle = Bundle { timetag = timetag_immediately; elements = [
+    Message { address = "/time"; args = [Float32 1.0] };
+    Message { address = "/time"; args = [Float32 2.0] };
+    Message { address = "/track/1/select"; args = [Int32 1l] };
+  ] } in
+  Batch.push_datagram b (Cstruct.of_string (Serialize.serialize bundle));
+  Batch.push_datagram b (Cstruct.of_string "garbage");
+  Alcotest.(check int) "coalesced /time" 2 (List.length (Batch.take_batch b));
+  Alcotest.(check int) "decode errors" 1 (Batch.stats b).Batch.decode_errors
+
 (** All tests *)
 let () =
   Alcotest.run "OSC" [
@@ -195,13 +515,44 @@ let () =
     "bundle", [
       Alcotest.test_case "bundle roundtrip" `Quick test_bundle;
     ];
+    "encode", [
+      Alcotest.test_case "buffer reuse" `Quick test_encode_reuse;
+      Alcotest.test_case "nested bundle sizes" `Quick test_encode_nested_sizes;
+    ];
     "blob", [
       Alcotest.test_case "blob roundtrip" `Quick test_blob;
     ];
     "reaper", [
       Alcotest.test_case "reaper addresses" `Quick test_reaper_addresses;
     ];
+    "dispatch", [
+      Alcotest.test_case "pattern matching" `Quick test_pattern_matching;
+      Alcotest.test_case "trie captures" `Quick test_dispatch_captures;
+      Alcotest.test_case "incoming patterns" `Quick test_dispatch_incoming_pattern;
+      Alcotest.test_case "malformed incoming patterns" `Quick test_dispatch_malformed_pattern;
+    ];
+    "schedule", [
+      Alcotest.test_case "timetag conversion" `Quick test_timetag_conversion;
+      Alcotest.test_case "tempo map" `Quick test_tempo_map;
+      Alcotest.test_case "poll" `Quick test_schedule_poll;
+      Alcotest.test_case "cancel" `Quick test_schedule_cancel;
+    ];
+    "stream", [
+      Alcotest.test_case "framing roundtrip" `Quick test_stream_framing;
+      Alcotest.test_case "oversized frame" `Quick test_stream_oversized_frame;
+      Alcotest.test_case "slip escaping" `Quick test_slip_escaping;
+    ];
+    "batch", [
+      Alcotest.test_case "coalescing" `Quick test_batch_coalescing;
+      Alcotest.test_case "datagram" `Quick test_batch_datagram;
+    ];
     "errors", [
       Alcotest.test_case "invalid input" `Quick test_invalid_input;
     ];
+    "decode", [
+      Alcotest.test_case "matches parser" `Quick test_decode_matches_parse;
+      Alcotest.test_case "lazy view" `Quick test_decode_view;
+      Alcotest.test_case "fold nested bundle" `Quick test_decode_fold;
+      Alcotest.test_case "malformed input" `Quick test_decode_invalid;
+    ];
   ]
@@ -165,6 +165,515 @@ let test_meter_event () =
   Alcotest.(check bool) "is meter" true (event.event_type = Meter);
   Alcotest.(check bool) "has id" true (Option.is_some event.id)
 
+let test_meter_batch_event () =
+  Eio_main.run @@ fun env ->
+  Eio.Switch.run @@ fun sw ->
+  let clock = Eio.Stdenv.clock env in
+  let config = { default_config with track_indices = Some [1] } in
+  let state = create_stream ~sw ~clock ~config () in
+  let bank = Metering.create_bank ~sample_rate:48000.0 ~tracks:3 () in
+  let frames = Metering.bank_frames bank ~timestamp:1.0 in
+  let event = meter_batch_event ~state frames in
+  let open Yojson.Safe.Util in
+  Alcotest.(check bool) "is meter" true (event.event_type = Meter);
+  Alcotest.(check (list int)) "filtered" [1]
+    (event.data |> member "frames" |> to_list |> List.map (fun f -> f |> member "track_index" |> to_int))
+
+(** {1 Compact Encoding Tests} *)
+
+let channel db = Metering.{ rms_linear = db_to_linear db; peak_linear = db_to_linear (db +. 3.0); rms_db = db; peak_db = db +. 3.0 }
+
+let track_frame ?(timestamp = 1.0) i db =
+  let c = channel db in
+  let field = Metering.{ correlation = 0.8; balance = -0.1; mid_side_db = 9.5; width = 0.1; mono_loss_db = -0.4 } in
+  Metering.create_frame ~timestamp ~track_index:i ~output:Metering.{ left = c; right = c; mono_sum = c } ~field ()
+
+let frames_of dbs = List.mapi (fun i db -> track_frame i db) dbs
+
+let decode_ok dec packet =
+  match Meter_codec.decode dec packet with
+  | Ok p -> p
+  | Error msg -> Alcotest.fail msg
+
+let test_codec_roundtrip () =
+  let enc = Meter_codec.create_encoder () and dec = Meter_codec.create_decoder () in
+  let first = Option.get (Meter_codec.encode enc ~timestamp:1.0 (frames_of [-12.04; -20.0; -96.0])) in
+  let p = decode_ok dec first in
+  Alcotest.(check bool) "keyframe" true p.keyframe;
+  Alcotest.(check int) "all tracks" 3 (List.length p.frames);
+  let t0 = List.hd p.frames in
+  Alcotest.(check (float 1e-9)) "timestamp" 1.0 p.timestamp;
+  Alcotest.(check (float 1e-9)) "quantized to 0.1 dB" (-12.0) t0.output.left.rms_db;
+  Alcotest.(check (float 1e-9)) "peak" (-9.0) t0.output.right.peak_db;
+  Alcotest.(check (float 1e-9)) "correlation" 0.8 (Option.get t0.field).correlation;
+  Alcotest.(check bool) "no input" true (Option.is_none t0.input);
+  (* Only track 1 changes *)
+  let second = Option.get (Meter_codec.encode enc ~timestamp:1.1 (frames_of [-12.04; -19.5; -96.0])) in
+  let p = decode_ok dec second in
+  Alcotest.(check bool) "delta" false p.keyframe;
+  Alcotest.(check (list int)) "changed tracks only" [1]
+    (List.map (fun (f : Metering.meter_frame) -> f.track_index) p.frames);
+  Alcotest.(check (float 1e-9)) "delta applied" (-19.5) (List.hd p.frames).output.left.rms_db;
+  Alcotest.(check bool) "smaller than keyframe" true (String.length second < String.length first);
+  Alcotest.(check bool) "unchanged tick" true
+    (Meter_codec.encode enc ~timestamp:1.2 (frames_of [-12.04; -19.5; -96.0]) = None)
+
+let test_codec_resync () =
+  let enc = Meter_codec.create_encoder ~keyframe_interval:4 () and dec = Meter_codec.create_decoder () in
+  let tick db = Meter_codec.encode enc ~timestamp:0.0 (frames_of [db]) in
+  let k = Option.get (tick (-10.0)) in
+  let lost = Option.get (tick (-11.0)) in
+  ignore lost;
+  ignore (decode_ok dec k);
+  let after_gap = Option.get (tick (-12.0)) in
+  Alcotest.(check bool) "gap rejected" true (Result.is_error (Meter_codec.decode dec after_gap));
+  Alcotest.(check bool) "still rejected" true
+    (Result.is_error (Meter_codec.decode dec (Option.get (tick (-13.0)))));
+  (* The fourth tick is a scheduled keyframe *)
+  let p = decode_ok dec (Option.get (tick (-14.0))) in
+  Alcotest.(check bool) "keyframe" true p.keyframe;
+  Alcotest.(check (float 1e-9)) "resynced" (-14.0) (List.hd p.frames).output.left.rms_db;
+  Meter_codec.force_keyframe enc;
+  Alcotest.(check bool) "forced keyframe" true (decode_ok dec (Option.get (tick (-14.0)))).keyframe;
+  Alcotest.(check bool) "garbage" true (Result.is_error (Meter_codec.decode dec "not a packet"))
+
+let test_codec_base64 () =
+  for n = 0 to 10 do
+    let s = String.init n (fun i -> Char.chr ((i * 97 + n) land 255)) in
+    Alcotest.(check (result string string)) "roundtrip" (Ok s)
+      (Meter_codec.base64_decode (Meter_codec.base64_encode s))
+  done;
+  Alcotest.(check string) "known" "TWFu" (Meter_codec.base64_encode "Man");
+  Alcotest.(check string) "padded" "TWE=" (Meter_codec.base64_encode "Ma");
+  List.iter (fun bad ->
+    Alcotest.(check bool) ("rejects " ^ bad) true (Result.is_error (Meter_codec.base64_decode bad)))
+    ["A=B="; "=AAA"; "A==="; "TWE=TWFu"; "TW=u"; "TWF*"]
+
+(** Test the decoder rejects mask bits past the known fields *)
+let test_codec_unknown_fields () =
+  let packet mask =
+    let buf = Buffer.create 32 in
+    let varint n =
+      let n = ref n in
+      while !n >= 0x80 do
+        Buffer.add_char buf (Char.chr (0x80 lor (!n land 0x7f)));
+        n := !n lsr 7
+      done;
+      Buffer.add_char buf (Char.chr !n)
+    in
+    Buffer.add_char buf 'M';
+    Buffer.add_char buf (Char.chr Meter_codec.version);
+    Buffer.add_char buf '\001';
+    varint 1;
+    Buffer.add_int64_le buf (Int64.bits_of_float 0.0);
+    varint 1;
+    varint 0;
+    varint mask;
+    for i = 0 to Meter_codec.fields do
+      if mask land (1 lsl i) <> 0 then varint 0
+    done;
+    Buffer.contents buf
+  in
+  Alcotest.(check bool) "known fields" true
+    (Result.is_ok (Meter_codec.decode (Meter_codec.create_decoder ()) (packet 1)));
+  Alcotest.(check bool) "unknown field bit" true
+    (Result.is_error
+       (Meter_codec.decode (Meter_codec.create_decoder ()) (packet (1 lor (1 lsl Meter_codec.fields)))))
+
+let test_codec_smaller_than_json () =
+  let frames = List.init 100 (fun i -> track_frame i (-30.0 +. Float.of_int (i mod 20))) in
+  let json = format_event (create_event ~event_type:Meter
+    ~data:(`Assoc [("frames", `List (List.map Metering.frame_to_json frames))]) ()) in
+  let enc = Meter_codec.create_encoder () in
+  let key = format_compact_event (Option.get (Meter_codec.encode enc ~timestamp:1.0 frames)) in
+  Alcotest.(check bool) "keyframe 4x smaller" true (String.length key * 4 < String.length json)
+
+let test_compact_stream () =
+  Eio_main.run @@ fun env ->
+  Eio.Switch.run @@ fun sw ->
+  let clock = Eio.Stdenv.clock env in
+  let config = config_of_json (Yojson.Safe.from_string {|{"encoding": "compact", "track_indices": [1]}|}) in
+  Alcotest.(check bool) "compact" true (config.encoding = Compact);
+  let state = create_stream ~sw ~clock ~config () in
+  let text = meter_tick ~state (frames_of [-10.0; -20.0]) in
+  Alcotest.(check bool) "compact event" true
+    (String.length text > 20 && String.sub text 0 20 = "event: meter_compact");
+  let data =
+    List.find (fun l -> String.length l > 6 && String.sub l 0 6 = "data: ") (String.split_on_char '\n' text)
+  in
+  let packet = Result.get_ok (Meter_codec.base64_decode (String.sub data 6 (String.length data - 6))) in
+  let p = decode_ok (Meter_codec.create_decoder ()) packet in
+  Alcotest.(check (list int)) "subscribed only" [1]
+    (List.map (fun (f : Metering.meter_frame) -> f.track_index) p.frames);
+  Alcotest.(check string) "nothing changed" "" (meter_tick ~state (frames_of [-10.0; -20.0]))
+
+(** {1 Frame Scheduler Tests} *)
+
+(** Run [ticks] manual ticks, claiming each due frame *)
+let drive ticker sched ticks =
+  for _ = 1 to ticks do
+    Ticker.advance ticker 1;
+    while Ticker.due sched do Ticker.take sched done
+  done
+
+let test_schedule_exact () =
+  let ticker = Ticker.manual ~rate:60 () in
+  let sched = Ticker.schedule ticker ~fps:30 in
+  Ticker.take sched;
+  drive ticker sched 60;
+  Alcotest.(check int) "frames" 31 (Ticker.frames sched);
+  Alcotest.(check int) "dropped" 0 (Ticker.dropped sched);
+  Alcotest.(check (float 1e-9)) "achieved fps" 30.0 (Ticker.achieved_fps sched);
+  Alcotest.(check (float 1e-9)) "no jitter" 0.0 (Ticker.jitter sched)
+
+let test_schedule_no_drift () =
+  let ticker = Ticker.manual ~rate:60 () in
+  let sched = Ticker.schedule ticker ~fps:25 in
+  Ticker.take sched;
+  drive ticker sched 119;
+  Alcotest.(check int) "exactly 25 per second" 50 (Ticker.frames sched);
+  Alcotest.(check bool) "achieved fps" true (Float.abs (Ticker.achieved_fps sched -. 25.0) < 0.5)
+
+let test_schedule_catch_up () =
+  let stall policy =
+    let ticker = Ticker.manual ~rate:60 () in
+    let sched = Ticker.schedule ~policy ticker ~fps:60 in
+    Ticker.take sched;
+    Ticker.advance ticker 5;
+    let sent = ref 0 in
+    while Ticker.due sched do Ticker.take sched; incr sent done;
+    (!sent, Ticker.dropped sched)
+  in
+  Alcotest.(check (pair int int)) "skip sends the current frame" (1, 4) (stall Ticker.Skip);
+  Alcotest.(check (pair int int)) "burst sends two missed frames too" (3, 2) (stall (Ticker.Burst 2))
+
+let test_generate_on_ticker () =
+  Eio_main.run @@ fun env ->
+  Eio.Switch.run @@ fun sw ->
+  let clock = Eio.Stdenv.clock env in
+  let ticker = Ticker.manual ~rate:60 () in
+  let state = create_stream ~sw ~clock ~ticker () in
+  start_stream state;
+  let frame () = Some (track_frame 0 (-12.0)) in
+  let events = generate_meter_events ~state ~get_meter_frame:frame () in
+  let rest =
+    match events () with
+    | Seq.Cons (text, rest) ->
+      Alcotest.(check bool) "frame 0 at start" true (String.sub text 0 12 = "event: meter");
+      rest
+    | Seq.Nil -> Alcotest.fail "stream ended"
+  in
+  Eio.Fiber.both
+    (fun () -> ignore (Seq.take 2 rest |> List.of_seq))
+    (fun () -> for _ = 1 to 4 do Eio.Fiber.yield (); Ticker.advance ticker 1 done);
+  let stats = stream_stats state in
+  let int key = Yojson.Safe.Util.(stats |> member key |> to_int) in
+  Alcotest.(check int) "frames on their deadlines" 3 (int "frames");
+  Alcotest.(check int) "none dropped" 0 (int "dropped");
+  stop_stream state
+
+(** {1 Broadcast Tests} *)
+
+(** A writer that blocks until [release] is resolved *)
+let stalled_writer release = fun _ -> Eio.Promise.await release
+
+let broadcast_stat b key = Yojson.Safe.Util.(Broadcast.stats b |> member key |> to_int)
+
+let test_broadcast_slow_client () =
+  Eio_main.run @@ fun _env ->
+  Eio.Switch.run @@ fun sw ->
+  let b = Broadcast.create ~capacity:8 () in
+  let release, resolve = Eio.Promise.create () in
+  let received = ref [] in
+  Eio.Fiber.fork ~sw (fun () -> Broadcast.serve b (stalled_writer release));
+  Eio.Fiber.fork ~sw (fun () -> Broadcast.serve b (fun text -> received := text :: !received));
+  Alcotest.(check int) "two clients" 2 (Broadcast.clients b);
+  List.iter (Broadcast.publish b Broadcast.Notification) ["a"; "b"; "c"];
+  Eio.Fiber.yield ();
+  Alcotest.(check (list string)) "fast client unaffected" ["a"; "b"; "c"] (List.rev !received);
+  Alcotest.(check int) "stalled client queued" 2 (Broadcast.total_depth b);
+  Eio.Promise.resolve resolve ();
+  Eio.Fiber.yield ();
+  Alcotest.(check int) "drained" 0 (Broadcast.total_depth b);
+  Broadcast.close b
+
+let test_broadcast_coalesce () =
+  Eio_main.run @@ fun _env ->
+  Eio.Switch.run @@ fun sw ->
+  let b = Broadcast.create () in
+  let release, resolve = Eio.Promise.create () in
+  let received = ref [] in
+  Eio.Fiber.fork ~sw (fun () ->
+    Broadcast.serve b (fun text -> Eio.Promise.await release; received := text :: !received));
+  Broadcast.publish b Broadcast.Notification "first";
+  Eio.Fiber.yield ();
+  List.iter (Broadcast.publish b Broadcast.Meter) ["m1"; "m2"; "m3"];
+  Broadcast.publish b Broadcast.Notification "note";
+  Alcotest.(check int) "coalesced" 2 (broadcast_stat b "coalesced");
+  Eio.Promise.resolve resolve ();
+  Eio.Fiber.yield ();
+  Alcotest.(check (list string)) "latest meter after notifications"
+    ["first"; "note"; "m3"] (List.rev !received);
+  Broadcast.close b
+
+let test_broadcast_evicts () =
+  Eio_main.run @@ fun _env ->
+  let b = Broadcast.create ~capacity:2 () in
+  let release, _ = Eio.Promise.create () in
+  Eio.Fiber.both
+    (fun () -> Broadcast.serve b (stalled_writer release))
+    (fun () ->
+      (* One stuck in the writer, two queued, the fourth overflows *)
+      Broadcast.publish b Broadcast.Notification "1";
+      Eio.Fiber.yield ();
+      List.iter (Broadcast.publish b Broadcast.Notification) ["2"; "3"; "4"]);
+  Alcotest.(check int) "evicted" 1 (broadcast_stat b "evictions");
+  Alcotest.(check int) "unregistered" 0 (Broadcast.clients b)
+
+let test_broadcast_keepalive () =
+  Eio_main.run @@ fun _env ->
+  Eio.Switch.run @@ fun sw ->
+  let b = Broadcast.create ~keepalive:3.0 ~resolution:1.0 () in
+  let writes = ref 0 in
+  Eio.Fiber.fork ~sw (fun () -> Broadcast.serve b (fun _ -> incr writes));
+  for _ = 1 to 2 do Broadcast.keepalive_tick b ~now:0.0 done;
+  Eio.Fiber.yield ();
+  Alcotest.(check int) "not yet idle" 0 !writes;
+  Broadcast.keepalive_tick b ~now:0.0;
+  Eio.Fiber.yield ();
+  Alcotest.(check int) "one ping per period" 1 !writes;
+  for _ = 1 to 2 do Broadcast.keepalive_tick b ~now:0.0 done;
+  Broadcast.publish b Broadcast.Notification "busy";
+  Eio.Fiber.yield ();
+  Broadcast.keepalive_tick b ~now:0.0;
+  Eio.Fiber.yield ();
+  Alcotest.(check int) "no ping after recent write" 2 !writes;
+  Broadcast.close b
+
+(** {1 Meter Hub Tests} *)
+
+(** Constant source: track [i] at amplitude [0.5 / (i + 1)] *)
+let constant_source i (block : Metering.float32_buffer) =
+  Bigarray.Array1.fill block (0.5 /. Float.of_int (i + 1))
+
+let make_hub ?queue_capacity () =
+  create_hub ?queue_capacity ~sample_rate:48000.0 ~tracks:4 ~source:constant_source ()
+
+let stat hub key = Yojson.Safe.Util.(hub_stats hub |> member key |> to_int)
+
+let event_tracks text =
+  let data =
+    List.find (fun l -> String.length l > 6 && String.sub l 0 6 = "data: ") (String.split_on_char '\n' text)
+  in
+  let json = Yojson.Safe.from_string (String.sub data 6 (String.length data - 6)) in
+  Yojson.Safe.Util.(json |> member "frames" |> to_list
+                    |> List.map (fun f -> f |> member "track_index" |> to_int))
+
+let test_hub_shared_group () =
+  Eio_main.run @@ fun _env ->
+  let hub = make_hub () in
+  let a = subscribe hub { default_config with frame_rate = 60 } in
+  let b = subscribe hub { default_config with frame_rate = 60 } in
+  Alcotest.(check int) "one group" 1 (stat hub "groups");
+  for t = 0 to 4 do hub_tick hub ~timestamp:(Float.of_int t /. 60.0) done;
+  Alcotest.(check int) "encoded once per track per tick" (5 * 4) (stat hub "frames_encoded");
+  Alcotest.(check int) "one event per tick" 5 (stat hub "events");
+  let ea = next_event a and eb = next_event b in
+  Alcotest.(check string) "same event text" ea eb;
+  Alcotest.(check (list int)) "all tracks" [0; 1; 2; 3] (event_tracks ea);
+  Alcotest.(check bool) "latest frame" true (Option.is_some (latest_frame hub 3));
+  unsubscribe hub a;
+  unsubscribe hub b;
+  Alcotest.(check int) "group kept for resumption" 1 (stat hub "groups");
+  for t = 5 to 5 + 120 do hub_tick hub ~timestamp:(Float.of_int t /. 60.0) done;
+  Alcotest.(check int) "idle group dropped" 0 (stat hub "groups")
+
+let test_hub_filter_and_rate () =
+  Eio_main.run @@ fun _env ->
+  let hub = make_hub () in
+  let sub = subscribe hub { default_config with frame_rate = 30; track_indices = Some [2] } in
+  for t = 0 to 5 do hub_tick hub ~timestamp:(Float.of_int t /. 60.0) done;
+  Alcotest.(check int) "every other tick" 3 (stat hub "events");
+  Alcotest.(check int) "only the selected track encoded" 3 (stat hub "frames_encoded");
+  Alcotest.(check (list int)) "filtered" [2] (event_tracks (next_event sub))
+
+let test_hub_compact () =
+  Eio_main.run @@ fun _env ->
+  let hub = make_hub () in
+  let sub = subscribe hub { default_config with frame_rate = 60; encoding = Compact } in
+  hub_tick hub ~timestamp:0.0;
+  let text = next_event sub in
+  Alcotest.(check bool) "compact event" true
+    (String.length text > 20 && String.sub text 0 20 = "event: meter_compact")
+
+let test_hub_slow_subscriber () =
+  Eio_main.run @@ fun _env ->
+  let hub = make_hub ~queue_capacity:2 () in
+  let sub = subscribe hub { default_config with frame_rate = 60 } in
+  for t = 0 to 4 do hub_tick hub ~timestamp:(Float.of_int t /. 60.0) done;
+  Alcotest.(check int) "overflow dropped" 3 (stat hub "dropped");
+  unsubscribe hub sub;
+  Alcotest.(check int) "monotonic after leaving" 3 (stat hub "dropped")
+
+let test_hub_history () =
+  Eio_main.run @@ fun _env ->
+  let hub = make_hub () in
+  for t = 0 to 119 do hub_tick hub ~timestamp:(Float.of_int t /. 60.0) done;
+  let open Yojson.Safe.Util in
+  match history_json hub ~track:1 ~seconds:1.0 ~points:10 with
+  | None -> Alcotest.fail "no history"
+  | Some json ->
+    let points = json |> member "left" |> member "points" |> to_list in
+    Alcotest.(check int) "points" 10 (List.length points);
+    (* Track 1 is a constant 0.25; allow for the meter ballistics settling *)
+    List.iter (fun p ->
+      Alcotest.(check (float 0.02)) "peak" 0.25 (p |> member "max" |> to_number);
+      Alcotest.(check (float 0.02)) "rms" 0.25 (p |> member "rms" |> to_number)) points;
+    Alcotest.(check (float 1e-6)) "last second" 1.0 (json |> member "left" |> member "from_s" |> to_number);
+    Alcotest.(check bool) "unknown track" true (history_json hub ~track:9 ~seconds:1.0 ~points:10 = None)
+
+let test_hub_streams () =
+  Eio_main.run @@ fun _env ->
+  let hub = make_hub () in
+  let id = open_meter_stream hub { default_config with track_indices = Some [1] } in
+  Alcotest.(check bool) "registered" true
+    (Option.map (fun c -> c.track_indices) (meter_stream_config hub id) = Some (Some [1]));
+  Alcotest.(check bool) "closed" true (close_meter_stream hub id);
+  Alcotest.(check bool) "gone" false (close_meter_stream hub id);
+  Alcotest.(check bool) "no config" true (meter_stream_config hub id = None)
+
+(** {1 Replay Tests} *)
+
+let test_replay_since () =
+  let r = Replay.create ~capacity:3 () in
+  let texts = List.map (fun _ -> Replay.push r (Printf.sprintf "id: %d\n")) [(); (); (); ()] in
+  Alcotest.(check (list string)) "ids issued in order"
+    ["id: 1\n"; "id: 2\n"; "id: 3\n"; "id: 4\n"] texts;
+  Alcotest.(check int) "last id" 4 (Replay.last_id r);
+  Alcotest.(check bool) "up to date" true (Replay.since r 4 = Replay.Missed []);
+  Alcotest.(check bool) "missed two" true (Replay.since r 2 = Replay.Missed ["id: 3\n"; "id: 4\n"]);
+  Alcotest.(check bool) "oldest retained" true (Replay.since r 1 = Replay.Missed ["id: 2\n"; "id: 3\n"; "id: 4\n"]);
+  Alcotest.(check bool) "evicted" true (Replay.since r 0 = Replay.Snapshot);
+  Alcotest.(check bool) "unknown future id" true (Replay.since r 9 = Replay.Snapshot);
+  Alcotest.(check (option int)) "parse" (Some 12) (Replay.parse_id " 12");
+  Alcotest.(check (option int)) "parse garbage" None (Replay.parse_id "abc")
+
+let test_broadcast_resume () =
+  Eio_main.run @@ fun _env ->
+  Eio.Switch.run @@ fun sw ->
+  let b = Broadcast.create ~replay:2 () in
+  List.iter (Broadcast.publish b Broadcast.Notification) ["event: n\ndata: 1\n\n"; "event: n\ndata: 2\n\n"; "event: n\ndata: 3\n\n"];
+  let resumed = ref [] and stale = ref [] in
+  Eio.Fiber.fork ~sw (fun () ->
+    Broadcast.serve ~last_event_id:2 b (fun text -> resumed := text :: !resumed));
+  Eio.Fiber.fork ~sw (fun () ->
+    Broadcast.serve ~last_event_id:0 ~snapshot:(fun () -> "{}") b (fun text -> stale := text :: !stale));
+  Alcotest.(check (list string)) "missed notification, pre-encoded"
+    ["id: 3\nevent: n\ndata: 3\n\n"] !resumed;
+  Alcotest.(check (list string)) "snapshot at the latest id"
+    ["event: snapshot\nid: 3\ndata: {}\n\n"] !stale;
+  Broadcast.close b
+
+let packet_of_event text =
+  let data =
+    List.find (fun l -> String.length l > 6 && String.sub l 0 6 = "data: ") (String.split_on_char '\n' text)
+  in
+  Result.get_ok (Meter_codec.base64_decode (String.sub data 6 (String.length data - 6)))
+
+let test_hub_resume () =
+  Eio_main.run @@ fun _env ->
+  (* A level that rises every tick, so every tick builds a delta event *)
+  let level = ref 0.0 in
+  let source i (block : Metering.float32_buffer) =
+    Bigarray.Array1.fill block (!level /. Float.of_int (i + 1))
+  in
+  let hub = create_hub ~sample_rate:48000.0 ~tracks:4 ~source () in
+  let config = { default_config with frame_rate = 60; encoding = Compact } in
+  let tick t =
+    level := 0.1 +. 0.05 *. Float.of_int t;
+    hub_tick hub ~timestamp:(Float.of_int t /. 60.0)
+  in
+  let sub = subscribe hub config in
+  for t = 0 to 2 do tick t done;
+  let first = next_event sub in
+  unsubscribe hub sub;
+  for t = 3 to 5 do tick t done;
+  let built = stat hub "events" in
+  Alcotest.(check int) "one event per tick" 6 built;
+  let again = subscribe ~last_event_id:1 hub config in
+  Alcotest.(check int) "missed events replayed" (built - 1) (stat hub "replayed");
+  (* The replayed deltas continue the client's decoder without a gap *)
+  let dec = Meter_codec.create_decoder () in
+  Alcotest.(check bool) "first was a keyframe" true (decode_ok dec (packet_of_event first)).keyframe;
+  for _ = 2 to built do ignore (decode_ok dec (packet_of_event (next_event again))) done;
+  tick 6;
+  Alcotest.(check int) "event after resuming" (built + 1) (stat hub "events");
+  Alcotest.(check bool) "no keyframe forced by resumption" false
+    (decode_ok dec (packet_of_event (next_event again))).keyframe;
+  let _fresh = subscribe hub config in
+  tick 7;
+  Alcotest.(check bool) "keyframe for a new client" true
+    (decode_ok dec (packet_of_event (next_event again))).keyframe
+
+let test_hub_drop_forces_keyframe () =
+  Eio_main.run @@ fun _env ->
+  let level = ref 0.0 in
+  let source _ (block : Metering.float32_buffer) = Bigarray.Array1.fill block !level in
+  let hub = create_hub ~queue_capacity:1 ~sample_rate:48000.0 ~tracks:1 ~source () in
+  let config = { default_config with frame_rate = 60; encoding = Compact } in
+  let tick t =
+    level := 0.1 +. 0.05 *. Float.of_int t;
+    hub_tick hub ~timestamp:(Float.of_int t /. 60.0)
+  in
+  let sub = subscribe hub config in
+  let dec = Meter_codec.create_decoder () in
+  tick 0;
+  Alcotest.(check bool) "keyframe" true (decode_ok dec (packet_of_event (next_event sub))).keyframe;
+  tick 1;
+  tick 2;
+  Alcotest.(check int) "delta dropped" 1 (stat hub "dropped");
+  ignore (next_event sub);
+  tick 3;
+  Alcotest.(check bool) "keyframe after the drop" true
+    (decode_ok dec (packet_of_event (next_event sub))).keyframe
+
+let test_hub_domains () =
+  (* Enough tracks for the bank's parallel pass; frames match one domain *)
+  let make domains = create_hub ~domains ~sample_rate:48000.0 ~tracks:70 ~source:constant_source () in
+  let seq = make 0 and par = make 1 in
+  Fun.protect ~finally:(fun () -> shutdown_hub par) (fun () ->
+    for t = 0 to 2 do
+      hub_tick seq ~timestamp:(Float.of_int t);
+      hub_tick par ~timestamp:(Float.of_int t)
+    done;
+    for track = 0 to 69 do
+      let level hub = (Option.get (latest_frame hub track)).output.left.rms_db in
+      Alcotest.(check (float 1e-9)) (Printf.sprintf "track %d" track) (level seq) (level par)
+    done)
+
+let event_id text =
+  let line =
+    List.find (fun l -> String.length l > 4 && String.sub l 0 4 = "id: ") (String.split_on_char '\n' text)
+  in
+  int_of_string (String.sub line 4 (String.length line - 4))
+
+let test_hub_ids_after_expiry () =
+  Eio_main.run @@ fun _env ->
+  let hub = create_hub ~replay:2 ~sample_rate:48000.0 ~tracks:1 ~source:constant_source () in
+  let config = { default_config with frame_rate = 60 } in
+  let tick t = hub_tick hub ~timestamp:(Float.of_int t /. 60.0) in
+  let sub = subscribe hub config in
+  tick 0;
+  Alcotest.(check int) "first id" 1 (event_id (next_event sub));
+  unsubscribe hub sub;
+  (* The idle group fills its ring (ids 2, 3) and then expires *)
+  for t = 1 to 3 do tick t done;
+  Alcotest.(check int) "group expired" 0 (stat hub "groups");
+  let again = subscribe ~last_event_id:1 hub config in
+  Alcotest.(check int) "old id not replayed" 0 (stat hub "replayed");
+  tick 4;
+  Alcotest.(check int) "ids continue" 4 (event_id (next_event again))
+
 (** {1 HTTP Headers Test} *)
 
 let test_sse_headers () =
@@ -208,6 +717,43 @@ let () =
       Alcotest.test_case "transport" `Quick test_transport_event;
       Alcotest.test_case "automation" `Quick test_automation_event;
       Alcotest.test_case "meter" `Quick test_meter_event;
+      Alcotest.test_case "meter batch" `Quick test_meter_batch_event;
+    ];
+    "compact encoding", [
+      Alcotest.test_case "roundtrip" `Quick test_codec_roundtrip;
+      Alcotest.test_case "resync" `Quick test_codec_resync;
+      Alcotest.test_case "base64" `Quick test_codec_base64;
+      Alcotest.test_case "unknown fields" `Quick test_codec_unknown_fields;
+      Alcotest.test_case "size" `Quick test_codec_smaller_than_json;
+      Alcotest.test_case "stream" `Quick test_compact_stream;
+    ];
+    "frame scheduler", [
+      Alcotest.test_case "exact ticks" `Quick test_schedule_exact;
+      Alcotest.test_case "no drift" `Quick test_schedule_no_drift;
+      Alcotest.test_case "catch up" `Quick test_schedule_catch_up;
+      Alcotest.test_case "generate on ticker" `Quick test_generate_on_ticker;
+    ];
+    "broadcast", [
+      Alcotest.test_case "slow client" `Quick test_broadcast_slow_client;
+      Alcotest.test_case "coalesce" `Quick test_broadcast_coalesce;
+      Alcotest.test_case "evicts" `Quick test_broadcast_evicts;
+      Alcotest.test_case "keepalive" `Quick test_broadcast_keepalive;
+    ];
+    "replay", [
+      Alcotest.test_case "since" `Quick test_replay_since;
+      Alcotest.test_case "broadcast resume" `Quick test_broadcast_resume;
+      Alcotest.test_case "hub resume" `Quick test_hub_resume;
+      Alcotest.test_case "hub ids after expiry" `Quick test_hub_ids_after_expiry;
+      Alcotest.test_case "hub domains" `Quick test_hub_domains;
+      Alcotest.test_case "hub drop forces keyframe" `Quick test_hub_drop_forces_keyframe;
+    ];
+    "meter hub", [
+      Alcotest.test_case "shared group" `Quick test_hub_shared_group;
+      Alcotest.test_case "filter and rate" `Quick test_hub_filter_and_rate;
+      Alcotest.test_case "compact" `Quick test_hub_compact;
+      Alcotest.test_case "slow subscriber" `Quick test_hub_slow_subscriber;
+      Alcotest.test_case "streams" `Quick test_hub_streams;
+      Alcotest.test_case "history" `Quick test_hub_history;
     ];
     "http", [
       Alcotest.test_case "sse headers" `Quick test_sse_headers;
@@ -0,0 +1,129 @@
+(** WebSocket Transport Tests *)
+
+let hex s = String.concat "" (List.map (fun c -> Printf.sprintf "%02x" (Char.code c)) (List.of_seq (String.to_seq s)))
+
+let mask = "\x37\xfa\x21\x3d"
+
+(** Run [f] on a connection reading [input] (client frames); returns
+    [f]'s result and the bytes the server wrote *)
+let with_conn ?max_message input f =
+  Eio_main.run @@ fun _env ->
+  let out = Buffer.create 64 in
+  let ws = Websocket.create ?max_message (Eio.Buf_read.of_string input) (Eio.Flow.buffer_sink out) in
+  let result = f ws in
+  (result, Buffer.contents out)
+
+let message = Alcotest.testable
+  (fun fmt -> function
+    | Websocket.Text s -> Format.fprintf fmt "Text %S" s
+    | Websocket.Binary s -> Format.fprintf fmt "Binary %S" s
+    | Websocket.Close c -> Format.fprintf fmt "Close %s" (Option.fold ~none:"-" ~some:string_of_int c))
+  ( = )
+
+(** {1 Handshake Tests} *)
+
+let test_sha1 () =
+  Alcotest.(check string) "abc" "a9993e364706816aba3e25717850c26c9cd0d89d" (hex (Websocket.sha1 "abc"));
+  Alcotest.(check string) "empty" "da39a3ee5e6b4b0d3255bfef95601890afd80709" (hex (Websocket.sha1 ""))
+
+let test_accept_key () =
+  (* RFC 6455 section 1.3 *)
+  Alcotest.(check string) "rfc example" "s3pPLMBiTxaQ9kYGzzhZRbK+xOo="
+    (Websocket.accept_key "dGhlIHNhbXBsZSBub25jZQ==")
+
+let test_upgrade_key () =
+  let headers = [
+    ("host", "localhost");
+    ("upgrade", "websocket");
+    ("connection", "keep-alive, Upgrade");
+    ("sec-websocket-key", "dGhlIHNhbXBsZSBub25jZQ==");
+  ] in
+  Alcotest.(check (option string)) "upgrade" (Some "dGhlIHNhbXBsZSBub25jZQ==") (Websocket.upgrade_key headers);
+  Alcotest.(check (option string)) "plain request" None
+    (Websocket.upgrade_key (List.remove_assoc "upgrade" headers));
+  let response = Websocket.handshake_response ~key:"dGhlIHNhbXBsZSBub25jZQ==" in
+  Alcotest.(check bool) "101" true (String.starts_with ~prefix:"HTTP/1.1 101" response);
+  Alcotest.(check bool) "ends headers" true (String.ends_with ~suffix:"\r\n\r\n" response)
+
+(** {1 Frame Tests} *)
+
+let test_text_roundtrip () =
+  let input = Websocket.encode_frame ~mask ~opcode:Websocket.op_text {|{"jsonrpc":"2.0"}|} in
+  let (msg, out) = with_conn input (fun ws ->
+    let msg = Websocket.read_message ws in
+    Websocket.send_text ws "ok";
+    msg)
+  in
+  Alcotest.check message "text" (Websocket.Text {|{"jsonrpc":"2.0"}|}) msg;
+  Alcotest.(check string) "unmasked reply" "\x81\x02ok" out
+
+let test_fragmented () =
+  let input =
+    Websocket.encode_frame ~fin:false ~mask ~opcode:Websocket.op_binary "ab"
+    ^ Websocket.encode_frame ~mask ~opcode:Websocket.op_ping "hi"
+    ^ Websocket.encode_frame ~mask ~opcode:Websocket.op_continuation "cd"
+  in
+  let (msg, out) = with_conn input Websocket.read_message in
+  Alcotest.check message "reassembled" (Websocket.Binary "abcd") msg;
+  Alcotest.(check string) "pong between fragments" "\x8a\x02hi" out
+
+let test_length_encodings () =
+  List.iter (fun len ->
+    let payload = String.make len 'x' in
+    let (msg, _) = with_conn (Websocket.encode_frame ~mask ~opcode:Websocket.op_binary payload)
+      Websocket.read_message
+    in
+    Alcotest.check message (Printf.sprintf "%d bytes" len) (Websocket.Binary payload) msg) [0; 125; 126; 65535; 65536];
+  Alcotest.(check int) "7-bit header" 2 (String.length (Websocket.encode_frame ~opcode:1 (String.make 125 'x')) - 125);
+  Alcotest.(check int) "16-bit header" 4 (String.length (Websocket.encode_frame ~opcode:1 (String.make 126 'x')) - 126);
+  Alcotest.(check int) "64-bit header" 10
+    (String.length (Websocket.encode_frame ~opcode:1 (String.make 65536 'x')) - 65536)
+
+let test_close () =
+  let input = Websocket.encode_frame ~mask ~opcode:Websocket.op_close "\x03\xe8" in
+  let ((msg, closed), out) = with_conn input (fun ws ->
+    let msg = Websocket.read_message ws in
+    Websocket.send_text ws "ignored";
+    (msg, Websocket.is_closed ws))
+  in
+  Alcotest.check message "close" (Websocket.Close (Some 1000)) msg;
+  Alcotest.(check bool) "closed" true closed;
+  Alcotest.(check string) "close echoed, later sends dropped" "\x88\x02\x03\xe8" out
+
+let test_protocol_errors () =
+  let (msg, out) = with_conn (Websocket.encode_frame ~opcode:Websocket.op_text "hi") Websocket.read_message in
+  Alcotest.check message "unmasked" (Websocket.Close (Some 1002)) msg;
+  Alcotest.(check string) "1002 sent" "\x88\x02\x03\xea" out;
+  let (msg, _) = with_conn (Websocket.encode_frame ~mask ~opcode:Websocket.op_continuation "x")
+    Websocket.read_message
+  in
+  Alcotest.check message "stray continuation" (Websocket.Close (Some 1002)) msg;
+  let (msg, _) = with_conn ~max_message:4 (Websocket.encode_frame ~mask ~opcode:Websocket.op_text "hello")
+    Websocket.read_message
+  in
+  Alcotest.check message "too large" (Websocket.Close (Some 1009)) msg
+
+let test_disconnect () =
+  let (raised, _) = with_conn "" (fun ws ->
+    match Websocket.read_message ws with
+    | _ -> false
+    | exception End_of_file -> true)
+  in
+  Alcotest.(check bool) "end of file" true raised
+
+let () =
+  Alcotest.run "WebSocket" [
+    "handshake", [
+      Alcotest.test_case "sha1" `Quick test_sha1;
+      Alcotest.test_case "accept key" `Quick test_accept_key;
+      Alcotest.test_case "upgrade key" `Quick test_upgrade_key;
+    ];
+    "frames", [
+      Alcotest.test_case "text roundtrip" `Quick test_text_roundtrip;
+      Alcotest.test_case "fragmented" `Quick test_fragmented;
+      Alcotest.test_case "length encodings" `Quick test_length_encodings;
+      Alcotest.test_case "close" `Quick test_close;
+      Alcotest.test_case "protocol errors" `Quick test_protocol_errors;
+      Alcotest.test_case "disconnect" `Quick test_disconnect;
+    ];
+  ]